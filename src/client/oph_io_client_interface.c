@@ -23,6 +23,11 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/mman.h>
 
 #include "oph_network.h"
 
@@ -66,6 +71,27 @@ int _oph_io_client_ping_connection(oph_io_client_connection * connection)
 		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 }
 
+static void _oph_io_client_free_requests(oph_io_client_connection * connection)
+{
+	oph_io_client_request *request = NULL;
+
+	while (connection->requests) {
+		request = connection->requests;
+		connection->requests = request->next;
+		if (request->result)
+			oph_io_client_free_result(request->result);
+		free(request);
+	}
+}
+
+//Open a connection to the TCP socket or to the local socket of server
+static int _oph_io_client_open(const char *hostname, const char *port, int *fd)
+{
+	if (hostname[0] == '/')
+		return oph_net_unix_connect(hostname, fd);
+	return oph_net_connect(hostname, port, fd);
+}
+
 int oph_io_client_setup()
 {
 	return OPH_IO_CLIENT_INTERFACE_OK;
@@ -83,8 +109,8 @@ int oph_io_client_connect(const char *hostname, const char *port, const char *db
 
 	if (*connection) {
 		if ((*connection)->socket) {
-			//Check connection state
-			if (!_oph_io_client_ping_connection(*connection)) {
+			//Check connection state (replies of submitted requests would be lost)
+			if (!(*connection)->requests && !_oph_io_client_ping_connection(*connection)) {
 				//Connection established
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection already established\n");
 				return OPH_IO_CLIENT_INTERFACE_OK;
@@ -94,15 +120,22 @@ int oph_io_client_connect(const char *hostname, const char *port, const char *db
 					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while closing connection!\n");
 					return OPH_IO_CLIENT_INTERFACE_IO_ERR;
 				}
+				if ((*connection)->result_types)
+					free((*connection)->result_types);
+				_oph_io_client_free_requests(*connection);
 				free(*connection);
 			}
-		} else
+		} else {
+			if ((*connection)->result_types)
+				free((*connection)->result_types);
+			_oph_io_client_free_requests(*connection);
 			free(*connection);
+		}
 	}
 
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connecting to %s:%s...\n", hostname, port);
 
-	if (oph_net_connect(hostname, port, &fd) != 0) {
+	if (_oph_io_client_open(hostname, port, &fd) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Connection error\n");
 		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
 	}
@@ -119,6 +152,13 @@ int oph_io_client_connect(const char *hostname, const char *port, const char *db
 	(*connection)->host[OPH_IO_CLIENT_HOST_LEN - 1] = 0;
 	(*connection)->db_name[0] = 0;
 	(*connection)->socket = fd;
+	(*connection)->result_stream = 0;
+	(*connection)->options = 0;
+	(*connection)->result_types = NULL;
+	(*connection)->requests = NULL;
+	(*connection)->last_request_id = 0;
+	memset(&((*connection)->sent_stats), 0, sizeof(oph_io_client_compression_stats));
+	memset(&((*connection)->received_stats), 0, sizeof(oph_io_client_compression_stats));
 
 	//Set default db
 	if (db_name) {
@@ -134,6 +174,76 @@ int oph_io_client_connect(const char *hostname, const char *port, const char *db
 }
 
 
+int oph_io_client_set_options(oph_io_client_connection * connection, unsigned int options)
+{
+	if (!connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+
+	char request[OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN];
+	char reply[OPH_IO_CLIENT_MSG_TYPE_LEN + 1];
+	unsigned int m = 0;
+	int res = 0, fd = 0;
+
+	//Compression can be requested only if supported by the library
+	if (!oph_net_compression_supported())
+		options &= ~OPH_IO_CLIENT_OPT_COMPRESSION;
+
+	//Build request packet TYPE|OPTIONS
+	memcpy(request, OPH_IO_CLIENT_MSG_PING_OPTIONS, OPH_IO_CLIENT_MSG_TYPE_LEN);
+	m += OPH_IO_CLIENT_MSG_TYPE_LEN;
+	memcpy(request + m, (void *) &options, OPH_IO_CLIENT_MSG_SHORT_LEN);
+	m += OPH_IO_CLIENT_MSG_SHORT_LEN;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", m);
+	if (write(connection->socket, (void *) request, m) != m) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+	}
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for answer...\n");
+	res = oph_net_readn(connection->socket, reply, OPH_IO_CLIENT_MSG_TYPE_LEN);
+	if (res != OPH_IO_CLIENT_MSG_TYPE_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+	reply[OPH_IO_CLIENT_MSG_TYPE_LEN] = 0;
+
+	if (STRCMP(OPH_IO_CLIENT_MSG_PING_OPTIONS, reply) != 0) {
+		//Server closes the connection after an unknown request
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Protocol options are not supported by server\n");
+		close(connection->socket);
+		connection->socket = 0;
+		connection->options = 0;
+		if (_oph_io_client_open(connection->host, connection->port, &fd) != 0) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Connection error\n");
+			return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+		}
+		connection->socket = fd;
+		if (connection->db_name[0]) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Default database has to be set again\n");
+			connection->db_name[0] = 0;
+			return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+		}
+		return OPH_IO_CLIENT_INTERFACE_OK;
+	}
+
+	if (oph_net_readn(connection->socket, request, OPH_IO_CLIENT_MSG_SHORT_LEN) != OPH_IO_CLIENT_MSG_SHORT_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+	memcpy(&(connection->options), request, OPH_IO_CLIENT_MSG_SHORT_LEN);
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Enabled options: %u\n", connection->options);
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
 int oph_io_client_use_db(const char *db_name, const char *device, oph_io_client_connection * connection)
 {
 	if (!db_name || !connection || !device) {
@@ -151,6 +261,10 @@ int oph_io_client_use_db(const char *db_name, const char *device, oph_io_client_
 		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
 		return OPH_IO_CLIENT_INTERFACE_OK;
 	}
+	if (connection->requests) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Submitted requests have to be completed first\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
 
 	//set default db
 	char *request = NULL;
@@ -332,45 +446,55 @@ int oph_io_client_setup_query(oph_io_client_connection * connection, const char
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
-int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_client_query * query)
+//Check if an argument is binary and at least min_len bytes long (to be passed in shared memory or compressed)
+static int _oph_io_client_large_arg(oph_io_client_query_arg * arg, unsigned long long min_len)
 {
+	return (arg->arg_type == OPH_IO_CLIENT_TYPE_LONG_BLOB || arg->arg_type == OPH_IO_CLIENT_TYPE_BLOB || arg->arg_type == OPH_IO_CLIENT_TYPE_BIT)
+	    && arg->arg_length >= min_len;
+}
 
-	if (!connection || !query || !query->query) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
-		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
-	}
+//Update compression statistics with a frame processed since start
+static void _oph_io_client_compression_update(oph_io_client_compression_stats * stats, unsigned long long raw_len, unsigned long long packed_len, struct timeval *start)
+{
+	struct timeval end;
 
-	if (connection->socket) {
-		//Check connection state
-/*    if(_oph_io_client_ping_connection(connection)){
-      pmesg(LOG_DEBUG,__FILE__,__LINE__,"Connection was closed\n");
-      return OPH_IO_CLIENT_INTERFACE_DATA_ERR;    
-    }*/
-	} else {
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
-		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
-	}
+	gettimeofday(&end, NULL);
+	stats->frames++;
+	stats->raw_len += raw_len;
+	stats->packed_len += packed_len;
+	stats->time += (end.tv_sec - start->tv_sec) + (end.tv_usec - start->tv_usec) / 1000000.0;
+}
 
+//Complete the message of a query with the arguments of its current run; with shm set, large binary args are stored in the segment returned in shm_fd,
+//otherwise they are compressed if enabled on connection
+static int _oph_io_client_build_query(oph_io_client_connection * connection, oph_io_client_query * query, char shm, unsigned int *len, int *shm_fd)
+{
 	unsigned int n = 0, m = 0;
-	int res = 0;
-
-	if (!query->args) {
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", query->fixed_length);
-		if (write(connection->socket, (void *) query->query, query->fixed_length) != query->fixed_length) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
-			return OPH_IO_CLIENT_INTERFACE_IO_ERR;
-		}
-	} else {
+	unsigned long long shm_len = 0, offset = 0, packed_arg_len = 0;
+	char *segment = NULL, compress = (connection->options & OPH_IO_CLIENT_OPT_COMPRESSION) ? 1 : 0;
+	size_t packed_len = 0;
+	struct timeval start;
+
+	*shm_fd = -1;
+	if (!query->args)
+		m = query->fixed_length;
+	else {
 		//Re-calculate variable part length
 		unsigned long long arg_len = query->args_count * (strlen(OPH_IO_CLIENT_MSG_ARG_DATA_LONG) + 1 + sizeof(unsigned long long));
 		//Get size of variable args   
 		for (n = 0; n < query->args_count; n++) {
-			arg_len += query->args[n]->arg_length;
+			if (shm && _oph_io_client_large_arg(query->args[n], OPH_IO_CLIENT_SHM_ARG_LEN)) {
+				arg_len += sizeof(unsigned long long);
+				shm_len += query->args[n]->arg_length;
+			} else if (compress && _oph_io_client_large_arg(query->args[n], OPH_IO_CLIENT_COMPRESS_LEN))
+				arg_len += sizeof(unsigned long long) + oph_net_compress_bound(query->args[n]->arg_length);
+			else
+				arg_len += query->args[n]->arg_length;
 		}
 		char *query_ptr = NULL;
 		if (arg_len > query->args_length) {
 			//Realloc args array 
-			query_ptr = realloc(query->query, arg_len);
+			query_ptr = realloc(query->query, query->fixed_length + arg_len);
 			if (!query_ptr) {
 				pmesg(LOG_ERROR, __FILE__, __LINE__, "Error allocation memory\n");
 				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
@@ -378,6 +502,17 @@ int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_cl
 			query->query = query_ptr;
 			query->args_length = arg_len;
 		}
+		if (shm_len) {
+			if (oph_net_shm_create(shm_len, shm_fd))
+				return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+			segment = (char *) mmap(NULL, shm_len, PROT_READ | PROT_WRITE, MAP_SHARED, *shm_fd, 0);
+			if (segment == MAP_FAILED) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to map shared memory segment\n");
+				close(*shm_fd);
+				*shm_fd = -1;
+				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+			}
+		}
 
 		m = query->fixed_length - sizeof(unsigned long long);
 		//Store current row number into buffer
@@ -408,24 +543,115 @@ int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_cl
 				case OPH_IO_CLIENT_TYPE_LONG_BLOB:
 				case OPH_IO_CLIENT_TYPE_BLOB:
 				case OPH_IO_CLIENT_TYPE_BIT:
+					if (segment && _oph_io_client_large_arg(query->args[n], OPH_IO_CLIENT_SHM_ARG_LEN)) {
+						//Only the offset in segment is sent
+						m += snprintf(query->query + m, strlen(OPH_IO_CLIENT_MSG_ARG_DATA_SHM) + 1, OPH_IO_CLIENT_MSG_ARG_DATA_SHM);
+						memcpy(query->query + m, (void *) &offset, sizeof(unsigned long long));
+						m += sizeof(unsigned long long);
+						memcpy(segment + offset, (void *) (query->args[n]->arg), query->args[n]->arg_length);
+						offset += query->args[n]->arg_length;
+						continue;
+					}
+					if (compress && _oph_io_client_large_arg(query->args[n], OPH_IO_CLIENT_COMPRESS_LEN)) {
+						//Compressed data are stored after type and original length, the arg is sent as it is if compression does not pay
+						gettimeofday(&start, NULL);
+						packed_len = oph_net_compress_bound(query->args[n]->arg_length);
+						if (!oph_net_compress(query->args[n]->arg, query->args[n]->arg_length, query->query + m + strlen(OPH_IO_CLIENT_MSG_ARG_DATA_COMPRESSED) + sizeof(unsigned long long),
+								      &packed_len) && sizeof(unsigned long long) + packed_len < query->args[n]->arg_length) {
+							packed_arg_len = sizeof(unsigned long long) + packed_len;
+							memcpy(query->query + m - sizeof(unsigned long long), (void *) &packed_arg_len, sizeof(unsigned long long));
+							m += snprintf(query->query + m, strlen(OPH_IO_CLIENT_MSG_ARG_DATA_COMPRESSED) + 1, OPH_IO_CLIENT_MSG_ARG_DATA_COMPRESSED);
+							memcpy(query->query + m, (void *) &(query->args[n]->arg_length), sizeof(unsigned long long));
+							m += packed_arg_len;
+							_oph_io_client_compression_update(&(connection->sent_stats), query->args[n]->arg_length, packed_arg_len, &start);
+							continue;
+						}
+						_oph_io_client_compression_update(&(connection->sent_stats), query->args[n]->arg_length, query->args[n]->arg_length, &start);
+					}
 					m += snprintf(query->query + m, strlen(OPH_IO_CLIENT_MSG_ARG_DATA_BLOB) + 1, OPH_IO_CLIENT_MSG_ARG_DATA_BLOB);
 					break;
 				default:
 					pmesg(LOG_ERROR, __FILE__, __LINE__, "Argument type not recognized\n");
+					if (segment) {
+						munmap(segment, shm_len);
+						close(*shm_fd);
+						*shm_fd = -1;
+					}
 					return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
 			}
 			memcpy(query->query + m, (void *) (query->args[n]->arg), query->args[n]->arg_length);
 			m += query->args[n]->arg_length;
 		}
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", m);
-		if (write(connection->socket, (void *) query->query, m) != m) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
-			return OPH_IO_CLIENT_INTERFACE_IO_ERR;
-		}
+		if (segment)
+			munmap(segment, shm_len);
+	}
 
+	*len = m;
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+//Send the next run of a query, optionally preceded by head and followed by tail
+static int _oph_io_client_send_query(oph_io_client_connection * connection, oph_io_client_query * query, char *head, unsigned int head_len, char *tail, unsigned int tail_len)
+{
+	unsigned int m = 0;
+	struct iovec iov[3];
+	int iov_num = 0;
+	int res = 0, shm_fd = -1;
+	ssize_t n = 0;
+
+	if ((res = _oph_io_client_build_query(connection, query, (connection->options & OPH_IO_CLIENT_OPT_SHARED_MEMORY) ? 1 : 0, &m, &shm_fd)))
+		return res;
+
+	//Send the whole message with a single system call
+	if (head_len) {
+		iov[iov_num].iov_base = head;
+		iov[iov_num++].iov_len = head_len;
+	}
+	iov[iov_num].iov_base = query->query;
+	iov[iov_num++].iov_len = m;
+	if (tail_len) {
+		iov[iov_num].iov_base = tail;
+		iov[iov_num++].iov_len = tail_len;
+	}
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", head_len + m + tail_len);
+	if (shm_fd >= 0) {
+		//The server has its own reference to the segment once it is passed
+		n = oph_net_writev_fd(connection->socket, iov, iov_num, shm_fd);
+		close(shm_fd);
+	} else
+		n = oph_net_writev(connection->socket, iov, iov_num, NULL);
+	if (n != (ssize_t) (head_len + m + tail_len)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+	}
+	if (query->args)
 		query->curr_run++;
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_client_query * query)
+{
+
+	if (!connection || !query || !query->query) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	if (connection->requests) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Submitted requests have to be completed first\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
 	}
 
+	int res = 0;
+
+	if ((res = _oph_io_client_send_query(connection, query, NULL, 0, NULL, 0)))
+		return res;
+
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for answer...\n");
 
 	//Decode response
@@ -447,6 +673,99 @@ int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_cl
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
+int oph_io_client_execute_batch(oph_io_client_connection * connection, oph_io_client_query ** queries, unsigned int query_num, unsigned int flags, char *status)
+{
+
+	if (!connection || !queries || !query_num || !status) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	if (connection->requests) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Submitted requests have to be completed first\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+
+	char head[OPH_IO_CLIENT_MSG_TYPE_LEN + 2 * OPH_IO_CLIENT_MSG_SHORT_LEN];
+	char *batch = NULL, *tmp = NULL;
+	unsigned long long batch_len = 0, batch_size = 0;
+	unsigned int n = 0, m = 0;
+	int res = 0, shm_fd = -1;
+
+	//Queries are copied in a single buffer, since the same query can be given several times
+	for (n = 0; n < query_num; n++) {
+		if (!queries[n] || !queries[n]->query) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+			free(batch);
+			return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+		}
+		//Args are always sent inline, since a single segment can be passed with the batch
+		if ((res = _oph_io_client_build_query(connection, queries[n], 0, &m, &shm_fd))) {
+			free(batch);
+			return res;
+		}
+		if (batch_len + m > batch_size) {
+			batch_size = 2 * (batch_len + m);
+			tmp = (char *) realloc(batch, batch_size);
+			if (!tmp) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Error allocation memory\n");
+				free(batch);
+				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+			}
+			batch = tmp;
+		}
+		memcpy(batch + batch_len, queries[n]->query, m);
+		batch_len += m;
+		if (queries[n]->args)
+			queries[n]->curr_run++;
+	}
+
+	memcpy(head, OPH_IO_CLIENT_MSG_BATCH_QUERY, OPH_IO_CLIENT_MSG_TYPE_LEN);
+	memcpy(head + OPH_IO_CLIENT_MSG_TYPE_LEN, (void *) &flags, OPH_IO_CLIENT_MSG_SHORT_LEN);
+	memcpy(head + OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN, (void *) &query_num, OPH_IO_CLIENT_MSG_SHORT_LEN);
+
+	struct iovec iov[2];
+	iov[0].iov_base = head;
+	iov[0].iov_len = sizeof(head);
+	iov[1].iov_base = batch;
+	iov[1].iov_len = batch_len;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %llu bytes\n", sizeof(head) + batch_len);
+	if (oph_net_writev(connection->socket, iov, 2, NULL) != (ssize_t) (sizeof(head) + batch_len)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		free(batch);
+		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+	}
+	free(batch);
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for answer...\n");
+
+	//Decode response TYPE|QUERY_NUM|STATUS1|STATUS2|...
+	char reply[OPH_IO_CLIENT_MSG_TYPE_LEN + 1];
+	if (oph_net_readn(connection->socket, reply, OPH_IO_CLIENT_MSG_TYPE_LEN) != (ssize_t) OPH_IO_CLIENT_MSG_TYPE_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+	reply[OPH_IO_CLIENT_MSG_TYPE_LEN] = 0;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response received: %s\n", reply);
+
+	if (STRCMP(OPH_IO_CLIENT_MSG_BATCH_QUERY, reply) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error executing query batch\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+	if (oph_net_readn(connection->socket, (void *) &m, OPH_IO_CLIENT_MSG_SHORT_LEN) != (ssize_t) OPH_IO_CLIENT_MSG_SHORT_LEN || m != query_num
+	    || oph_net_readn(connection->socket, status, query_num) != (ssize_t) query_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error receiving query status\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Query batch executed\n");
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
 int oph_io_client_free_query(oph_io_client_query * query)
 {
 	if (!query) {
@@ -461,199 +780,580 @@ int oph_io_client_free_query(oph_io_client_query * query)
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
-int oph_io_client_get_result(oph_io_client_connection * connection, oph_io_client_result ** result_set)
+//Release the payload of a result set part, read from socket or mapped from shared memory
+static void _oph_io_client_free_payload(char *reply, unsigned long long payload_len, char mapped)
 {
-	if (!result_set || !connection) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
-		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	if (mapped)
+		munmap(reply, payload_len);
+	else
+		free(reply);
+}
+
+//Read next part of a streamed result set and append its rows to result set; end is set to 1 when the end marker is received
+static int _oph_io_client_read_result_part(oph_io_client_connection * connection, oph_io_client_result * result, unsigned long long *max_rows, char *end)
+{
+	char reply_type[OPH_IO_CLIENT_MSG_TYPE_LEN + 1];
+	char reply_info[sizeof(unsigned long long)] = { 0 };
+	unsigned long long payload_len = 0, num_rows = 0, i = 0, string_head = 0, field_length = 0, raw_length = 0;
+	unsigned int num_fields = 0, j = 0;
+	oph_io_client_record **tmp = NULL, *record = NULL;
+	int res = 0, shm_fd = -1;
+	char mapped = 0, packed = 0;
+	struct timeval start;
+
+	*end = 0;
+
+	res = oph_net_readn(connection->socket, reply_type, OPH_IO_CLIENT_MSG_TYPE_LEN);
+	if (res != OPH_IO_CLIENT_MSG_TYPE_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 	}
+	reply_type[OPH_IO_CLIENT_MSG_TYPE_LEN] = 0;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response received: %s\n", reply_type);
 
-	if (connection->socket) {
-		//Check connection state
-/*    if(_oph_io_client_ping_connection(connection)){
-      pmesg(LOG_DEBUG,__FILE__,__LINE__,"Connection was closed\n");
-      return OPH_IO_CLIENT_INTERFACE_OK;    
-    }*/
+	if (STRCMP(OPH_IO_CLIENT_MSG_RESULT_TYPES, reply_type) == 0) {
+		//Type header NUM_FIELDS|FIELD_TYPES, followed by the first part
+		if (oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_SHORT_LEN) != OPH_IO_CLIENT_MSG_SHORT_LEN) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		memcpy(&num_fields, reply_info, sizeof(unsigned int));
+		if (connection->result_types)
+			free(connection->result_types);
+		connection->result_types = (char *) calloc(num_fields + 1, sizeof(char));
+		if (!connection->result_types) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
+		if (num_fields && oph_net_readn(connection->socket, connection->result_types, num_fields) != (ssize_t) num_fields) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Field types: %s\n", connection->result_types);
+
+		res = oph_net_readn(connection->socket, reply_type, OPH_IO_CLIENT_MSG_TYPE_LEN);
+		if (res != OPH_IO_CLIENT_MSG_TYPE_LEN) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		reply_type[OPH_IO_CLIENT_MSG_TYPE_LEN] = 0;
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response received: %s\n", reply_type);
+	}
+
+	if (STRCMP(OPH_IO_CLIENT_MSG_RESULT_END, reply_type) == 0) {
+		//End marker TOTAL_ROWS|NUM_FIELDS
+		if (oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_LONG_LEN) != OPH_IO_CLIENT_MSG_LONG_LEN) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		memcpy(&num_rows, reply_info, sizeof(unsigned long long));
+		if (oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_SHORT_LEN) != OPH_IO_CLIENT_MSG_SHORT_LEN) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		memcpy(&num_fields, reply_info, sizeof(unsigned int));
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result set completed: %llu rows\n", num_rows);
+		if (!result->num_fields)
+			result->num_fields = num_fields;
+		*end = 1;
+	} else if (STRCMP(OPH_IO_CLIENT_MSG_RESULT_PART, reply_type) == 0 || STRCMP(OPH_IO_CLIENT_MSG_RESULT_SHM, reply_type) == 0) {
+		//Part PAYLOAD_LENGTH|NUM_ROWS|NUM_FIELDS|PAYLOAD, where payload can be replaced by a marker carrying a shared memory segment
+		if (oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_LONG_LEN) != OPH_IO_CLIENT_MSG_LONG_LEN) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		memcpy(&payload_len, reply_info, sizeof(unsigned long long));
+		if (oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_LONG_LEN) != OPH_IO_CLIENT_MSG_LONG_LEN) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		memcpy(&num_rows, reply_info, sizeof(unsigned long long));
+		if (oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_SHORT_LEN) != OPH_IO_CLIENT_MSG_SHORT_LEN) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
+		memcpy(&num_fields, reply_info, sizeof(unsigned int));
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Part of %llu bytes with %llu rows\n", payload_len, num_rows);
+		if (STRCMP(OPH_IO_CLIENT_MSG_RESULT_SHM, reply_type) == 0 && (oph_net_readn_fd(connection->socket, reply_info, 1, &shm_fd) != 1 || shm_fd < 0)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Shared memory segment has not been received\n");
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
 	} else {
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error transfering result\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+
+	if (shm_fd >= 0 && (!num_rows || !payload_len)) {
+		close(shm_fd);
+		shm_fd = -1;
+	}
+
+	if (!result->max_field_length) {
+		result->num_fields = num_fields;
+		result->max_field_length = (unsigned long long *) calloc(num_fields + 1, sizeof(unsigned long long));
+		if (!result->max_field_length) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			if (shm_fd >= 0)
+				close(shm_fd);
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
+		if (connection->result_types) {
+			result->field_type = (char *) malloc((num_fields + 1) * sizeof(char));
+			if (!result->field_type) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+				if (shm_fd >= 0)
+					close(shm_fd);
+				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+			}
+			memcpy(result->field_type, connection->result_types, num_fields + 1);
+		}
+	} else if (result->num_fields != num_fields) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Number of fields is not coherent\n");
+		if (shm_fd >= 0)
+			close(shm_fd);
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+	//Keep result set NULL terminated
+	if (!result->result_set || result->num_rows + num_rows > *max_rows) {
+		*max_rows = result->num_rows + num_rows > 2 * (*max_rows) ? result->num_rows + num_rows : 2 * (*max_rows);
+		tmp = (oph_io_client_record **) realloc(result->result_set, (*max_rows + 1) * sizeof(oph_io_client_record *));
+		if (!tmp) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			if (shm_fd >= 0)
+				close(shm_fd);
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
+		result->result_set = tmp;
+		result->result_set[result->num_rows] = NULL;
+	}
+
+	if (*end || !num_rows)
 		return OPH_IO_CLIENT_INTERFACE_OK;
+
+	//Read payload (binary format)
+	char *reply = NULL;
+	if (shm_fd >= 0) {
+		reply = (char *) mmap(NULL, payload_len, PROT_READ, MAP_SHARED, shm_fd, 0);
+		close(shm_fd);
+		if (reply == MAP_FAILED) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to map shared memory segment\n");
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
+		mapped = 1;
+	} else {
+		reply = (char *) malloc(payload_len * sizeof(char));
+		if (!reply) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error allocation memory\n");
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
+		res = oph_net_readn(connection->socket, reply, payload_len);
+		if (res < 0 || (unsigned long long) res != payload_len) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+			free(reply);
+			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+		}
 	}
 
-	char request[strlen(OPH_IO_CLIENT_MSG_RESULT) + 1];
-	unsigned int m = 0;
-	int res = 0;
+	for (i = 0; i < num_rows; i++) {
+		record = (oph_io_client_record *) calloc(1, sizeof(oph_io_client_record));
+		if (!record) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			_oph_io_client_free_payload(reply, payload_len, mapped);
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
+		//Append record before filling it, so that it is released together with result set in case of errors
+		result->result_set[result->num_rows++] = record;
+		result->result_set[result->num_rows] = NULL;
+		record->field_type = result->field_type;
+
+		record->field_length = (unsigned long *) calloc(num_fields, sizeof(unsigned long));
+		record->field = (char **) calloc(num_fields + 1, sizeof(char *));
+		if (!record->field_length || !record->field) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+			_oph_io_client_free_payload(reply, payload_len, mapped);
+			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		}
 
-	//Build request packet TYPE
-	m = snprintf(request, strlen(OPH_IO_CLIENT_MSG_RESULT) + 1, OPH_IO_CLIENT_MSG_RESULT);
+		for (j = 0; j < num_fields; j++) {
+			//Extract field length
+			if (string_head + OPH_IO_CLIENT_MSG_LONG_LEN > payload_len) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Result set part is corrupted\n");
+				_oph_io_client_free_payload(reply, payload_len, mapped);
+				return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+			}
+			memcpy(&field_length, reply + string_head, OPH_IO_CLIENT_MSG_LONG_LEN);
+			string_head += OPH_IO_CLIENT_MSG_LONG_LEN;
+			packed = (field_length & OPH_IO_CLIENT_FIELD_COMPRESSED) ? 1 : 0;
+			field_length &= ~OPH_IO_CLIENT_FIELD_COMPRESSED;
+			if (string_head + field_length > payload_len || (packed && field_length < OPH_IO_CLIENT_MSG_LONG_LEN)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Result set part is corrupted\n");
+				_oph_io_client_free_payload(reply, payload_len, mapped);
+				return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+			}
+			//Compressed fields RAW_LENGTH|DATA are uncompressed directly in the record
+			raw_length = field_length;
+			if (packed)
+				memcpy(&raw_length, reply + string_head, OPH_IO_CLIENT_MSG_LONG_LEN);
+			record->field_length[j] = raw_length;
+			pmesg(LOG_DEBUG, __FILE__, __LINE__, "Field %u, row %llu length is: %lu\n", j, result->num_rows - 1, record->field_length[j]);
+
+			record->field[j] = (char *) malloc(raw_length ? raw_length : 1);
+			if (!record->field[j]) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+				_oph_io_client_free_payload(reply, payload_len, mapped);
+				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+			}
+			if (packed) {
+				gettimeofday(&start, NULL);
+				if (oph_net_uncompress(reply + string_head + OPH_IO_CLIENT_MSG_LONG_LEN, field_length - OPH_IO_CLIENT_MSG_LONG_LEN, record->field[j], raw_length)) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to uncompress field\n");
+					_oph_io_client_free_payload(reply, payload_len, mapped);
+					return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+				}
+				_oph_io_client_compression_update(&(connection->received_stats), raw_length, field_length, &start);
+			} else
+				memcpy(record->field[j], reply + string_head, field_length);
+			string_head += field_length;
+
+			//Set max field length
+			if (result->max_field_length[j] < raw_length)
+				result->max_field_length[j] = raw_length;
+		}
+	}
+	_oph_io_client_free_payload(reply, payload_len, mapped);
 
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", m);
-	if (write(connection->socket, (void *) request, m) != m) {
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+static int _oph_io_client_request_result(oph_io_client_connection * connection)
+{
+	if (connection->result_types) {
+		free(connection->result_types);
+		connection->result_types = NULL;
+	}
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", OPH_IO_CLIENT_MSG_TYPE_LEN);
+	if (write(connection->socket, (void *) OPH_IO_CLIENT_MSG_RESULT_STREAM, OPH_IO_CLIENT_MSG_TYPE_LEN) != OPH_IO_CLIENT_MSG_TYPE_LEN) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
 		return OPH_IO_CLIENT_INTERFACE_IO_ERR;
 	}
-
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for answer...\n");
-	//transfer result + build structure
 
-	char reply_type[strlen(OPH_IO_CLIENT_MSG_RESULT) + 1];
-	res = oph_net_readn(connection->socket, reply_type, strlen(OPH_IO_CLIENT_MSG_RESULT));
-	if (!res) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
-		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_get_result(oph_io_client_connection * connection, oph_io_client_result ** result_set)
+{
+	if (!result_set || !connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
 	}
-	reply_type[strlen(OPH_IO_CLIENT_MSG_RESULT)] = 0;
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response received: %s\n", reply_type);
 
-	if (STRCMP(OPH_IO_CLIENT_MSG_RESULT, reply_type) != 0) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error transfering result\n");
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_OK;
+	}
+	if (connection->result_stream) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "A result set is already being retrieved\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+	if (connection->requests) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Submitted requests have to be completed first\n");
 		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
 	}
+
+	int res = 0;
+	char end = 0;
+	unsigned long long max_rows = 0;
+
+	if ((res = _oph_io_client_request_result(connection)))
+		return res;
+
+	//Rebuild result set struct part by part
+	*result_set = (oph_io_client_result *) calloc(1, sizeof(oph_io_client_result));
+	if (!(*result_set)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+		return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+	}
+
+	while (!end) {
+		if ((res = _oph_io_client_read_result_part(connection, *result_set, &max_rows, &end))) {
+			oph_io_client_free_result(*result_set);
+			*result_set = NULL;
+			return res;
+		}
+	}
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Transfer executed\n");
 
-	//Read payload len
-	char reply_info[sizeof(unsigned long long)] = { 0 };
-	unsigned long long payload_len = 0;
-	res = oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_LONG_LEN);
-	if (!res) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
-		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_get_result_part(oph_io_client_connection * connection, oph_io_client_result ** result_set)
+{
+	if (!result_set || !connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
 	}
-	memcpy(&payload_len, reply_info, sizeof(unsigned long long));
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Response length: %llu\n", payload_len);
+	*result_set = NULL;
 
-	unsigned long long num_rows = 0;
-	res = oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_LONG_LEN);
-	if (!res) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
-		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_OK;
 	}
-	memcpy(&num_rows, reply_info, sizeof(unsigned long long));
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Number of rows: %llu\n", num_rows);
 
-	unsigned int num_fields = 0;
-	res = oph_net_readn(connection->socket, reply_info, OPH_IO_CLIENT_MSG_SHORT_LEN);
-	if (!res) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
-		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	int res = 0;
+	char end = 0;
+	unsigned long long max_rows = 0;
+
+	if (!connection->result_stream) {
+		if (connection->requests) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Submitted requests have to be completed first\n");
+			return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+		}
+		if ((res = _oph_io_client_request_result(connection)))
+			return res;
+		connection->result_stream = 1;
 	}
-	memcpy(&num_fields, reply_info, sizeof(unsigned int));
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Number of fields: %u\n", num_fields);
 
-	//Rebuild result set struct
 	*result_set = (oph_io_client_result *) calloc(1, sizeof(oph_io_client_result));
 	if (!(*result_set)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-		*result_set = NULL;
+		connection->result_stream = 0;
 		return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
 	}
-	(*result_set)->num_rows = num_rows;
-	(*result_set)->num_fields = num_fields;
-	(*result_set)->current_row = 0;
-	(*result_set)->result_set = 0;
-	(*result_set)->max_field_length = (unsigned long long *) calloc(num_fields, sizeof(unsigned long long));
 
-	if (!(*result_set)->max_field_length) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
+	res = _oph_io_client_read_result_part(connection, *result_set, &max_rows, &end);
+	if (res || end) {
+		//The whole result set has been retrieved
 		oph_io_client_free_result(*result_set);
 		*result_set = NULL;
-		return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		connection->result_stream = 0;
 	}
-	(*result_set)->result_set = (oph_io_client_record **) calloc(num_rows + 1, sizeof(oph_io_client_record *));
 
-	if (!((*result_set)->result_set)) {
+	return res;
+}
+
+int oph_io_client_submit_query(oph_io_client_connection * connection, oph_io_client_query * query, char get_result, unsigned int *request_id)
+{
+	if (!connection || !query || !query->query || !request_id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	*request_id = 0;
+
+	if (!connection->socket) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection was closed\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	if (connection->result_stream) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "A result set is already being retrieved\n");
+		return OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
+	}
+
+	char head[OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN], tail[2 * OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN];
+	oph_io_client_request *request = NULL, **last = NULL;
+	int res = 0;
+
+	request = (oph_io_client_request *) calloc(1, sizeof(oph_io_client_request));
+	if (!request) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-		oph_io_client_free_result(*result_set);
-		*result_set = NULL;
 		return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
 	}
-	unsigned long long i = 0, j = 0;
+	//Identifier 0 is never used
+	if (!++connection->last_request_id)
+		++connection->last_request_id;
+	request->id = connection->last_request_id;
+	request->get_result = get_result ? 1 : 0;
+	request->replies = get_result ? 2 : 1;
+
+	//Build request packets TYPE|REQUEST_ID|QUERY[|TYPE|REQUEST_ID|RESULT_REQUEST]
+	memcpy(head, OPH_IO_CLIENT_MSG_TAGGED, OPH_IO_CLIENT_MSG_TYPE_LEN);
+	memcpy(head + OPH_IO_CLIENT_MSG_TYPE_LEN, (void *) &(request->id), OPH_IO_CLIENT_MSG_SHORT_LEN);
+	memcpy(tail, head, sizeof(head));
+	memcpy(tail + sizeof(head), OPH_IO_CLIENT_MSG_RESULT_STREAM, OPH_IO_CLIENT_MSG_TYPE_LEN);
+
+	if ((res = _oph_io_client_send_query(connection, query, head, sizeof(head), tail, get_result ? sizeof(tail) : 0))) {
+		free(request);
+		return res;
+	}
 
-	//If result set does contain rows
-	if (num_rows > 0) {
-		//Read payload (binary format)
-		char *reply = (char *) calloc(payload_len, sizeof(char));
-		if (!reply) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error allocation memory\n");
+	for (last = &(connection->requests); *last; last = &((*last)->next));
+	*last = request;
+	*request_id = request->id;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Request %u submitted\n", request->id);
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+//Read a reply to a submitted request and store it into the related request
+static int _oph_io_client_read_reply(oph_io_client_connection * connection)
+{
+	char reply[OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN + 1];
+	oph_io_client_request *request = NULL;
+	unsigned int id = 0;
+	unsigned long long max_rows = 0;
+	char end = 0;
+	int res = 0;
+
+	if (oph_net_readn(connection->socket, reply, OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN) != OPH_IO_CLIENT_MSG_TYPE_LEN + OPH_IO_CLIENT_MSG_SHORT_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+	if (strncmp(reply, OPH_IO_CLIENT_MSG_TAGGED_REPLY, OPH_IO_CLIENT_MSG_TYPE_LEN)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unexpected reply\n");
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+	memcpy(&id, reply + OPH_IO_CLIENT_MSG_TYPE_LEN, OPH_IO_CLIENT_MSG_SHORT_LEN);
+	for (request = connection->requests; request && (request->id != id || !request->replies); request = request->next);
+	if (!request) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Reply to unknown request %u\n", id);
+		return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
+	}
+
+	if (request->get_result && request->replies == 1) {
+		//Streamed result set
+		if (connection->result_types) {
+			free(connection->result_types);
+			connection->result_types = NULL;
+		}
+		request->result = (oph_io_client_result *) calloc(1, sizeof(oph_io_client_result));
+		if (!request->result) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
 			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
 		}
-		res = oph_net_readn(connection->socket, reply, payload_len);
-		if (!res) {
+		while (!end && !(res = _oph_io_client_read_result_part(connection, request->result, &max_rows, &end)));
+		if (res || request->status) {
+			oph_io_client_free_result(request->result);
+			request->result = NULL;
+		}
+		//An error reply leaves the connection usable
+		if (res && res != OPH_IO_CLIENT_INTERFACE_QUERY_ERR)
+			return res;
+		if (res)
+			request->status = res;
+	} else {
+		if (oph_net_readn(connection->socket, reply, OPH_IO_CLIENT_MSG_TYPE_LEN) != (ssize_t) OPH_IO_CLIENT_MSG_TYPE_LEN) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, "No reply\n");
-			free(reply);
 			return OPH_IO_CLIENT_INTERFACE_CONN_ERR;
 		}
-
-		char *sub_reply = (char *) calloc(payload_len, sizeof(char));
-		if (!sub_reply) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error allocation memory\n");
-			free(reply);
-			return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
+		if (strncmp(reply, OPH_IO_CLIENT_MSG_EXEC_QUERY, OPH_IO_CLIENT_MSG_TYPE_LEN)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error executing query of request %u\n", id);
+			request->status = OPH_IO_CLIENT_INTERFACE_QUERY_ERR;
 		}
-		unsigned long long string_head = 0;
+	}
+	request->replies--;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Reply to request %u received\n", id);
 
-		//Setup each row
-		for (i = 0; i < num_rows; i++) {
-			(*result_set)->result_set[i] = (oph_io_client_record *) calloc(1, sizeof(oph_io_client_record));
-			if (!((*result_set)->result_set[i])) {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-				free(reply);
-				free(sub_reply);
-				oph_io_client_free_result(*result_set);
-				*result_set = NULL;
-				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
-			}
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
 
-			(*result_set)->result_set[i]->field_length = (unsigned long *) calloc(num_fields, sizeof(unsigned long));
-			if (!((*result_set)->result_set[i]->field_length)) {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-				free(reply);
-				free(sub_reply);
-				oph_io_client_free_result(*result_set);
-				*result_set = NULL;
-				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
-			}
+//Complete all pending requests with an error when replies cannot be received anymore
+static void _oph_io_client_abort_requests(oph_io_client_connection * connection, int error)
+{
+	oph_io_client_request *request = NULL;
+
+	pmesg(LOG_WARNING, __FILE__, __LINE__, "Connection lost: pending requests are aborted\n");
+	for (request = connection->requests; request; request = request->next) {
+		if (!request->replies)
+			continue;
+		if (request->result) {
+			oph_io_client_free_result(request->result);
+			request->result = NULL;
+		}
+		if (!request->status)
+			request->status = error;
+		request->replies = 0;
+	}
+	close(connection->socket);
+	connection->socket = 0;
+}
 
-			(*result_set)->result_set[i]->field = (char **) calloc(num_fields + 1, sizeof(char *));
-			if (!((*result_set)->result_set[i]->field)) {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-				free(reply);
-				free(sub_reply);
-				oph_io_client_free_result(*result_set);
-				*result_set = NULL;
-				return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
-			}
+int oph_io_client_poll(oph_io_client_connection * connection, int timeout, unsigned int *request_id)
+{
+	if (!connection || !request_id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	*request_id = 0;
 
-			for (j = 0; j < num_fields; j++) {
-				//Setup each field
-
-				//Extract field length
-				memcpy(sub_reply, reply + string_head, sizeof(unsigned long));
-				(*result_set)->result_set[i]->field_length[j] = *((unsigned long *) sub_reply);
-				string_head += sizeof(unsigned long);
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Field %llu, row %llu length is: %lu\n", j, i, (*result_set)->result_set[i]->field_length[j]);
-
-				(*result_set)->result_set[i]->field[j] = (char *) calloc((*result_set)->result_set[i]->field_length[j], sizeof(char));
-				if (!((*result_set)->result_set[i]->field[j])) {
-					pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to alloc memory\n");
-					free(reply);
-					free(sub_reply);
-					oph_io_client_free_result(*result_set);
-					*result_set = NULL;
-					return OPH_IO_CLIENT_INTERFACE_MEMORY_ERR;
-				}
-				memcpy((*result_set)->result_set[i]->field[j], reply + string_head, (*result_set)->result_set[i]->field_length[j]);
-				string_head += (*result_set)->result_set[i]->field_length[j];
+	oph_io_client_request *request = NULL;
+	struct pollfd pfd;
+	struct timespec now, deadline;
+	long wait = timeout;
+	int res = 0;
 
-				//Set max field length
-				if ((*result_set)->max_field_length[j] < (*result_set)->result_set[i]->field_length[j])
-					(*result_set)->max_field_length[j] = (*result_set)->result_set[i]->field_length[j];
-			}
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout / 1000;
+	deadline.tv_nsec += (timeout % 1000) * 1000000L;
+
+	for (;;) {
+		for (request = connection->requests; request && request->replies; request = request->next);
+		if (request) {
+			*request_id = request->id;
+			return OPH_IO_CLIENT_INTERFACE_OK;
 		}
-		free(sub_reply);
-		free(reply);
+		if (!connection->requests || !connection->socket)
+			return OPH_IO_CLIENT_INTERFACE_OK;
+
+		if (timeout > 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			wait = (deadline.tv_sec - now.tv_sec) * 1000 + (deadline.tv_nsec - now.tv_nsec) / 1000000L;
+			if (wait < 0)
+				wait = 0;
+		}
+		pfd.fd = connection->socket;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		res = poll(&pfd, 1, (int) wait);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while polling socket\n");
+			return OPH_IO_CLIENT_INTERFACE_IO_ERR;
+		}
+		if (!res)
+			return OPH_IO_CLIENT_INTERFACE_OK;
+
+		if ((res = _oph_io_client_read_reply(connection)))
+			_oph_io_client_abort_requests(connection, res);
 	}
+}
 
-	return OPH_IO_CLIENT_INTERFACE_OK;
+int oph_io_client_complete(oph_io_client_connection * connection, unsigned int request_id, oph_io_client_result ** result_set)
+{
+	if (!connection) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+	if (result_set)
+		*result_set = NULL;
+
+	oph_io_client_request **iter = NULL, *request = NULL;
+	int res = 0;
+
+	for (iter = &(connection->requests); *iter && (*iter)->id != request_id; iter = &((*iter)->next));
+	if (!(request = *iter)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Request %u not found\n", request_id);
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	//Replies to other requests received in the meantime are stored
+	while (request->replies) {
+		if (!connection->socket)
+			_oph_io_client_abort_requests(connection, OPH_IO_CLIENT_INTERFACE_CONN_ERR);
+		else if ((res = _oph_io_client_read_reply(connection)))
+			_oph_io_client_abort_requests(connection, res);
+	}
+
+	*iter = request->next;
+	res = request->status;
+	if (result_set)
+		*result_set = request->result;
+	else if (request->result)
+		oph_io_client_free_result(request->result);
+	free(request);
+
+	return res;
 }
 
 int oph_io_client_fetch_row(oph_io_client_result * result_set, oph_io_client_record ** current_row)
@@ -675,6 +1375,59 @@ int oph_io_client_fetch_row(oph_io_client_result * result_set, oph_io_client_rec
 	return OPH_IO_CLIENT_INTERFACE_OK;
 }
 
+static int _oph_io_client_get_field(oph_io_client_record * record, unsigned int field, void *value, char type)
+{
+	if (!record || !record->field || !value) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Parameters are not given\n");
+		return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+	}
+
+	//Field array is NULL terminated
+	unsigned int j;
+	for (j = 0; j <= field; j++) {
+		if (!record->field[j]) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Field %u not available\n", field);
+			return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+		}
+	}
+
+	char field_type = record->field_type ? record->field_type[field] : OPH_IO_CLIENT_FIELD_TYPE_STRING;
+	if (field_type == OPH_IO_CLIENT_FIELD_TYPE_LONG || field_type == OPH_IO_CLIENT_FIELD_TYPE_REAL) {
+		if (record->field_length[field] != sizeof(long long)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Field %u is corrupted\n", field);
+			return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+		}
+		if (field_type == type)
+			memcpy(value, record->field[field], sizeof(long long));
+		else if (type == OPH_IO_CLIENT_FIELD_TYPE_LONG)
+			*((long long *) value) = (long long) *((double *) record->field[field]);
+		else
+			*((double *) value) = (double) *((long long *) record->field[field]);
+	} else {
+		//String values are NULL terminated
+		if (!record->field_length[field] || record->field[field][record->field_length[field] - 1]) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Field %u is not a number\n", field);
+			return OPH_IO_CLIENT_INTERFACE_DATA_ERR;
+		}
+		if (type == OPH_IO_CLIENT_FIELD_TYPE_LONG)
+			*((long long *) value) = (long long) strtoull(record->field[field], NULL, 10);
+		else
+			*((double *) value) = strtod(record->field[field], NULL);
+	}
+
+	return OPH_IO_CLIENT_INTERFACE_OK;
+}
+
+int oph_io_client_get_field_long(oph_io_client_record * record, unsigned int field, long long *value)
+{
+	return _oph_io_client_get_field(record, field, (void *) value, OPH_IO_CLIENT_FIELD_TYPE_LONG);
+}
+
+int oph_io_client_get_field_double(oph_io_client_record * record, unsigned int field, double *value)
+{
+	return _oph_io_client_get_field(record, field, (void *) value, OPH_IO_CLIENT_FIELD_TYPE_REAL);
+}
+
 int oph_io_client_free_result(oph_io_client_result * result)
 {
 	if (!result) {
@@ -684,6 +1437,8 @@ int oph_io_client_free_result(oph_io_client_result * result)
 
 	if (result->max_field_length)
 		free(result->max_field_length);
+	if (result->field_type)
+		free(result->field_type);
 
 	unsigned long long i, j;
 
@@ -692,12 +1447,13 @@ int oph_io_client_free_result(oph_io_client_result * result)
 			if (result->result_set[i]) {
 				if (result->result_set[i]->field_length)
 					free(result->result_set[i]->field_length);
-				for (j = 0; j < result->num_fields; j++) {
-					if (result->result_set[i]->field[j])
-						free(result->result_set[i]->field[j]);
-				}
-				if (result->result_set[i]->field)
+				if (result->result_set[i]->field) {
+					for (j = 0; j < result->num_fields; j++) {
+						if (result->result_set[i]->field[j])
+							free(result->result_set[i]->field[j]);
+					}
 					free(result->result_set[i]->field);
+				}
 				free(result->result_set[i]);
 			}
 		}
@@ -722,6 +1478,9 @@ int oph_io_client_close(oph_io_client_connection * connection)
 	}
 	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection closed\n");
 
+	if (connection->result_types)
+		free(connection->result_types);
+	_oph_io_client_free_requests(connection);
 	free(connection);
 
 	return OPH_IO_CLIENT_INTERFACE_OK;
@@ -46,6 +46,57 @@
 ----------------------------------------------------------------------------------------------------------
 */
 
+//Tagged request format: any request can be prefixed with an identifier, that is returned before the reply, so that several requests can be in flight
+/*
+-------------------------------------------------------
+| char type[2]="TQ"| uint32 request_id| request ...|
+-------------------------------------------------------
+| char type[2]="TR"| uint32 request_id| reply ...|
+-------------------------------------------------------
+*/
+
+//Query batch format: a sequence of exec query requests executed in order, answered with a status byte for each query
+/*
+-------------------------------------------------------------------------
+| char type[2]="BQ"| uint32 flags| uint32 nqueries| EQ request 1| ...|
+-------------------------------------------------------------------------
+| char type[2]="BQ"| uint32 nqueries| char status[nqueries]|
+---------------------------------------------------------
+*/
+
+//Shared memory format (local socket only): large binary args are replaced by their offset in a segment passed with the request,
+//result sets are sent as a single part whose payload is stored in a segment passed with the marker byte
+/*
+---------------------------------------------------
+| uint64 arg_len| char type[2]="DM"| uint64 offset|
+-----------------------------------------------------------------------------------
+| char type[2]="RM"| uint64 payload_len| uint64 nrows| uint32 nfields| char marker|
+-----------------------------------------------------------------------------------
+*/
+
+//Compression format (when negotiated): binary args and fields of streamed result sets of at least OPH_IO_CLIENT_COMPRESS_LEN bytes can be compressed,
+//compressed fields are marked by the highest bit of their length
+/*
+--------------------------------------------------------------------------
+| uint64 arg_len| char type[2]="DZ"| uint64 raw_len| char *compressed_arg|
+-----------------------------------------------------------------------------
+| uint64 field_len (highest bit set)| uint64 raw_len| char *compressed_field|
+-----------------------------------------------------------------------------
+*/
+
+//Streamed result set format: a sequence of parts followed by an end marker
+/*
+-------------------------------------------------------------------------------------------------------------------
+| char type[2]="RP"| uint64 payload_len| uint64 nrows| uint32 nfields| uint64 field11_len| char *field11| ...|
+-------------------------------------------------------------------------------------------------------------------
+| char type[2]="RE"| uint64 total_rows| uint32 nfields|
+-----------------------------------------------------
+When binary numbers are enabled, parts are preceded by a type header and LONG/REAL fields are sent as 8-byte values
+------------------------------------------------------------
+| char type[2]="RT"| uint32 nfields| char field_type[nfields]|
+------------------------------------------------------------
+*/
+
 //Header type messages
 #define OPH_IO_CLIENT_MSG_TYPE_LEN 2
 #define OPH_IO_CLIENT_MSG_LONG_LEN sizeof(unsigned long long)
@@ -56,6 +107,15 @@
 #define OPH_IO_CLIENT_MSG_USE_DB "UD"
 #define OPH_IO_CLIENT_MSG_SET_QUERY "SQ"
 #define OPH_IO_CLIENT_MSG_EXEC_QUERY "EQ"
+#define OPH_IO_CLIENT_MSG_RESULT_STREAM "RF"
+#define OPH_IO_CLIENT_MSG_RESULT_PART "RP"
+#define OPH_IO_CLIENT_MSG_RESULT_END "RE"
+#define OPH_IO_CLIENT_MSG_RESULT_TYPES "RT"
+#define OPH_IO_CLIENT_MSG_RESULT_SHM "RM"
+#define OPH_IO_CLIENT_MSG_PING_OPTIONS "PO"
+#define OPH_IO_CLIENT_MSG_TAGGED "TQ"
+#define OPH_IO_CLIENT_MSG_TAGGED_REPLY "TR"
+#define OPH_IO_CLIENT_MSG_BATCH_QUERY "BQ"
 
 #define OPH_IO_CLIENT_REQ_ERROR   "ER"
 
@@ -64,6 +124,48 @@
 #define OPH_IO_CLIENT_MSG_ARG_DATA_NULL "DN"
 #define OPH_IO_CLIENT_MSG_ARG_DATA_VARCHAR "DV"
 #define OPH_IO_CLIENT_MSG_ARG_DATA_BLOB "DB"
+#define OPH_IO_CLIENT_MSG_ARG_DATA_SHM "DM"
+#define OPH_IO_CLIENT_MSG_ARG_DATA_COMPRESSED "DZ"
+
+//Protocol options
+#define OPH_IO_CLIENT_OPT_BINARY_NUMBERS 0x1
+//Shared memory transfers, available only on local socket
+#define OPH_IO_CLIENT_OPT_SHARED_MEMORY 0x2
+
+//Compression of large binary args and result fields, available if both client and server are built with zlib
+#define OPH_IO_CLIENT_OPT_COMPRESSION 0x4
+
+//Binary arguments of at least this length are passed in shared memory, when enabled
+#define OPH_IO_CLIENT_SHM_ARG_LEN 65536
+
+//Binary arguments and result fields of at least this length are compressed, when enabled
+#define OPH_IO_CLIENT_COMPRESS_LEN 4096
+#define OPH_IO_CLIENT_FIELD_COMPRESSED (1ULL << 63)
+
+//Query batch flags and status codes
+#define OPH_IO_CLIENT_BATCH_STOP_ON_ERROR 0x1
+#define OPH_IO_CLIENT_BATCH_DONE 0
+#define OPH_IO_CLIENT_BATCH_FAILED 1
+#define OPH_IO_CLIENT_BATCH_SKIPPED 2
+
+//Field types
+#define OPH_IO_CLIENT_FIELD_TYPE_LONG 'L'
+#define OPH_IO_CLIENT_FIELD_TYPE_REAL 'R'
+#define OPH_IO_CLIENT_FIELD_TYPE_STRING 'S'
+
+/**
+ * \brief              Structure to collect statistics about data compressed on a connection
+ * \param frames       Number of arguments or fields processed
+ * \param raw_len      Number of bytes before compression
+ * \param packed_len   Number of bytes after compression
+ * \param time         Time spent to compress or uncompress data (seconds)
+ */
+typedef struct {
+	unsigned long long frames;
+	unsigned long long raw_len;
+	unsigned long long packed_len;
+	double time;
+} oph_io_client_compression_stats;
 
 /**
  * \brief        Structure to contain reference to server connection
@@ -71,22 +173,38 @@
  * \param port   Port of the server
  * \param db   	DB to be used on the server
  * \param socket Id of file descriptor of socket associated to connection
+ * \param result_stream Flag set to 1 while a result set is being retrieved part by part
+ * \param options Protocol options enabled on the connection
+ * \param result_types Field types of the result set being retrieved, if sent by server
+ * \param requests Requests submitted and not yet completed by the caller
+ * \param last_request_id Identifier of last submitted request
+ * \param sent_stats Statistics about arguments compressed by the client
+ * \param received_stats Statistics about result fields compressed by the server
  */
 typedef struct {
 	char host[OPH_IO_CLIENT_HOST_LEN];
 	char port[OPH_IO_CLIENT_PORT_LEN];
 	char db_name[OPH_IO_CLIENT_DB_LEN];
 	int socket;
+	char result_stream;
+	unsigned int options;
+	char *result_types;
+	struct _oph_io_client_request *requests;
+	unsigned int last_request_id;
+	oph_io_client_compression_stats sent_stats;
+	oph_io_client_compression_stats received_stats;
 } oph_io_client_connection;
 
 /**
  * \brief			          Structure for storing information about the current record
  * \param field_length 	Array containing the length for each cell in the record
  * \param field			    NULL terminated array containing the cell values
+ * \param field_type   Array containing the type of each cell (shared with result set), NULL if values are strings
  */
 typedef struct {
 	unsigned long *field_length;
 	char **field;
+	char *field_type;
 } oph_io_client_record;
 
 /**
@@ -96,6 +214,7 @@ typedef struct {
  * \param max_field_length 	Array containing the maximum width of the field
  * \param current_row		Index of current row
  * \param result_set		Pointer to NULL terminated result set
+ * \param field_type		Array containing the type of each field, NULL if values are strings
  */
 typedef struct {
 	unsigned long long num_rows;
@@ -103,8 +222,27 @@ typedef struct {
 	unsigned long long *max_field_length;
 	unsigned long long current_row;
 	oph_io_client_record **result_set;
+	char *field_type;
 } oph_io_client_result;
 
+/**
+ * \brief			Structure for a request submitted without waiting for its reply
+ * \param id			Identifier of the request
+ * \param get_result		Flag set to 1 if the result set has been requested too
+ * \param replies		Number of replies still to be received
+ * \param status		Outcome of the request
+ * \param result		Result set, if requested
+ * \param next			Pointer to next submitted request
+ */
+typedef struct _oph_io_client_request {
+	unsigned int id;
+	char get_result;
+	char replies;
+	int status;
+	oph_io_client_result *result;
+	struct _oph_io_client_request *next;
+} oph_io_client_request;
+
 /**
  * \brief           Enum with admissible argument types
  */
@@ -159,8 +297,8 @@ int oph_io_client_setup();
 
 /**
  * \brief               Function to connect or reconnect to IO server.
- * \param hostname      Hostname of server
- * \param port          Port of server
+ * \param hostname      Hostname of server or path of its local socket (beginning with '/') for clients running on the same node
+ * \param port          Port of server (not used with local socket)
  * \param db_name       DB to be used (can be NULL)
  * \param device        Name of device where data is stored
  * \param connection    Pointer to IO server connection structure
@@ -168,6 +306,15 @@ int oph_io_client_setup();
  */
 int oph_io_client_connect(const char *hostname, const char *port, const char *db_name, const char *device, oph_io_client_connection ** connection);
 
+/**
+ * \brief               Function to negotiate protocol options with IO server; it should be called before setting the default database.
+ *                      If the server does not support the negotiation, the connection is re-established and no option is enabled.
+ * \param connection    Pointer to IO server connection structure
+ * \param options       Bitmask of requested options (OPH_IO_CLIENT_OPT_*); enabled ones are stored in connection
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_set_options(oph_io_client_connection * connection, unsigned int options);
+
 /**
  * \brief               Function to set default database for specified server.
  * \param db_name       Name of database to be used
@@ -185,6 +332,18 @@ int oph_io_client_use_db(const char *db_name, const char *device, oph_io_client_
  */
 int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_client_query * query);
 
+/**
+ * \brief               Function to execute several operations on data stored into server with a single request; operations are executed in order.
+ *                      A query can be given several times, each occurrence being a run of the query with the values of its arguments at call time.
+ * \param connection    Pointer to server-specific connection structure
+ * \param queries       Array of queries to be executed
+ * \param query_num     Number of queries in array
+ * \param flags         Bitmask of batch flags (OPH_IO_CLIENT_BATCH_*); with OPH_IO_CLIENT_BATCH_STOP_ON_ERROR the queries following a failed one are skipped
+ * \param status        Array of query_num elements filled with the status of each query (OPH_IO_CLIENT_BATCH_DONE, OPH_IO_CLIENT_BATCH_FAILED or OPH_IO_CLIENT_BATCH_SKIPPED)
+ * \return              0 if the batch has been executed, even if some queries failed, non-0 otherwise
+ */
+int oph_io_client_execute_batch(oph_io_client_connection * connection, oph_io_client_query ** queries, unsigned int query_num, unsigned int flags, char *status);
+
 /**
  * \brief               Function to setup the query structure with given operation and array argument
  * \param connection    Pointer to server-specific connection structure
@@ -198,6 +357,36 @@ int oph_io_client_execute_query(oph_io_client_connection * connection, oph_io_cl
 int oph_io_client_setup_query(oph_io_client_connection * connection, const char *operation, const char *device, unsigned long long tot_run, oph_io_client_query_arg ** args,
 			      oph_io_client_query ** query);
 
+/**
+ * \brief               Function to send a query without waiting for its execution; several queries can be in flight on the same connection.
+ *                      Blocking functions cannot be used until all submitted queries are completed. A failed query is completed with
+ *                      OPH_IO_CLIENT_INTERFACE_QUERY_ERR, while the other queries in flight are still executed.
+ * \param connection    Pointer to server-specific connection structure
+ * \param query         Pointer to query to be executed
+ * \param get_result    Set to 1 to retrieve also the result set of the query
+ * \param request_id    Pointer to the identifier of the request, to be used with oph_io_client_complete
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_submit_query(oph_io_client_connection * connection, oph_io_client_query * query, char get_result, unsigned int *request_id);
+
+/**
+ * \brief               Function to check for a submitted query whose reply has been received; requests can be completed in any order.
+ * \param connection    Pointer to server-specific connection structure
+ * \param timeout       Maximum time to wait in milliseconds (0 to return immediately, -1 to wait indefinitely)
+ * \param request_id    Pointer to the identifier of a completed request, set to 0 if no request has been completed in time
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_poll(oph_io_client_connection * connection, int timeout, unsigned int *request_id);
+
+/**
+ * \brief               Function to wait for the completion of a submitted query and release the related resources.
+ * \param connection    Pointer to server-specific connection structure
+ * \param request_id    Identifier of the request
+ * \param result_set    Pointer to the result set, if requested on submission (can be NULL)
+ * \return              0 if query has been executed successfully, non-0 otherwise
+ */
+int oph_io_client_complete(oph_io_client_connection * connection, unsigned int request_id, oph_io_client_result ** result_set);
+
 /**
  * \brief               Function to release resources allocated for query
  * \param query         Pointer to query to be executed
@@ -226,6 +415,15 @@ int oph_io_client_cleanup();
  */
 int oph_io_client_get_result(oph_io_client_connection * connection, oph_io_client_result ** result_set);
 
+/**
+ * \brief               Function to get the next part of the result set after executing a query, so that rows can be processed while the rest is being transferred.
+ *                      The first call requests the result set, following calls return the next parts.
+ * \param connection    Pointer to server-specific connection structure
+ * \param result_set    Pointer to the partial result set to be created; it is set to NULL when the whole result set has been retrieved
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_get_result_part(oph_io_client_connection * connection, oph_io_client_result ** result_set);
+
 /**
  * \brief               Function to fetch the next row in a result set.
  * \param result        Pointer to the result set structure to scan
@@ -234,6 +432,24 @@ int oph_io_client_get_result(oph_io_client_connection * connection, oph_io_clien
  */
 int oph_io_client_fetch_row(oph_io_client_result * result_set, oph_io_client_record ** current_row);
 
+/**
+ * \brief               Function to get a field of a record as an integer value; both binary and string values are handled.
+ * \param record        Pointer to the record
+ * \param field         Index of the field
+ * \param value         Pointer to the value to be filled
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_get_field_long(oph_io_client_record * record, unsigned int field, long long *value);
+
+/**
+ * \brief               Function to get a field of a record as a real value; both binary and string values are handled.
+ * \param record        Pointer to the record
+ * \param field         Index of the field
+ * \param value         Pointer to the value to be filled
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_client_get_field_double(oph_io_client_record * record, unsigned int field, double *value);
+
 /**
  * \brief               Function to free the allocated result set.
  * \param result        Pointer to the result set structure to free
@@ -94,7 +94,7 @@ int main(int argc, char *argv[])
 				printf("Query submitted correctly.\n");
 				oph_io_client_free_query(stmt);
 
-				snprintf(query, 1024, "test%d;", ii);
+				snprintf(query, 1024, "test%d", ii);
 
 				//Use new DB
 				if ((res = oph_io_client_use_db(query, "memory", connection))) {
@@ -179,6 +179,35 @@ int main(int argc, char *argv[])
 				oph_io_client_free_query(stmt);
 				free(arg2.arg);
 
+				//Pipeline some queries: the one selecting from a missing fragment fails without affecting the others
+				char *pipelined[3] = { "operation=create_frag_select;frag_name=trial4;field=id|measure;alias=id|measure;from=trial1;",
+					"operation=create_frag_select;frag_name=trial5;field=id|measure;alias=id|measure;from=trial0;",
+					"operation=create_frag_select;frag_name=trial6;field=id|measure;alias=id|measure;from=trial1;"
+				};
+				oph_io_client_query *pipelined_stmt[3] = { NULL, NULL, NULL };
+				unsigned int request_id[3] = { 0, 0, 0 };
+
+				for (r = 0; r < 3; r++) {
+					if ((res = oph_io_client_setup_query(connection, pipelined[r], "memory", 0, (oph_io_client_query_arg **) NULL, &(pipelined_stmt[r])))
+					    || (res = oph_io_client_submit_query(connection, pipelined_stmt[r], 0, &(request_id[r])))) {
+						pmesg(LOG_ERROR, __FILE__, __LINE__, "Error %d in submitting query '%s'\n", res, pipelined[r]);
+						break;
+					}
+				}
+				for (i = 0; i < r; i++) {
+					res = oph_io_client_complete(connection, request_id[i], NULL);
+					if (res != (i == 1 ? OPH_IO_CLIENT_INTERFACE_QUERY_ERR : OPH_IO_CLIENT_INTERFACE_OK))
+						pmesg(LOG_ERROR, __FILE__, __LINE__, "Unexpected result %d of query '%s'\n", res, pipelined[i]);
+					else
+						printf("Query completed as expected.\n");
+				}
+				for (i = 0; i < 3; i++)
+					oph_io_client_free_query(pipelined_stmt[i]);
+				if (r < 3) {
+					res = oph_io_client_close(connection);
+					return 0;
+				}
+
 
 				//Create empty fragment
 				if ((res =
@@ -242,7 +271,7 @@ int main(int argc, char *argv[])
 				printf("Query submitted correctly.\n");
 				oph_io_client_free_query(stmt);
 
-				snprintf(query, 1024, "test%d;", ii + (nchildren));
+				snprintf(query, 1024, "test%d", ii + (nchildren));
 
 
 				//Use new DB
@@ -293,7 +322,7 @@ int main(int argc, char *argv[])
 				printf("Query submitted correctly.\n");
 				oph_io_client_free_query(stmt);
 
-				snprintf(query, 1024, "test%d;", ii);
+				snprintf(query, 1024, "test%d", ii);
 
 				//Use new DB
 				if ((res = oph_io_client_use_db(query, "memory", connection))) {
@@ -419,7 +448,7 @@ int main(int argc, char *argv[])
 				printf("Query submitted correctly.\n");
 				oph_io_client_free_query(stmt);
 
-				snprintf(query, 1024, "test%d;", ii + (nchildren));
+				snprintf(query, 1024, "test%d", ii + (nchildren));
 
 				//Use new DB
 				if ((res = oph_io_client_use_db(query, "memory", connection))) {
@@ -70,11 +70,18 @@
 #define OPH_SERVER_CONF_CACHE_LINE_SIZE	  "CACHE_LINE_SIZE"
 #define OPH_SERVER_CONF_CACHE_SIZE     	  "CACHE_SIZE"
 #define OPH_SERVER_CONF_WORKING_DIR    	  "WORKING_DIR"
+#define OPH_SERVER_CONF_WORKER_THREADS    "WORKER_THREADS"
+#define OPH_SERVER_CONF_UNIX_SOCKET       "UNIX_SOCKET"
+#define OPH_SERVER_CONF_READER_PROCESSES  "READER_PROCESSES"
+#define OPH_SERVER_CONF_PLAN_CACHE_SIZE   "PLAN_CACHE_SIZE"
+#define OPH_SERVER_CONF_MEMORY_BUDGET     "MEMORY_BUDGET"
+#define OPH_SERVER_CONF_COMPRESSION_IDLE  "COMPRESSION_IDLE_TIME"
 
 
 static const char *const oph_server_conf_params[] =
     { OPH_SERVER_CONF_HOSTNAME, OPH_SERVER_CONF_PORT, OPH_SERVER_CONF_DIR, OPH_SERVER_CONF_MPL, OPH_SERVER_CONF_TTL, OPH_SERVER_CONF_OMP_THREADS, OPH_SERVER_CONF_MEMORY_BUFFER,
-	OPH_SERVER_CONF_CACHE_LINE_SIZE, OPH_SERVER_CONF_CACHE_SIZE, OPH_SERVER_CONF_WORKING_DIR, NULL
+	OPH_SERVER_CONF_CACHE_LINE_SIZE, OPH_SERVER_CONF_CACHE_SIZE, OPH_SERVER_CONF_WORKING_DIR, OPH_SERVER_CONF_WORKER_THREADS,
+	OPH_SERVER_CONF_UNIX_SOCKET, OPH_SERVER_CONF_READER_PROCESSES, OPH_SERVER_CONF_PLAN_CACHE_SIZE, OPH_SERVER_CONF_MEMORY_BUDGET, OPH_SERVER_CONF_COMPRESSION_IDLE, NULL
 };
 
 /**
@@ -37,6 +37,9 @@ extern int msglevel;
 extern unsigned short disable_mem_check;
 
 pthread_rwlock_t syslock = PTHREAD_RWLOCK_INITIALIZER;
+pthread_mutex_t cpu_lock = PTHREAD_MUTEX_INITIALIZER;
+long cpu_budget = -1;
+long cpu_used = 0;
 
 char oph_util_get_measure_type(char *measure_type)
 {
@@ -429,3 +432,48 @@ int memory_check()		// Check for memory swap
 	}
 	return OPH_SERVER_UTIL_SUCCESS;
 }
+
+int oph_util_cpu_acquire(unsigned short requested, unsigned short *granted)
+{
+	if (!granted)
+		return OPH_SERVER_UTIL_NULL_PARAM;
+	*granted = 0;
+
+	if (pthread_mutex_lock(&cpu_lock))
+		return OPH_SERVER_UTIL_ERROR;
+
+	if (cpu_budget < 0) {
+		cpu_budget = sysconf(_SC_NPROCESSORS_ONLN);
+		if (cpu_budget < 1)
+			cpu_budget = 1;
+	}
+	long available = cpu_budget - cpu_used;
+	if (available > requested)
+		available = requested;
+	//A single thread is the sequential case
+	if (available > 1) {
+		*granted = (unsigned short) available;
+		cpu_used += available;
+	}
+
+	pthread_mutex_unlock(&cpu_lock);
+
+	return OPH_SERVER_UTIL_SUCCESS;
+}
+
+int oph_util_cpu_release(unsigned short granted)
+{
+	if (!granted)
+		return OPH_SERVER_UTIL_SUCCESS;
+
+	if (pthread_mutex_lock(&cpu_lock))
+		return OPH_SERVER_UTIL_ERROR;
+
+	cpu_used -= granted;
+	if (cpu_used < 0)
+		cpu_used = 0;
+
+	pthread_mutex_unlock(&cpu_lock);
+
+	return OPH_SERVER_UTIL_SUCCESS;
+}
@@ -104,4 +104,19 @@ int is_numeric_string(int array_length, char *array, int *is_string);
  */
 int memory_check();
 
+/**
+ * \brief			        This function reserves worker threads from the server-wide CPU budget (number of online CPUs), shared by concurrent queries.
+ * \param requested   Number of threads requested
+ * \param granted     Number of threads actually reserved (0 if less than 2 are available); it has to be released with oph_util_cpu_release
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_util_cpu_acquire(unsigned short requested, unsigned short *granted);
+
+/**
+ * \brief			        This function gives back worker threads reserved with oph_util_cpu_acquire.
+ * \param granted     Number of threads to be released
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_util_cpu_release(unsigned short granted);
+
 #endif				/* OPH_SERVER_UTILITY_H */
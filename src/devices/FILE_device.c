@@ -0,0 +1,244 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+#include "FILE_device.h"
+
+#include "oph_server_utility.h"
+
+#include <unistd.h>
+#include "debug.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+int _file_setup(oph_iostore_handler * handle)
+{
+	if (!handle || !handle->data_dir) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		return FILE_DEV_NULL_PARAM;
+	}
+
+	char path[FILE_DEV_PATH_LEN];
+	snprintf(path, FILE_DEV_PATH_LEN, FILE_DEV_DIR, handle->data_dir);
+	if (mkdir(path, 0755) && (errno != EEXIST)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_IO_ERROR, path, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_IO_ERROR, path, strerror(errno));
+		return FILE_DEV_IO_ERROR;
+	}
+
+	return FILE_DEV_SUCCESS;
+}
+
+int _file_cleanup(oph_iostore_handler * handle)
+{
+	if (!handle) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		return FILE_DEV_NULL_PARAM;
+	}
+	return FILE_DEV_SUCCESS;
+}
+
+int _file_get_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record)
+{
+	if (!handle || !res_id || !res_id->id || !db_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		return FILE_DEV_NULL_PARAM;
+	}
+
+	*db_record = NULL;
+
+	//Read resource id (nothing to do)
+	;
+
+	//Get in-memory copy of DB
+	*db_record = (oph_iostore_db_record_set *) malloc(1 * sizeof(oph_iostore_db_record_set));
+	if (*db_record == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		return FILE_DEV_ERROR;
+	}
+
+	(*db_record)->db_name = (char *) strndup(res_id->id, res_id->id_length - strlen(handle->device) - 1);
+	if ((*db_record)->db_name == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		free(*db_record);
+		*db_record = NULL;
+		return FILE_DEV_ERROR;
+	}
+
+	return FILE_DEV_SUCCESS;
+}
+
+int _file_put_db(oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id)
+{
+	if (!handle || !res_id || !db_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		return FILE_DEV_NULL_PARAM;
+	}
+
+	*res_id = NULL;
+
+	//DBs are only stored in MetaDB (nothing to do)
+	;
+
+	//Get resource id
+	*res_id = (oph_iostore_resource_id *) malloc(1 * sizeof(oph_iostore_resource_id));
+	if (*res_id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		return FILE_DEV_ERROR;
+	}
+
+	(*res_id)->id_length = strlen(db_record->db_name) + strlen(handle->device) + 1;
+	(*res_id)->id = (void *) calloc((*res_id)->id_length, sizeof(char));
+	if ((*res_id)->id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		free(*res_id);
+		*res_id = NULL;
+		return FILE_DEV_ERROR;
+	}
+	snprintf((*res_id)->id, strlen(db_record->db_name) + strlen(handle->device) + 1, "%s%s", db_record->db_name, handle->device);
+
+	return FILE_DEV_SUCCESS;
+}
+
+int _file_delete_db(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+{
+	if (!handle || !res_id || !res_id->id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		return FILE_DEV_NULL_PARAM;
+	}
+	//Read resource ID (nothing to do)
+	;
+
+	//Remove db (fragments are deleted one by one)
+	;
+
+	return FILE_DEV_SUCCESS;
+}
+
+int _file_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record)
+{
+	if (!handle || !handle->data_dir || !res_id || !res_id->id || !frag_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		return FILE_DEV_NULL_PARAM;
+	}
+
+	*frag_record = NULL;
+
+	//Read resource id
+	char path[FILE_DEV_PATH_LEN];
+	snprintf(path, FILE_DEV_PATH_LEN, FILE_DEV_PATH, handle->data_dir, (char *) res_id->id);
+
+	//Map the file: pages are loaded only when cells are read and changes are kept private
+	if (oph_iostore_map_frag_file(path, frag_record)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_READ_ERROR, path);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_READ_ERROR, path);
+		return FILE_DEV_IO_ERROR;
+	}
+
+	return FILE_DEV_SUCCESS;
+}
+
+int _file_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id)
+{
+	if (!handle || !handle->data_dir || !res_id || !frag_record || !frag_record->field_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		return FILE_DEV_NULL_PARAM;
+	}
+
+	*res_id = NULL;
+
+	char path[FILE_DEV_PATH_LEN];
+	snprintf(path, FILE_DEV_PATH_LEN, FILE_DEV_TEMPLATE, handle->data_dir);
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_IO_ERROR, path, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_IO_ERROR, path, strerror(errno));
+		return FILE_DEV_IO_ERROR;
+	}
+	//Blocks are written with large sequential writes and then flushed
+	int res = oph_iostore_write_frag_file(frag_record, fd, path);
+	if (!res && fdatasync(fd)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_IO_ERROR, path, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_IO_ERROR, path, strerror(errno));
+		res = FILE_DEV_IO_ERROR;
+	}
+	close(fd);
+	if (res) {
+		unlink(path);
+		return FILE_DEV_IO_ERROR;
+	}
+	//Get resource id (the null-terminated file name)
+	*res_id = (oph_iostore_resource_id *) malloc(1 * sizeof(oph_iostore_resource_id));
+	if (*res_id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		unlink(path);
+		return FILE_DEV_ERROR;
+	}
+
+	char *file_name = strrchr(path, '/') + 1;
+	(*res_id)->id_length = strlen(file_name) + 1;
+	(*res_id)->id = (void *) strdup(file_name);
+	if ((*res_id)->id == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_MEMORY_ERROR);
+		free(*res_id);
+		*res_id = NULL;
+		unlink(path);
+		return FILE_DEV_ERROR;
+	}
+
+	return FILE_DEV_SUCCESS;
+}
+
+int _file_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
+{
+	if (!handle || !handle->data_dir || !res_id || !res_id->id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_NULL_INPUT_PARAM);
+		return FILE_DEV_NULL_PARAM;
+	}
+	//Read resource id
+	char path[FILE_DEV_PATH_LEN];
+	snprintf(path, FILE_DEV_PATH_LEN, FILE_DEV_PATH, handle->data_dir, (char *) res_id->id);
+
+	//Delete frag file
+	if (unlink(path) && (errno != ENOENT)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_IO_ERROR, path, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, FILE_LOG_IO_ERROR, path, strerror(errno));
+		return FILE_DEV_IO_ERROR;
+	}
+
+	return FILE_DEV_SUCCESS;
+}
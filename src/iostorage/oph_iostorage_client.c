@@ -103,6 +103,8 @@ int main()
 	}
 
 	printf("Retrieved Frag has %s field\n", frag_record1->field_name[0]);
+	//Fragments of transient devices stay resident until they are released
+	oph_iostore_release_frag(dev_handle, frag_record1);
 
 	if (oph_iostore_delete_frag(dev_handle, res_id) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to delete frag from device\n");
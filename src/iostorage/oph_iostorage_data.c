@@ -25,11 +25,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <ctype.h>
 
 #include <debug.h>
 
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "oph_server_utility.h"
 
@@ -123,6 +127,8 @@ int oph_iostore_copy_frag_record_set_limit(oph_iostore_frag_record_set * input_r
 		oph_iostore_destroy_frag_recordset(output_record_set);
 		return OPH_IOSTORAGE_MEMORY_ERR;
 	}
+	//Records are copied one by one
+	(*output_record_set)->columns = NULL;
 
 	long long j, total_size = 0, set_size = 0;
 	oph_iostore_frag_record *tmp_record = NULL;
@@ -170,6 +176,8 @@ int oph_iostore_copy_frag_record_set_only(oph_iostore_frag_record_set * input_re
 	(*output_record_set)->field_num = input_record_set->field_num;
 	(*output_record_set)->field_type = NULL;
 	(*output_record_set)->record_set = NULL;
+	(*output_record_set)->columns = NULL;
+	(*output_record_set)->shared = NULL;
 	(*output_record_set)->field_name = (char **) calloc(input_record_set->field_num, sizeof(char *));
 	if (!(*output_record_set)->field_name) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
@@ -219,6 +227,9 @@ int oph_iostore_copy_frag_record_set_only(oph_iostore_frag_record_set * input_re
 			return OPH_IOSTORAGE_MEMORY_ERR;
 		}
 	}
+	//Records of the copy can still be read by columns
+	(*output_record_set)->columns = input_record_set->columns;
+
 	return OPH_IOSTORAGE_SUCCESS;
 }
 
@@ -288,15 +299,7 @@ int oph_iostore_destroy_frag_recordset(oph_iostore_frag_record_set ** record_set
 		return OPH_IOSTORAGE_NULL_PARAM;
 	}
 
-	long long i = 0;
-
-	if ((*record_set)->record_set != NULL) {
-		while ((*record_set)->record_set[i]) {
-			oph_iostore_destroy_frag_record(&(*record_set)->record_set[i], (*record_set)->field_num);
-			i++;
-		}
-	}
-
+	oph_iostore_release_frag_records(*record_set);
 	oph_iostore_destroy_frag_recordset_only(record_set);
 
 	return OPH_IOSTORAGE_SUCCESS;
@@ -386,6 +389,8 @@ int oph_iostore_create_frag_recordset_only(oph_iostore_frag_record_set ** record
 	(*record_set)->field_type = NULL;
 	(*record_set)->record_set = NULL;
 	(*record_set)->tmp_flag = 0;
+	(*record_set)->columns = NULL;
+	(*record_set)->shared = NULL;
 
 	(*record_set)->field_name = (char **) calloc(field_num, sizeof(char *));
 	if (!(*record_set)->field_name) {
@@ -414,6 +419,912 @@ int oph_iostore_create_frag_recordset_only(oph_iostore_frag_record_set ** record
 	return OPH_IOSTORAGE_SUCCESS;
 }
 
+//Cells in arena are aligned as malloc'd values
+#define OPH_IOSTORE_ARENA_ALIGN(size)	(((size) + sizeof(long long) - 1) & ~((unsigned long long) sizeof(long long) - 1))
+
+//Value slots of columns built in place: a block of row_capacity values for each field, following the array of column pointers
+#define OPH_IOSTORE_SLOTS(columns)	((long long *) ((columns)->column + (columns)->field_num))
+
+int oph_iostore_create_frag_recordset_columns(oph_iostore_frag_record_set ** record_set, long long set_size, short int field_num)
+{
+	if (!record_set || !field_num || (set_size < 0)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+	//Empty record sets have no columns
+	if (!set_size)
+		return oph_iostore_create_frag_recordset(record_set, 0, field_num);
+
+	if (oph_iostore_create_frag_recordset_only(record_set, set_size, field_num)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	//Records, cell lengths, offsets and pointers, column pointers and a value slot for each cell are allocated at once, while other values are appended to the arena
+	unsigned long long cells = set_size * field_num;
+	char *slab =
+	    (char *) malloc(sizeof(oph_iostore_frag_columns) + set_size * sizeof(oph_iostore_frag_record) + cells * (2 * sizeof(unsigned long long) + sizeof(void *) + sizeof(long long)) +
+			    field_num * sizeof(void *));
+	if (!slab) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		oph_iostore_destroy_frag_recordset_only(record_set);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	oph_iostore_frag_columns *columns = (oph_iostore_frag_columns *) slab;
+	columns->owner = *record_set;
+	columns->row_num = set_size;
+	columns->arena = NULL;
+	columns->arena_size = 0;
+	columns->map = NULL;
+	columns->map_size = 0;
+	columns->refcount = 1;
+	columns->field_num = field_num;
+	columns->shared = NULL;
+	columns->is_open = 1;
+	columns->arena_capacity = 0;
+	columns->row_capacity = set_size;
+	slab += sizeof(oph_iostore_frag_columns);
+	columns->records = (oph_iostore_frag_record *) slab;
+	slab += set_size * sizeof(oph_iostore_frag_record);
+	columns->field_length = (unsigned long long *) slab;
+	slab += cells * sizeof(unsigned long long);
+	columns->offset = (unsigned long long *) slab;
+	slab += cells * sizeof(unsigned long long);
+	columns->field = (void **) slab;
+	slab += cells * sizeof(void *);
+	columns->column = (void **) slab;
+
+	unsigned short i;
+	for (i = 0; i < field_num; i++)
+		columns->column[i] = NULL;
+
+	long long j;
+	unsigned long long cell;
+	oph_iostore_frag_record *record;
+	for (j = 0; j < set_size; j++) {
+		record = columns->records + j;
+		record->field_length = columns->field_length + j * field_num;
+		record->field = columns->field + j * field_num;
+		for (i = 0; i < field_num; i++) {
+			cell = j * field_num + i;
+			columns->field_length[cell] = 0;
+			columns->offset[cell] = OPH_IOSTORE_NULL_OFFSET;
+			columns->field[cell] = NULL;
+		}
+		(*record_set)->record_set[j] = record;
+	}
+	(*record_set)->record_set[set_size] = NULL;
+	(*record_set)->columns = columns;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Function used to update the pointers to the first cells of the arena of columns after it has been moved
+static void _oph_iostore_rebase_frag_arena(oph_iostore_frag_columns * columns, char *arena, unsigned long long cells)
+{
+	unsigned long long cell;
+	if (arena != columns->arena)
+		for (cell = 0; cell < cells; cell++)
+			if (columns->offset[cell] != OPH_IOSTORE_NULL_OFFSET)
+				columns->field[cell] = arena + columns->offset[cell];
+	columns->arena = arena;
+}
+
+//Function used to make room for size bytes at the end of the arena of open columns: since the following rows are likely to need as much,
+//capacity grows by their estimate (or by half, at least)
+static int _oph_iostore_reserve_frag_arena(oph_iostore_frag_columns * columns, unsigned long long size, unsigned long long next_size)
+{
+	if (columns->arena_size + size <= columns->arena_capacity)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	unsigned long long capacity = columns->arena_size + size + next_size;
+	if (capacity < columns->arena_capacity + columns->arena_capacity / 2)
+		capacity = columns->arena_capacity + columns->arena_capacity / 2;
+	char *arena = (char *) realloc(columns->arena, capacity);
+	if (!arena) {
+		capacity = columns->arena_size + size;
+		if (!(arena = (char *) realloc(columns->arena, capacity))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		}
+	}
+	_oph_iostore_rebase_frag_arena(columns, arena, columns->row_capacity * columns->field_num);
+	columns->arena_capacity = capacity;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Function used to append a value to the arena of open columns, as a null-terminated string followed by zeros up to alignment
+static void _oph_iostore_append_frag_cell(oph_iostore_frag_columns * columns, unsigned long long cell, const void *value, unsigned long long length)
+{
+	columns->offset[cell] = columns->arena_size;
+	columns->field[cell] = columns->arena + columns->arena_size;
+	memmove(columns->field[cell], value, length);
+	memset(columns->arena + columns->arena_size + length, 0, OPH_IOSTORE_ARENA_ALIGN(length + 1) - length);
+	columns->arena_size += OPH_IOSTORE_ARENA_ALIGN(length + 1);
+}
+
+int oph_iostore_set_frag_cell(oph_iostore_frag_record_set * record_set, long long row, unsigned short field, const void *value, unsigned long long length)
+{
+	if (!record_set || !record_set->record_set || (row < 0) || (field >= record_set->field_num)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	oph_iostore_frag_columns *columns = record_set->columns;
+	if (!columns) {
+		//Records allocated one by one own their cells
+		oph_iostore_frag_record *record = record_set->record_set[row];
+		if (!record) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+			return OPH_IOSTORAGE_NULL_PARAM;
+		}
+		record->field[field] = NULL;
+		record->field_length[field] = length;
+		if (value && !(record->field[field] = memdup(value, length))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		}
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+	if (!columns->is_open || (row >= columns->row_capacity)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_BAD_PARAMETER;
+	}
+
+	unsigned long long cell = row * columns->field_num + field;
+	columns->field_length[cell] = length;
+	columns->offset[cell] = OPH_IOSTORE_NULL_OFFSET;
+	columns->field[cell] = NULL;
+	if (!value)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	//Values with the size of numbers are stored in the slot of the cell, the others are appended to the arena
+	if (length == sizeof(long long)) {
+		columns->field[cell] = OPH_IOSTORE_SLOTS(columns) + field * columns->row_capacity + row;
+		memcpy(columns->field[cell], value, length);
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+	unsigned long long size = OPH_IOSTORE_ARENA_ALIGN(length + 1);
+	if (_oph_iostore_reserve_frag_arena(columns, size, size * (columns->row_capacity - row - 1)))
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	_oph_iostore_append_frag_cell(columns, cell, value, length);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Function used to seal the open columns of a record set, following the current order of its records: rows removed or reordered after being
+//built are compacted, numeric fields whose cells are all in their slots become columns and the other values in slots are moved to the arena
+static int _oph_iostore_seal_frag_columns(oph_iostore_frag_record_set * record_set)
+{
+	oph_iostore_frag_columns *columns = record_set->columns;
+	oph_iostore_frag_record **rows = record_set->record_set;
+	unsigned short i, field_num = columns->field_num;
+	long long j, first, row_num = 0, row_capacity = columns->row_capacity;
+	long long *slots = OPH_IOSTORE_SLOTS(columns), *slot_end = slots + field_num * row_capacity, *slot;
+	unsigned long long cell, from;
+	while (rows[row_num])
+		row_num++;
+
+	for (first = 0; (first < row_num) && (rows[first] == columns->records + first); first++);
+	if (first < row_num) {
+		//Only lengths, offsets, pointers and slots of the rows following the first moved one are gathered, values in arena are not copied
+		unsigned long long moved = (row_num - first) * field_num;
+		char *buffer = (char *) malloc(moved * (2 * sizeof(unsigned long long) + sizeof(void *) + sizeof(long long)));
+		if (!buffer) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		}
+		unsigned long long *field_length = (unsigned long long *) buffer, *offset = field_length + moved;
+		void **field = (void **) (offset + moved);
+		long long *values = (long long *) (field + moved);
+		for (j = first, cell = 0; j < row_num; j++)
+			for (i = 0, from = (rows[j] - columns->records) * field_num; i < field_num; i++, cell++, from++) {
+				field_length[cell] = columns->field_length[from];
+				offset[cell] = columns->offset[from];
+				field[cell] = columns->field[from];
+				if (((long long *) field[cell] >= slots) && ((long long *) field[cell] < slot_end))
+					values[cell] = *((long long *) field[cell]);
+			}
+		for (j = first, cell = 0; j < row_num; j++) {
+			for (i = 0; i < field_num; i++, cell++) {
+				columns->field_length[j * field_num + i] = field_length[cell];
+				columns->offset[j * field_num + i] = offset[cell];
+				columns->field[j * field_num + i] = field[cell];
+				if (((long long *) field[cell] >= slots) && ((long long *) field[cell] < slot_end)) {
+					slot = slots + i * row_capacity + j;
+					*slot = values[cell];
+					columns->field[j * field_num + i] = slot;
+				}
+			}
+			rows[j] = columns->records + j;
+		}
+		free(buffer);
+	}
+
+	unsigned long long cells = row_num * field_num, size = 0;
+	char numeric[field_num];
+	for (i = 0; i < field_num; i++) {
+		numeric[i] = (!record_set->shared || !record_set->shared[i])
+		    && ((record_set->field_type[i] == OPH_IOSTORE_LONG_TYPE) || (record_set->field_type[i] == OPH_IOSTORE_REAL_TYPE));
+		for (j = 0; numeric[i] && (j < row_num); j++)
+			if (columns->field[j * field_num + i] != slots + i * row_capacity + j)
+				numeric[i] = 0;
+		columns->column[i] = numeric[i] ? (void *) (slots + i * row_capacity) : NULL;
+		for (j = 0; !numeric[i] && (j < row_num); j++)
+			if (((long long *) columns->field[j * field_num + i] >= slots) && ((long long *) columns->field[j * field_num + i] < slot_end))
+				size += OPH_IOSTORE_ARENA_ALIGN(sizeof(long long) + 1);
+	}
+	if (size) {
+		if (_oph_iostore_reserve_frag_arena(columns, size, 0))
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		for (i = 0; i < field_num; i++)
+			for (j = 0; !numeric[i] && (j < row_num); j++) {
+				cell = j * field_num + i;
+				if (((long long *) columns->field[cell] >= slots) && ((long long *) columns->field[cell] < slot_end))
+					_oph_iostore_append_frag_cell(columns, cell, columns->field[cell], columns->field_length[cell]);
+			}
+	}
+	//Arena is trimmed to its actual size
+	if (columns->arena_capacity > columns->arena_size) {
+		char *arena = columns->arena_size ? (char *) realloc(columns->arena, columns->arena_size) : NULL;
+		if (arena || !columns->arena_size) {
+			if (!arena)
+				free(columns->arena);
+			_oph_iostore_rebase_frag_arena(columns, arena, cells);
+			columns->arena_capacity = columns->arena_size;
+		}
+	}
+
+	columns->row_num = row_num;
+	columns->shared = record_set->shared;
+	columns->is_open = 0;
+	record_set->shared = NULL;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_pack_frag_recordset(oph_iostore_frag_record_set * record_set)
+{
+	if (!record_set) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (record_set->columns && record_set->columns->is_open)
+		return _oph_iostore_seal_frag_columns(record_set);
+	if (record_set->columns || !record_set->record_set || !record_set->record_set[0] || !record_set->field_num)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	//Records allocated one by one (e.g. by inserts) are copied in new columns
+
+	oph_iostore_frag_record **rows = record_set->record_set;
+	unsigned short i, field_num = record_set->field_num, numeric_num = 0;
+	long long j, row_num = 0;
+	while (rows[row_num])
+		row_num++;
+
+	//Numeric columns are stored as arrays only if every cell is set, otherwise they are moved in arena; shared cells are kept where they are
+	char numeric[field_num], shared[field_num];
+	for (i = 0; i < field_num; i++) {
+		shared[i] = record_set->shared && record_set->shared[i];
+		numeric[i] = !shared[i] && ((record_set->field_type[i] == OPH_IOSTORE_LONG_TYPE) || (record_set->field_type[i] == OPH_IOSTORE_REAL_TYPE));
+		for (j = 0; numeric[i] && (j < row_num); j++)
+			if (!rows[j]->field[i] || (rows[j]->field_length[i] != sizeof(long long)))
+				numeric[i] = 0;
+		if (numeric[i])
+			numeric_num++;
+	}
+
+	//Values in arena are null-terminated, since strings may be used as they are
+	unsigned long long arena_size = 0;
+	for (j = 0; j < row_num; j++)
+		for (i = 0; i < field_num; i++)
+			if (!numeric[i] && !shared[i] && rows[j]->field[i])
+				arena_size += OPH_IOSTORE_ARENA_ALIGN(rows[j]->field_length[i] + 1);
+
+	unsigned long long cells = row_num * field_num;
+	size_t slab_size =
+	    sizeof(oph_iostore_frag_columns) + row_num * sizeof(oph_iostore_frag_record) + cells * (2 * sizeof(unsigned long long) + sizeof(void *)) + field_num * sizeof(void *) +
+	    numeric_num * row_num * sizeof(long long);
+	char *slab = (char *) malloc(slab_size);
+	if (!slab) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	oph_iostore_frag_columns *columns = (oph_iostore_frag_columns *) slab;
+	columns->arena = NULL;
+	if (arena_size && !(columns->arena = (char *) malloc(arena_size))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		free(slab);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	columns->owner = record_set;
+	columns->row_num = row_num;
+	columns->arena_size = arena_size;
+	columns->map = NULL;
+	columns->map_size = 0;
+	columns->refcount = 1;
+	columns->field_num = field_num;
+	columns->shared = record_set->shared;
+	columns->is_open = 0;
+	columns->arena_capacity = arena_size;
+	columns->row_capacity = 0;
+	slab += sizeof(oph_iostore_frag_columns);
+	columns->records = (oph_iostore_frag_record *) slab;
+	slab += row_num * sizeof(oph_iostore_frag_record);
+	columns->field_length = (unsigned long long *) slab;
+	slab += cells * sizeof(unsigned long long);
+	columns->offset = (unsigned long long *) slab;
+	slab += cells * sizeof(unsigned long long);
+	columns->field = (void **) slab;
+	slab += cells * sizeof(void *);
+	columns->column = (void **) slab;
+	slab += field_num * sizeof(void *);
+	for (i = 0; i < field_num; i++) {
+		columns->column[i] = NULL;
+		if (numeric[i]) {
+			columns->column[i] = (void *) slab;
+			slab += row_num * sizeof(long long);
+		}
+	}
+
+	//Each record is released as soon as it is copied
+	unsigned long long arena_used = 0, cell;
+	oph_iostore_frag_record *record;
+	for (j = 0; j < row_num; j++) {
+		record = columns->records + j;
+		record->field_length = columns->field_length + j * field_num;
+		record->field = columns->field + j * field_num;
+		for (i = 0; i < field_num; i++) {
+			cell = j * field_num + i;
+			record->field_length[i] = rows[j]->field_length[i];
+			columns->offset[cell] = OPH_IOSTORE_NULL_OFFSET;
+			if (numeric[i]) {
+				record->field[i] = (long long *) columns->column[i] + j;
+				memcpy(record->field[i], rows[j]->field[i], sizeof(long long));
+			} else if (shared[i]) {
+				//Cell still refers to shared arena, so it is not released with the record
+				record->field[i] = rows[j]->field[i];
+				rows[j]->field[i] = NULL;
+			} else if (rows[j]->field[i]) {
+				columns->offset[cell] = arena_used;
+				record->field[i] = columns->arena + arena_used;
+				memcpy(record->field[i], rows[j]->field[i], record->field_length[i]);
+				columns->arena[arena_used + record->field_length[i]] = 0;
+				arena_used += OPH_IOSTORE_ARENA_ALIGN(record->field_length[i] + 1);
+			} else
+				record->field[i] = NULL;
+		}
+		oph_iostore_destroy_frag_record(&(rows[j]), field_num);
+		rows[j] = record;
+	}
+	record_set->columns = columns;
+	record_set->shared = NULL;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_get_frag_shared_columns(oph_iostore_frag_record_set * record_set, unsigned short field, oph_iostore_frag_columns ** columns)
+{
+	if (!record_set || !columns) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	*columns = NULL;
+
+	//Only string cells stored in an arena (of the record set or of the columns it refers to) can be shared
+	if (!record_set->columns || record_set->columns->is_open || (field >= record_set->field_num) || (record_set->field_type[field] != OPH_IOSTORE_STRING_TYPE))
+		return OPH_IOSTORAGE_SUCCESS;
+	if (record_set->columns->shared && record_set->columns->shared[field])
+		*columns = record_set->columns->shared[field];
+	else if (!record_set->columns->column[field])
+		*columns = record_set->columns;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_share_frag_field(oph_iostore_frag_record_set * record_set, unsigned short field, oph_iostore_frag_columns * columns)
+{
+	if (!record_set || !columns || (field >= record_set->field_num) || (record_set->columns && !record_set->columns->is_open)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (record_set->shared && record_set->shared[field])
+		return record_set->shared[field] == columns ? OPH_IOSTORAGE_SUCCESS : OPH_IOSTORAGE_BAD_PARAMETER;
+	if (!record_set->shared && !(record_set->shared = (oph_iostore_frag_columns **) calloc(record_set->field_num, sizeof(oph_iostore_frag_columns *)))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	__sync_fetch_and_add(&(columns->refcount), 1);
+	record_set->shared[field] = columns;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_destroy_frag_shared_record(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** record)
+{
+	if (!record_set || !record || !*record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	//Records of columns are only dropped, their cells are released with the columns
+	if (record_set->columns) {
+		*record = NULL;
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+
+	unsigned short i;
+	if (record_set->shared)
+		for (i = 0; i < record_set->field_num; i++)
+			if (record_set->shared[i])
+				(*record)->field[i] = NULL;
+
+	return oph_iostore_destroy_frag_record(record, record_set->field_num);
+}
+
+int oph_iostore_get_frag_row_num(oph_iostore_frag_record_set * record_set, long long *row_num)
+{
+	if (!record_set || !row_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	*row_num = 0;
+	if (record_set->columns && (record_set->columns->owner == record_set) && !record_set->columns->is_open)
+		*row_num = record_set->columns->row_num;
+	else if (record_set->record_set)
+		while (record_set->record_set[*row_num])
+			(*row_num)++;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_get_frag_column(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** records, long long row_num, unsigned short field, void **values)
+{
+	if (!record_set || !records || !values) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	*values = NULL;
+
+	oph_iostore_frag_columns *columns = record_set->columns;
+	if (!columns || (field >= record_set->field_num) || !columns->column[field] || (row_num <= 0))
+		return OPH_IOSTORAGE_SUCCESS;
+
+	//Records have to be consecutive rows of the columns
+	oph_iostore_frag_record *first = records[0];
+	if ((first < columns->records) || (first + row_num > columns->records + columns->row_num))
+		return OPH_IOSTORAGE_SUCCESS;
+	long long j;
+	for (j = 1; j < row_num; j++)
+		if (records[j] != first + j)
+			return OPH_IOSTORAGE_SUCCESS;
+
+	*values = (long long *) columns->column[field] + (first - columns->records);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_get_frag_size(oph_iostore_frag_record_set * record_set, unsigned long long *size)
+{
+	if (!record_set || !size) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	*size = 0;
+
+	unsigned short i, field_num = record_set->field_num;
+	long long j;
+	oph_iostore_frag_columns *columns = record_set->columns;
+	if (columns) {
+		if (columns->owner != record_set)
+			return OPH_IOSTORAGE_SUCCESS;
+		//Columns built in place keep a slot for each cell and the arena space of dropped rows
+		if (columns->row_capacity) {
+			*size =
+			    sizeof(oph_iostore_frag_columns) + columns->row_capacity * (sizeof(oph_iostore_frag_record) + field_num * (2 * sizeof(unsigned long long) + sizeof(void *) + sizeof(long long))) +
+			    columns->arena_capacity;
+			return OPH_IOSTORAGE_SUCCESS;
+		}
+		*size = sizeof(oph_iostore_frag_columns) + columns->row_num * (sizeof(oph_iostore_frag_record) + field_num * (2 * sizeof(unsigned long long) + sizeof(void *))) + columns->arena_size;
+		for (i = 0; i < field_num; i++)
+			if (columns->column[i])
+				*size += columns->row_num * sizeof(long long);
+	} else if (record_set->record_set)
+		for (j = 0; record_set->record_set[j]; j++) {
+			*size += sizeof(oph_iostore_frag_record) + field_num * (sizeof(unsigned long long) + sizeof(void *));
+			for (i = 0; i < field_num; i++)
+				if (record_set->record_set[j]->field[i] && (!record_set->shared || !record_set->shared[i]))
+					*size += record_set->record_set[j]->field_length[i];
+		}
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Function used to drop a reference to columns: they are released with the last one
+static void _oph_iostore_unref_frag_columns(oph_iostore_frag_columns * columns)
+{
+	if (__sync_sub_and_fetch(&(columns->refcount), 1))
+		return;
+
+	unsigned short i;
+	if (columns->shared) {
+		for (i = 0; i < columns->field_num; i++)
+			if (columns->shared[i])
+				_oph_iostore_unref_frag_columns(columns->shared[i]);
+		free(columns->shared);
+	}
+	if (columns->map)
+		munmap(columns->map, columns->map_size);
+	else if (columns->arena)
+		free(columns->arena);
+	free(columns);
+}
+
+int oph_iostore_release_frag_records(oph_iostore_frag_record_set * record_set)
+{
+	if (!record_set) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	long long i = 0;
+
+	if (record_set->columns) {
+		//Records are views of the columns, which are released only by their owner (when no other record set shares them)
+		if (record_set->columns->owner == record_set) {
+			record_set->columns->owner = NULL;
+			_oph_iostore_unref_frag_columns(record_set->columns);
+		}
+		record_set->columns = NULL;
+	} else if (record_set->record_set != NULL) {
+		while (record_set->record_set[i]) {
+			oph_iostore_destroy_frag_shared_record(record_set, &record_set->record_set[i]);
+			i++;
+		}
+	}
+	if (record_set->shared) {
+		for (i = 0; i < record_set->field_num; i++)
+			if (record_set->shared[i])
+				_oph_iostore_unref_frag_columns(record_set->shared[i]);
+		free(record_set->shared);
+		record_set->shared = NULL;
+	}
+
+	if (record_set->record_set != NULL) {
+		free(record_set->record_set);
+		record_set->record_set = NULL;
+	}
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Function used to write a block with sequential writes of at most OPH_IOSTORE_FILE_WRITE_SIZE bytes, followed by padding_size zeros (at most 7)
+static int _oph_iostore_write_block(int fd, const char *path, const void *buffer, unsigned long long size, unsigned long long padding_size)
+{
+	static const char padding[8] = { 0 };
+	const char *ptr = (const char *) buffer;
+	ssize_t n;
+	while (size || padding_size) {
+		if (!size) {
+			ptr = padding;
+			size = padding_size;
+			padding_size = 0;
+		}
+		n = write(fd, ptr, size > OPH_IOSTORE_FILE_WRITE_SIZE ? OPH_IOSTORE_FILE_WRITE_SIZE : size);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+			return OPH_IOSTORAGE_IO_ERR;
+		}
+		ptr += n;
+		size -= n;
+	}
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_write_frag_file(oph_iostore_frag_record_set * record_set, int fd, const char *path)
+{
+	if (!record_set || !record_set->field_num || (fd < 0) || !path) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+	//Fragment is written from its columnar storage
+	if (oph_iostore_pack_frag_recordset(record_set)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	oph_iostore_frag_columns *columns = record_set->columns;
+	if (!columns && record_set->record_set && record_set->record_set[0]) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+
+	unsigned short i, field_num = record_set->field_num;
+	long long j;
+	unsigned long long cell, cells = columns ? columns->row_num * field_num : 0;
+
+	//Cells shared with other columns are appended to the arena, so that the file does not depend on them
+	unsigned long long *offset = columns ? columns->offset : NULL, shared_size = 0;
+	char *shared_arena = NULL;
+	if (columns && columns->shared) {
+		for (j = 0; j < columns->row_num; j++)
+			for (i = 0; i < field_num; i++)
+				if (columns->shared[i] && columns->records[j].field[i])
+					shared_size += OPH_IOSTORE_ARENA_ALIGN(columns->records[j].field_length[i] + 1);
+		offset = (unsigned long long *) malloc(cells * sizeof(unsigned long long));
+		shared_arena = shared_size ? (char *) calloc(shared_size, sizeof(char)) : NULL;
+		if (!offset || (shared_size && !shared_arena)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			if (offset)
+				free(offset);
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		}
+		memcpy(offset, columns->offset, cells * sizeof(unsigned long long));
+		shared_size = 0;
+		for (j = 0; j < columns->row_num; j++)
+			for (i = 0; i < field_num; i++)
+				if (columns->shared[i] && columns->records[j].field[i]) {
+					cell = j * field_num + i;
+					offset[cell] = columns->arena_size + shared_size;
+					memcpy(shared_arena + shared_size, columns->records[j].field[i], columns->records[j].field_length[i]);
+					shared_size += OPH_IOSTORE_ARENA_ALIGN(columns->records[j].field_length[i] + 1);
+				}
+	}
+
+	oph_iostore_frag_file_header header;
+	memset(&header, 0, sizeof(oph_iostore_frag_file_header));
+	memcpy(header.magic, OPH_IOSTORE_FILE_MAGIC, sizeof(header.magic));
+	header.version = OPH_IOSTORE_FILE_VERSION;
+	header.field_num = field_num;
+	header.row_num = columns ? columns->row_num : 0;
+	header.arena_size = columns ? columns->arena_size + shared_size : 0;
+	header.names_size = (record_set->frag_name ? strlen(record_set->frag_name) : 0) + 1;
+	char numeric[field_num];
+	for (i = 0; i < field_num; i++) {
+		header.names_size += (record_set->field_name[i] ? strlen(record_set->field_name[i]) : 0) + 1;
+		numeric[i] = columns && columns->column[i];
+	}
+
+	//Blocks are written sequentially, as they are stored in memory
+	int res = _oph_iostore_write_block(fd, path, &header, sizeof(oph_iostore_frag_file_header), OPH_IOSTORE_FILE_ALIGN(sizeof(oph_iostore_frag_file_header)) - sizeof(oph_iostore_frag_file_header))
+	    || _oph_iostore_write_block(fd, path, record_set->field_type, field_num * sizeof(oph_iostore_field_type),
+					OPH_IOSTORE_FILE_ALIGN(field_num * sizeof(oph_iostore_field_type)) - field_num * sizeof(oph_iostore_field_type))
+	    || _oph_iostore_write_block(fd, path, numeric, field_num, OPH_IOSTORE_FILE_ALIGN(field_num) - field_num);
+	res = res || _oph_iostore_write_block(fd, path, record_set->frag_name ? record_set->frag_name : "", (record_set->frag_name ? strlen(record_set->frag_name) : 0) + 1, 0);
+	for (i = 0; !res && (i < field_num); i++)
+		res = _oph_iostore_write_block(fd, path, record_set->field_name[i] ? record_set->field_name[i] : "", (record_set->field_name[i] ? strlen(record_set->field_name[i]) : 0) + 1, 0);
+	res = res || _oph_iostore_write_block(fd, path, NULL, 0, OPH_IOSTORE_FILE_ALIGN(header.names_size) - header.names_size);
+	if (columns) {
+		res = res || _oph_iostore_write_block(fd, path, columns->field_length, cells * sizeof(unsigned long long), 0)
+		    || _oph_iostore_write_block(fd, path, offset, cells * sizeof(unsigned long long), 0);
+		for (i = 0; !res && (i < field_num); i++)
+			if (numeric[i])
+				res = _oph_iostore_write_block(fd, path, columns->column[i], header.row_num * sizeof(long long), 0);
+		res = res || _oph_iostore_write_block(fd, path, columns->arena, columns->arena_size, 0) || _oph_iostore_write_block(fd, path, shared_arena, shared_size, 0);
+	}
+	if (offset && (offset != columns->offset))
+		free(offset);
+	if (shared_arena)
+		free(shared_arena);
+
+	return res ? OPH_IOSTORAGE_IO_ERR : OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_map_frag_file(const char *path, oph_iostore_frag_record_set ** record_set)
+{
+	if (!path || !record_set) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	*record_set = NULL;
+
+	//Map the whole file: pages are loaded only when cells are read and changes are kept private
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+	struct stat st;
+	if (fstat(fd, &st)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		close(fd);
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+	unsigned long long map_size = st.st_size;
+	if (map_size < sizeof(oph_iostore_frag_file_header)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FORMAT_ERROR, path);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FORMAT_ERROR, path);
+		close(fd);
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+	char *map = (char *) mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+
+	//Check the layout of the file
+	oph_iostore_frag_file_header *header = (oph_iostore_frag_file_header *) map;
+	unsigned short i, field_num = header->field_num;
+	long long j, row_num = header->row_num;
+	unsigned long long cells = row_num * field_num, size = 0;
+	if (!memcmp(header->magic, OPH_IOSTORE_FILE_MAGIC, sizeof(header->magic)) && (header->version == OPH_IOSTORE_FILE_VERSION) && field_num && (header->field_num <= 0xFFFF) && (row_num >= 0)
+	    && (header->names_size <= map_size) && (header->arena_size <= map_size)
+	    && ((unsigned long long) row_num <= map_size / (2 * sizeof(unsigned long long) * field_num)))
+		size =
+		    OPH_IOSTORE_FILE_ALIGN(sizeof(oph_iostore_frag_file_header)) + OPH_IOSTORE_FILE_ALIGN(field_num * sizeof(oph_iostore_field_type)) + OPH_IOSTORE_FILE_ALIGN(field_num) + OPH_IOSTORE_FILE_ALIGN(header->names_size) +
+		    2 * cells * sizeof(unsigned long long);
+	char *types = map + OPH_IOSTORE_FILE_ALIGN(sizeof(oph_iostore_frag_file_header));
+	char *numeric = types + OPH_IOSTORE_FILE_ALIGN(field_num * sizeof(oph_iostore_field_type));
+	char *names = numeric + OPH_IOSTORE_FILE_ALIGN(field_num);
+	unsigned short numeric_num = 0;
+	if (size && (size <= map_size)) {
+		for (i = 0; i < field_num; i++)
+			if (numeric[i])
+				numeric_num++;
+		size += numeric_num * row_num * sizeof(long long) + header->arena_size;
+	}
+	if (!size || (size != map_size) || !header->names_size || names[header->names_size - 1]) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FORMAT_ERROR, path);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FORMAT_ERROR, path);
+		munmap(map, map_size);
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+	//Cells of numeric columns are read as values of fixed size, so their length is checked too
+	unsigned long long *field_length = (unsigned long long *) (names + OPH_IOSTORE_FILE_ALIGN(header->names_size));
+	for (j = 0; numeric_num && (j < row_num); j++) {
+		for (i = 0; i < field_num; i++)
+			if (numeric[i] && (field_length[j * field_num + i] != sizeof(long long)))
+				break;
+		if (i < field_num)
+			break;
+	}
+	if (numeric_num && (j < row_num)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FORMAT_ERROR, path);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FORMAT_ERROR, path);
+		munmap(map, map_size);
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+
+	if (oph_iostore_create_frag_recordset_only(record_set, row_num, field_num) || !*record_set) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		munmap(map, map_size);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	//Names block contains fragment name followed by field names
+	char *name = names, *names_end = names + header->names_size;
+	(*record_set)->frag_name = strdup(name);
+	name += strlen(name) + 1;
+	for (i = 0; (i < field_num) && (name < names_end); i++) {
+		if (!((*record_set)->field_name[i] = strdup(name)))
+			break;
+		name += strlen(name) + 1;
+	}
+	memcpy((*record_set)->field_type, types, field_num * sizeof(oph_iostore_field_type));
+	if (!(*record_set)->frag_name || (i < field_num)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FORMAT_ERROR, path);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_FORMAT_ERROR, path);
+		oph_iostore_destroy_frag_recordset_only(record_set);
+		munmap(map, map_size);
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+	//Empty fragments are not mapped
+	if (!row_num) {
+		munmap(map, map_size);
+		(*record_set)->record_set = (oph_iostore_frag_record **) calloc(1, sizeof(oph_iostore_frag_record *));
+		if (!(*record_set)->record_set) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+			oph_iostore_destroy_frag_recordset_only(record_set);
+			return OPH_IOSTORAGE_MEMORY_ERR;
+		}
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+	//Only records and cell pointers are allocated, while cell values are referred in the mapping
+	char *slab = (char *) malloc(sizeof(oph_iostore_frag_columns) + row_num * sizeof(oph_iostore_frag_record) + cells * sizeof(void *) + field_num * sizeof(void *));
+	if (!slab) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		oph_iostore_destroy_frag_recordset_only(record_set);
+		munmap(map, map_size);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	oph_iostore_frag_columns *columns = (oph_iostore_frag_columns *) slab;
+	columns->owner = *record_set;
+	columns->row_num = row_num;
+	columns->arena_size = header->arena_size;
+	columns->map = map;
+	columns->map_size = map_size;
+	columns->refcount = 1;
+	columns->field_num = field_num;
+	columns->shared = NULL;
+	columns->is_open = 0;
+	columns->arena_capacity = 0;
+	columns->row_capacity = 0;
+	slab += sizeof(oph_iostore_frag_columns);
+	columns->records = (oph_iostore_frag_record *) slab;
+	slab += row_num * sizeof(oph_iostore_frag_record);
+	columns->field = (void **) slab;
+	slab += cells * sizeof(void *);
+	columns->column = (void **) slab;
+
+	char *data = names + OPH_IOSTORE_FILE_ALIGN(header->names_size);
+	columns->field_length = (unsigned long long *) data;
+	data += cells * sizeof(unsigned long long);
+	columns->offset = (unsigned long long *) data;
+	data += cells * sizeof(unsigned long long);
+	for (i = 0; i < field_num; i++) {
+		columns->column[i] = NULL;
+		if (numeric[i]) {
+			columns->column[i] = (void *) data;
+			data += row_num * sizeof(long long);
+		}
+	}
+	columns->arena = data;
+
+	unsigned long long cell;
+	oph_iostore_frag_record *record;
+	for (j = 0; j < row_num; j++) {
+		record = columns->records + j;
+		record->field_length = columns->field_length + j * field_num;
+		record->field = columns->field + j * field_num;
+		for (i = 0; i < field_num; i++) {
+			cell = j * field_num + i;
+			if (numeric[i])
+				record->field[i] = (long long *) columns->column[i] + j;
+			else if ((columns->offset[cell] != OPH_IOSTORE_NULL_OFFSET) && (columns->offset[cell] < columns->arena_size)
+				 && (record->field_length[i] < columns->arena_size - columns->offset[cell]))
+				record->field[i] = columns->arena + columns->offset[cell];
+			else
+				record->field[i] = NULL;
+		}
+		(*record_set)->record_set[j] = record;
+	}
+	(*record_set)->record_set[row_num] = NULL;
+	(*record_set)->columns = columns;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
 int oph_iostore_create_sample_frag(const long long row_number, const long long array_length, oph_iostore_frag_record_set ** record_set)
 {
 	if (!record_set || !row_number || !array_length) {
@@ -432,6 +1343,8 @@ int oph_iostore_create_sample_frag(const long long row_number, const long long a
 	(*record_set)->field_num = 2;
 	(*record_set)->field_type = NULL;
 	(*record_set)->record_set = NULL;
+	(*record_set)->columns = NULL;
+	(*record_set)->shared = NULL;
 	(*record_set)->field_name = (char **) calloc(2, sizeof(char *));
 	if (!(*record_set)->field_name) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
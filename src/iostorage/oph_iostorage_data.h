@@ -38,6 +38,49 @@ typedef struct {
 	void **field;
 } oph_iostore_frag_record;
 
+//Offset of cells not stored in arena
+#define OPH_IOSTORE_NULL_OFFSET	((unsigned long long) -1)
+
+/**
+ * \brief			          Structure for storing the records of a fragment by columns in two blocks: a slab with cells metadata and numeric columns, and an arena with other values
+ * \param owner			    Record set the columns belong to (copies of the record set only refer to them)
+ * \param row_num		    Number of rows
+ * \param records		    Array of records, used as row views of the columns
+ * \param field_length 	Array with the length of each cell (row by row, so that each record refers to its own slice)
+ * \param field			    Array with the pointer to each cell (row by row)
+ * \param column		    Array with the contiguous values of each numeric column (NULL for columns stored in arena)
+ * \param offset		    Array with the offset of each cell in arena (row by row, OPH_IOSTORE_NULL_OFFSET for numeric and null cells)
+ * \param arena		      Buffer with the values of string (binary) columns
+ * \param arena_size	    Size of arena
+ * \param map		        Memory mapped file containing cells metadata, numeric columns and arena (NULL if they are allocated in memory)
+ * \param map_size	      Size of the mapping
+ * \param refcount	      Number of references to the columns: the owner and each fragment sharing cells of its arena
+ * \param field_num	      Number of fields
+ * \param shared		    Array with the columns whose arena contains the cells of each field (NULL if no field refers to other arenas)
+ * \param is_open	      Flag set while cells are being set, until the columns are sealed by packing the record set
+ * \param arena_capacity  Allocated size of arena
+ * \param row_capacity    Number of rows allocated for columns built in place, including a value slot for each cell (0 otherwise)
+ */
+typedef struct _oph_iostore_frag_columns {
+	void *owner;
+	long long row_num;
+	oph_iostore_frag_record *records;
+	unsigned long long *field_length;
+	void **field;
+	void **column;
+	unsigned long long *offset;
+	char *arena;
+	unsigned long long arena_size;
+	void *map;
+	unsigned long long map_size;
+	unsigned int refcount;
+	unsigned short field_num;
+	struct _oph_iostore_frag_columns **shared;
+	char is_open;
+	unsigned long long arena_capacity;
+	long long row_capacity;
+} oph_iostore_frag_columns;
+
 /**
  * \brief			          Structure containing information about a fragment record set (entire table)
  * \param frag_name		  Name of Fragment
@@ -46,6 +89,8 @@ typedef struct {
  * \param field_type		Array containing type of each cell
  * \param record_set		NULL terminated array with pointers to actual records
  * \param tmp_flag			Flag set to 1 if the table is considered as a temporary one (deleted at the end of the operation)
+ * \param columns			Columnar storage of the records (NULL if each record is allocated separately)
+ * \param shared			Array with the columns whose arena contains the cells of each field, until records are packed (NULL if no field refers to other arenas)
  */
 typedef struct {
 	char *frag_name;
@@ -54,8 +99,37 @@ typedef struct {
 	oph_iostore_field_type *field_type;
 	oph_iostore_frag_record **record_set;
 	char tmp_flag;
+	oph_iostore_frag_columns *columns;
+	oph_iostore_frag_columns **shared;
 } oph_iostore_frag_record_set;
 
+//Fragments can be stored in files with the layout of columnar storage: a header, field types, numeric flags and names (fragment name followed
+//by field names), then cell lengths, cell offsets, numeric columns and arena, each block aligned to 8 bytes, so that files can be mapped as they are
+#define OPH_IOSTORE_FILE_MAGIC		"OPHFRAG"
+#define OPH_IOSTORE_FILE_VERSION	1
+#define OPH_IOSTORE_FILE_ALIGN(size)	(((size) + 7) & ~7ULL)
+
+//Max size of each write
+#define OPH_IOSTORE_FILE_WRITE_SIZE	(64 * 1024 * 1024)
+
+/**
+ * \brief			          Header of fragment files
+ * \param magic		      Magic string
+ * \param version		    Version of file format
+ * \param field_num	    Number of fields
+ * \param row_num		    Number of rows
+ * \param names_size	    Size of the block of null-terminated names
+ * \param arena_size	    Size of the arena
+ */
+typedef struct {
+	char magic[8];
+	unsigned int version;
+	unsigned int field_num;
+	long long row_num;
+	unsigned long long names_size;
+	unsigned long long arena_size;
+} oph_iostore_frag_file_header;
+
 /**
  * \brief			          Structure containing information about a DB record set
  * \param db_name		    Name of DB
@@ -168,6 +242,111 @@ int oph_iostore_create_frag_recordset(oph_iostore_frag_record_set ** record_set,
  */
 int oph_iostore_create_frag_recordset_only(oph_iostore_frag_record_set ** record_set, long long set_size, short int field_num);
 
+/**
+ * \brief			        Create an empty recordset whose records are views of open columnar storage, so that cells are set in place by oph_iostore_set_frag_cell
+ * \param record_set  Record set to be allocated
+ * \param set_size    Number of rows in record set
+ * \param field_num   Number of fields in each record
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_create_frag_recordset_columns(oph_iostore_frag_record_set ** record_set, long long set_size, short int field_num);
+
+/**
+ * \brief			        Set a cell of a record set; the value is copied in the columns while they are open, or in a new buffer owned by the record otherwise. Not thread-safe for cells of open columns
+ * \param record_set  Record set
+ * \param row         Index of the record
+ * \param field       Index of the field
+ * \param value       Value of the cell (NULL for a null cell)
+ * \param length      Length of the value
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_set_frag_cell(oph_iostore_frag_record_set * record_set, long long row, unsigned short field, const void *value, unsigned long long length);
+
+/**
+ * \brief			        Seal the columnar storage of a record set. Open columns are sealed in place, following the current order of records (the arena space of dropped rows is kept until release);
+ *                    records allocated one by one are instead copied in new columns and released, and are not changed if columns cannot be allocated
+ * \param record_set  Record set to be packed (its records are then views of the columns and cannot be released one by one)
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_pack_frag_recordset(oph_iostore_frag_record_set * record_set);
+
+/**
+ * \brief			        Get the columns whose arena contains the cells of a string field, so that they can be shared instead of being copied
+ * \param record_set  Record set (or a copy of it)
+ * \param field       Index of the field
+ * \param columns     Pointer to be filled with the columns, or NULL if cells of the field cannot be shared
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_get_frag_shared_columns(oph_iostore_frag_record_set * record_set, unsigned short field, oph_iostore_frag_columns ** columns);
+
+/**
+ * \brief			        Mark a field of a record set not yet packed (or whose columns are still open) as referring to cells of other columns, which are kept until the record set is released
+ * \param record_set  Record set whose records refer to the cells (they are not copied in its arena and not released with its records)
+ * \param field       Index of the field
+ * \param columns     Columns containing the cells
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_share_frag_field(oph_iostore_frag_record_set * record_set, unsigned short field, oph_iostore_frag_columns * columns);
+
+/**
+ * \brief			        Release a record of a record set not yet packed, without releasing cells shared with other record sets; records of columns are only dropped from the record set
+ * \param record_set  Record set
+ * \param record      Record to be freed
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_destroy_frag_shared_record(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** record);
+
+/**
+ * \brief			        Get the number of rows of a record set
+ * \param record_set  Record set
+ * \param row_num     Pointer to be filled with the number of rows
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_get_frag_row_num(oph_iostore_frag_record_set * record_set, long long *row_num);
+
+/**
+ * \brief			        Get the contiguous values of a numeric column for a sequence of records
+ * \param record_set  Record set (or a copy of it)
+ * \param records     Sequence of records of the record set
+ * \param row_num     Number of records in sequence
+ * \param field       Index of the column
+ * \param values      Pointer to be filled with the values of the records, or NULL if they are not consecutive rows of columnar storage
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_get_frag_column(oph_iostore_frag_record_set * record_set, oph_iostore_frag_record ** records, long long row_num, unsigned short field, void **values);
+
+/**
+ * \brief			        Get the memory used by the records of a record set
+ * \param record_set  Record set
+ * \param size        Pointer to be filled with the size in bytes of records, cells and columns (cells shared with other record sets are not included)
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_get_frag_size(oph_iostore_frag_record_set * record_set, unsigned long long *size);
+
+/**
+ * \brief			        Release the records of a record set, keeping fragment name and fields; shared columns are released with their last reference
+ * \param record_set  Record set to be emptied
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_release_frag_records(oph_iostore_frag_record_set * record_set);
+
+/**
+ * \brief			        Write a record set in a fragment file; it is moved in columnar storage if needed and shared cells are appended to its arena
+ * \param record_set  Record set to be written
+ * \param fd          Descriptor of the file, positioned at its beginning
+ * \param path        Path of the file (used for error messages)
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_write_frag_file(oph_iostore_frag_record_set * record_set, int fd, const char *path);
+
+/**
+ * \brief			        Create a record set by mapping a fragment file; cell values are read from the file only when they are accessed
+ * \param path        Path of the file
+ * \param record_set  Record set to be allocated (the mapping is released with it)
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_iostore_map_frag_file(const char *path, oph_iostore_frag_record_set ** record_set);
+
 /**
  * \brief			        Create a sample recordset (for test purposes). It does not set the frag_name.
  * \param row_number  Number of rows in record set
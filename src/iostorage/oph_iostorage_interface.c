@@ -27,6 +27,7 @@
 
 #include "debug.h"
 #include "oph_iostorage_log_error_codes.h"
+#include "oph_iostorage_memory.h"
 #include "oph_server_confs.h"
 #include "oph_server_utility.h"
 
@@ -37,14 +38,22 @@ extern pthread_mutex_t libtool_lock;
 
 static int oph_iostore_find_device(const char *device, char **dyn_lib, unsigned short int *is_persitent);
 
-int (*_DEVICE_setup) (oph_iostore_handler * handle);
-int (*_DEVICE_cleanup) (oph_iostore_handler * handle);
-int (*_DEVICE_get_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record);
-int (*_DEVICE_put_db) (oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id);
-int (*_DEVICE_delete_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
-int (*_DEVICE_get_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
-int (*_DEVICE_put_frag) (oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id);
-int (*_DEVICE_delete_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+//Device functions are resolved before each call, so they are thread-local in order to allow threads to use different devices
+__thread int (*_DEVICE_setup) (oph_iostore_handler * handle);
+__thread int (*_DEVICE_cleanup) (oph_iostore_handler * handle);
+__thread int (*_DEVICE_get_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record);
+__thread int (*_DEVICE_put_db) (oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id);
+__thread int (*_DEVICE_delete_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+__thread int (*_DEVICE_get_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
+__thread int (*_DEVICE_put_frag) (oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id);
+__thread int (*_DEVICE_delete_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+
+static char data_dir[OPH_IOSTORAGE_BUFLEN] = OPH_IO_SERVER_PREFIX;
+
+void oph_iostore_set_data_prefix(char *p)
+{
+	snprintf(data_dir, OPH_IOSTORAGE_BUFLEN, "%s", p);
+}
 
 int oph_iostore_setup(const char *device, oph_iostore_handler ** handle)
 {
@@ -67,6 +76,8 @@ int oph_iostore_setup(const char *device, oph_iostore_handler ** handle)
 	internal_handle->device = NULL;
 	internal_handle->lib = NULL;
 	internal_handle->dlh = NULL;
+	internal_handle->connection = NULL;
+	internal_handle->data_dir = data_dir;
 
 	//Set storage device type
 	internal_handle->device = (char *) strndup(device, strlen(device));
@@ -312,7 +323,31 @@ int oph_iostore_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id *
 	}
 	pthread_mutex_unlock(&libtool_lock);
 
-	return _DEVICE_get_frag(handle, res_id, frag_record);
+	int res = _DEVICE_get_frag(handle, res_id, frag_record);
+	if (res || handle->is_persistent)
+		return res;
+
+	//Fragments of transient devices are kept resident until they are released
+	if (oph_iostore_memory_pin(res_id)) {
+		*frag_record = NULL;
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_release_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record)
+{
+	if (!handle) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_HANDLE);
+		return OPH_IOSTORAGE_NULL_HANDLE;
+	}
+
+	if (handle->is_persistent || !frag_record)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	return oph_iostore_memory_unpin(frag_record);
 }
 
 int oph_iostore_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id)
@@ -341,7 +376,17 @@ int oph_iostore_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_s
 	}
 	pthread_mutex_unlock(&libtool_lock);
 
-	return _DEVICE_put_frag(handle, frag_record, res_id);
+	int res = _DEVICE_put_frag(handle, frag_record, res_id);
+	if (res || handle->is_persistent)
+		return res;
+
+	//The fragment stays in memory anyway, so accounting errors are not fatal
+	if (oph_iostore_memory_add(*res_id, frag_record)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to account fragment '%s' in memory budget\n", frag_record->frag_name);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to account fragment '%s' in memory budget\n", frag_record->frag_name);
+	}
+
+	return OPH_IOSTORAGE_SUCCESS;
 }
 
 int oph_iostore_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_id * res_id)
@@ -370,6 +415,9 @@ int oph_iostore_delete_frag(oph_iostore_handler * handle, oph_iostore_resource_i
 	}
 	pthread_mutex_unlock(&libtool_lock);
 
+	if (!handle->is_persistent)
+		oph_iostore_memory_remove(res_id);
+
 	return _DEVICE_delete_frag(handle, res_id);
 }
 
@@ -47,6 +47,7 @@
  * \param lib             Dynamic library path
  * \param dlh             Libtool handler to dynamic library
  * \param connection      Variable to hold generic storage device connection status info
+ * \param data_dir        Server directory where persistent devices can store data
  */
 typedef struct {
 	char *device;
@@ -54,36 +55,43 @@ typedef struct {
 	char *lib;
 	void *dlh;
 	void *connection;
+	char *data_dir;
 } oph_iostore_handler;
 
 //****************Plugin Interface******************//
 
 //Function to initialize storage library.
-extern int (*_DEVICE_setup) (oph_iostore_handler * handle);
+extern __thread int (*_DEVICE_setup) (oph_iostore_handler * handle);
 
 //Function to finalize the storage library and release all dynamic loading resources.
-extern int (*_DEVICE_cleanup) (oph_iostore_handler * handle);
+extern __thread int (*_DEVICE_cleanup) (oph_iostore_handler * handle);
 
 //Function to retrieve a DB record from storage device
-extern int (*_DEVICE_get_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record);
+extern __thread int (*_DEVICE_get_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_db_record_set ** db_record);
 
 //Function to insert a DB record into storage device
-extern int (*_DEVICE_put_db) (oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id);
+extern __thread int (*_DEVICE_put_db) (oph_iostore_handler * handle, oph_iostore_db_record_set * db_record, oph_iostore_resource_id ** res_id);
 
 //Function to delete a DB from a storage device
-extern int (*_DEVICE_delete_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+extern __thread int (*_DEVICE_delete_db) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
 
 //Function to retrieve a fragment record from storage device
-extern int (*_DEVICE_get_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
+extern __thread int (*_DEVICE_get_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id, oph_iostore_frag_record_set ** frag_record);
 
 //Function to insert a fragment record into storage device
-extern int (*_DEVICE_put_frag) (oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id);
+extern __thread int (*_DEVICE_put_frag) (oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id);
 
 //Function to delete a fragment from a storage device
-extern int (*_DEVICE_delete_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
+extern __thread int (*_DEVICE_delete_frag) (oph_iostore_handler * handle, oph_iostore_resource_id * res_id);
 
 //*****************Internal Functions (used by query engine library)***************//
 
+/**
+ * \brief               Function to set the server directory passed to devices
+ * \param p             Path of the directory
+ */
+void oph_iostore_set_data_prefix(char *p);
+
 /**
  * \brief               Function to initialize data storage library. This function should be called before any other function to initialize the dynamic library.
  * \param device        String with the name of storage device plugin to use
@@ -143,6 +151,14 @@ int oph_iostore_get_frag(oph_iostore_handler * handle, oph_iostore_resource_id *
  */
 int oph_iostore_put_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record, oph_iostore_resource_id ** res_id);
 
+/**
+ * \brief               Function to release a fragment got with oph_iostore_get_frag and not destroyed by the caller (fragments of transient devices)
+ * \param handle        Dynamic I/O storage plugin handle
+ * \param frag_record   Fragment record set to be released
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_release_frag(oph_iostore_handler * handle, oph_iostore_frag_record_set * frag_record);
+
 /**
  * \brief               Function to delete a fragment from a storage device
  * \param handle        Dynamic I/O storage plugin handle
@@ -34,6 +34,8 @@
 #define OPH_IOSTORAGE_MEMORY_ERR			-10
 #define OPH_IOSTORAGE_NULL_PARAM			-11
 #define OPH_IOSTORAGE_VALID_ERROR			-12
+#define OPH_IOSTORAGE_IO_ERR				-13
+#define OPH_IOSTORAGE_COMPRESSION_ERR			-14
 
 #define OPH_IOSTORAGE_NULL_HANDLE_FIELD			-101
 #define OPH_IOSTORAGE_NOT_NULL_OPERATOR_HANDLE		-102
@@ -65,5 +67,8 @@
 #define OPH_IOSTORAGE_LOG_FILE_NOT_FOUND    "IO server file not found %s\n"
 #define OPH_IOSTORAGE_LOG_READ_LINE_ERROR   "Unable to read file line\n"
 #define OPH_IOSTORAGE_LOG_MEMORY_ERROR      "Memory allocation error\n"
+#define OPH_IOSTORAGE_LOG_IO_ERROR          "Error on file %s: %s\n"
+#define OPH_IOSTORAGE_LOG_FORMAT_ERROR      "File %s is not a valid fragment\n"
+#define OPH_IOSTORAGE_LOG_COMPRESSION_ERROR "Unable to decompress fragment %s\n"
 
 #endif				//__OPH_IOSTORAGE_LOG_ERROR_CODES_H
@@ -0,0 +1,863 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "oph_iostorage_memory.h"
+#include "oph_iostorage_log_error_codes.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "debug.h"
+#include "taketime.h"
+
+#ifdef OPH_IOSTORE_ZLIB
+#include <zlib.h>
+#define OPH_IOSTORE_MEMORY_COMPRESSION_LEVEL	Z_BEST_SPEED	/* favour speed, fragments are decompressed at each access */
+#endif
+
+extern int msglevel;
+
+#define OPH_IOSTORE_MEMORY_PATH_LEN	1024
+#define OPH_IOSTORE_MEMORY_MIN_SLOTS	1024
+
+//Arenas are compressed only if they are large enough and shrink by at least a quarter
+#define OPH_IOSTORE_MEMORY_MIN_ARENA	4096
+#define OPH_IOSTORE_MEMORY_MAX_RATIO(size)	((size) - (size) / 4)
+
+//Cells in arena are aligned to 8 bytes, so bytes are shuffled with this stride before compression
+#define OPH_IOSTORE_MEMORY_SHUFFLE	sizeof(long long)
+
+/**
+ * \brief			        Structure with a fragment accounted by the manager
+ * \param id            Resource id of the fragment
+ * \param id_length     Length of resource id
+ * \param id_hash       Hash of resource id
+ * \param frag_record   Record set of the fragment (its records are released while it is spilled)
+ * \param size          Size of the records
+ * \param pin           Number of queries using the fragment
+ * \param last_use      Time of last access to the fragment
+ * \param is_resident   Flag set if records are in memory
+ * \param is_compressed Flag set if the arena of the fragment is compressed
+ * \param is_busy       Flag set while the arena is being compressed in background or the spill file is being written
+ * \param skip_compression Flag set if the arena has not to be compressed (too small or not compressible)
+ * \param zbuf          Compressed arena
+ * \param zbuf_size     Size of compressed arena
+ * \param compression_ratio Ratio between size of arena and its compressed size (0 if never compressed)
+ * \param decompressions Number of times the arena has been decompressed
+ * \param decompression_time Overall time spent decompressing the arena (in seconds)
+ * \param spill_path    Spill file of the fragment (NULL if it has never been spilled)
+ * \param prev          Resident fragment used more recently
+ * \param next          Resident fragment used less recently
+ * \param id_chain      Next entry in the same slot of resource ids
+ * \param ref_chain     Next entry in the same slot of record sets
+ */
+typedef struct _oph_iostore_memory_entry {
+	void *id;
+	unsigned short id_length;
+	unsigned long long id_hash;
+	oph_iostore_frag_record_set *frag_record;
+	unsigned long long size;
+	unsigned int pin;
+	time_t last_use;
+	char is_resident;
+	char is_compressed;
+	char is_busy;
+	char skip_compression;
+	void *zbuf;
+	unsigned long long zbuf_size;
+	double compression_ratio;
+	unsigned int decompressions;
+	double decompression_time;
+	char *spill_path;
+	struct _oph_iostore_memory_entry *prev;
+	struct _oph_iostore_memory_entry *next;
+	struct _oph_iostore_memory_entry *id_chain;
+	struct _oph_iostore_memory_entry *ref_chain;
+} oph_iostore_memory_entry;
+
+/**
+ * \brief			        Structure with the status of the manager
+ * \param id_slots      Hash slots of entries by resource id
+ * \param ref_slots     Hash slots of entries by record set
+ * \param slot_num      Number of slots (power of 2)
+ * \param entry_num     Number of entries
+ * \param enabled       Flag set if the manager is enabled
+ * \param budget        Max size of resident fragments (0 for no limit)
+ * \param idle_time     Time after which unused fragments are compressed (0 to disable compression)
+ * \param resident_size Size of resident fragments
+ * \param head          Resident fragment used most recently
+ * \param tail          Resident fragment used least recently, spilled first
+ * \param spills        Number of fragments spilled
+ * \param faults        Number of spilled fragments loaded again
+ * \param compressions  Number of fragments compressed
+ * \param data_dir      Server directory
+ * \param lock          Mutex protecting the manager
+ * \param cond          Condition used to wake up the compressor thread
+ * \param busy_cond     Condition signalled when a fragment is no longer being compressed or spilled
+ * \param compressor    Thread compressing idle fragments
+ * \param stop          Flag set to stop the compressor thread
+ */
+typedef struct {
+	oph_iostore_memory_entry **id_slots;
+	oph_iostore_memory_entry **ref_slots;
+	unsigned int slot_num;
+	unsigned int entry_num;
+	char enabled;
+	unsigned long long budget;
+	unsigned int idle_time;
+	unsigned long long resident_size;
+	oph_iostore_memory_entry *head;
+	oph_iostore_memory_entry *tail;
+	unsigned long long spills;
+	unsigned long long faults;
+	unsigned long long compressions;
+	char data_dir[OPH_IOSTORE_MEMORY_PATH_LEN];
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_cond_t busy_cond;
+	pthread_t compressor;
+	char stop;
+} oph_iostore_memory_manager;
+
+static oph_iostore_memory_manager manager =
+    { NULL, NULL, 0, 0, 0, 0, 0, 0, NULL, NULL, 0, 0, 0, "", PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0 };
+
+//FNV-1a
+static unsigned long long _oph_iostore_memory_hash(const void *key, size_t length)
+{
+	const unsigned char *ptr = (const unsigned char *) key;
+	unsigned long long hash = 14695981039346656037ULL;
+	for (; length; ptr++, length--) {
+		hash ^= *ptr;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static unsigned long long _oph_iostore_memory_ref_hash(oph_iostore_frag_record_set * frag_record)
+{
+	return _oph_iostore_memory_hash(&frag_record, sizeof(oph_iostore_frag_record_set *));
+}
+
+static void _oph_iostore_memory_unlink(oph_iostore_memory_entry * entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		manager.head = entry->next;
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		manager.tail = entry->prev;
+	entry->prev = entry->next = NULL;
+}
+
+static void _oph_iostore_memory_push(oph_iostore_memory_entry * entry)
+{
+	entry->prev = NULL;
+	entry->next = manager.head;
+	if (manager.head)
+		manager.head->prev = entry;
+	else
+		manager.tail = entry;
+	manager.head = entry;
+}
+
+static void _oph_iostore_memory_insert(oph_iostore_memory_entry * entry)
+{
+	oph_iostore_memory_entry **slot = &(manager.id_slots[entry->id_hash & (manager.slot_num - 1)]);
+	entry->id_chain = *slot;
+	*slot = entry;
+	slot = &(manager.ref_slots[_oph_iostore_memory_ref_hash(entry->frag_record) & (manager.slot_num - 1)]);
+	entry->ref_chain = *slot;
+	*slot = entry;
+}
+
+//Function used to find an entry by resource id: the manager has to be locked
+static oph_iostore_memory_entry *_oph_iostore_memory_find(oph_iostore_resource_id * res_id)
+{
+	if (!manager.id_slots || !res_id || !res_id->id)
+		return NULL;
+
+	unsigned long long hash = _oph_iostore_memory_hash(res_id->id, res_id->id_length);
+	oph_iostore_memory_entry *entry = manager.id_slots[hash & (manager.slot_num - 1)];
+	for (; entry; entry = entry->id_chain)
+		if (entry->id_hash == hash && entry->id_length == res_id->id_length && !memcmp(entry->id, res_id->id, res_id->id_length))
+			break;
+	return entry;
+}
+
+//Function used to double the slots when they are full: the manager has to be locked
+static void _oph_iostore_memory_grow()
+{
+	if (manager.entry_num < manager.slot_num)
+		return;
+
+	oph_iostore_memory_entry **id_slots = (oph_iostore_memory_entry **) calloc(2 * manager.slot_num, sizeof(oph_iostore_memory_entry *));
+	oph_iostore_memory_entry **ref_slots = (oph_iostore_memory_entry **) calloc(2 * manager.slot_num, sizeof(oph_iostore_memory_entry *));
+	if (!id_slots || !ref_slots) {
+		//Chains are only longer
+		free(id_slots);
+		free(ref_slots);
+		return;
+	}
+
+	unsigned int i, slot_num = manager.slot_num;
+	oph_iostore_memory_entry **old_slots = manager.id_slots, *entry, *next;
+	free(manager.ref_slots);
+	manager.id_slots = id_slots;
+	manager.ref_slots = ref_slots;
+	manager.slot_num *= 2;
+	for (i = 0; i < slot_num; i++)
+		for (entry = old_slots[i]; entry; entry = next) {
+			next = entry->id_chain;
+			_oph_iostore_memory_insert(entry);
+		}
+	free(old_slots);
+}
+
+static void _oph_iostore_memory_free_entry(oph_iostore_memory_entry * entry)
+{
+	if (entry->spill_path) {
+		unlink(entry->spill_path);
+		free(entry->spill_path);
+	}
+	free(entry->zbuf);
+	free(entry->id);
+	free(entry);
+}
+
+#ifdef OPH_IOSTORE_ZLIB
+//Function used to compress a buffer: bytes are grouped by their position in 8-byte words, so that exponents and signs of numbers are contiguous
+static int _oph_iostore_memory_compress_buffer(const char *buffer, unsigned long long size, void **zbuf, unsigned long long *zbuf_size)
+{
+	*zbuf = NULL;
+	*zbuf_size = 0;
+
+	unsigned long long i, j, words = size / OPH_IOSTORE_MEMORY_SHUFFLE;
+	uLongf len = compressBound((uLong) size);
+	char *shuffled = (char *) malloc(size);
+	char *compressed = (char *) malloc(len);
+	if (!shuffled || !compressed) {
+		free(shuffled);
+		free(compressed);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	for (j = 0; j < OPH_IOSTORE_MEMORY_SHUFFLE; j++)
+		for (i = 0; i < words; i++)
+			shuffled[j * words + i] = buffer[i * OPH_IOSTORE_MEMORY_SHUFFLE + j];
+	memcpy(shuffled + words * OPH_IOSTORE_MEMORY_SHUFFLE, buffer + words * OPH_IOSTORE_MEMORY_SHUFFLE, size - words * OPH_IOSTORE_MEMORY_SHUFFLE);
+
+	int res = compress2((Bytef *) compressed, &len, (const Bytef *) shuffled, (uLong) size, OPH_IOSTORE_MEMORY_COMPRESSION_LEVEL);
+	free(shuffled);
+	if ((res != Z_OK) || (len > OPH_IOSTORE_MEMORY_MAX_RATIO(size))) {
+		free(compressed);
+		return OPH_IOSTORAGE_COMPRESSION_ERR;
+	}
+
+	//Buffer is shrunk only if possible
+	void *shrunk = realloc(compressed, len);
+	*zbuf = shrunk ? shrunk : (void *) compressed;
+	*zbuf_size = len;
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Function used to decompress a buffer compressed by _oph_iostore_memory_compress_buffer
+static int _oph_iostore_memory_decompress_buffer(const void *zbuf, unsigned long long zbuf_size, char *buffer, unsigned long long size)
+{
+	unsigned long long i, j, words = size / OPH_IOSTORE_MEMORY_SHUFFLE;
+	uLongf len = (uLongf) size;
+	char *shuffled = (char *) malloc(size);
+	if (!shuffled)
+		return OPH_IOSTORAGE_MEMORY_ERR;
+
+	if ((uncompress((Bytef *) shuffled, &len, (const Bytef *) zbuf, (uLong) zbuf_size) != Z_OK) || (len != (uLongf) size)) {
+		free(shuffled);
+		return OPH_IOSTORAGE_COMPRESSION_ERR;
+	}
+	for (j = 0; j < OPH_IOSTORE_MEMORY_SHUFFLE; j++)
+		for (i = 0; i < words; i++)
+			buffer[i * OPH_IOSTORE_MEMORY_SHUFFLE + j] = shuffled[j * words + i];
+	memcpy(buffer + words * OPH_IOSTORE_MEMORY_SHUFFLE, shuffled + words * OPH_IOSTORE_MEMORY_SHUFFLE, size - words * OPH_IOSTORE_MEMORY_SHUFFLE);
+	free(shuffled);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+#endif
+
+//Function used to restore the arena of a compressed fragment and the cells referring to it: the manager has to be locked
+static int _oph_iostore_memory_decompress(oph_iostore_memory_entry * entry)
+{
+#ifdef OPH_IOSTORE_ZLIB
+	struct timeval start, end, elapsed;
+	gettimeofday(&start, NULL);
+
+	oph_iostore_frag_record_set *frag_record = entry->frag_record;
+	oph_iostore_frag_columns *columns = frag_record->columns;
+	char *arena = (char *) malloc(columns->arena_size);
+	if (!arena) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	if (_oph_iostore_memory_decompress_buffer(entry->zbuf, entry->zbuf_size, arena, columns->arena_size)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_COMPRESSION_ERROR, frag_record->frag_name);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_COMPRESSION_ERROR, frag_record->frag_name);
+		free(arena);
+		return OPH_IOSTORAGE_COMPRESSION_ERR;
+	}
+
+	unsigned short i, field_num = frag_record->field_num;
+	long long j;
+	unsigned long long cell;
+	for (j = 0; j < columns->row_num; j++)
+		for (i = 0; i < field_num; i++) {
+			cell = j * field_num + i;
+			if (!columns->column[i] && (columns->offset[cell] != OPH_IOSTORE_NULL_OFFSET))
+				columns->field[cell] = arena + columns->offset[cell];
+		}
+	columns->arena = arena;
+
+	manager.resident_size += columns->arena_size - entry->zbuf_size;
+	entry->size += columns->arena_size - entry->zbuf_size;
+	free(entry->zbuf);
+	entry->zbuf = NULL;
+	entry->zbuf_size = 0;
+	entry->is_compressed = 0;
+
+	gettimeofday(&end, NULL);
+	timeval_subtract(&elapsed, &end, &start);
+	entry->decompressions++;
+	entry->decompression_time += elapsed.tv_sec + elapsed.tv_usec / (double) MILLION;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Fragment '%s' decompressed in %f s (compression ratio %.2f)\n", frag_record->frag_name, elapsed.tv_sec + elapsed.tv_usec / (double) MILLION,
+	      entry->compression_ratio);
+
+	return OPH_IOSTORAGE_SUCCESS;
+#else
+	(void) entry;
+	return OPH_IOSTORAGE_COMPRESSION_ERR;
+#endif
+}
+
+//Function used to compress the arena of an idle fragment: the manager has to be locked and it is unlocked while the arena is compressed
+static void _oph_iostore_memory_compress(oph_iostore_memory_entry * entry)
+{
+#ifdef OPH_IOSTORE_ZLIB
+	oph_iostore_frag_columns *columns = entry->frag_record->columns;
+	void *zbuf = NULL;
+	unsigned long long zbuf_size = 0;
+
+	//The fragment can be read while it is compressed, but it cannot be released
+	entry->is_busy = 1;
+	pthread_mutex_unlock(&manager.lock);
+	int res = _oph_iostore_memory_compress_buffer(columns->arena, columns->arena_size, &zbuf, &zbuf_size);
+	pthread_mutex_lock(&manager.lock);
+	entry->is_busy = 0;
+	pthread_cond_broadcast(&manager.busy_cond);
+
+	if (res) {
+		//Fragments are not changed once stored, so compression is not tried again
+		entry->skip_compression = 1;
+		return;
+	}
+	//The arena can be released only if no query has started to use it (or shared its cells) in the meantime
+	if (entry->pin || !entry->is_resident || (__sync_fetch_and_add(&(columns->refcount), 0) > 1)) {
+		free(zbuf);
+		return;
+	}
+
+	free(columns->arena);
+	columns->arena = NULL;
+	entry->zbuf = zbuf;
+	entry->zbuf_size = zbuf_size;
+	entry->is_compressed = 1;
+	entry->compression_ratio = columns->arena_size / (double) zbuf_size;
+	manager.resident_size -= columns->arena_size - zbuf_size;
+	entry->size -= columns->arena_size - zbuf_size;
+	manager.compressions++;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Fragment '%s' compressed from %llu to %llu bytes\n", entry->frag_record->frag_name, columns->arena_size, zbuf_size);
+#else
+	entry->skip_compression = 1;
+#endif
+}
+
+//Function executed by the compressor thread: the least recently used fragments that have been idle for a while are compressed
+static void *_oph_iostore_memory_compressor(void *arg)
+{
+	(void) arg;
+
+	struct timespec wakeup;
+	oph_iostore_memory_entry *entry;
+	time_t now;
+
+	pthread_mutex_lock(&manager.lock);
+	while (!manager.stop) {
+		clock_gettime(CLOCK_REALTIME, &wakeup);
+		wakeup.tv_sec += manager.idle_time > 1 ? manager.idle_time / 2 : 1;
+		pthread_cond_timedwait(&manager.cond, &manager.lock, &wakeup);
+
+		//The list is scanned again after each compression, since it can be changed while the manager is unlocked
+		now = time(NULL);
+		for (entry = manager.tail; entry && !manager.stop && (now - entry->last_use >= (time_t) manager.idle_time);)
+			if (entry->pin || entry->is_busy || entry->is_compressed || entry->skip_compression)
+				entry = entry->prev;
+			else if (entry->frag_record->columns && (__sync_fetch_and_add(&(entry->frag_record->columns->refcount), 0) > 1))
+				//Arenas shared with other fragments are kept as they are, until they are released
+				entry = entry->prev;
+			else if (!entry->frag_record->columns || entry->frag_record->columns->map || !entry->frag_record->columns->arena
+				 || (entry->frag_record->columns->arena_size < OPH_IOSTORE_MEMORY_MIN_ARENA)) {
+				entry->skip_compression = 1;
+				entry = entry->prev;
+			} else {
+				_oph_iostore_memory_compress(entry);
+				entry = manager.tail;
+			}
+	}
+	pthread_mutex_unlock(&manager.lock);
+
+	return NULL;
+}
+
+//Function used to write the spill file of a fragment: it is called while the manager is unlocked, so only the (busy) entry is accessed
+static int _oph_iostore_memory_write(oph_iostore_memory_entry * entry, char **spill_path)
+{
+	char path[OPH_IOSTORE_MEMORY_PATH_LEN];
+	snprintf(path, OPH_IOSTORE_MEMORY_PATH_LEN, OPH_IOSTORE_MEMORY_SPILL_TEMPLATE, manager.data_dir);
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		logging(LOG_WARNING, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+	//Spill files are written from the whole arena, so a compressed arena is restored only until the file is written
+	oph_iostore_frag_columns *columns = entry->frag_record->columns;
+	char *arena = NULL;
+	if (entry->is_compressed) {
+#ifdef OPH_IOSTORE_ZLIB
+		if (!(arena = (char *) malloc(columns->arena_size)) || _oph_iostore_memory_decompress_buffer(entry->zbuf, entry->zbuf_size, arena, columns->arena_size)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_COMPRESSION_ERROR, entry->frag_record->frag_name);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_COMPRESSION_ERROR, entry->frag_record->frag_name);
+			free(arena);
+			close(fd);
+			unlink(path);
+			return OPH_IOSTORAGE_COMPRESSION_ERR;
+		}
+		columns->arena = arena;
+#endif
+	}
+	int res = oph_iostore_write_frag_file(entry->frag_record, fd, path);
+	close(fd);
+	if (arena) {
+		columns->arena = NULL;
+		free(arena);
+	}
+	if (res || !(*spill_path = strdup(path))) {
+		unlink(path);
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Function used to write the records of a fragment in its spill file (if not already written) and release them: the manager has to be locked,
+//but it is unlocked while the file is written; records are not released if the fragment has been pinned in the meantime
+static int _oph_iostore_memory_spill(oph_iostore_memory_entry * entry)
+{
+	if (!entry->spill_path) {
+		//Records are moved in columnar storage before the fragment can be read concurrently
+		if ((!entry->frag_record->columns || entry->frag_record->columns->is_open) && oph_iostore_pack_frag_recordset(entry->frag_record))
+			return OPH_IOSTORAGE_MEMORY_ERR;
+
+		//The fragment can be read while it is written (unless it is compressed), but it cannot be released
+		char *spill_path = NULL;
+		entry->is_busy = 1;
+		pthread_mutex_unlock(&manager.lock);
+		int res = _oph_iostore_memory_write(entry, &spill_path);
+		pthread_mutex_lock(&manager.lock);
+		entry->is_busy = 0;
+		pthread_cond_broadcast(&manager.busy_cond);
+		if (res)
+			return res;
+		entry->spill_path = spill_path;
+		if (entry->pin)
+			return OPH_IOSTORAGE_SUCCESS;
+	}
+	//Compressed arena is dropped with the records, so that the fragment is loaded with its original size
+	manager.resident_size -= entry->size;
+	if (entry->is_compressed) {
+		entry->size += entry->frag_record->columns->arena_size - entry->zbuf_size;
+		free(entry->zbuf);
+		entry->zbuf = NULL;
+		entry->zbuf_size = 0;
+		entry->is_compressed = 0;
+	}
+
+	oph_iostore_release_frag_records(entry->frag_record);
+	_oph_iostore_memory_unlink(entry);
+	entry->is_resident = 0;
+	manager.spills++;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Fragment '%s' spilled to %s\n", entry->frag_record->frag_name, entry->spill_path);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Function used to map the spill file of a fragment in its record set: the manager has to be locked
+static int _oph_iostore_memory_load(oph_iostore_memory_entry * entry)
+{
+	oph_iostore_frag_record_set *tmp = NULL;
+	if (oph_iostore_map_frag_file(entry->spill_path, &tmp) || !tmp)
+		return OPH_IOSTORAGE_IO_ERR;
+
+	//Record set is shared by the device, so only its records are replaced
+	entry->frag_record->record_set = tmp->record_set;
+	entry->frag_record->columns = tmp->columns;
+	if (tmp->columns)
+		tmp->columns->owner = entry->frag_record;
+	tmp->record_set = NULL;
+	tmp->columns = NULL;
+	oph_iostore_destroy_frag_recordset_only(&tmp);
+
+	_oph_iostore_memory_push(entry);
+	entry->is_resident = 1;
+	manager.resident_size += entry->size;
+	manager.faults++;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Fragment '%s' loaded from %s\n", entry->frag_record->frag_name, entry->spill_path);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+//Function used to spill the least recently used fragments not in use until the budget is met: the manager has to be locked
+static void _oph_iostore_memory_enforce()
+{
+	//The list is scanned again after each spill, since it can be changed while the manager is unlocked
+	oph_iostore_memory_entry *entry = manager.tail;
+	while (entry && manager.budget && (manager.resident_size > manager.budget)) {
+		if (entry->pin || entry->is_busy)
+			entry = entry->prev;
+		else if (_oph_iostore_memory_spill(entry)) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to spill fragment '%s': memory budget is exceeded\n", entry->frag_record->frag_name);
+			logging(LOG_WARNING, __FILE__, __LINE__, "Unable to spill fragment '%s': memory budget is exceeded\n", entry->frag_record->frag_name);
+			break;
+		} else
+			entry = manager.tail;
+	}
+}
+
+int oph_iostore_memory_init(unsigned long long budget, unsigned int idle_time, const char *data_dir)
+{
+	if (!data_dir) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+#ifndef OPH_IOSTORE_ZLIB
+	if (idle_time) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Compression is not supported: idle fragments will not be compressed\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Compression is not supported: idle fragments will not be compressed\n");
+		idle_time = 0;
+	}
+#endif
+	if (!budget && !idle_time)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	//Create spill directory and remove files left by previous executions, since fragments of transient devices are lost
+	char path[OPH_IOSTORE_MEMORY_PATH_LEN];
+	snprintf(manager.data_dir, OPH_IOSTORE_MEMORY_PATH_LEN, "%s", data_dir);
+	snprintf(path, OPH_IOSTORE_MEMORY_PATH_LEN, "%s/var", data_dir);
+	mkdir(path, 0755);
+	snprintf(path, OPH_IOSTORE_MEMORY_PATH_LEN, OPH_IOSTORE_MEMORY_SPILL_DIR, data_dir);
+	if (budget && mkdir(path, 0755) && (errno != EEXIST)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_IO_ERROR, path, strerror(errno));
+		return OPH_IOSTORAGE_IO_ERR;
+	}
+	DIR *dir = opendir(path);
+	if (dir) {
+		char file[OPH_IOSTORE_MEMORY_PATH_LEN];
+		struct dirent *ent;
+		while ((ent = readdir(dir)))
+			if (!strncmp(ent->d_name, OPH_IOSTORE_MEMORY_SPILL_PREFIX, strlen(OPH_IOSTORE_MEMORY_SPILL_PREFIX))) {
+				snprintf(file, OPH_IOSTORE_MEMORY_PATH_LEN, "%s/%s", path, ent->d_name);
+				unlink(file);
+			}
+		closedir(dir);
+	}
+
+	manager.id_slots = (oph_iostore_memory_entry **) calloc(OPH_IOSTORE_MEMORY_MIN_SLOTS, sizeof(oph_iostore_memory_entry *));
+	manager.ref_slots = (oph_iostore_memory_entry **) calloc(OPH_IOSTORE_MEMORY_MIN_SLOTS, sizeof(oph_iostore_memory_entry *));
+	if (!manager.id_slots || !manager.ref_slots) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		free(manager.id_slots);
+		free(manager.ref_slots);
+		manager.id_slots = manager.ref_slots = NULL;
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	manager.slot_num = OPH_IOSTORE_MEMORY_MIN_SLOTS;
+	manager.budget = budget;
+	manager.idle_time = idle_time;
+	manager.stop = 0;
+	manager.enabled = 1;
+
+	if (idle_time && pthread_create(&manager.compressor, NULL, _oph_iostore_memory_compressor, NULL)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to start compressor thread: idle fragments will not be compressed\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to start compressor thread: idle fragments will not be compressed\n");
+		manager.idle_time = 0;
+	}
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_memory_free()
+{
+	pthread_mutex_lock(&manager.lock);
+	if (manager.idle_time) {
+		manager.stop = 1;
+		pthread_cond_signal(&manager.cond);
+		pthread_mutex_unlock(&manager.lock);
+		pthread_join(manager.compressor, NULL);
+		pthread_mutex_lock(&manager.lock);
+		manager.idle_time = 0;
+	}
+	if (manager.id_slots) {
+		unsigned int i;
+		oph_iostore_memory_entry *entry, *next;
+		for (i = 0; i < manager.slot_num; i++)
+			for (entry = manager.id_slots[i]; entry; entry = next) {
+				next = entry->id_chain;
+				_oph_iostore_memory_free_entry(entry);
+			}
+		free(manager.id_slots);
+		free(manager.ref_slots);
+		manager.id_slots = manager.ref_slots = NULL;
+	}
+	manager.slot_num = manager.entry_num = 0;
+	manager.enabled = 0;
+	manager.budget = manager.resident_size = 0;
+	manager.head = manager.tail = NULL;
+	pthread_mutex_unlock(&manager.lock);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_memory_add(oph_iostore_resource_id * res_id, oph_iostore_frag_record_set * frag_record)
+{
+	if (!res_id || !res_id->id || !frag_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (!manager.enabled)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	oph_iostore_memory_entry *entry = (oph_iostore_memory_entry *) calloc(1, sizeof(oph_iostore_memory_entry));
+	if (!entry || !(entry->id = malloc(res_id->id_length))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_MEMORY_ERROR);
+		free(entry);
+		return OPH_IOSTORAGE_MEMORY_ERR;
+	}
+	memcpy(entry->id, res_id->id, res_id->id_length);
+	entry->id_length = res_id->id_length;
+	entry->id_hash = _oph_iostore_memory_hash(res_id->id, res_id->id_length);
+	entry->frag_record = frag_record;
+	entry->last_use = time(NULL);
+	entry->is_resident = 1;
+	oph_iostore_get_frag_size(frag_record, &(entry->size));
+
+	pthread_mutex_lock(&manager.lock);
+	if (!manager.id_slots || _oph_iostore_memory_find(res_id)) {
+		pthread_mutex_unlock(&manager.lock);
+		free(entry->id);
+		free(entry);
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+	_oph_iostore_memory_grow();
+	_oph_iostore_memory_insert(entry);
+	_oph_iostore_memory_push(entry);
+	manager.entry_num++;
+	manager.resident_size += entry->size;
+	_oph_iostore_memory_enforce();
+	pthread_mutex_unlock(&manager.lock);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_memory_pin(oph_iostore_resource_id * res_id)
+{
+	if (!res_id || !res_id->id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (!manager.enabled)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	pthread_mutex_lock(&manager.lock);
+	oph_iostore_memory_entry *entry;
+	//A compressed arena cannot be restored while it is read to write the spill file
+	while ((entry = _oph_iostore_memory_find(res_id)) && entry->is_busy && entry->is_compressed)
+		pthread_cond_wait(&manager.busy_cond, &manager.lock);
+	if (!entry) {
+		pthread_mutex_unlock(&manager.lock);
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+	if (!entry->is_resident) {
+		if (_oph_iostore_memory_load(entry)) {
+			pthread_mutex_unlock(&manager.lock);
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to load fragment '%s' from %s\n", entry->frag_record->frag_name, entry->spill_path);
+			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to load fragment '%s' from %s\n", entry->frag_record->frag_name, entry->spill_path);
+			return OPH_IOSTORAGE_IO_ERR;
+		}
+	} else {
+		if (entry->is_compressed && _oph_iostore_memory_decompress(entry)) {
+			pthread_mutex_unlock(&manager.lock);
+			return OPH_IOSTORAGE_COMPRESSION_ERR;
+		}
+		if (entry != manager.head) {
+			_oph_iostore_memory_unlink(entry);
+			_oph_iostore_memory_push(entry);
+		}
+	}
+	entry->pin++;
+	entry->last_use = time(NULL);
+	_oph_iostore_memory_enforce();
+	pthread_mutex_unlock(&manager.lock);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_memory_unpin(oph_iostore_frag_record_set * frag_record)
+{
+	if (!frag_record) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (!manager.enabled)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	pthread_mutex_lock(&manager.lock);
+	if (manager.ref_slots) {
+		oph_iostore_memory_entry *entry = manager.ref_slots[_oph_iostore_memory_ref_hash(frag_record) & (manager.slot_num - 1)];
+		for (; entry; entry = entry->ref_chain)
+			if (entry->frag_record == frag_record)
+				break;
+		if (entry && entry->pin) {
+			entry->pin--;
+			entry->last_use = time(NULL);
+		}
+	}
+	pthread_mutex_unlock(&manager.lock);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_memory_remove(oph_iostore_resource_id * res_id)
+{
+	if (!res_id || !res_id->id) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	if (!manager.enabled)
+		return OPH_IOSTORAGE_SUCCESS;
+
+	pthread_mutex_lock(&manager.lock);
+	oph_iostore_memory_entry *entry, **slot;
+	//The arena of the fragment could be read by the compressor thread
+	while ((entry = _oph_iostore_memory_find(res_id)) && entry->is_busy)
+		pthread_cond_wait(&manager.busy_cond, &manager.lock);
+	if (!entry) {
+		pthread_mutex_unlock(&manager.lock);
+		return OPH_IOSTORAGE_SUCCESS;
+	}
+	for (slot = &(manager.id_slots[entry->id_hash & (manager.slot_num - 1)]); *slot != entry; slot = &((*slot)->id_chain));
+	*slot = entry->id_chain;
+	for (slot = &(manager.ref_slots[_oph_iostore_memory_ref_hash(entry->frag_record) & (manager.slot_num - 1)]); *slot != entry; slot = &((*slot)->ref_chain));
+	*slot = entry->ref_chain;
+	if (entry->is_resident) {
+		_oph_iostore_memory_unlink(entry);
+		manager.resident_size -= entry->size;
+	}
+	manager.entry_num--;
+	pthread_mutex_unlock(&manager.lock);
+
+	_oph_iostore_memory_free_entry(entry);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_memory_stats(unsigned long long *resident_size, unsigned long long *spills, unsigned long long *faults, unsigned long long *compressions)
+{
+	pthread_mutex_lock(&manager.lock);
+	if (resident_size)
+		*resident_size = manager.resident_size;
+	if (spills)
+		*spills = manager.spills;
+	if (faults)
+		*faults = manager.faults;
+	if (compressions)
+		*compressions = manager.compressions;
+	pthread_mutex_unlock(&manager.lock);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
+
+int oph_iostore_memory_frag_stats(oph_iostore_resource_id * res_id, double *compression_ratio, double *decompression_time)
+{
+	if (!res_id || !res_id->id || !compression_ratio || !decompression_time) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IOSTORAGE_LOG_NULL_INPUT_PARAM);
+		return OPH_IOSTORAGE_NULL_PARAM;
+	}
+
+	*compression_ratio = 0;
+	*decompression_time = 0;
+
+	pthread_mutex_lock(&manager.lock);
+	oph_iostore_memory_entry *entry = _oph_iostore_memory_find(res_id);
+	if (entry) {
+		*compression_ratio = entry->compression_ratio;
+		if (entry->decompressions)
+			*decompression_time = entry->decompression_time / entry->decompressions;
+	}
+	pthread_mutex_unlock(&manager.lock);
+
+	return OPH_IOSTORAGE_SUCCESS;
+}
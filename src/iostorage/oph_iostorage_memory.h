@@ -0,0 +1,98 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __OPH_IOSTORAGE_MEMORY_H
+#define __OPH_IOSTORAGE_MEMORY_H
+
+#include "oph_iostorage_data.h"
+
+//Server-wide manager of the fragments kept by transient devices. The size of resident fragments is accounted against a budget:
+//when it is exceeded, the least recently used fragments not in use are spilled to files in the server directory and their records
+//are released; spilled fragments are mapped again as soon as they are read, and their files are removed with them.
+//Moreover, the arena (string and binary values) of fragments not used for a while can be compressed by a background thread; it is
+//decompressed as soon as the fragment is read.
+
+//Spill files are stored in a subdirectory of server directory (removed files of previous executions)
+#define OPH_IOSTORE_MEMORY_SPILL_DIR		"%s/var/spill"
+#define OPH_IOSTORE_MEMORY_SPILL_TEMPLATE	"%s/var/spill/spill_XXXXXX"
+#define OPH_IOSTORE_MEMORY_SPILL_PREFIX		"spill_"
+
+/**
+ * \brief               Function used to setup the memory manager; it has to be called before any worker thread is started
+ * \param budget        Max size in bytes of resident fragments (0 for no limit)
+ * \param idle_time     Seconds after which unused fragments are compressed (0 to disable compression); the manager is disabled if both are 0
+ * \param data_dir      Server directory
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_memory_init(unsigned long long budget, unsigned int idle_time, const char *data_dir);
+
+/**
+ * \brief               Function used to stop the compressor thread, release the memory manager and remove spill files
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_memory_free();
+
+/**
+ * \brief               Function used to account a fragment just stored by a transient device; other fragments can be spilled
+ * \param res_id        Resource id of the fragment
+ * \param frag_record   Record set stored by the device
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_memory_add(oph_iostore_resource_id * res_id, oph_iostore_frag_record_set * frag_record);
+
+/**
+ * \brief               Function used to mark a fragment as in use, so that it cannot be spilled or compressed; spilled or compressed fragment is restored
+ * \param res_id        Resource id of the fragment
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_memory_pin(oph_iostore_resource_id * res_id);
+
+/**
+ * \brief               Function used to mark a fragment as no longer in use by a query
+ * \param frag_record   Record set of the fragment
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_memory_unpin(oph_iostore_frag_record_set * frag_record);
+
+/**
+ * \brief               Function used to forget a fragment before it is deleted by a transient device; its spill file is removed
+ * \param res_id        Resource id of the fragment
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_memory_remove(oph_iostore_resource_id * res_id);
+
+/**
+ * \brief               Function used to get the counters of the memory manager
+ * \param resident_size Pointer to be filled with the size of resident fragments (can be NULL)
+ * \param spills        Pointer to be filled with the number of fragments spilled (can be NULL)
+ * \param faults        Pointer to be filled with the number of spilled fragments loaded again (can be NULL)
+ * \param compressions  Pointer to be filled with the number of fragments compressed (can be NULL)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_memory_stats(unsigned long long *resident_size, unsigned long long *spills, unsigned long long *faults, unsigned long long *compressions);
+
+/**
+ * \brief               Function used to get the compression statistics of a fragment
+ * \param res_id        Resource id of the fragment
+ * \param compression_ratio Pointer to be filled with the ratio between original and compressed size of the arena (0 if never compressed)
+ * \param decompression_time Pointer to be filled with the average time in seconds spent to decompress the arena (0 if never decompressed)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_iostore_memory_frag_stats(oph_iostore_resource_id * res_id, double *compression_ratio, double *decompression_time);
+
+#endif				/* __OPH_IOSTORAGE_MEMORY_H */
@@ -141,7 +141,7 @@ int _oph_metadb_serialize_frag_row(oph_metadb_frag_row * row, char **line, unsig
 	memcpy(buffer + m, (void *) row->frag_name, strlen(row->frag_name));
 	m += strlen(row->frag_name);
 	if ((row->frag_id).id_length != 0) {
-		memcpy(buffer + m, (void *) &(row->frag_id).id, (row->frag_id).id_length);
+		memcpy(buffer + m, (void *) row->frag_id.id, (row->frag_id).id_length);
 	}
 	m += (row->frag_id).id_length;
 	memcpy(buffer + m, (void *) row->device, strlen(row->device));
@@ -236,6 +236,9 @@ int _oph_metadb_deserialize_db_row(char *line, oph_metadb_db_row ** row)
 	m += db_id_len;
 	tmp_row->frag_number = *((unsigned long long *) (line + m));
 	m += frag_number_len;
+	pthread_rwlock_init(&(tmp_row->lock), NULL);
+	tmp_row->next_index = NULL;
+	tmp_row->index = NULL;
 
 	*row = tmp_row;
 
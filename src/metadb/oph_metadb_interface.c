@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <strings.h>
+#include <ctype.h>
 
 #include "oph_server_utility.h"
 
@@ -34,6 +35,10 @@ char db_file[OPH_SERVER_CONF_LINE_LEN] = OPH_METADB_DATABASE_SCHEMA_PREFIX;
 char tmp_file[OPH_SERVER_CONF_LINE_LEN] = OPH_METADB_TEMP_SCHEMA_PREFIX;
 char frag_file[OPH_SERVER_CONF_LINE_LEN] = OPH_METADB_FRAGMENT_SCHEMA_PREFIX;
 
+//Mutexes used to serialize appends (offset computation and write) and updates of schema files
+static pthread_mutex_t db_file_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t frag_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void oph_metadb_set_data_prefix(char *p)
 {
 	snprintf(db_file, OPH_SERVER_CONF_LINE_LEN, OPH_METADB_DATABASE_SCHEMA, p);
@@ -41,16 +46,42 @@ void oph_metadb_set_data_prefix(char *p)
 	snprintf(tmp_file, OPH_SERVER_CONF_LINE_LEN, OPH_METADB_TEMP_SCHEMA, p);
 }
 
-static unsigned int oph_metadb_hash_function(const char *key)
+static unsigned long long oph_metadb_hash_string(unsigned long long hash, const char *key)
+{
+	/* FNV-1a hash function; case is ignored as in name comparisons */
+	while (*key) {
+		hash ^= (unsigned char) tolower((unsigned char) *key++);
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static unsigned long long oph_metadb_hash_mix(unsigned long long hash)
 {
-	/* djb2 hash function - Adapted from http://www.cse.yorku.ca/~oz/hash.html */
-	unsigned int hash = 5381;
-	while (*key)
-		hash = ((hash << 5) + hash) + (unsigned int) *key++;
+	/* Finalizer of MurmurHash3, so that the low bits used to select buckets depend on every character */
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
 
 	return hash;
 }
 
+static unsigned long long oph_metadb_hash_function(const char *key)
+{
+	return oph_metadb_hash_mix(oph_metadb_hash_string(14695981039346656037ULL, key));
+}
+
+static unsigned long long oph_metadb_db_hash_function(const char *db_name, const char *device)
+{
+	unsigned long long hash = oph_metadb_hash_string(14695981039346656037ULL, db_name);
+	hash = oph_metadb_hash_string(hash * 1099511628211ULL, device);
+
+	return oph_metadb_hash_mix(hash);
+}
+
 oph_metadb_frag_table *oph_metadb_frag_table_create(int size)
 {
 	oph_metadb_frag_table *table = (oph_metadb_frag_table *) malloc(sizeof(oph_metadb_frag_table));
@@ -61,8 +92,18 @@ oph_metadb_frag_table *oph_metadb_frag_table_create(int size)
 		free(table);
 		return NULL;
 	}
+	if (!(table->locks = (pthread_rwlock_t *) malloc(OPH_METADB_FRAG_TABLE_LOCKS * sizeof(pthread_rwlock_t)))) {
+		free(table->rows);
+		free(table);
+		return NULL;
+	}
+
+	int i;
+	for (i = 0; i < OPH_METADB_FRAG_TABLE_LOCKS; i++)
+		pthread_rwlock_init(&(table->locks[i]), NULL);
 
 	table->size = size;
+	table->count = 0;
 
 	return table;
 }
@@ -86,12 +127,164 @@ int oph_metadb_frag_table_destroy(oph_metadb_frag_table * table)
 			curr_row = tmp_row;
 		}
 	}
+	for (i = 0; i < OPH_METADB_FRAG_TABLE_LOCKS; i++)
+		pthread_rwlock_destroy(&(table->locks[i]));
+	free(table->locks);
 	free(table->rows);
 	free(table);
 
 	return OPH_METADB_OK;
 }
 
+//NOTE: since table size is a multiple of OPH_METADB_FRAG_TABLE_LOCKS, the lock of a key does not change when the table grows
+static pthread_rwlock_t *oph_metadb_frag_table_lock(oph_metadb_frag_table * table, unsigned long long hash)
+{
+	return &(table->locks[hash & (OPH_METADB_FRAG_TABLE_LOCKS - 1)]);
+}
+
+//NOTE: the hash table of a DB is created by the first fragment added, possibly by concurrent threads holding the DB lock in read mode
+static oph_metadb_frag_table *oph_metadb_frag_table_get(oph_metadb_db_row * db)
+{
+	if (db->table == NULL) {
+		oph_metadb_frag_table *table = oph_metadb_frag_table_create(OPH_METADB_FRAG_TABLE_SIZE);
+		if (table == NULL)
+			return NULL;
+		if (!__sync_bool_compare_and_swap(&(db->table), NULL, table))
+			oph_metadb_frag_table_destroy(table);
+	}
+
+	return db->table;
+}
+
+//NOTE: the bucket lock has to be held by the caller
+static oph_metadb_frag_row *oph_metadb_frag_table_find(oph_metadb_frag_table * table, unsigned long long hash, char *frag_name)
+{
+	oph_metadb_frag_row *tmp_row = table->rows[hash & (table->size - 1)];
+	while (tmp_row) {
+		if (STRCMP(tmp_row->frag_name, frag_name) == 0)
+			break;
+		tmp_row = (oph_metadb_frag_row *) tmp_row->next_frag;
+	}
+
+	return tmp_row;
+}
+
+//NOTE: the bucket lock has to be held by the caller; it returns 1 if the table should grow
+static int oph_metadb_frag_table_insert(oph_metadb_frag_table * table, unsigned long long hash, oph_metadb_frag_row * frag_row)
+{
+	int bucket = hash & (table->size - 1);
+	frag_row->next_frag = (struct oph_metadb_frag_row *) table->rows[bucket];
+	table->rows[bucket] = (struct oph_metadb_frag_row *) frag_row;
+
+	return __sync_add_and_fetch(&(table->count), 1) > table->size * OPH_METADB_FRAG_TABLE_LOAD;
+}
+
+//NOTE: the table is doubled in place holding all bucket locks, so the cost of rehashing is amortized over insertions
+static void oph_metadb_frag_table_grow(oph_metadb_frag_table * table)
+{
+	int i;
+	for (i = 0; i < OPH_METADB_FRAG_TABLE_LOCKS; i++)
+		pthread_rwlock_wrlock(&(table->locks[i]));
+
+	//Another thread may have already doubled the table
+	if (table->count > table->size * OPH_METADB_FRAG_TABLE_LOAD) {
+		int size = table->size * 2;
+		oph_metadb_frag_row **rows = (oph_metadb_frag_row **) calloc(size, sizeof(oph_metadb_frag_row *));
+		if (rows) {
+			oph_metadb_frag_row *curr_row, *tmp_row;
+			int bucket;
+			for (i = 0; i < table->size; i++) {
+				curr_row = table->rows[i];
+				while (curr_row) {
+					tmp_row = (oph_metadb_frag_row *) curr_row->next_frag;
+					bucket = oph_metadb_hash_function(curr_row->frag_name) & (size - 1);
+					curr_row->next_frag = (struct oph_metadb_frag_row *) rows[bucket];
+					rows[bucket] = curr_row;
+					curr_row = tmp_row;
+				}
+			}
+			free(table->rows);
+			table->rows = rows;
+			table->size = size;
+		} else {
+			//Keep the current table: lookups are slower, but still correct
+			pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_WARNING, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
+		}
+	}
+
+	for (i = OPH_METADB_FRAG_TABLE_LOCKS - 1; i >= 0; i--)
+		pthread_rwlock_unlock(&(table->locks[i]));
+}
+
+//Add a row to the hash index of the DB list whose head is "list" (the index is created with the first row)
+static int oph_metadb_db_index_insert(oph_metadb_db_row * list, oph_metadb_db_row * db_row)
+{
+	int i, bucket;
+	oph_metadb_db_index *index = list ? list->index : NULL;
+
+	if (!index && !(index = (oph_metadb_db_index *) calloc(1, sizeof(oph_metadb_db_index))))
+		return OPH_METADB_MEMORY_ERR;
+
+	if (index->count >= index->size) {
+		int size = index->size ? index->size * 2 : OPH_METADB_DB_INDEX_SIZE;
+		oph_metadb_db_row **rows = (oph_metadb_db_row **) calloc(size, sizeof(oph_metadb_db_row *));
+		if (!rows) {
+			if (!index->rows) {
+				free(index);
+				return OPH_METADB_MEMORY_ERR;
+			}
+		} else {
+			oph_metadb_db_row *curr_row, *tmp_row;
+			for (i = 0; i < index->size; i++) {
+				curr_row = index->rows[i];
+				while (curr_row) {
+					tmp_row = curr_row->next_index;
+					bucket = oph_metadb_db_hash_function(curr_row->db_name, curr_row->device) & (size - 1);
+					curr_row->next_index = rows[bucket];
+					rows[bucket] = curr_row;
+					curr_row = tmp_row;
+				}
+			}
+			if (index->rows)
+				free(index->rows);
+			index->rows = rows;
+			index->size = size;
+		}
+	}
+
+	bucket = oph_metadb_db_hash_function(db_row->db_name, db_row->device) & (index->size - 1);
+	db_row->next_index = index->rows[bucket];
+	index->rows[bucket] = db_row;
+	index->count++;
+	db_row->index = index;
+
+	return OPH_METADB_OK;
+}
+
+//Remove a row from the hash index of its DB list (the index is freed with the last row)
+static void oph_metadb_db_index_remove(oph_metadb_db_row * db_row)
+{
+	oph_metadb_db_index *index = db_row->index;
+	if (!index)
+		return;
+
+	oph_metadb_db_row **curr_row = &(index->rows[oph_metadb_db_hash_function(db_row->db_name, db_row->device) & (index->size - 1)]);
+	while (*curr_row) {
+		if (*curr_row == db_row) {
+			*curr_row = db_row->next_index;
+			index->count--;
+			break;
+		}
+		curr_row = &((*curr_row)->next_index);
+	}
+	db_row->index = NULL;
+
+	if (!index->count) {
+		free(index->rows);
+		free(index);
+	}
+}
 
 int oph_metadb_setup_db_struct(char *db_name, char *device, short unsigned int is_persistent, oph_iostore_resource_id * db_id, unsigned long long frag_number, oph_metadb_db_row ** db)
 {
@@ -145,9 +338,12 @@ int oph_metadb_setup_db_struct(char *db_name, char *device, short unsigned int i
 	memcpy(tmp_row->device, device, strlen(device));
 	tmp_row->table = NULL;
 	tmp_row->next_db = NULL;
+	tmp_row->next_index = NULL;
+	tmp_row->index = NULL;
 	tmp_row->file_offset = 0;
 	tmp_row->frag_number = frag_number;
 	tmp_row->is_persistent = is_persistent;
+	pthread_rwlock_init(&(tmp_row->lock), NULL);
 
 	*db = tmp_row;
 
@@ -163,6 +359,7 @@ int oph_metadb_cleanup_db_struct(oph_metadb_db_row * db)
 			free(db->device);
 		if (db->db_id.id)
 			free(db->db_id.id);
+		pthread_rwlock_destroy(&(db->lock));
 		free(db);
 		db = NULL;
 	}
@@ -353,6 +550,14 @@ int oph_metadb_load_schema(oph_metadb_db_row ** meta_db, short unsigned int clea
 
 			*meta_db = curr_db_row;
 			prev_db_row = curr_db_row;
+
+			if (oph_metadb_db_index_insert((oph_metadb_db_row *) curr_db_row->next_db, curr_db_row)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
+				logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
+				oph_metadb_unload_schema(*meta_db);
+				*meta_db = NULL;
+				return OPH_METADB_MEMORY_ERR;
+			}
 		}
 		curr_offset += (OPH_METADB_HEADER_LENGTH + length);
 	}
@@ -362,7 +567,7 @@ int oph_metadb_load_schema(oph_metadb_db_row ** meta_db, short unsigned int clea
 	oph_metadb_db_row *db_row = NULL;
 	curr_offset = 0;
 	tot_records = 0;
-	int hash = 0;
+	unsigned long long hash = 0;
 
 	if (_oph_metadb_count_records(frag_file, &tot_records)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_COUNT_RECORDS_ERROR, frag_file);
@@ -423,24 +628,20 @@ int oph_metadb_load_schema(oph_metadb_db_row ** meta_db, short unsigned int clea
 						}
 					}
 
-					hash = oph_metadb_hash_function(curr_frag_row->frag_name) % db_row->table->size;
+					hash = oph_metadb_hash_function(curr_frag_row->frag_name);
 
-					tmp_row = db_row->table->rows[hash];
-					while (tmp_row) {
-						if (STRCMP(tmp_row->frag_name, curr_frag_row->frag_name) == 0) {
-							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_DUPLICATE_ERROR, curr_frag_row->frag_name);
-							logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_DUPLICATE_ERROR, curr_frag_row->frag_name);
-							oph_metadb_cleanup_frag_struct(curr_frag_row);
-							oph_metadb_unload_schema(*meta_db);
-							*meta_db = NULL;
-							return OPH_METADB_IO_ERR;
-						}
-						tmp_row = tmp_row->next_frag;
+					tmp_row = oph_metadb_frag_table_find(db_row->table, hash, curr_frag_row->frag_name);
+					if (tmp_row) {
+						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_DUPLICATE_ERROR, curr_frag_row->frag_name);
+						logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_DUPLICATE_ERROR, curr_frag_row->frag_name);
+						oph_metadb_cleanup_frag_struct(curr_frag_row);
+						oph_metadb_unload_schema(*meta_db);
+						*meta_db = NULL;
+						return OPH_METADB_IO_ERR;
 					}
 
-					curr_frag_row->next_frag = (struct oph_metadb_frag_row *) db_row->table->rows[hash];
-					//Update db head pointer
-					db_row->table->rows[hash] = (struct oph_metadb_frag_row *) curr_frag_row;
+					if (oph_metadb_frag_table_insert(db_row->table, hash, curr_frag_row))
+						oph_metadb_frag_table_grow(db_row->table);
 					break;
 				}
 				j++;
@@ -472,6 +673,7 @@ int oph_metadb_unload_schema(oph_metadb_db_row * meta_db)
 				oph_metadb_frag_table_destroy(meta_db->table);
 			meta_db->table = NULL;
 			tmp_db_row = (oph_metadb_db_row *) meta_db->next_db;
+			oph_metadb_db_index_remove(meta_db);
 			oph_metadb_cleanup_db_struct(meta_db);
 			meta_db = tmp_db_row;
 		}
@@ -516,15 +718,7 @@ int oph_metadb_add_db(oph_metadb_db_row ** meta_db, oph_metadb_db_row * db)
 			return OPH_METADB_OK;
 		}
 	}
-	//Count bytes in file
-	unsigned long long byte_size = 0;
-	if (_oph_metadb_count_bytes(db_file, &byte_size)) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FILE_SIZE_ERROR);
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FILE_SIZE_ERROR);
-		oph_metadb_cleanup_db_struct(db_row);
-		return OPH_METADB_IO_ERR;
-	}
-	//Insert in file
+	//Serialize row
 	char *line = NULL;
 	unsigned int length = 0;
 	if (_oph_metadb_serialize_db_row(db_row, &line, &length)) {
@@ -533,15 +727,38 @@ int oph_metadb_add_db(oph_metadb_db_row ** meta_db, oph_metadb_db_row * db)
 		oph_metadb_cleanup_db_struct(db_row);
 		return OPH_METADB_IO_ERR;
 	}
+	//Row is indexed before being written, so that the schema file never contains a DB missing in memory
+	if (oph_metadb_db_index_insert(*meta_db, db_row)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
+		free(line);
+		oph_metadb_cleanup_db_struct(db_row);
+		return OPH_METADB_MEMORY_ERR;
+	}
+	//Count bytes in file
+	unsigned long long byte_size = 0;
+	pthread_mutex_lock(&db_file_lock);
+	if (_oph_metadb_count_bytes(db_file, &byte_size)) {
+		pthread_mutex_unlock(&db_file_lock);
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FILE_SIZE_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FILE_SIZE_ERROR);
+		free(line);
+		oph_metadb_db_index_remove(db_row);
+		oph_metadb_cleanup_db_struct(db_row);
+		return OPH_METADB_IO_ERR;
+	}
 	//Append row
 	if (_oph_metadb_write_row(line, length, db_row->is_persistent, db_file, 0, 1)) {
+		pthread_mutex_unlock(&db_file_lock);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
 		free(line);
+		oph_metadb_db_index_remove(db_row);
+		oph_metadb_cleanup_db_struct(db_row);
 		return OPH_METADB_IO_ERR;
 	}
+	pthread_mutex_unlock(&db_file_lock);
 	free(line);
-
 	//Insert new DB into stack
 	db_row->file_offset = byte_size;
 	db_row->next_db = (struct oph_metadb_db_row *) *meta_db;
@@ -575,21 +792,25 @@ int oph_metadb_update_db(oph_metadb_db_row * meta_db, oph_metadb_db_row * db)
 			//Update file
 			char *line = NULL;
 			unsigned int length = 0;
+			pthread_mutex_lock(&db_file_lock);
 			//Update meta_db
 			tmp_row->frag_number = db->frag_number;
 
 			if (_oph_metadb_serialize_db_row(tmp_row, &line, &length)) {
+				pthread_mutex_unlock(&db_file_lock);
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
 				return OPH_METADB_IO_ERR;
 			}
 			//Append row
 			if (_oph_metadb_write_row(line, length, tmp_row->is_persistent, db_file, tmp_row->file_offset, 0)) {
+				pthread_mutex_unlock(&db_file_lock);
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
 				free(line);
 				return OPH_METADB_IO_ERR;
 			}
+			pthread_mutex_unlock(&db_file_lock);
 			free(line);
 
 			return OPH_METADB_OK;
@@ -603,6 +824,40 @@ int oph_metadb_update_db(oph_metadb_db_row * meta_db, oph_metadb_db_row * db)
 	return OPH_METADB_OK;
 }
 
+int oph_metadb_update_db_frag_number(oph_metadb_db_row * db, long long delta)
+{
+	if (!db) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_NULL_INPUT_PARAM);
+		return OPH_METADB_NULL_ERR;
+	}
+
+	char *line = NULL;
+	unsigned int length = 0;
+
+	//Counter is changed and written under the file lock, so that concurrent updates are not lost
+	pthread_mutex_lock(&db_file_lock);
+	db->frag_number += delta;
+
+	if (_oph_metadb_serialize_db_row(db, &line, &length)) {
+		pthread_mutex_unlock(&db_file_lock);
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
+		return OPH_METADB_IO_ERR;
+	}
+	if (_oph_metadb_write_row(line, length, db->is_persistent, db_file, db->file_offset, 0)) {
+		pthread_mutex_unlock(&db_file_lock);
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
+		free(line);
+		return OPH_METADB_IO_ERR;
+	}
+	pthread_mutex_unlock(&db_file_lock);
+	free(line);
+
+	return OPH_METADB_OK;
+}
+
 int oph_metadb_remove_db(oph_metadb_db_row ** meta_db, char *db_name, char *device)
 {
 	if (!meta_db || !*meta_db || !db_name || !device) {
@@ -635,6 +890,7 @@ int oph_metadb_remove_db(oph_metadb_db_row ** meta_db, char *db_name, char *devi
 				//If first record
 				*meta_db = (oph_metadb_db_row *) tmp_row->next_db;
 			}
+			oph_metadb_db_index_remove(tmp_row);
 			oph_metadb_cleanup_db_struct(tmp_row);
 
 			break;
@@ -666,12 +922,15 @@ int oph_metadb_find_db(oph_metadb_db_row * meta_db, char *db_name, char *device,
 
 	if (db_name && device) {
 		//If db is set
+		oph_metadb_db_index *index = meta_db->index;
+		if (index)
+			tmp_row = index->rows[oph_metadb_db_hash_function(db_name, device) & (index->size - 1)];
 		while (tmp_row) {
 			if (STRCMP(tmp_row->db_name, db_name) == 0 && STRCMP(tmp_row->device, device) == 0) {
 				found_row = tmp_row;
 				break;
 			}
-			tmp_row = (oph_metadb_db_row *) tmp_row->next_db;
+			tmp_row = (oph_metadb_db_row *) (index ? tmp_row->next_index : tmp_row->next_db);
 		}
 	} else {
 		//Get first db
@@ -714,65 +973,87 @@ int oph_metadb_add_frag(oph_metadb_db_row * db, oph_metadb_frag_row * frag)
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_RECORD_COPY_ERROR);
 		return OPH_METADB_DATA_ERR;
 	}
+	//Serialize row
+	char *line = NULL;
+	unsigned int length = 0;
+	if (_oph_metadb_serialize_frag_row(frag_row, &line, &length)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
+		oph_metadb_cleanup_frag_struct(frag_row);
+		return OPH_METADB_IO_ERR;
+	}
+
+	oph_metadb_frag_table *table = oph_metadb_frag_table_get(db);
+	if (table == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
+		free(line);
+		oph_metadb_cleanup_frag_struct(frag_row);
+		return OPH_METADB_MEMORY_ERR;
+	}
+
+	unsigned long long hash = oph_metadb_hash_function(frag_row->frag_name);
+	pthread_rwlock_t *bucket_lock = oph_metadb_frag_table_lock(table, hash);
+
 	//Check if Frag name already exists in given DB
-	oph_metadb_frag_row *tmp_row = NULL;
-	if (db->table != NULL) {
-		//If frag list is not empty find record
-		if (oph_metadb_find_frag(db, frag_row->frag_name, &tmp_row)) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_RECORD_UPDATE_NOT_FOUND, frag_row->frag_name);
-			logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_RECORD_UPDATE_NOT_FOUND, frag_row->frag_name);
-			return OPH_METADB_IO_ERR;
-		}
-		if (tmp_row != NULL) {
-			pmesg(LOG_DEBUG, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_EXIST_ERROR);
-			logging(LOG_DEBUG, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_EXIST_ERROR);
-			oph_metadb_cleanup_frag_struct(frag_row);
-			return OPH_METADB_OK;
-		}
+	pthread_rwlock_rdlock(bucket_lock);
+	oph_metadb_frag_row *tmp_row = oph_metadb_frag_table_find(table, hash, frag_row->frag_name);
+	pthread_rwlock_unlock(bucket_lock);
+	if (tmp_row != NULL) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_EXIST_ERROR);
+		logging(LOG_DEBUG, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_EXIST_ERROR);
+		free(line);
+		oph_metadb_cleanup_frag_struct(frag_row);
+		return OPH_METADB_OK;
 	}
-	//Count bytes in file
+	//Row is appended without locking the bucket, so that fragments of the same bucket can be accessed in the meantime
 	unsigned long long byte_size = 0;
+	pthread_mutex_lock(&frag_file_lock);
 	if (_oph_metadb_count_bytes(frag_file, &byte_size)) {
+		pthread_mutex_unlock(&frag_file_lock);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FILE_SIZE_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FILE_SIZE_ERROR);
+		free(line);
 		oph_metadb_cleanup_frag_struct(frag_row);
 		return OPH_METADB_IO_ERR;
 	}
-	//Insert in file
-	char *line = NULL;
-	unsigned int length = 0;
-	if (_oph_metadb_serialize_frag_row(frag_row, &line, &length)) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
-		oph_metadb_cleanup_frag_struct(frag_row);
-		return OPH_METADB_IO_ERR;
-	}
-	//Append row
 	if (_oph_metadb_write_row(line, length, frag_row->is_persistent, frag_file, 0, 1)) {
+		pthread_mutex_unlock(&frag_file_lock);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
 		free(line);
+		oph_metadb_cleanup_frag_struct(frag_row);
 		return OPH_METADB_IO_ERR;
 	}
+	pthread_mutex_unlock(&frag_file_lock);
 	free(line);
 
-	if (db->table == NULL) {
-		//Create hash table
-		db->table = oph_metadb_frag_table_create(OPH_METADB_FRAG_TABLE_SIZE);
-		if (db->table == NULL) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
-			logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_MEMORY_ALLOC_ERROR);
-			return OPH_METADB_MEMORY_ERR;
+	frag_row->file_offset = byte_size;
+	frag_row->db_ptr = db;
+
+	pthread_rwlock_wrlock(bucket_lock);
+
+	//The same Frag could have been added while the row was appended: the row is then removed
+	if (oph_metadb_frag_table_find(table, hash, frag_row->frag_name) != NULL) {
+		pthread_rwlock_unlock(bucket_lock);
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_EXIST_ERROR);
+		logging(LOG_DEBUG, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_EXIST_ERROR);
+		if (_oph_metadb_remove_row(frag_file, frag_row->file_offset)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_REMOVE_RECORD_ERROR, frag_file);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_REMOVE_RECORD_ERROR, frag_file);
+			oph_metadb_cleanup_frag_struct(frag_row);
+			return OPH_METADB_IO_ERR;
 		}
+		oph_metadb_cleanup_frag_struct(frag_row);
+		return OPH_METADB_OK;
 	}
 	//Insert new Frag into stack
-	frag_row->file_offset = byte_size;
-	frag_row->db_ptr = db;
+	int grow = oph_metadb_frag_table_insert(table, hash, frag_row);
+
+	pthread_rwlock_unlock(bucket_lock);
 
-	int hash = oph_metadb_hash_function(frag->frag_name) % db->table->size;
-	frag_row->next_frag = (struct oph_metadb_frag_row *) db->table->rows[hash];
-	//Update db head pointer
-	db->table->rows[hash] = (struct oph_metadb_frag_row *) frag_row;
+	if (grow)
+		oph_metadb_frag_table_grow(table);
 
 	return OPH_METADB_OK;
 }
@@ -789,13 +1070,17 @@ int oph_metadb_remove_frag(oph_metadb_db_row * db, char *frag_name, oph_iostore_
 
 	if (db->table != NULL) {
 		//Find Frag 
-		int hash = oph_metadb_hash_function(frag_name) % db->table->size;
+		unsigned long long hash = oph_metadb_hash_function(frag_name);
+		pthread_rwlock_t *bucket_lock = oph_metadb_frag_table_lock(db->table, hash);
+		pthread_rwlock_wrlock(bucket_lock);
 
-		tmp_row = db->table->rows[hash];
+		int bucket = hash & (db->table->size - 1);
+		tmp_row = db->table->rows[bucket];
 		while (tmp_row) {
 			if (STRCMP(tmp_row->frag_name, frag_name) == 0) {
 				//Delete row
 				if (_oph_metadb_remove_row(frag_file, tmp_row->file_offset)) {
+					pthread_rwlock_unlock(bucket_lock);
 					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_REMOVE_RECORD_ERROR, frag_file);
 					logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_REMOVE_RECORD_ERROR, frag_file);
 					return OPH_METADB_IO_ERR;
@@ -806,8 +1091,9 @@ int oph_metadb_remove_frag(oph_metadb_db_row * db, char *frag_name, oph_iostore_
 					prev_row->next_frag = tmp_row->next_frag;
 				} else {
 					//If first record
-					(db->table->rows)[hash] = tmp_row->next_frag;
+					(db->table->rows)[bucket] = tmp_row->next_frag;
 				}
+				__sync_sub_and_fetch(&(db->table->count), 1);
 
 				if (frag_id) {
 					//Recover resource id
@@ -822,6 +1108,7 @@ int oph_metadb_remove_frag(oph_metadb_db_row * db, char *frag_name, oph_iostore_
 			tmp_row = (oph_metadb_frag_row *) tmp_row->next_frag;
 		}
 
+		pthread_rwlock_unlock(bucket_lock);
 	}
 
 	if (tmp_row == NULL) {
@@ -842,35 +1129,32 @@ int oph_metadb_find_frag(oph_metadb_db_row * db, char *frag_name, oph_metadb_fra
 
 	*frag = NULL;
 
-	oph_metadb_frag_row *tmp_row = NULL, *found_row = NULL;
+	oph_metadb_frag_row *found_row = NULL;
+	oph_metadb_frag_table *table = db->table;
+	pthread_rwlock_t *bucket_lock = NULL;
 
-	if (db->table != NULL) {
+	if (table != NULL) {
 		//Find Frag in DB stack struct
 		if (frag_name) {
 			//If frag is set
-			int hash = oph_metadb_hash_function(frag_name) % db->table->size;
-			tmp_row = (oph_metadb_frag_row *) db->table->rows[hash];
-
-			while (tmp_row) {
-				if (STRCMP(tmp_row->frag_name, frag_name) == 0) {
-					found_row = tmp_row;
-					break;
-				}
-				tmp_row = (oph_metadb_frag_row *) tmp_row->next_frag;
-			}
+			unsigned long long hash = oph_metadb_hash_function(frag_name);
+			bucket_lock = oph_metadb_frag_table_lock(table, hash);
+			pthread_rwlock_rdlock(bucket_lock);
+			found_row = oph_metadb_frag_table_find(table, hash, frag_name);
+			pthread_rwlock_unlock(bucket_lock);
 		} else {
 			//Get first frag
 			int i;
-			for (i = 0; i < db->table->size; i++) {
-				tmp_row = db->table->rows[i];
-				if (tmp_row) {
-					found_row = tmp_row;
-					break;
-				}
+			for (i = 0; i < table->size && !found_row; i++) {
+				bucket_lock = oph_metadb_frag_table_lock(table, i);
+				pthread_rwlock_rdlock(bucket_lock);
+				//Tables only grow, so the bucket is still valid
+				found_row = table->rows[i];
+				pthread_rwlock_unlock(bucket_lock);
 			}
 		}
 	}
-	if (tmp_row == NULL) {
+	if (found_row == NULL) {
 		pmesg(LOG_DEBUG, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_RECORD_NOT_FOUND, frag_name);
 		logging(LOG_DEBUG, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_RECORD_NOT_FOUND, frag_name);
 		return OPH_METADB_OK;
@@ -896,8 +1180,13 @@ int oph_metadb_update_frag(oph_metadb_db_row * db, oph_metadb_frag_row * frag)
 	//Check if Frag name exists
 	oph_metadb_frag_row *tmp_row = NULL;
 	if (db->table != NULL) {
+		unsigned long long hash = oph_metadb_hash_function(frag->frag_name);
+		pthread_rwlock_t *bucket_lock = oph_metadb_frag_table_lock(db->table, hash);
+		pthread_rwlock_wrlock(bucket_lock);
+
 		//If frag list is not empty find record
-		if (oph_metadb_find_frag(db, frag->frag_name, &tmp_row) || !tmp_row) {
+		if (!(tmp_row = oph_metadb_frag_table_find(db->table, hash, frag->frag_name))) {
+			pthread_rwlock_unlock(bucket_lock);
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_RECORD_UPDATE_NOT_FOUND, frag->frag_name);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_FRAG_RECORD_UPDATE_NOT_FOUND, frag->frag_name);
 			return OPH_METADB_IO_ERR;
@@ -909,17 +1198,23 @@ int oph_metadb_update_frag(oph_metadb_db_row * db, oph_metadb_frag_row * frag)
 			tmp_row->frag_size = frag->frag_size;
 
 			if (_oph_metadb_serialize_frag_row(tmp_row, &line, &length)) {
+				pthread_rwlock_unlock(bucket_lock);
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_SERIAL_RECORD_ERROR);
 				return OPH_METADB_IO_ERR;
 			}
+			pthread_rwlock_unlock(bucket_lock);
+
 			//Append row
+			pthread_mutex_lock(&frag_file_lock);
 			if (_oph_metadb_write_row(line, length, tmp_row->is_persistent, frag_file, tmp_row->file_offset, 0)) {
+				pthread_mutex_unlock(&frag_file_lock);
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_METADB_LOG_WRITE_RECORD_ERROR);
 				free(line);
 				return OPH_METADB_IO_ERR;
 			}
+			pthread_mutex_unlock(&frag_file_lock);
 			free(line);
 
 			return OPH_METADB_OK;
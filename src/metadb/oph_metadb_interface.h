@@ -20,6 +20,7 @@
 #define __OPH_METADB_INTERFACE_H
 
 #include "oph_iostorage_data.h"
+#include <pthread.h>
 
 #define OPH_METADB_DATABASE_SCHEMA_PREFIX         OPH_SERVER_DATABASE_SCHEMA_PREFIX
 #define OPH_METADB_FRAGMENT_SCHEMA_PREFIX         OPH_SERVER_FRAGMENT_SCHEMA_PREFIX
@@ -37,8 +38,35 @@
 #define OPH_METADB_IO_ERR 3
 #define OPH_METADB_DATA_ERR 4
 
-//default hash table size
-#define OPH_METADB_FRAG_TABLE_SIZE 5000
+//initial hash table size (power of 2); tables are doubled when the number of fragments exceeds OPH_METADB_FRAG_TABLE_LOAD times the size
+#define OPH_METADB_FRAG_TABLE_SIZE 1024
+#define OPH_METADB_FRAG_TABLE_LOAD 1
+//number of locks protecting the buckets of a hash table (power of 2, bucket i is protected by lock i % OPH_METADB_FRAG_TABLE_LOCKS)
+#define OPH_METADB_FRAG_TABLE_LOCKS 64
+//initial size of DB hash index (power of 2), doubled when full
+#define OPH_METADB_DB_INDEX_SIZE 64
+
+/*
+LOCKING:
+The list of DBs and its hash index are protected by the caller (the server uses a global rwlock, held in write mode only to add or remove a DB).
+Each DB record has its own rwlock: it is held in read mode to use fragments and in write mode to remove them,
+so that fragment records returned by oph_metadb_find_frag are valid as long as the DB lock is held in read mode.
+Buckets of fragment hash tables are protected by the table locks, which are managed internally by MetaDB functions;
+all of them are taken in write mode to double the size of a table.
+Writes to schema files are serialized by MetaDB with a mutex for each file: new fragments are written holding only the lock of their bucket.
+*/
+
+/**
+ * \brief			        Structure to contain the hash index of a DB list, keyed on (db_name, device) and shared by the rows of the list
+ * \param size				Size of hash index
+ * \param count				Number of DB schema records in hash index
+ * \param rows   			Array of pointers to DB schema records
+ */
+typedef struct oph_metadb_db_index {
+	int size;
+	int count;
+	struct oph_metadb_db_row **rows;
+} oph_metadb_db_index;
 
 /**
  * \brief			        Structure to contain a database schema record
@@ -50,6 +78,9 @@
  * \param is_persistent Flag used to indicate whether the device is persistent (1) or transient (0)
  * \param db_id      	ID of DB in device (generated by I/O storage API)
  * \param frag_number Number of fragments managed by the database
+ * \param lock        Lock protecting fragments of the database
+ * \param next_index  Pointer to next db inside the same bucket of DB hash index
+ * \param index       Hash index of the DB list containing the record
  */
 typedef struct oph_metadb_db_row {
 	char *db_name;
@@ -61,6 +92,9 @@ typedef struct oph_metadb_db_row {
 	oph_iostore_resource_id db_id;
 	//Info section
 	unsigned long long frag_number;
+	pthread_rwlock_t lock;
+	struct oph_metadb_db_row *next_index;
+	oph_metadb_db_index *index;
 } oph_metadb_db_row;
 
 /**
@@ -92,11 +126,15 @@ typedef struct oph_metadb_frag_row {
 /**
  * \brief			        Structure to contain a fragment schema hash table
  * \param size				Size of hash table
+ * \param count				Number of fragment schema records in hash table
  * \param rows   			Array of pointers to fragment schema records
+ * \param locks  			Array of OPH_METADB_FRAG_TABLE_LOCKS locks protecting the buckets
  */
 typedef struct oph_metadb_frag_table {
 	int size;
+	int count;
 	oph_metadb_frag_row **rows;
+	pthread_rwlock_t *locks;
 } oph_metadb_frag_table;
 
 /**
@@ -105,6 +143,13 @@ typedef struct oph_metadb_frag_table {
  */
 void oph_metadb_set_data_prefix(char *p);
 
+/**
+ * \brief               Function to release a fragment hash table and the fragment records it contains
+ * \param table         Fragment hash table
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_metadb_frag_table_destroy(oph_metadb_frag_table * table);
+
 /**
  * \brief               Function create a new MetaDB Db record
  * \param db_name		    Name of database
@@ -174,6 +219,14 @@ int oph_metadb_add_db(oph_metadb_db_row ** meta_db, oph_metadb_db_row * db);
  */
 int oph_metadb_update_db(oph_metadb_db_row * meta_db, oph_metadb_db_row * db);
 
+/**
+ * \brief           Function to change the number of fragments of a DB and update its record in the schema file. Concurrent updates are serialized.
+ * \param db        Pointer to DB record (as returned by oph_metadb_find_db)
+ * \param delta     Value to be added to the number of fragments
+ * \return          0 if successfull, non-0 otherwise
+ */
+int oph_metadb_update_db_frag_number(oph_metadb_db_row * db, long long delta);
+
 /**
  * \brief           Function to remove an empty DB (after verifying its existance) from MetaDB and update meta_db. NOTE: db is uniquely identified by the couple db_name and device.
  * \param meta_db   MetaDB table
@@ -16,6 +16,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#define _GNU_SOURCE
+
 #include "oph_network.h"
 
 #include <unistd.h>
@@ -23,7 +25,16 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <strings.h>
+#include <string.h>
+#include <limits.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <sys/time.h>
 
 #include "debug.h"
 #include <errno.h>
@@ -31,6 +42,22 @@
 
 #define	OPH_NET_LISTEN_QUEUE		512	/* 2nd argument to listen() */
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#define	OPH_NET_SHM_TEMPLATE		"/dev/shm/oph_net_XXXXXX"	/* used when memfd_create is not available */
+
+#ifdef OPH_NET_ZLIB
+#include <zlib.h>
+#define	OPH_NET_COMPRESSION_LEVEL	Z_BEST_SPEED	/* favour speed, data are compressed at each transfer */
+#endif
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define OPH_NET_ZEROCOPY
+#endif
+
 /* Read "n" bytes from a descriptor. */
 ssize_t oph_net_readn(int fd, void *buffer, size_t n)
 {
@@ -57,6 +84,429 @@ ssize_t oph_net_readn(int fd, void *buffer, size_t n)
 	return (n - nleft);	/* return >= 0 */
 }
 
+/* Write "n" bytes to a descriptor. */
+ssize_t oph_net_writen(int fd, const void *buffer, size_t n)
+{
+	/* Adapted from Stevens et al. UNP Vol. 1, 3rd Ed. source code - http://www.unpbook.com/src.html */
+
+	size_t nleft;
+	ssize_t nwritten;
+	const char *ptr;
+
+	ptr = buffer;
+	nleft = n;
+	while (nleft > 0) {
+		if ((nwritten = write(fd, ptr, nleft)) <= 0) {
+			if (nwritten < 0 && errno == EINTR)
+				nwritten = 0;	/* and call write() again */
+			else
+				return OPH_NETWORK_ERROR;
+		}
+
+		nleft -= nwritten;
+		ptr += nwritten;
+	}
+	return n;
+}
+
+int oph_net_set_zerocopy(int fd)
+{
+#ifdef OPH_NET_ZEROCOPY
+	const int on = 1;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0)
+		return OPH_NETWORK_SUCCESS;
+#endif
+	return OPH_NETWORK_ERROR;
+}
+
+/* Buffers handed to the tracker are preceded by this header, aligned as malloc'ed memory */
+typedef union {
+	struct {
+		oph_net_zerocopy_buffer *next;
+		size_t size;
+		unsigned int id;
+	} head;
+	long double align;
+} oph_net_zerocopy_header;
+
+#define OPH_NET_ZEROCOPY_HEADER(buffer)	(((oph_net_zerocopy_header *) (buffer)) - 1)
+
+#ifdef OPH_NET_ZEROCOPY
+/* Collect the completion notifications queued on the socket, waiting up to "timeout" ms for the first one. */
+static int _oph_net_zerocopy_collect(int fd, oph_net_zerocopy * zc, int timeout)
+{
+	char control[128];
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct sock_extended_err *serr;
+	struct pollfd pfd;
+	int n;
+
+	while (zc->completed != zc->sent) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return OPH_NETWORK_ERROR;
+			if (!timeout)
+				break;
+			/* Notifications are signalled as POLLERR */
+			pfd.fd = fd;
+			pfd.events = 0;
+			pfd.revents = 0;
+			if ((n = poll(&pfd, 1, timeout)) < 0 && errno != EINTR)
+				return OPH_NETWORK_ERROR;
+			if (!n)
+				break;
+			continue;
+		}
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+				continue;
+			serr = (struct sock_extended_err *) CMSG_DATA(cm);
+			if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+			/* Range of completed transmissions is [ee_info, ee_data]: TCP completes them in order */
+			zc->completed = serr->ee_data + 1;
+		}
+	}
+	return OPH_NETWORK_SUCCESS;
+}
+#endif
+
+void *oph_net_zerocopy_alloc(int fd, oph_net_zerocopy * zc, size_t size)
+{
+	oph_net_zerocopy_header *header;
+	oph_net_zerocopy_buffer *buffer, *prev = NULL;
+
+	if (zc) {
+#ifdef OPH_NET_ZEROCOPY
+		_oph_net_zerocopy_collect(fd, zc, 0);
+#else
+		(void) fd;
+#endif
+		/* Buffers are released in transmission order, so only the first ones can be reused */
+		for (buffer = zc->buffers; buffer; prev = buffer, buffer = OPH_NET_ZEROCOPY_HEADER(buffer)->head.next) {
+			header = OPH_NET_ZEROCOPY_HEADER(buffer);
+			if ((int) (zc->completed - header->head.id) < 0)
+				break;
+			if (header->head.size < size)
+				continue;
+			if (prev)
+				OPH_NET_ZEROCOPY_HEADER(prev)->head.next = header->head.next;
+			else
+				zc->buffers = header->head.next;
+			if (zc->last == buffer)
+				zc->last = prev;
+			return buffer;
+		}
+	}
+	if (!(header = (oph_net_zerocopy_header *) malloc(sizeof(oph_net_zerocopy_header) + size)))
+		return NULL;
+	header->head.size = size;
+	return header + 1;
+}
+
+void oph_net_zerocopy_free(oph_net_zerocopy * zc, void *buffer)
+{
+	if (!buffer)
+		return;
+	oph_net_zerocopy_header *header = OPH_NET_ZEROCOPY_HEADER(buffer);
+	if (!zc) {
+		free(header);
+		return;
+	}
+	/* Buffer can be reused once the transmissions started so far are completed */
+	header->head.id = zc->sent;
+	header->head.next = NULL;
+	if (zc->last)
+		OPH_NET_ZEROCOPY_HEADER(zc->last)->head.next = buffer;
+	else
+		zc->buffers = buffer;
+	zc->last = buffer;
+}
+
+int oph_net_zerocopy_wait(int fd, oph_net_zerocopy * zc, int timeout)
+{
+#ifdef OPH_NET_ZEROCOPY
+	struct timeval start, now;
+	int elapsed = 0;
+
+	gettimeofday(&start, NULL);
+	do {
+		if (_oph_net_zerocopy_collect(fd, zc, timeout - elapsed))
+			return OPH_NETWORK_ERROR;
+		gettimeofday(&now, NULL);
+		elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000;
+	} while (zc->completed != zc->sent && elapsed < timeout);
+#else
+	(void) fd;
+	(void) timeout;
+#endif
+	return zc->completed == zc->sent ? OPH_NETWORK_SUCCESS : OPH_NETWORK_ERROR;
+}
+
+void oph_net_zerocopy_destroy(oph_net_zerocopy * zc)
+{
+	oph_net_zerocopy_buffer *buffer;
+
+	while ((buffer = zc->buffers)) {
+		zc->buffers = OPH_NET_ZEROCOPY_HEADER(buffer)->head.next;
+		free(OPH_NET_ZEROCOPY_HEADER(buffer));
+	}
+	zc->last = NULL;
+}
+
+/* Write a vector of buffers to a descriptor. */
+ssize_t oph_net_writev(int fd, struct iovec *iov, int iovcnt, oph_net_zerocopy * zc)
+{
+	size_t nwritten = 0;
+	ssize_t n;
+	int res = OPH_NETWORK_SUCCESS;
+#ifdef OPH_NET_ZEROCOPY
+	struct msghdr msg;
+	int zerocopy = zc != NULL;
+#endif
+
+	while (iovcnt > 0) {
+		if (!iov->iov_len) {
+			iov++;
+			iovcnt--;
+			continue;
+		}
+#ifdef OPH_NET_ZEROCOPY
+		if (zerocopy) {
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = iov;
+			msg.msg_iovlen = iovcnt > IOV_MAX ? IOV_MAX : iovcnt;
+			if ((n = sendmsg(fd, &msg, MSG_ZEROCOPY)) >= 0)
+				zc->sent++;
+			else if (errno == ENOBUFS) {
+				/* Out of option memory for pinned pages: go on copying data */
+				zerocopy = 0;
+				continue;
+			}
+		} else
+#endif
+			n = writev(fd, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			res = OPH_NETWORK_ERROR;
+			break;
+		}
+
+		nwritten += n;
+		while (n > 0) {
+			if ((size_t) n >= iov->iov_len) {
+				n -= iov->iov_len;
+				iov++;
+				iovcnt--;
+			} else {
+				iov->iov_base = (char *) iov->iov_base + n;
+				iov->iov_len -= n;
+				n = 0;
+			}
+		}
+	}
+
+#ifdef OPH_NET_ZEROCOPY
+	/* Completions are only collected here, buffers are released by the caller once they are notified */
+	if (zc && _oph_net_zerocopy_collect(fd, zc, 0))
+		res = OPH_NETWORK_ERROR;
+#else
+	(void) zc;
+#endif
+
+	return res ? res : (ssize_t) nwritten;
+}
+
+/* Write a vector of buffers to a descriptor, passing a descriptor together with the first bytes. */
+ssize_t oph_net_writev_fd(int fd, struct iovec *iov, int iovcnt, int passfd)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(sizeof(int))];
+	size_t nwritten = 0;
+	ssize_t n;
+
+	while (iovcnt > 0 && !iov->iov_len) {
+		iov++;
+		iovcnt--;
+	}
+	if (!iovcnt)
+		return OPH_NETWORK_ERROR;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt > IOV_MAX ? IOV_MAX : iovcnt;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &passfd, sizeof(int));
+
+	while ((n = sendmsg(fd, &msg, 0)) < 0 && errno == EINTR);
+	if (n <= 0)
+		return OPH_NETWORK_ERROR;
+
+	/* Descriptor has been sent: go on with the remaining bytes */
+	nwritten = n;
+	while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+		n -= iov->iov_len;
+		iov++;
+		iovcnt--;
+	}
+	if (iovcnt > 0) {
+		iov->iov_base = (char *) iov->iov_base + n;
+		iov->iov_len -= n;
+		if ((n = oph_net_writev(fd, iov, iovcnt, 0)) < 0)
+			return OPH_NETWORK_ERROR;
+		nwritten += n;
+	}
+
+	return (ssize_t) nwritten;
+}
+
+/* Read "n" bytes from a descriptor, receiving the descriptor passed with them, if any. */
+ssize_t oph_net_readn_fd(int fd, void *buffer, size_t n, int *passfd)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char control[CMSG_SPACE(sizeof(int))];
+	size_t nleft = n;
+	ssize_t nread;
+	int rfd;
+
+	*passfd = -1;
+	while (nleft > 0) {
+		memset(&msg, 0, sizeof(msg));
+		iov.iov_base = (char *) buffer + (n - nleft);
+		iov.iov_len = nleft;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if ((nread = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		} else if (nread == 0)
+			break;	/* EOF */
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+				continue;
+			memcpy(&rfd, CMSG_DATA(cmsg), sizeof(int));
+			if (*passfd < 0)
+				*passfd = rfd;
+			else
+				close(rfd);
+		}
+		nleft -= nread;
+	}
+
+	if (nleft && *passfd >= 0) {
+		close(*passfd);
+		*passfd = -1;
+	}
+	return nleft ? OPH_NETWORK_ERROR : (ssize_t) n;
+}
+
+int oph_net_shm_create(size_t size, int *fd)
+{
+	int shmfd;
+	*fd = -1;
+
+#ifdef MFD_CLOEXEC
+	shmfd = memfd_create("oph_net_shm", MFD_CLOEXEC);
+#else
+	char name[] = OPH_NET_SHM_TEMPLATE;
+	if ((shmfd = mkstemp(name)) >= 0)
+		unlink(name);
+#endif
+	if (shmfd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to create shared memory segment\n");
+		return OPH_NETWORK_ERROR;
+	}
+	if (ftruncate(shmfd, (off_t) size)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to set size of shared memory segment\n");
+		close(shmfd);
+		return OPH_NETWORK_ERROR;
+	}
+
+	*fd = shmfd;
+	return OPH_NETWORK_SUCCESS;
+}
+
+int oph_net_compression_supported(void)
+{
+#ifdef OPH_NET_ZLIB
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+size_t oph_net_compress_bound(size_t len)
+{
+#ifdef OPH_NET_ZLIB
+	return (size_t) compressBound((uLong) len);
+#else
+	return len;
+#endif
+}
+
+int oph_net_compress(const void *src, size_t src_len, void *dst, size_t *dst_len)
+{
+#ifdef OPH_NET_ZLIB
+	uLongf len = (uLongf) * dst_len;
+
+	if (compress2((Bytef *) dst, &len, (const Bytef *) src, (uLong) src_len, OPH_NET_COMPRESSION_LEVEL) != Z_OK) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to compress %zu bytes\n", src_len);
+		return OPH_NETWORK_ERROR;
+	}
+	*dst_len = (size_t) len;
+	return OPH_NETWORK_SUCCESS;
+#else
+	(void) src;
+	(void) src_len;
+	(void) dst;
+	(void) dst_len;
+	pmesg(LOG_WARNING, __FILE__, __LINE__, "Compression is not supported\n");
+	return OPH_NETWORK_ERROR;
+#endif
+}
+
+int oph_net_uncompress(const void *src, size_t src_len, void *dst, size_t dst_len)
+{
+#ifdef OPH_NET_ZLIB
+	uLongf len = (uLongf) dst_len;
+
+	if (uncompress((Bytef *) dst, &len, (const Bytef *) src, (uLong) src_len) != Z_OK || len != (uLongf) dst_len) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to uncompress %zu bytes\n", src_len);
+		return OPH_NETWORK_ERROR;
+	}
+	return OPH_NETWORK_SUCCESS;
+#else
+	(void) src;
+	(void) src_len;
+	(void) dst;
+	(void) dst_len;
+	pmesg(LOG_ERROR, __FILE__, __LINE__, "Compression is not supported\n");
+	return OPH_NETWORK_ERROR;
+#endif
+}
+
 int oph_net_connect(const char *host, const char *port, int *fd)
 {
 	/* Adapted from Stevens et al. UNP Vol. 1, 3rd Ed. source code - http://www.unpbook.com/src.html */
@@ -100,6 +550,34 @@ int oph_net_connect(const char *host, const char *port, int *fd)
 	return OPH_NETWORK_SUCCESS;
 }
 
+int oph_net_unix_connect(const char *path, int *fd)
+{
+	int sockfd;
+	struct sockaddr_un addr;
+	*fd = 0;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Socket path %s is too long\n", path);
+		return OPH_NETWORK_ERROR;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((sockfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to create socket\n");
+		return OPH_NETWORK_ERROR;
+	}
+	if (connect(sockfd, (struct sockaddr *) &addr, sizeof(addr))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "unix_connect error for %s\n", path);
+		close(sockfd);
+		return OPH_NETWORK_ERROR;
+	}
+
+	*fd = sockfd;
+	return OPH_NETWORK_SUCCESS;
+}
+
 int oph_net_accept(int in_fd, struct sockaddr *sa, socklen_t * salenptr, int *out_fd)
 {
 	/* Adapted from Stevens et al. UNP Vol. 1, 3rd Ed. source code - http://www.unpbook.com/src.html */
@@ -179,6 +657,43 @@ int oph_net_listen(const char *host, const char *port, socklen_t * addrlenp, int
 	return OPH_NETWORK_SUCCESS;
 }
 
+int oph_net_unix_listen(const char *path, int *out_fd)
+{
+	int listenfd;
+	struct sockaddr_un addr;
+	*out_fd = 0;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Socket path %s is too long\n", path);
+		return OPH_NETWORK_ERROR;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((listenfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to create socket\n");
+		return OPH_NETWORK_ERROR;
+	}
+
+	/* Remove the socket left by a previous run */
+	unlink(path);
+	if (bind(listenfd, (struct sockaddr *) &addr, sizeof(addr))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "unix_listen error for %s\n", path);
+		close(listenfd);
+		return OPH_NETWORK_ERROR;
+	}
+
+	if (listen(listenfd, OPH_NET_LISTEN_QUEUE) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while listening socket!\n");
+		close(listenfd);
+		return OPH_NETWORK_ERROR;
+	}
+
+	*out_fd = listenfd;
+	return OPH_NETWORK_SUCCESS;
+}
+
 int oph_net_signal(int signo, void *func)
 {
 	/* Adapted from Stevens et al. UNP Vol. 1, 3rd Ed. source code - http://www.unpbook.com/src.html */
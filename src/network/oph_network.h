@@ -24,6 +24,26 @@
 #define OPH_NETWORK_ERROR                              -1
 
 #include <netdb.h>
+#include <sys/uio.h>
+
+/**
+ * \brief               Buffer handed to a zero-copy tracker (memory is preceded by a private header)
+ */
+typedef void oph_net_zerocopy_buffer;
+
+/**
+ * \brief               Structure to track the zero-copy transmissions of a socket
+ * \param sent          Number of zero-copy transmissions started on socket
+ * \param completed     Number of transmissions whose pages have been released by the kernel
+ * \param buffers       Buffers released by the caller, to be reused once their transmissions are completed
+ * \param last          Last buffer released
+ */
+typedef struct {
+	unsigned int sent;
+	unsigned int completed;
+	oph_net_zerocopy_buffer *buffers;
+	oph_net_zerocopy_buffer *last;
+} oph_net_zerocopy;
 
 // Prototypes
 
@@ -36,6 +56,124 @@
  */
 ssize_t oph_net_readn(int fd, void *buffer, size_t n);
 
+/**
+ * \brief               Function to write n bytes to socket
+ * \param fd            Socket being written
+ * \param buffer        Buffer with data to be written
+ * \param n             Number of bytes to be written
+ * \return              number of bytes written if successfull, -1 otherwise
+ */
+ssize_t oph_net_writen(int fd, const void *buffer, size_t n);
+
+/**
+ * \brief               Function to write a vector of buffers to socket, splitting it in batches of IOV_MAX entries
+ * \param fd            Socket being written
+ * \param iov           Buffers to be written; entries are modified while data are sent
+ * \param iovcnt        Number of buffers
+ * \param zc            Tracker of the socket to send data with MSG_ZEROCOPY, NULL to copy data; buffers cannot be changed until the transmission is completed
+ * \return              number of bytes written if successfull, -1 otherwise
+ */
+ssize_t oph_net_writev(int fd, struct iovec *iov, int iovcnt, oph_net_zerocopy * zc);
+
+/**
+ * \brief               Function to get a buffer that can be sent with zero-copy, reusing a buffer whose transmissions are completed if any
+ * \param fd            Socket descriptor
+ * \param zc            Tracker of the socket, NULL to allocate a new buffer
+ * \param size          Size of the buffer
+ * \return              the buffer if successfull, NULL otherwise
+ */
+void *oph_net_zerocopy_alloc(int fd, oph_net_zerocopy * zc, size_t size);
+
+/**
+ * \brief               Function to release a buffer got with oph_net_zerocopy_alloc: it is kept until the transmissions started so far are completed
+ * \param zc            Tracker of the socket, NULL to free the buffer at once
+ * \param buffer        Buffer to be released
+ */
+void oph_net_zerocopy_free(oph_net_zerocopy * zc, void *buffer);
+
+/**
+ * \brief               Function to wait until the zero-copy transmissions started on socket are completed
+ * \param fd            Socket descriptor
+ * \param zc            Tracker of the socket
+ * \param timeout       Max number of ms to wait, 0 to only collect the completions already notified
+ * \return              0 if all transmissions are completed, -1 otherwise (completions can be collected later)
+ */
+int oph_net_zerocopy_wait(int fd, oph_net_zerocopy * zc, int timeout);
+
+/**
+ * \brief               Function to free the buffers of a tracker, once its socket has been closed
+ * \param zc            Tracker of the socket
+ */
+void oph_net_zerocopy_destroy(oph_net_zerocopy * zc);
+
+/**
+ * \brief               Function to enable zero-copy transmission on socket, if supported by the kernel
+ * \param fd            Socket descriptor
+ * \return              0 if successfull, -1 otherwise
+ */
+int oph_net_set_zerocopy(int fd);
+
+/**
+ * \brief               Function to write a vector of buffers to a local socket, passing a descriptor (e.g. a shared memory segment) together with the first bytes
+ * \param fd            Socket being written
+ * \param iov           Buffers to be written; entries are modified while data are sent
+ * \param iovcnt        Number of buffers
+ * \param passfd        Descriptor to be passed
+ * \return              number of bytes written if successfull, -1 otherwise
+ */
+ssize_t oph_net_writev_fd(int fd, struct iovec *iov, int iovcnt, int passfd);
+
+/**
+ * \brief               Function to read n bytes from a local socket, receiving the descriptor passed with them
+ * \param fd            Socket being read
+ * \param buffer        Buffer for result read
+ * \param n             Number of bytes being read
+ * \param passfd        Descriptor received, -1 if no descriptor has been passed
+ * \return              n if successfull, -1 otherwise
+ */
+ssize_t oph_net_readn_fd(int fd, void *buffer, size_t n, int *passfd);
+
+/**
+ * \brief               Function to create an anonymous shared memory segment, that can be mapped by other processes once its descriptor is passed
+ * \param size          Size of the segment
+ * \param fd            Descriptor of the new segment
+ * \return              0 if successfull, -1 otherwise
+ */
+int oph_net_shm_create(size_t size, int *fd);
+
+/**
+ * \brief               Function to check if the library has been built with support for data compression
+ * \return              1 if compression is supported, 0 otherwise
+ */
+int oph_net_compression_supported(void);
+
+/**
+ * \brief               Function to get the maximum length of len bytes once compressed
+ * \param len           Number of bytes to be compressed
+ * \return              size of the buffer needed by oph_net_compress
+ */
+size_t oph_net_compress_bound(size_t len);
+
+/**
+ * \brief               Function to compress a buffer with a fast codec
+ * \param src           Buffer to be compressed
+ * \param src_len       Number of bytes to be compressed
+ * \param dst           Buffer for compressed data
+ * \param dst_len       Size of dst as input, number of compressed bytes as output
+ * \return              0 if successfull, -1 otherwise
+ */
+int oph_net_compress(const void *src, size_t src_len, void *dst, size_t *dst_len);
+
+/**
+ * \brief               Function to uncompress a buffer compressed with oph_net_compress
+ * \param src           Compressed data
+ * \param src_len       Number of compressed bytes
+ * \param dst           Buffer for uncompressed data
+ * \param dst_len       Expected number of uncompressed bytes
+ * \return              0 if successfull, -1 otherwise
+ */
+int oph_net_uncompress(const void *src, size_t src_len, void *dst, size_t dst_len);
+
 /**
  * \brief               Function to connect to hostname:port 
  * \param host          Server hostname
@@ -45,6 +183,14 @@ ssize_t oph_net_readn(int fd, void *buffer, size_t n);
  */
 int oph_net_connect(const char *host, const char *port, int *fd);
 
+/**
+ * \brief               Function to connect to a local (AF_UNIX) socket
+ * \param path          Path of the socket
+ * \param fd            Fd descriptor of the new socket
+ * \return              0 if successfull, -1 otherwise
+ */
+int oph_net_unix_connect(const char *path, int *fd);
+
 /**
  * \brief               Function to accept a connection on a socket
  * \param in_fd         Descriptor of socket being listened
@@ -65,6 +211,14 @@ int oph_net_accept(int in_fd, struct sockaddr *sa, socklen_t * salenptr, int *ou
  */
 int oph_net_listen(const char *host, const char *port, socklen_t * addrlenp, int *fd);
 
+/**
+ * \brief               Function to listen to a local (AF_UNIX) socket; an existing socket with the same path is replaced
+ * \param path          Path of the socket
+ * \param fd            Descriptor of socket for listened socket
+ * \return              0 if successfull, -1 otherwise
+ */
+int oph_net_unix_listen(const char *path, int *fd);
+
 /**
  * \brief               Function used to set a handler function for a signal
  * \param signo         Signal to be catched
@@ -98,6 +98,8 @@
 
 #define OPH_QUERY_ENGINE_LANG_VAL_YES "yes"
 #define OPH_QUERY_ENGINE_LANG_VAL_NO 	"no"
+#define OPH_QUERY_ENGINE_LANG_VAL_ASC 	"ASC"
+#define OPH_QUERY_ENGINE_LANG_VAL_DESC 	"DESC"
 
 //*****************Query argument values***************//
 
@@ -36,6 +36,7 @@
 #define OPH_QUERY_ENGINE_LOG_PLUGIN_FILE_CORRUPTED  "Unable to read plugin file line %s\n"
 #define OPH_QUERY_ENGINE_LOG_QUERY_PARSING_ERROR    "Unable to parse query %s\n"
 #define OPH_QUERY_ENGINE_LOG_PLUGIN_LOAD_ERROR      "Unable to load plugin table\n"
+#define OPH_QUERY_ENGINE_LOG_PLUGIN_DLOPEN_ERROR    "Unable to load library of plugin %s: %s\n"
 #define OPH_QUERY_ENGINE_LOG_HASHTBL_CREATE_ERROR   "Unable to create hash table\n"
 #define OPH_QUERY_ENGINE_LOG_QUERY_ARG_LOAD_ERROR   "Unable to load query args in table\n"
 #define OPH_QUERY_ENGINE_LOG_PLUGIN_EXEC_ERROR      "Error while executing %s\n"
@@ -46,6 +47,7 @@
 /* QUERY EVALUATOR LOG ERRORS */
 #define OPH_QUERY_ENGINE_LOG_LEXER_INIT_ERROR       "Error while initializing the lexer\n"
 #define OPH_QUERY_ENGINE_LOG_EVAL_ERROR       		"Error while evaluating the expression\n"
+#define OPH_QUERY_ENGINE_LOG_COMPILE_ERROR       	"Error while compiling the expression\n"
 #define OPH_QUERY_ENGINE_LOG_FULL_SYMTABLE       	"Symtable is full\n"
 #define OPH_QUERY_ENGINE_LOG_ARG_NUM_ERROR 			"Wrong number of arguments for function '%s.' Expected %d args. \n"
 #define OPH_QUERY_ENGINE_LOG_ARG_TYPE_ERROR         "Wrong argument type for function '%s.' Expected %s. \n"
@@ -18,6 +18,7 @@
 
 #include "oph_query_expression_evaluator.h"
 #include "oph_query_expression_functions.h"
+#include "oph_query_plugin_executor.h"
 #include "oph_query_expression_parser.h"
 #include "oph_query_expression_lexer.h"
 #include "oph_query_engine_log_error_codes.h"
@@ -47,6 +48,7 @@ static oph_query_expr_node *allocate_node()
 	b->type = eVALUE;
 	b->left = NULL;
 	b->right = NULL;
+	b->record = NULL;
 
 	return b;
 }
@@ -177,7 +179,9 @@ int oph_query_expr_delete_node(oph_query_expr_node * b, oph_query_expr_symtable
 		return OPH_QUERY_ENGINE_NULL_PARAM;
 
 	if (b->type == eFUN) {
-		oph_query_expr_record *r = oph_query_expr_lookup(b->name, oph_function_table);
+		oph_query_expr_record *r = b->record;
+		if (r == NULL)
+			r = oph_query_expr_lookup(b->name, oph_function_table);
 		if (r == NULL)
 			r = oph_query_expr_lookup(b->name, table);
 		if (table != NULL && r != NULL && r->type == 2) {
@@ -242,6 +246,13 @@ int oph_query_expr_create_function_symtable(int additional_size)
 	oph_query_expr_add_function("oph_id_to_index2", 0, 3, oph_id_to_index2, oph_function_table);
 	oph_query_expr_add_function("oph_id_to_index", 1, 2, oph_id_to_index, oph_function_table);
 	oph_query_expr_add_function("one", 0, 2, oph_query_generic_double, oph_function_table);
+
+	//built-in functions that can be evaluated on blocks of rows
+	oph_query_expr_add_batch_function("oph_id", oph_id_batch, oph_function_table);
+	oph_query_expr_add_batch_function("oph_id2", oph_id2_batch, oph_function_table);
+	oph_query_expr_add_batch_function("oph_is_in_subset", oph_is_in_subset_batch, oph_function_table);
+	oph_query_expr_add_batch_function("oph_id_to_index2", oph_id_to_index2_batch, oph_function_table);
+	oph_query_expr_add_batch_function("oph_id_to_index", oph_id_to_index_batch, oph_function_table);
 	return OPH_QUERY_ENGINE_SUCCESS;
 }
 
@@ -347,6 +358,7 @@ int oph_query_expr_add_function(const char *name, int fun_type, int args_num, op
 	sp->fun_type = fun_type;
 	sp->numArgs = args_num;
 	sp->function = value_fun;
+	sp->batch_function = NULL;
 
 	//put a reference to the new record in the first empty spot in the array
 	int max = table->maxSize;
@@ -367,6 +379,18 @@ int oph_query_expr_add_function(const char *name, int fun_type, int args_num, op
 	return OPH_QUERY_ENGINE_MEMORY_ERROR;
 }
 
+int oph_query_expr_add_batch_function(const char *name, void (*batch_function) (long long **, int, int, long long *), oph_query_expr_symtable * table)
+{
+	oph_query_expr_record *r = oph_query_expr_lookup(name, table);
+	if (r == NULL || r->type != 2 || batch_function == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+	r->batch_function = batch_function;
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
 int oph_query_expr_add_variable(const char *name, oph_query_expr_value_type var_type, double double_value, long long long_value,
 				char *string_value, oph_query_arg * binary_value, oph_query_expr_symtable * table)
 {
@@ -476,6 +500,42 @@ int oph_query_expr_add_binary(const char *name, oph_query_arg * value, oph_query
 	return oph_query_expr_add_variable(name, OPH_QUERY_EXPR_TYPE_BINARY, 0, 0, NULL, value, table);
 }
 
+int oph_query_expr_set_long(oph_query_expr_record * record, long long value)
+{
+	if (record == NULL || record->type != 1) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+	record->value.type = OPH_QUERY_EXPR_TYPE_LONG;
+	record->value.data.long_value = value;
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
+int oph_query_expr_set_double(oph_query_expr_record * record, double value)
+{
+	if (record == NULL || record->type != 1) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+	record->value.type = OPH_QUERY_EXPR_TYPE_DOUBLE;
+	record->value.data.double_value = value;
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
+int oph_query_expr_set_binary(oph_query_expr_record * record, oph_query_arg * value)
+{
+	if (record == NULL || record->type != 1) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+	record->value.type = OPH_QUERY_EXPR_TYPE_BINARY;
+	record->value.data.binary_value = value;
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
 int eeparse(int mode, oph_query_expr_node ** expression, yyscan_t scanner);
 
 oph_query_expr_value *get_array_args(char *name, oph_query_expr_node * e, int fun_type, int num_args_required, int *num_args_used, int *er, oph_query_expr_symtable * table, char *jump_flag);
@@ -516,6 +576,79 @@ int oph_query_expr_get_ast(const char *expr, oph_query_expr_node ** e)
 	return OPH_QUERY_ENGINE_SUCCESS;
 }
 
+static oph_query_expr_node *copy_node(oph_query_expr_node * e, int *er)
+{
+	if (e == NULL || *er)
+		return NULL;
+
+	oph_query_expr_node *b = allocate_node();
+	if (b == NULL) {
+		*er = 1;
+		return NULL;
+	}
+	b->type = e->type;
+	b->value = e->value;
+	b->descriptor = e->descriptor;
+	b->name = NULL;
+
+	switch (e->type) {
+		case eVALUE:
+			//Only values built by the parser can be found in a tree
+			if (e->value.type == OPH_QUERY_EXPR_TYPE_BINARY || (e->value.type == OPH_QUERY_EXPR_TYPE_STRING && !(b->value.data.string_value = strdup(e->value.data.string_value))))
+				*er = 1;
+			break;
+		case eFUN:
+			b->descriptor.initialized = 0;
+			b->descriptor.aggregate = 0;
+			b->descriptor.clear = 0;
+			b->descriptor.dlh = NULL;
+			b->descriptor.initid = NULL;
+			b->descriptor.internal_args = NULL;
+			if (!(b->name = strdup(e->name)))
+				*er = 1;
+			break;
+		case eVAR:
+			if (!(b->name = strdup(e->name)))
+				*er = 1;
+			break;
+		default:
+			break;
+	}
+	if (*er) {
+		//Children have not been copied yet
+		free(b->name);
+		free(b);
+		return NULL;
+	}
+
+	b->left = copy_node(e->left, er);
+	b->right = copy_node(e->right, er);
+
+	return b;
+}
+
+int oph_query_expr_copy_ast(oph_query_expr_node * e, oph_query_expr_node ** copy)
+{
+	if (e == NULL || copy == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+
+	int er = 0;
+	*copy = copy_node(e, &er);
+	if (er) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+		if (*copy)
+			oph_query_expr_delete_node(*copy, NULL);
+		*copy = NULL;
+		return OPH_QUERY_ENGINE_MEMORY_ERROR;
+	}
+
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
 double get_double_value(oph_query_expr_value value, int *er, const char *fun_name)
 {
 	if (value.type == OPH_QUERY_EXPR_TYPE_DOUBLE) {
@@ -702,7 +835,7 @@ oph_query_expr_value evaluate(oph_query_expr_node * e, int *er, oph_query_expr_s
 			}
 		case eVAR:
 			{
-				oph_query_expr_record *r = oph_query_expr_lookup(e->name, table);
+				oph_query_expr_record *r = e->record ? e->record : oph_query_expr_lookup(e->name, table);
 				if (r != NULL && r->type == 1) {
 					return r->value;
 				} else {
@@ -719,7 +852,9 @@ oph_query_expr_value evaluate(oph_query_expr_node * e, int *er, oph_query_expr_s
 			}
 		case eFUN:
 			{
-				oph_query_expr_record *r = oph_query_expr_lookup(e->name, oph_function_table);
+				oph_query_expr_record *r = e->record;
+				if (r == NULL)
+					r = oph_query_expr_lookup(e->name, oph_function_table);
 				if (r == NULL)
 					r = oph_query_expr_lookup(e->name, table);
 				if (r != NULL && r->type == 2) {
@@ -871,6 +1006,597 @@ oph_query_expr_value *get_array_args(char *name, oph_query_expr_node * e, int fu
 	return arr;
 }
 
+//helpers of oph_query_expr_compile
+static int is_numeric_value(oph_query_expr_node * e)
+{
+	return e && e->type == eVALUE && (e->value.type == OPH_QUERY_EXPR_TYPE_DOUBLE || e->value.type == OPH_QUERY_EXPR_TYPE_LONG);
+}
+
+static int compile_node(oph_query_expr_node * e, oph_query_expr_symtable * table)
+{
+	if (e == NULL)
+		return OPH_QUERY_ENGINE_SUCCESS;
+
+	switch (e->type) {
+		case eVALUE:
+			return OPH_QUERY_ENGINE_SUCCESS;
+		case eVAR:
+			{
+				//Variables are bound to a record updated in place by oph_query_expr_add_* and oph_query_expr_set_*
+				if ((e->record = oph_query_expr_lookup(e->name, table)) == NULL) {
+					if (oph_query_expr_add_variable(e->name, OPH_QUERY_EXPR_TYPE_NULL, 0, 0, NULL, NULL, table))
+						return OPH_QUERY_ENGINE_MEMORY_ERROR;
+					e->record = oph_query_expr_lookup(e->name, table);
+				}
+				if (e->record == NULL || e->record->type != 1) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_UNKNOWN_SYMBOL, e->name);
+					logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_UNKNOWN_SYMBOL, e->name);
+					e->record = NULL;
+					return OPH_QUERY_ENGINE_ERROR;
+				}
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		case eFUN:
+			{
+				oph_query_expr_record *r = oph_query_expr_lookup(e->name, oph_function_table);
+				if (r == NULL)
+					r = oph_query_expr_lookup(e->name, table);
+				if (r == NULL || r->type != 2) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_UNKNOWN_SYMBOL, e->name);
+					logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_UNKNOWN_SYMBOL, e->name);
+					return OPH_QUERY_ENGINE_ERROR;
+				}
+
+				int num_args_provided = 0;
+				oph_query_expr_node *cur = e->left;
+				for (; cur != NULL; cur = cur->right, num_args_provided++)
+					if (compile_node(cur->left, table))
+						return OPH_QUERY_ENGINE_ERROR;
+				if ((!r->fun_type && num_args_provided != r->numArgs) || (r->fun_type && num_args_provided < r->numArgs)) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_ARG_NUM_ERROR, e->name, r->numArgs);
+					logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_ARG_NUM_ERROR, e->name, r->numArgs);
+					return OPH_QUERY_ENGINE_ERROR;
+				}
+				e->record = r;
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		default:
+			{
+				if (compile_node(e->left, table) || compile_node(e->right, table))
+					return OPH_QUERY_ENGINE_ERROR;
+
+				//Fold operations on numeric constants
+				char unary = (e->type == eNOT) || (e->type == eNEG);
+				if ((unary ? !e->left : is_numeric_value(e->left)) && is_numeric_value(e->right)) {
+					//Division by zero is left to evaluation
+					if (e->type == eMOD && !(int) (e->right->value.type == OPH_QUERY_EXPR_TYPE_LONG ? e->right->value.data.long_value : e->right->value.data.double_value))
+						return OPH_QUERY_ENGINE_SUCCESS;
+					int er = 0;
+					oph_query_expr_value res = evaluate(e, &er, table);
+					if (!er) {
+						oph_query_expr_delete_node(e->left, table);
+						oph_query_expr_delete_node(e->right, table);
+						e->left = NULL;
+						e->right = NULL;
+						e->type = eVALUE;
+						e->value = res;
+					}
+				}
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+	}
+}
+
+//helper of oph_query_expr_has_aggregate
+static void has_aggregate_node(oph_query_expr_node * e, char *has_aggregate)
+{
+	if (e == NULL || *has_aggregate)
+		return;
+
+	char is_aggregate = 0;
+	//Built-in functions are not in plugin table
+	if (e->type == eFUN && !oph_query_plugin_is_aggregate(e->name, &is_aggregate) && is_aggregate) {
+		*has_aggregate = 1;
+		return;
+	}
+
+	has_aggregate_node(e->left, has_aggregate);
+	has_aggregate_node(e->right, has_aggregate);
+}
+
+int oph_query_expr_has_aggregate(oph_query_expr_node * e, char *has_aggregate)
+{
+	if (e == NULL || has_aggregate == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+
+	*has_aggregate = 0;
+	has_aggregate_node(e, has_aggregate);
+
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
+//helpers of oph_query_expr_select_ids
+static char select_ids_is_id(oph_query_expr_node * e, oph_query_expr_record ** id_slots, int id_num)
+{
+	int i;
+	if (e->type == eVAR && e->record != NULL)
+		for (i = 0; i < id_num; i++)
+			if (e->record == id_slots[i])
+				return 1;
+	return 0;
+}
+
+static void select_ids_set_range(unsigned long long *bitmap, long long from, long long to)
+{
+	//Bits from from to to (included)
+	long long i;
+	for (i = from; i <= to && (i % OPH_QUERY_EXPR_BITMAP_BITS); i++)
+		bitmap[i / OPH_QUERY_EXPR_BITMAP_BITS] |= 1ULL << (i % OPH_QUERY_EXPR_BITMAP_BITS);
+	for (; i + OPH_QUERY_EXPR_BITMAP_BITS - 1 <= to; i += OPH_QUERY_EXPR_BITMAP_BITS)
+		bitmap[i / OPH_QUERY_EXPR_BITMAP_BITS] = ~0ULL;
+	for (; i <= to; i++)
+		bitmap[i / OPH_QUERY_EXPR_BITMAP_BITS] |= 1ULL << (i % OPH_QUERY_EXPR_BITMAP_BITS);
+}
+
+static int select_ids_node(oph_query_expr_node * e, oph_query_expr_record ** id_slots, int id_num, long long first_id, long long row_num, unsigned long long *bitmap)
+{
+	long long words = (row_num + OPH_QUERY_EXPR_BITMAP_BITS - 1) / OPH_QUERY_EXPR_BITMAP_BITS, i;
+
+	memset(bitmap, 0, words * sizeof(unsigned long long));
+	switch (e->type) {
+		case eVALUE:
+			{
+				//Constants are accepted when their truth value does not depend on the context (i.e. double values have to be integer)
+				if (e->value.type == OPH_QUERY_EXPR_TYPE_LONG) {
+					if (e->value.data.long_value)
+						select_ids_set_range(bitmap, 0, row_num - 1);
+				} else if (e->value.type == OPH_QUERY_EXPR_TYPE_DOUBLE && e->value.data.double_value == floor(e->value.data.double_value)) {
+					if (e->value.data.double_value)
+						select_ids_set_range(bitmap, 0, row_num - 1);
+				} else
+					return OPH_QUERY_ENGINE_EXEC_ERROR;
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		case eEQUAL:
+			{
+				char left_id = select_ids_is_id(e->left, id_slots, id_num), right_id = select_ids_is_id(e->right, id_slots, id_num);
+				if (left_id && right_id) {
+					//Ids of joined tables are equal
+					select_ids_set_range(bitmap, 0, row_num - 1);
+					return OPH_QUERY_ENGINE_SUCCESS;
+				}
+				oph_query_expr_node *value = left_id ? e->right : (right_id ? e->left : NULL);
+				if (value == NULL || value->type != eVALUE || (value->value.type != OPH_QUERY_EXPR_TYPE_LONG && value->value.type != OPH_QUERY_EXPR_TYPE_DOUBLE))
+					return OPH_QUERY_ENGINE_EXEC_ERROR;
+				double id = value->value.type == OPH_QUERY_EXPR_TYPE_LONG ? (double) value->value.data.long_value : value->value.data.double_value;
+				if (id == floor(id) && id >= (double) first_id && id < (double) (first_id + row_num)) {
+					i = (long long) id - first_id;
+					bitmap[i / OPH_QUERY_EXPR_BITMAP_BITS] |= 1ULL << (i % OPH_QUERY_EXPR_BITMAP_BITS);
+				}
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		case eFUN:
+			{
+				//oph_is_in_subset(id, start, step, max) selects the ids start, start + step, ... not greater than max
+				if (e->record == NULL || e->record->function != oph_is_in_subset)
+					return OPH_QUERY_ENGINE_EXEC_ERROR;
+				//Arguments are linked in reverse order
+				oph_query_expr_node *cur = e->left;
+				long long values[3];
+				for (i = 2; i >= 0; i--, cur = cur->right) {
+					if (cur == NULL || cur->left->type != eVALUE || cur->left->value.type != OPH_QUERY_EXPR_TYPE_LONG)
+						return OPH_QUERY_ENGINE_EXEC_ERROR;
+					values[i] = cur->left->value.data.long_value;
+				}
+				if (cur == NULL || cur->right != NULL || !select_ids_is_id(cur->left, id_slots, id_num))
+					return OPH_QUERY_ENGINE_EXEC_ERROR;
+				long long start = values[0], step = values[1] < 0 ? -values[1] : values[1], max = values[2];
+				//Leave errors to the evaluator
+				if (step <= 0)
+					return OPH_QUERY_ENGINE_EXEC_ERROR;
+				long long from = start > first_id ? start : first_id, to = max < first_id + row_num - 1 ? max : first_id + row_num - 1;
+				if (from > to)
+					return OPH_QUERY_ENGINE_SUCCESS;
+				if ((from - start) % step)
+					from += step - (from - start) % step;
+				if (step == 1)
+					select_ids_set_range(bitmap, from - first_id, to - first_id);
+				else
+					for (i = from - first_id; i <= to - first_id; i += step)
+						bitmap[i / OPH_QUERY_EXPR_BITMAP_BITS] |= 1ULL << (i % OPH_QUERY_EXPR_BITMAP_BITS);
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		case eAND:
+		case eOR:
+			{
+				int ret = select_ids_node(e->left, id_slots, id_num, first_id, row_num, bitmap);
+				if (ret)
+					return ret;
+				unsigned long long *right = (unsigned long long *) malloc(words * sizeof(unsigned long long));
+				if (right == NULL) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+					logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+					return OPH_QUERY_ENGINE_MEMORY_ERROR;
+				}
+				ret = select_ids_node(e->right, id_slots, id_num, first_id, row_num, right);
+				if (!ret) {
+					if (e->type == eAND)
+						for (i = 0; i < words; i++)
+							bitmap[i] &= right[i];
+					else
+						for (i = 0; i < words; i++)
+							bitmap[i] |= right[i];
+				}
+				free(right);
+				return ret;
+			}
+		case eNOT:
+			{
+				int ret = select_ids_node(e->right, id_slots, id_num, first_id, row_num, bitmap);
+				if (ret)
+					return ret;
+				for (i = 0; i < words; i++)
+					bitmap[i] = ~bitmap[i];
+				//Clear bits beyond the last row
+				if (row_num % OPH_QUERY_EXPR_BITMAP_BITS)
+					bitmap[words - 1] &= (1ULL << (row_num % OPH_QUERY_EXPR_BITMAP_BITS)) - 1;
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		default:
+			return OPH_QUERY_ENGINE_EXEC_ERROR;
+	}
+}
+
+int oph_query_expr_select_ids(oph_query_expr_node * e, oph_query_expr_record ** id_slots, int id_num, long long first_id, long long row_num, unsigned long long *bitmap)
+{
+	if (e == NULL || (id_num > 0 && id_slots == NULL) || row_num <= 0 || bitmap == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+
+	return select_ids_node(e, id_slots, id_num, first_id, row_num, bitmap);
+}
+
+int oph_query_expr_compile(oph_query_expr_node * e, oph_query_expr_symtable * table, char **var_list, int var_count, oph_query_expr_record ** var_slots)
+{
+	if (e == NULL || table == NULL || (var_count > 0 && (var_list == NULL || var_slots == NULL))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+
+	if (compile_node(e, table)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_COMPILE_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_COMPILE_ERROR);
+		return OPH_QUERY_ENGINE_PARSE_ERROR;
+	}
+
+	int i;
+	for (i = 0; i < var_count; i++) {
+		var_slots[i] = oph_query_expr_lookup(var_list[i], table);
+		if (var_slots[i] == NULL || var_slots[i]->type != 1) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_UNKNOWN_SYMBOL, var_list[i]);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_UNKNOWN_SYMBOL, var_list[i]);
+			return OPH_QUERY_ENGINE_PARSE_ERROR;
+		}
+	}
+
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
+//helpers of batch evaluation
+static int batch_var_index(oph_query_expr_batch * b, oph_query_expr_node * e)
+{
+	int k;
+	for (k = 0; k < b->var_count; k++)
+		if (e->record && b->var_slots[k] == e->record)
+			return k;
+	return -1;
+}
+
+//Count the buffers needed to evaluate a node and check that it can be evaluated by blocks
+static int batch_check(oph_query_expr_batch * b, oph_query_expr_node * e, int *buffer_num, oph_query_expr_value_type * type)
+{
+	oph_query_expr_value_type left_type, right_type;
+
+	if (e == NULL)
+		return OPH_QUERY_ENGINE_EXEC_ERROR;
+
+	switch (e->type) {
+		case eVALUE:
+			if (e->value.type != OPH_QUERY_EXPR_TYPE_LONG && e->value.type != OPH_QUERY_EXPR_TYPE_DOUBLE)
+				return OPH_QUERY_ENGINE_EXEC_ERROR;
+			*type = e->value.type;
+			(*buffer_num)++;
+			return OPH_QUERY_ENGINE_SUCCESS;
+		case eVAR:
+			{
+				int k = batch_var_index(b, e);
+				if (k < 0)
+					return OPH_QUERY_ENGINE_EXEC_ERROR;
+				*type = b->var_types[k];
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		case eFUN:
+			{
+				//Built-in functions only accept long arguments
+				if (e->record == NULL || e->record->batch_function == NULL)
+					return OPH_QUERY_ENGINE_EXEC_ERROR;
+				oph_query_expr_node *cur = e->left;
+				for (; cur != NULL; cur = cur->right)
+					if (batch_check(b, cur->left, buffer_num, &left_type) || left_type != OPH_QUERY_EXPR_TYPE_LONG)
+						return OPH_QUERY_ENGINE_EXEC_ERROR;
+				*type = OPH_QUERY_EXPR_TYPE_LONG;
+				(*buffer_num)++;
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		case eNOT:
+		case eNEG:
+			if (batch_check(b, e->right, buffer_num, &right_type))
+				return OPH_QUERY_ENGINE_EXEC_ERROR;
+			*type = e->type == eNEG ? OPH_QUERY_EXPR_TYPE_DOUBLE : OPH_QUERY_EXPR_TYPE_LONG;
+			(*buffer_num) += 2;
+			return OPH_QUERY_ENGINE_SUCCESS;
+		case eMULTIPLY:
+		case ePLUS:
+		case eMINUS:
+		case eEQUAL:
+		case eMOD:
+		case eAND:
+		case eOR:
+			if (batch_check(b, e->left, buffer_num, &left_type) || batch_check(b, e->right, buffer_num, &right_type))
+				return OPH_QUERY_ENGINE_EXEC_ERROR;
+			*type = (e->type == eMULTIPLY || e->type == ePLUS || e->type == eMINUS) ? OPH_QUERY_EXPR_TYPE_DOUBLE : OPH_QUERY_EXPR_TYPE_LONG;
+			(*buffer_num) += 3;
+			return OPH_QUERY_ENGINE_SUCCESS;
+		default:
+			//eDIVIDE and other nodes are evaluated by rows
+			return OPH_QUERY_ENGINE_EXEC_ERROR;
+	}
+}
+
+//Operations work on double values, as in evaluate
+static double *batch_double(oph_query_expr_value_type type, void *values, int n, double *buffer)
+{
+	if (type == OPH_QUERY_EXPR_TYPE_DOUBLE)
+		return (double *) values;
+	long long *l = (long long *) values;
+	int i;
+	for (i = 0; i < n; i++)
+		buffer[i] = (double) l[i];
+	return buffer;
+}
+
+static int batch_eval(oph_query_expr_batch * b, oph_query_expr_node * e, int n, int *buffer_index, oph_query_expr_value_type * type, void **values)
+{
+	oph_query_expr_value_type left_type, right_type;
+	void *left_values = NULL, *right_values = NULL;
+	int i;
+
+	//Variables are the only nodes without a result buffer
+	if (e->type != eVAR && *buffer_index >= b->buffer_num)
+		return OPH_QUERY_ENGINE_EXEC_ERROR;
+
+	switch (e->type) {
+		case eVALUE:
+			{
+				if (e->value.type == OPH_QUERY_EXPR_TYPE_LONG) {
+					long long *res = (long long *) b->buffers[(*buffer_index)++];
+					for (i = 0; i < n; i++)
+						res[i] = e->value.data.long_value;
+					*values = res;
+				} else {
+					double *res = (double *) b->buffers[(*buffer_index)++];
+					for (i = 0; i < n; i++)
+						res[i] = e->value.data.double_value;
+					*values = res;
+				}
+				*type = e->value.type;
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		case eVAR:
+			{
+				int k = batch_var_index(b, e);
+				if (k < 0)
+					return OPH_QUERY_ENGINE_EXEC_ERROR;
+				*type = b->var_types[k];
+				*values = b->var_values[k];
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		case eFUN:
+			{
+				long long *res = (long long *) b->buffers[(*buffer_index)++];
+				int num_args = 0;
+				oph_query_expr_node *cur = e->left;
+				for (; cur != NULL; cur = cur->right)
+					num_args++;
+				long long *args[num_args ? num_args : 1];
+				//the loop is reversed so they are put in the array in the same order they appeared in the query
+				for (i = num_args - 1, cur = e->left; i >= 0; i--, cur = cur->right) {
+					if (batch_eval(b, cur->left, n, buffer_index, &left_type, &left_values) || left_type != OPH_QUERY_EXPR_TYPE_LONG)
+						return OPH_QUERY_ENGINE_EXEC_ERROR;
+					args[i] = (long long *) left_values;
+				}
+				e->record->batch_function(args, num_args, n, res);
+				*type = OPH_QUERY_EXPR_TYPE_LONG;
+				*values = res;
+				return OPH_QUERY_ENGINE_SUCCESS;
+			}
+		default:
+			break;
+	}
+
+	void *res = b->buffers[(*buffer_index)++];
+	double *l = NULL, *r = NULL;
+	if (e->type != eNOT && e->type != eNEG) {
+		if (batch_eval(b, e->left, n, buffer_index, &left_type, &left_values) || *buffer_index >= b->buffer_num)
+			return OPH_QUERY_ENGINE_EXEC_ERROR;
+		l = batch_double(left_type, left_values, n, (double *) b->buffers[(*buffer_index)++]);
+	}
+	if (batch_eval(b, e->right, n, buffer_index, &right_type, &right_values) || *buffer_index >= b->buffer_num)
+		return OPH_QUERY_ENGINE_EXEC_ERROR;
+	r = batch_double(right_type, right_values, n, (double *) b->buffers[(*buffer_index)++]);
+
+	double *dres = (double *) res;
+	long long *lres = (long long *) res;
+	switch (e->type) {
+		case eMULTIPLY:
+			for (i = 0; i < n; i++)
+				dres[i] = l[i] * r[i];
+			break;
+		case ePLUS:
+			for (i = 0; i < n; i++)
+				dres[i] = l[i] + r[i];
+			break;
+		case eMINUS:
+			for (i = 0; i < n; i++)
+				dres[i] = l[i] - r[i];
+			break;
+		case eNEG:
+			for (i = 0; i < n; i++)
+				dres[i] = -r[i];
+			break;
+		case eEQUAL:
+			for (i = 0; i < n; i++)
+				lres[i] = (long long) (l[i] == r[i]);
+			break;
+		case eMOD:
+			for (i = 0; i < n; i++)
+				lres[i] = ((int) l[i] % (int) r[i]);
+			break;
+		case eAND:
+			for (i = 0; i < n; i++)
+				lres[i] = (long long) l[i] && r[i];
+			break;
+		case eOR:
+			for (i = 0; i < n; i++)
+				lres[i] = (long long) (l[i] || r[i]);
+			break;
+		case eNOT:
+			for (i = 0; i < n; i++)
+				lres[i] = (long long) !r[i];
+			break;
+		default:
+			return OPH_QUERY_ENGINE_EXEC_ERROR;
+	}
+	*type = (e->type == eMULTIPLY || e->type == ePLUS || e->type == eMINUS || e->type == eNEG) ? OPH_QUERY_EXPR_TYPE_DOUBLE : OPH_QUERY_EXPR_TYPE_LONG;
+	*values = res;
+
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
+int oph_query_expr_create_batch(oph_query_expr_node * e, oph_query_expr_record ** var_slots, oph_query_expr_value_type * var_types, int var_count, oph_query_expr_batch ** batch)
+{
+	if (e == NULL || batch == NULL || (var_count > 0 && (var_slots == NULL || var_types == NULL))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+	*batch = NULL;
+
+	int k;
+	for (k = 0; k < var_count; k++)
+		if (var_types[k] != OPH_QUERY_EXPR_TYPE_LONG && var_types[k] != OPH_QUERY_EXPR_TYPE_DOUBLE)
+			return OPH_QUERY_ENGINE_EXEC_ERROR;
+
+	oph_query_expr_batch b;
+	b.e = e;
+	b.var_count = var_count;
+	b.var_slots = var_slots;
+	b.var_types = var_types;
+	b.buffer_num = 0;
+
+	oph_query_expr_value_type type;
+	if (batch_check(&b, e, &b.buffer_num, &type))
+		return OPH_QUERY_ENGINE_EXEC_ERROR;
+
+	oph_query_expr_batch *tmp = (oph_query_expr_batch *) calloc(1, sizeof(oph_query_expr_batch));
+	if (tmp == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_QUERY_ENGINE_MEMORY_ERROR;
+	}
+	tmp->e = e;
+	tmp->var_count = var_count;
+	tmp->buffer_num = b.buffer_num;
+	tmp->var_slots = (oph_query_expr_record **) malloc((var_count ? var_count : 1) * sizeof(oph_query_expr_record *));
+	tmp->var_types = (oph_query_expr_value_type *) malloc((var_count ? var_count : 1) * sizeof(oph_query_expr_value_type));
+	tmp->var_values = (void **) calloc(var_count ? var_count : 1, sizeof(void *));
+	tmp->buffers = (void **) calloc(b.buffer_num ? b.buffer_num : 1, sizeof(void *));
+	if (tmp->var_slots == NULL || tmp->var_types == NULL || tmp->var_values == NULL || tmp->buffers == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+		oph_query_expr_destroy_batch(tmp);
+		return OPH_QUERY_ENGINE_MEMORY_ERROR;
+	}
+	//long long and double values have the same size
+	for (k = 0; k < var_count; k++) {
+		tmp->var_slots[k] = var_slots[k];
+		tmp->var_types[k] = var_types[k];
+		if ((tmp->var_values[k] = malloc(OPH_QUERY_EXPR_BATCH_SIZE * sizeof(double))) == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+			oph_query_expr_destroy_batch(tmp);
+			return OPH_QUERY_ENGINE_MEMORY_ERROR;
+		}
+	}
+	for (k = 0; k < b.buffer_num; k++) {
+		if ((tmp->buffers[k] = malloc(OPH_QUERY_EXPR_BATCH_SIZE * sizeof(double))) == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
+			oph_query_expr_destroy_batch(tmp);
+			return OPH_QUERY_ENGINE_MEMORY_ERROR;
+		}
+	}
+
+	*batch = tmp;
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
+int oph_query_expr_eval_batch(oph_query_expr_batch * batch, int n, oph_query_expr_value_type * type, void **values)
+{
+	if (batch == NULL || type == NULL || values == NULL || n < 0 || n > OPH_QUERY_EXPR_BATCH_SIZE) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+
+	int buffer_index = 0;
+	if (batch_eval(batch, batch->e, n, &buffer_index, type, values)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_EVAL_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_EVAL_ERROR);
+		return OPH_QUERY_ENGINE_EXEC_ERROR;
+	}
+
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
+int oph_query_expr_destroy_batch(oph_query_expr_batch * batch)
+{
+	if (batch == NULL)
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+
+	int k;
+	if (batch->var_values) {
+		for (k = 0; k < batch->var_count; k++)
+			free(batch->var_values[k]);
+		free(batch->var_values);
+	}
+	if (batch->buffers) {
+		for (k = 0; k < batch->buffer_num; k++)
+			free(batch->buffers[k]);
+		free(batch->buffers);
+	}
+	free(batch->var_slots);
+	free(batch->var_types);
+	free(batch);
+
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
 
 int oph_query_expr_eval_expression(oph_query_expr_node * e, oph_query_expr_value ** res, oph_query_expr_symtable * table)
 {
@@ -881,22 +1607,19 @@ int oph_query_expr_eval_expression(oph_query_expr_node * e, oph_query_expr_value
 	}
 
 	oph_query_expr_value *result = (oph_query_expr_value *) malloc(sizeof(oph_query_expr_value));
-	int *er = (int *) malloc(sizeof(int));
-	if (er == NULL) {
+	if (result == NULL) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_MEMORY_ALLOC_ERROR);
 		return OPH_QUERY_ENGINE_MEMORY_ERROR;
 	}
-	*er = 0;
+	int er = 0;
 
 	if (e != NULL) {
-		*result = evaluate(e, er, table);
-		if (*er != -1) {
+		*result = evaluate(e, &er, table);
+		if (er != -1) {
 			(*res) = result;
-			free(er);
 			return OPH_QUERY_ENGINE_SUCCESS;
 		} else {
-			free(er);
 			free(result);
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_EVAL_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_EVAL_ERROR);
@@ -904,7 +1627,6 @@ int oph_query_expr_eval_expression(oph_query_expr_node * e, oph_query_expr_value
 		}
 
 	} else {
-		free(er);
 		free(result);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_EVAL_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_EVAL_ERROR);
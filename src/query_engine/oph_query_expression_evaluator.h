@@ -111,6 +111,7 @@ typedef struct _oph_query_expr_udf_descriptor {
 * \parm  fun_type  	function type: 0 for constant parameters; 1 otherwise; (only with type 2)
 * \param numArgs	Number of function arguments (only with type 2)
 * \param function	Pointer to function (only with type 2)
+* \param batch_function	Pointer to batch version of function, working on arrays of long values (only with type 2, can be NULL)
 */
 typedef struct _oph_query_expr_record {
 	char *name;
@@ -123,6 +124,7 @@ typedef struct _oph_query_expr_record {
 	 oph_query_expr_value(*function) (oph_query_expr_value *, int, char *, oph_query_expr_udf_descriptor *, int, int *);
 	int fun_type;
 	int numArgs;
+	void (*batch_function) (long long **, int, int, long long *);
 } oph_query_expr_record;
 
 /**		
@@ -203,6 +205,30 @@ int oph_query_expr_add_string(const char *name, char *value, oph_query_expr_symt
  */
 int oph_query_expr_add_binary(const char *name, oph_query_arg * value, oph_query_expr_symtable * table);
 
+/**
+ * \brief               Set the value of a variable record, bound by oph_query_expr_compile, to a OPH_QUERY_EXPR_TYPE_LONG
+ * \param record        The reference to the variable record
+ * \param value         The long_value of the variable
+ * \return              0 if succesfull; non-0 otherwise
+ */
+int oph_query_expr_set_long(oph_query_expr_record * record, long long value);
+
+/**
+ * \brief               Set the value of a variable record, bound by oph_query_expr_compile, to a OPH_QUERY_EXPR_TYPE_DOUBLE
+ * \param record        The reference to the variable record
+ * \param value         The double_value of the variable
+ * \return              0 if succesfull; non-0 otherwise
+ */
+int oph_query_expr_set_double(oph_query_expr_record * record, double value);
+
+/**
+ * \brief               Set the value of a variable record, bound by oph_query_expr_compile, to a OPH_QUERY_EXPR_TYPE_BINARY
+ * \param record        The reference to the variable record
+ * \param value         A pointer to the binary_value of the variable
+ * \return              0 if succesfull; non-0 otherwise
+ */
+int oph_query_expr_set_binary(oph_query_expr_record * record, oph_query_arg * value);
+
 /**
  * \brief               add a new function to the table (NOTE: doesn't updates old values the same way add_variable does)
  * \param name          The name of the function to be added
@@ -217,6 +243,15 @@ int oph_query_expr_add_function(const char *name, int fun_type, int numArgs, oph
 
 
 
+/**
+ * \brief               set the batch version of a function already in the table, used by oph_query_expr_eval_batch
+ * \param name          The name of the function
+ * \param batch_function A reference to an implementation of the function working on arrays of long values
+ * \param symtable      A reference to the target symtable
+ * \return              0 if succesfull; non-0 otherwise
+ */
+int oph_query_expr_add_batch_function(const char *name, void (*batch_function) (long long **, int, int, long long *), oph_query_expr_symtable * symtable);
+
 //---------- 2
 
 /**
@@ -248,6 +283,7 @@ typedef enum _oph_query_expr_node_type {
 * \param value		node value; valid only when type is eVALUE	
 * \param descriptor	descriptor of udf; valid only when the type is eFUN	
 * \param name		node name; valid only when type is eVAR e eFUN		
+* \param record		symtable record bound by oph_query_expr_compile; valid only when type is eVAR e eFUN (NULL if not compiled)
 */
 typedef struct _oph_query_expr_node {
 	oph_query_expr_node_type type;
@@ -258,6 +294,7 @@ typedef struct _oph_query_expr_node {
 
 	oph_query_expr_udf_descriptor descriptor;
 	char *name;
+	oph_query_expr_record *record;
 } oph_query_expr_node;
 
 /**
@@ -383,6 +420,50 @@ oph_query_arg *get_binary_value(oph_query_expr_value value, int *er, const char
 */
 int oph_query_expr_get_ast(const char *expr, oph_query_expr_node ** e);
 
+/**
+* \brief               Creates a deep copy of an AST that has not been compiled yet (symtable bindings and function descriptors are not copied)
+* \param e             The root node of the tree to be copied
+* \param copy          A reference to the pointer that will point to the copy
+* \return              Returns 0 if operation was successfull; non-0 if otherwise;
+*/
+int oph_query_expr_copy_ast(oph_query_expr_node * e, oph_query_expr_node ** copy);
+
+/**
+ * \brief               Compiles an AST to be evaluated several times with the same symtable: variables and functions are bound to their symtable records,
+ *                      arguments numbers are checked and operations on numeric constants are folded. Variables not yet in the symtable are added as NULL.
+ * \param e             A reference to the AST to compile
+ * \param table         A reference to the symtable to use during evaluation
+ * \param var_list      The list of variables of the AST (can be NULL if var_count is 0)
+ * \param var_count     The number of variables in var_list
+ * \param var_slots     Array filled with the records of the variables in var_list, to be set with oph_query_expr_set_* (can be NULL if var_count is 0)
+ * \return              Returns 0 if operation was successfull; non-0 if otherwise;
+ */
+int oph_query_expr_compile(oph_query_expr_node * e, oph_query_expr_symtable * table, char **var_list, int var_count, oph_query_expr_record ** var_slots);
+
+/**
+ * \brief               Checks if an AST contains aggregating plugins, i.e. if its rows cannot be evaluated independently
+ * \param e             A reference to the AST
+ * \param has_aggregate Flag set to 1 if an aggregating plugin is found
+ * \return              Returns 0 if operation was successfull; non-0 if otherwise;
+ */
+int oph_query_expr_has_aggregate(oph_query_expr_node * e, char *has_aggregate);
+
+//Number of rows represented by each word of the bitmaps filled by oph_query_expr_select_ids
+#define OPH_QUERY_EXPR_BITMAP_BITS 64
+
+/**
+ * \brief               Selects the rows matching an AST on sequential ids without evaluating it row by row. Supported ASTs are AND, OR and NOT
+ *                      combinations of integer constants, equalities between ids and constants and oph_is_in_subset calls on an id with constant arguments
+ * \param e             A reference to the AST, compiled with oph_query_expr_compile
+ * \param id_slots      Records of the variables that are ids, as returned by oph_query_expr_compile
+ * \param id_num        Number of id variables
+ * \param first_id      Id of the first row (row i has id first_id + i for each id variable)
+ * \param row_num       Number of rows
+ * \param bitmap        Array of (row_num + OPH_QUERY_EXPR_BITMAP_BITS - 1) / OPH_QUERY_EXPR_BITMAP_BITS words, filled with a bit set for each selected row
+ * \return              Returns 0 if operation was successfull; OPH_QUERY_ENGINE_EXEC_ERROR if the AST has to be evaluated by rows; other non-0 in case of error
+ */
+int oph_query_expr_select_ids(oph_query_expr_node * e, oph_query_expr_record ** id_slots, int id_num, long long first_id, long long row_num, unsigned long long *bitmap);
+
 /**
  * \brief               Evaluates the value of the AST based on the content of a symtable 
  * \param e             A reference to the AST to evaluate
@@ -392,6 +473,57 @@ int oph_query_expr_get_ast(const char *expr, oph_query_expr_node ** e);
  */
 int oph_query_expr_eval_expression(oph_query_expr_node * e, oph_query_expr_value ** res, oph_query_expr_symtable * table);
 
+//Number of rows evaluated by oph_query_expr_eval_batch at once
+#define OPH_QUERY_EXPR_BATCH_SIZE 1024
+
+/**
+* \brief              Structure used to evaluate an expression on blocks of rows
+* \param e            AST to be evaluated, compiled with oph_query_expr_compile
+* \param var_count    Number of variables
+* \param var_slots    Records of the variables, as returned by oph_query_expr_compile
+* \param var_types    Types of the variables (OPH_QUERY_EXPR_TYPE_LONG or OPH_QUERY_EXPR_TYPE_DOUBLE)
+* \param var_values   Arrays of OPH_QUERY_EXPR_BATCH_SIZE values (long long or double, depending on var_types) to be filled with the rows before each evaluation
+* \param buffer_num   Number of buffers
+* \param buffers      Arrays of OPH_QUERY_EXPR_BATCH_SIZE values used for intermediate results
+*/
+typedef struct _oph_query_expr_batch {
+	oph_query_expr_node *e;
+	int var_count;
+	oph_query_expr_record **var_slots;
+	oph_query_expr_value_type *var_types;
+	void **var_values;
+	int buffer_num;
+	void **buffers;
+} oph_query_expr_batch;
+
+/**
+ * \brief               Prepares the evaluation on blocks of rows of an AST made up of numeric constants, numeric variables, operations and built-in functions
+ * \param e             A reference to the AST, compiled with oph_query_expr_compile
+ * \param var_slots     Records of the variables returned by oph_query_expr_compile
+ * \param var_types     Types of the variables
+ * \param var_count     Number of variables
+ * \param batch         A reference to the pointer that will point to the created structure
+ * \return              Returns 0 if operation was successfull; OPH_QUERY_ENGINE_EXEC_ERROR if the AST has to be evaluated by rows; other non-0 in case of error
+ */
+int oph_query_expr_create_batch(oph_query_expr_node * e, oph_query_expr_record ** var_slots, oph_query_expr_value_type * var_types, int var_count, oph_query_expr_batch ** batch);
+
+/**
+ * \brief               Evaluates an AST on a block of rows, whose values are in batch->var_values
+ * \param batch         A reference to the structure created by oph_query_expr_create_batch
+ * \param n             Number of rows (at most OPH_QUERY_EXPR_BATCH_SIZE)
+ * \param type          Type of results (OPH_QUERY_EXPR_TYPE_LONG or OPH_QUERY_EXPR_TYPE_DOUBLE)
+ * \param values        Pointer to an array of n results (long long or double, depending on type), valid until next evaluation
+ * \return              Returns 0 if operation was successfull; non-0 if otherwise;
+ */
+int oph_query_expr_eval_batch(oph_query_expr_batch * batch, int n, oph_query_expr_value_type * type, void **values);
+
+/**
+ * \brief               Frees the resources of a batch structure
+ * \param batch         A reference to the structure to be freed
+ * \return              Returns 0 if operation was successfull; non-0 if otherwise;
+ */
+int oph_query_expr_destroy_batch(oph_query_expr_batch * batch);
+
 /**
  * \brief               Set the value of all the functions clear flag to 1 
  * \param e             A reference to the AST to evaluate
@@ -47,6 +47,16 @@ oph_query_expr_value oph_id(oph_query_expr_value * args, int num_args, char *nam
 	return res;
 }
 
+void oph_id_batch(long long **args, int num_args, int n, long long *res)
+{
+	UNUSED(num_args);
+
+	long long *id = args[0], *size = args[1];
+	int i;
+	for (i = 0; i < n; i++)
+		res[i] = 1 + floor((id[i] - 1) / (size[i]));
+}
+
 oph_query_expr_value oph_id2(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er)
 {
 	UNUSED(num_args);
@@ -68,6 +78,16 @@ oph_query_expr_value oph_id2(oph_query_expr_value * args, int num_args, char *na
 	return res;
 }
 
+void oph_id2_batch(long long **args, int num_args, int n, long long *res)
+{
+	UNUSED(num_args);
+
+	long long *id = args[0], *size = args[1], *block_size = args[2];
+	int i;
+	for (i = 0; i < n; i++)
+		res[i] = 1 + (id[i] - 1 % block_size[i]) + (floor((id[i] - 1) / (size[i] * block_size[i]))) * block_size[i];
+}
+
 oph_query_expr_value oph_id3(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er)
 {
 	UNUSED(num_args);
@@ -155,6 +175,26 @@ oph_query_expr_value oph_id_to_index(oph_query_expr_value * args, int num_args,
 	return res;
 }
 
+void oph_id_to_index_batch(long long **args, int num_args, int n, long long *res)
+{
+	long long id, index, size;
+	int i, counter;
+	for (i = 0; i < n; i++) {
+		id = args[0][i] - 1;
+		if (id < 0) {
+			res[i] = -1;
+			continue;
+		}
+		index = id;
+		for (counter = 1; counter < num_args; counter++) {
+			size = args[counter][i];
+			index = (id % size);
+			id = (id - index) / size;
+		}
+		res[i] = index + 1;
+	}
+}
+
 oph_query_expr_value oph_id_to_index2(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er)
 {
 	UNUSED(num_args);
@@ -176,6 +216,16 @@ oph_query_expr_value oph_id_to_index2(oph_query_expr_value * args, int num_args,
 	return res;
 }
 
+void oph_id_to_index2_batch(long long **args, int num_args, int n, long long *res)
+{
+	UNUSED(num_args);
+
+	long long *id = args[0], *block_size = args[1], *size = args[2];
+	int i;
+	for (i = 0; i < n; i++)
+		res[i] = 1 + ((long long) floor((id[i] - 1) / block_size[i]) % size[i]);
+}
+
 oph_query_expr_value oph_is_in_subset(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er)
 {
 	UNUSED(num_args);
@@ -199,6 +249,16 @@ oph_query_expr_value oph_is_in_subset(oph_query_expr_value * args, int num_args,
 	return res;
 }
 
+void oph_is_in_subset_batch(long long **args, int num_args, int n, long long *res)
+{
+	UNUSED(num_args);
+
+	long long *id = args[0], *start = args[1], *step = args[2], *size = args[3];
+	int i;
+	for (i = 0; i < n; i++)
+		res[i] = !((id[i] - start[i]) % step[i]) && (id[i] >= start[i]) && (id[i] <= size[i]);
+}
+
 oph_query_expr_value oph_query_generic_long(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er)
 {
 	oph_query_expr_value res;
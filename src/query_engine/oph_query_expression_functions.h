@@ -34,6 +34,15 @@
  */
 oph_query_expr_value oph_id(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er);
 
+/**
+ * \brief               Batch version of oph_id, used by oph_query_expr_eval_batch
+ * \param args          A 2 element array of arrays of n values (args[0]=id, args[1]=size)
+ * \param num_args      Number of arguments
+ * \param n             Number of rows
+ * \param res           Array of n results
+ */
+void oph_id_batch(long long **args, int num_args, int n, long long *res);
+
 /**
  * \brief               One of the functions that can apper in the parsed query
  * \param args          A 3 element array (args[0]=id, args[1]=size, args[2]=block_size)
@@ -45,6 +54,15 @@ oph_query_expr_value oph_id(oph_query_expr_value * args, int num_args, char *nam
  */
 oph_query_expr_value oph_id2(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er);
 
+/**
+ * \brief               Batch version of oph_id2, used by oph_query_expr_eval_batch
+ * \param args          A 3 element array of arrays of n values (args[0]=id, args[1]=size, args[2]=block_size)
+ * \param num_args      Number of arguments
+ * \param n             Number of rows
+ * \param res           Array of n results
+ */
+void oph_id2_batch(long long **args, int num_args, int n, long long *res);
+
 /**
  * \brief               One of the functions that can apper in the parsed query
  * \param args          A 3 element array (args[0]=id, args[1]=list, args[2]=block_size)
@@ -67,6 +85,15 @@ oph_query_expr_value oph_id3(oph_query_expr_value * args, int num_args, char *na
  */
 oph_query_expr_value oph_id_to_index(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er);
 
+/**
+ * \brief               Batch version of oph_id_to_index, used by oph_query_expr_eval_batch
+ * \param args          An array of at least 2 arrays of n values (args[0]=id,args[1]=size,...)
+ * \param num_args      Number of arguments
+ * \param n             Number of rows
+ * \param res           Array of n results
+ */
+void oph_id_to_index_batch(long long **args, int num_args, int n, long long *res);
+
 /**
  * \brief               One of the functions that can apper in the parsed query
  * \param args          A 3 element array (args[0]=id, args[1]=block_size, args[2]=size)
@@ -78,6 +105,15 @@ oph_query_expr_value oph_id_to_index(oph_query_expr_value * args, int num_args,
  */
 oph_query_expr_value oph_id_to_index2(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er);
 
+/**
+ * \brief               Batch version of oph_id_to_index2, used by oph_query_expr_eval_batch
+ * \param args          A 3 element array of arrays of n values (args[0]=id, args[1]=block_size, args[2]=size)
+ * \param num_args      Number of arguments
+ * \param n             Number of rows
+ * \param res           Array of n results
+ */
+void oph_id_to_index2_batch(long long **args, int num_args, int n, long long *res);
+
 /**
  * \brief               One of the functions that can apper in the parsed query
  * \param args          A 4 element array (args[0]=id, args[1]=start, args[2]=step, args[3]=size)
@@ -89,6 +125,15 @@ oph_query_expr_value oph_id_to_index2(oph_query_expr_value * args, int num_args,
  */
 oph_query_expr_value oph_is_in_subset(oph_query_expr_value * args, int num_args, char *name, oph_query_expr_udf_descriptor * descriptor, int destroy, int *er);
 
+/**
+ * \brief               Batch version of oph_is_in_subset, used by oph_query_expr_eval_batch
+ * \param args          A 4 element array of arrays of n values (args[0]=id, args[1]=start, args[2]=step, args[3]=size)
+ * \param num_args      Number of arguments
+ * \param n             Number of rows
+ * \param res           Array of n results
+ */
+void oph_is_in_subset_batch(long long **args, int num_args, int n, long long *res);
+
 /**
  * \brief               A function that handles the invocation of primitives that return double
  * \param args          An array of variable length containing the arguments of the funtion
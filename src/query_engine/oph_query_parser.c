@@ -278,9 +278,10 @@ int _oph_query_check_query_params(HASHTBL * hashtbl)
 	}
 
 	char *tmp = hashtbl_get(hashtbl, OPH_QUERY_ENGINE_LANG_ARG_ORDER_DIR);
-	if (tmp && strcasecmp(tmp, "ASC")) {
-		pmesg(LOG_WARNING, __FILE__, __LINE__, "Keyword '%s' skipped.\n", OPH_QUERY_ENGINE_LANG_ARG_ORDER_DIR);
-		logging(LOG_WARNING, __FILE__, __LINE__, "Keyword '%s' skipped.\n", OPH_QUERY_ENGINE_LANG_ARG_ORDER_DIR);
+	if (tmp && strcasecmp(tmp, OPH_QUERY_ENGINE_LANG_VAL_ASC) && strcasecmp(tmp, OPH_QUERY_ENGINE_LANG_VAL_DESC)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Query not valid: value '%s' not supported for keyword '%s'.\n", tmp, OPH_QUERY_ENGINE_LANG_ARG_ORDER_DIR);
+		logging(LOG_ERROR, __FILE__, __LINE__, "Query not valid: value '%s' not supported for keyword '%s'.\n", tmp, OPH_QUERY_ENGINE_LANG_ARG_ORDER_DIR);
+		return OPH_QUERY_ENGINE_PARSE_ERROR;
 	}
 
 	return OPH_QUERY_ENGINE_SUCCESS;
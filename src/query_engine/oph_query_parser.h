@@ -77,6 +77,13 @@ int _oph_query_parser_validate_query(const char *query_string);
  */
 int _oph_query_parser_load_query_params(const char *query_string, HASHTBL * hashtbl);
 
+/**
+ * \brief               Function to check that keywords and values loaded into hash table are supported
+ * \param hashtbl       Hash table to be checked
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _oph_query_check_query_params(HASHTBL * hashtbl);
+
 /**
  * \brief               Function used to parse query string and load all arguments into hash table 
  * \param query_string  Submission query to load
@@ -42,7 +42,6 @@ typedef bool my_bool;
 #endif
 
 extern int msglevel;
-extern pthread_mutex_t libtool_lock;
 //TODO Restore OpenMP code
 extern unsigned long long omp_threads;
 extern HASHTBL *plugin_table;
@@ -191,10 +190,6 @@ int oph_query_plugin_deinit(oph_plugin_api * function, void *dlh, UDF_INIT * ini
 	//Deinitialize function
 	void (*_oph_plugin_deinit) (UDF_INIT *);
 	if (!(_oph_plugin_deinit = (void (*)(UDF_INIT *)) function->deinit_api)) {
-		pthread_mutex_lock(&libtool_lock);
-		lt_dlclose(dlh);
-		lt_dlexit();
-		pthread_mutex_unlock(&libtool_lock);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while calling plugin DEINIT function\n");
 		return -1;
 	}
@@ -205,27 +200,21 @@ int oph_query_plugin_deinit(oph_plugin_api * function, void *dlh, UDF_INIT * ini
 	free_udf_arg(internal_args);
 	free(internal_args);
 
-	//Release functions
-#ifndef OPH_WITH_VALGRIND
-	//Close dynamic loaded library
-	pthread_mutex_lock(&libtool_lock);
-	if ((lt_dlclose(dlh))) {
-		lt_dlexit();
-		pthread_mutex_unlock(&libtool_lock);
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while closing plugin library\n");
+	//Plugin library is closed by oph_unload_plugins
+
+	return 0;
+}
+
+int oph_query_plugin_is_aggregate(char *plugin_name, char *is_aggregate)
+{
+	if (!plugin_name || !plugin_table || !is_aggregate)
 		return -1;
-	}
-	pthread_mutex_unlock(&libtool_lock);
-	dlh = NULL;
 
-	pthread_mutex_lock(&libtool_lock);
-	if (lt_dlexit()) {
-		pthread_mutex_unlock(&libtool_lock);
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while closing plugin library\n");
+	oph_plugin *plugin = (oph_plugin *) hashtbl_get(plugin_table, plugin_name);
+	if (!plugin)
 		return -1;
-	}
-	pthread_mutex_unlock(&libtool_lock);
-#endif
+
+	*is_aggregate = (plugin->plugin_type == OPH_AGGREGATE_PLUGIN_TYPE);
 
 	return 0;
 }
@@ -235,51 +224,17 @@ int oph_query_plugin_init(oph_plugin_api * function, void **dlh, UDF_INIT ** ini
 	if (!function || !dlh || !initid || !internal_args || !plugin_name || !arg_count || !args || !plugin_table || !is_aggregate)
 		return -1;
 
-	//Load plugin shared library
+	//Plugin library and symbols are loaded once by oph_load_plugins
 	oph_plugin *plugin = (oph_plugin *) hashtbl_get(plugin_table, plugin_name);
 	if (!plugin) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Plugin not allowed\n");
 		return -1;
 	}
-	//Load all functions
-	char plugin_init_name[BUFLEN], plugin_deinit_name[BUFLEN], plugin_clear_name[BUFLEN], plugin_add_name[BUFLEN], plugin_reset_name[BUFLEN];
-	snprintf(plugin_init_name, BUFLEN, "%s_init", plugin->plugin_name);
-	snprintf(plugin_deinit_name, BUFLEN, "%s_deinit", plugin->plugin_name);
-	snprintf(plugin_clear_name, BUFLEN, "%s_clear", plugin->plugin_name);
-	snprintf(plugin_add_name, BUFLEN, "%s_add", plugin->plugin_name);
-	snprintf(plugin_reset_name, BUFLEN, "%s_reset", plugin->plugin_name);
-	*dlh = NULL;
-
-	//Initialize libltdl
-	pthread_mutex_lock(&libtool_lock);
-	lt_dlinit();
-	pthread_mutex_unlock(&libtool_lock);
-
-	pthread_mutex_lock(&libtool_lock);
-	//Load library
-	if (!(*dlh = (lt_dlhandle) lt_dlopen(plugin->plugin_library))) {
-		lt_dlclose(*dlh);
-		lt_dlexit();
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while loading plugin dynamic library: %s\n", lt_dlerror());
-		pthread_mutex_unlock(&libtool_lock);
+	if (!(*dlh = plugin->dlh)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while loading plugin dynamic library of %s\n", plugin_name);
 		return -1;
 	}
-	pthread_mutex_unlock(&libtool_lock);
-
-	//Load all library symbols
-	pthread_mutex_lock(&libtool_lock);
-	function->init_api = lt_dlsym(*dlh, plugin_init_name);
-	function->clear_api = NULL;
-	function->reset_api = NULL;
-	function->add_api = NULL;
-	function->exec_api = lt_dlsym(*dlh, plugin->plugin_name);
-	function->deinit_api = lt_dlsym(*dlh, plugin_deinit_name);
-	if ((plugin->plugin_type == OPH_AGGREGATE_PLUGIN_TYPE)) {
-		function->clear_api = lt_dlsym(*dlh, plugin_clear_name);
-		function->reset_api = lt_dlsym(*dlh, plugin_reset_name);
-		function->add_api = lt_dlsym(*dlh, plugin_add_name);
-	}
-	pthread_mutex_unlock(&libtool_lock);
+	*function = plugin->function;
 
 	*is_aggregate = (plugin->plugin_type == OPH_AGGREGATE_PLUGIN_TYPE);
 
@@ -86,6 +86,14 @@ int oph_query_plugin_deinit(oph_plugin_api * function, void *dlh, UDF_INIT * ini
  */
 int oph_query_plugin_init(oph_plugin_api * function, void **dlh, UDF_INIT ** initid, UDF_ARGS ** internal_args, char *plugin_name, int arg_count, oph_query_expr_value * args, char *is_aggregate);
 
+/**
+ * \brief               Function to check if a plugin is aggregating, without initializing it
+ * \param plugin_name   Name of plugin
+ * \param is_aggregate  Flag set to 1 if plugin is aggregating
+ * \return              0 if successfull, non-0 otherwise (e.g. for built-in functions)
+ */
+int oph_query_plugin_is_aggregate(char *plugin_name, char *is_aggregate);
+
 
 /**
  * \brief               Function to run plugin ADD function 
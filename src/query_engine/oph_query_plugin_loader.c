@@ -30,11 +30,16 @@
 #include <hashtbl.h>
 
 #include <errno.h>
+#include <ltdl.h>
+#include <pthread.h>
 
 #include "oph_server_utility.h"
 #include "oph_server_confs.h"
 
+#define BUFLEN 1024
+
 extern int msglevel;
+extern pthread_mutex_t libtool_lock;
 
 //Setup oph_plugin with default values
 int oph_init_plugin(oph_plugin * plugin)
@@ -49,6 +54,8 @@ int oph_init_plugin(oph_plugin * plugin)
 	plugin->plugin_library = NULL;
 	plugin->plugin_type = OPH_SIMPLE_PLUGIN_TYPE;
 	plugin->plugin_return = OPH_IOSTORE_STRING_TYPE;
+	plugin->dlh = NULL;
+	memset(&(plugin->function), 0, sizeof(oph_plugin_api));
 
 	return OPH_QUERY_ENGINE_SUCCESS;
 }
@@ -66,6 +73,53 @@ int oph_free_plugin(oph_plugin * plugin)
 	if (plugin->plugin_library)
 		free(plugin->plugin_library);
 
+#ifndef OPH_WITH_VALGRIND
+	//Close dynamic loaded library
+	if (plugin->dlh) {
+		pthread_mutex_lock(&libtool_lock);
+		lt_dlclose((lt_dlhandle) plugin->dlh);
+		pthread_mutex_unlock(&libtool_lock);
+	}
+#endif
+	plugin->dlh = NULL;
+
+	return OPH_QUERY_ENGINE_SUCCESS;
+}
+
+int oph_open_plugin(oph_plugin * plugin)
+{
+	if (!plugin || !plugin->plugin_name || !plugin->plugin_library) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_NULL_INPUT_PARAM);
+		return OPH_QUERY_ENGINE_NULL_PARAM;
+	}
+
+	char plugin_init_name[BUFLEN], plugin_deinit_name[BUFLEN], plugin_clear_name[BUFLEN], plugin_add_name[BUFLEN], plugin_reset_name[BUFLEN];
+	snprintf(plugin_init_name, BUFLEN, "%s_init", plugin->plugin_name);
+	snprintf(plugin_deinit_name, BUFLEN, "%s_deinit", plugin->plugin_name);
+	snprintf(plugin_clear_name, BUFLEN, "%s_clear", plugin->plugin_name);
+	snprintf(plugin_add_name, BUFLEN, "%s_add", plugin->plugin_name);
+	snprintf(plugin_reset_name, BUFLEN, "%s_reset", plugin->plugin_name);
+
+	pthread_mutex_lock(&libtool_lock);
+	//Load library
+	if (!(plugin->dlh = (void *) lt_dlopen(plugin->plugin_library))) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_PLUGIN_DLOPEN_ERROR, plugin->plugin_name, lt_dlerror());
+		logging(LOG_WARNING, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_PLUGIN_DLOPEN_ERROR, plugin->plugin_name, lt_dlerror());
+		pthread_mutex_unlock(&libtool_lock);
+		return OPH_QUERY_ENGINE_ERROR;
+	}
+	//Load all library symbols
+	plugin->function.init_api = lt_dlsym((lt_dlhandle) plugin->dlh, plugin_init_name);
+	plugin->function.exec_api = lt_dlsym((lt_dlhandle) plugin->dlh, plugin->plugin_name);
+	plugin->function.deinit_api = lt_dlsym((lt_dlhandle) plugin->dlh, plugin_deinit_name);
+	if (plugin->plugin_type == OPH_AGGREGATE_PLUGIN_TYPE) {
+		plugin->function.clear_api = lt_dlsym((lt_dlhandle) plugin->dlh, plugin_clear_name);
+		plugin->function.reset_api = lt_dlsym((lt_dlhandle) plugin->dlh, plugin_reset_name);
+		plugin->function.add_api = lt_dlsym((lt_dlhandle) plugin->dlh, plugin_add_name);
+	}
+	pthread_mutex_unlock(&libtool_lock);
+
 	return OPH_QUERY_ENGINE_SUCCESS;
 }
 
@@ -128,6 +182,10 @@ int oph_load_plugins(HASHTBL ** plugin_htable, oph_query_expr_symtable ** functi
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_QUERY_ENGINE_LOG_HASHTBL_ERROR);
 		return OPH_QUERY_ENGINE_ERROR;
 	}
+	//Initialize libltdl: it is released by oph_unload_plugins
+	pthread_mutex_lock(&libtool_lock);
+	lt_dlinit();
+	pthread_mutex_unlock(&libtool_lock);
 
 	while (!feof(fp)) {
 		res_string = fgets(line, OPH_PLUGIN_FILE_LINE, fp);
@@ -236,6 +294,8 @@ int oph_load_plugins(HASHTBL ** plugin_htable, oph_query_expr_symtable ** functi
 				}
 			}
 		}
+		//Libraries are opened once: a plugin whose library cannot be loaded fails only when it is used
+		oph_open_plugin(new);
 		hashtbl_insert(*plugin_htable, new->plugin_name, (oph_plugin *) new);
 		//Load function is symtable     
 		//TODO Set number of args in symtable and add string function
@@ -270,6 +330,13 @@ int oph_unload_plugins(HASHTBL ** plugin_htable, oph_query_expr_symtable ** func
 		return OPH_QUERY_ENGINE_NULL_PARAM;
 	}
 
+	if (!*plugin_htable) {
+		if (*function_table)
+			oph_query_expr_destroy_symtable(*function_table);
+		*function_table = NULL;
+		return OPH_QUERY_ENGINE_SUCCESS;
+	}
+
 	hash_size n;
 	oph_plugin *plugin_ptr;
 	struct hashnode_s *node, *oldnode;
@@ -291,6 +358,10 @@ int oph_unload_plugins(HASHTBL ** plugin_htable, oph_query_expr_symtable ** func
 	free((*plugin_htable)->nodes);
 	free(*plugin_htable);
 
+	pthread_mutex_lock(&libtool_lock);
+	lt_dlexit();
+	pthread_mutex_unlock(&libtool_lock);
+
 	*plugin_htable = NULL;
 	oph_query_expr_destroy_symtable(*function_table);
 	*function_table = NULL;
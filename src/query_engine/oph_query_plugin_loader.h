@@ -51,12 +51,16 @@ typedef enum {
  * \param plugin_library Filename with path of plugin
  * \param plugin_type		Type of plugin function (simple or aggragetion)
  * \param plugin_return	Return type of plugin
+ * \param dlh           Libtool handler to plugin library, opened once by oph_load_plugins (NULL if the library cannot be loaded)
+ * \param function      Plugin library symbols resolved by oph_load_plugins
  */
 typedef struct {
 	char *plugin_name;
 	char *plugin_library;
 	oph_plugin_type plugin_type;
 	oph_iostore_field_type plugin_return;
+	void *dlh;
+	oph_plugin_api function;
 } oph_plugin;
 
 /**
@@ -73,6 +77,13 @@ int oph_init_plugin(oph_plugin * plugin);
  */
 int oph_free_plugin(oph_plugin * plugin);
 
+/**
+ * \brief			        Open plugin library and resolve its symbols
+ * \param plugin      Pointer to plugin to be loaded
+ * \return            0 if successfull, non-0 otherwise
+ */
+int oph_open_plugin(oph_plugin * plugin);
+
 /**
  * \brief			        Load plugin list in plugin table
  * \param plugin_htable      Pointer to hash table used to store plugin list
@@ -17,6 +17,10 @@
 */
 
 #include "oph_io_server_thread.h"
+#include "oph_io_server_pool.h"
+#include "oph_io_server_reader.h"
+#include "oph_io_server_plan_cache.h"
+#include "oph_iostorage_memory.h"
 
 #include <signal.h>
 #include <unistd.h>
@@ -26,6 +30,7 @@
 #include "hashtbl.h"
 
 #include "oph_server_confs.h"
+#include "oph_server_utility.h"
 #include "oph_metadb_interface.h"
 #include "oph_network.h"
 #include "oph_query_expression_evaluator.h"
@@ -46,7 +51,10 @@ unsigned short disable_mem_check = 0;
 unsigned long long memory_buffer = 0;
 unsigned short cache_line_size = 0;
 unsigned long long cache_size = 0;
+unsigned short worker_threads = 0;
+unsigned short reader_processes = 0;
 
+//Protects the list of databases in db_table (see oph_metadb_interface.h for fragment locks)
 pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
 pthread_mutex_t libtool_lock = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t nc_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -56,8 +64,8 @@ HASHTBL *plugin_table = NULL;
 oph_query_expr_symtable *oph_function_table = NULL;
 
 //Global only in this files (for garbage collection purpose)
-struct sockaddr *cliaddr;
 HASHTBL *conf_db = NULL;
+char *unix_socket = NULL;
 char *oph_server_conf_file = OPH_SERVER_CONF_FILE_PATH;
 
 int main(int argc, char *argv[])
@@ -68,11 +76,9 @@ int main(int argc, char *argv[])
 	int msglevel = LOG_INFO;
 #endif
 
-	int listenfd, tmpconnfd, *connfd = NULL;
+	int listenfd, unixfd = -1;
 	void release(int);
-	void *server_child(void *);
-	pthread_t tid;
-	socklen_t clilen, addrlen;
+	socklen_t addrlen;
 
 	int ch;
 	unsigned short int instance = 0;
@@ -154,14 +160,20 @@ int main(int argc, char *argv[])
 	char *cache_line = 0;
 	char *cache = 0;
 	char *working_dir = 0;
+	char *workers = 0;
+	char *readers = 0;
+	char *plan_cache = 0;
+	char *memory_budget = 0;
+	char *compression_idle = 0;
 
 	if (oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_DIR, &dir)) {
 		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to get server dir param\n");
 		dir = OPH_IO_SERVER_PREFIX;
 	}
-	//Setup debug and MetaDB directories
+	//Setup debug, MetaDB and device directories
 	set_log_prefix(dir);
 	oph_metadb_set_data_prefix(dir);
+	oph_iostore_set_data_prefix(dir);
 
 	if (oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_HOSTNAME, &hostname))
 		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to get 'hostname' param: using node address\n");
@@ -234,6 +246,29 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_WORKER_THREADS, &workers) && workers)
+		worker_threads = strtol(workers, NULL, 10);
+	if (!worker_threads) {
+		long cpu_num = sysconf(_SC_NPROCESSORS_ONLN);
+		worker_threads = cpu_num > 0 ? (unsigned short) cpu_num : 1;
+		pmesg(LOG_INFO, __FILE__, __LINE__, "Using %d worker threads\n", worker_threads);
+	}
+
+	//By default, each worker can import a file in parallel with the others
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_READER_PROCESSES, &readers) && readers)
+		reader_processes = strtol(readers, NULL, 10);
+	else
+		reader_processes = worker_threads;
+
+	//Caching of parsed queries is disabled by setting size to 0
+	unsigned int plan_cache_size = OPH_IO_SERVER_PLAN_CACHE_DEFAULT_SIZE;
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_PLAN_CACHE_SIZE, &plan_cache) && plan_cache)
+		plan_cache_size = strtol(plan_cache, NULL, 10);
+	if (oph_io_server_plan_cache_init(plan_cache_size)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to setup plan cache: queries and expressions will be parsed at each execution\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to setup plan cache: queries and expressions will be parsed at each execution\n");
+	}
+
 	if (oph_load_plugins(&plugin_table, &oph_function_table)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to load plugin table\n");
 		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to load plugin table\n");
@@ -250,6 +285,29 @@ int main(int argc, char *argv[])
 		oph_server_conf_unload(&conf_db);
 		return -1;
 	}
+	//Startup reader processes before any other thread is created
+	if (oph_io_server_reader_start(reader_processes)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to start reader processes: files will be imported by worker threads\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to start reader processes: files will be imported by worker threads\n");
+		reader_processes = 0;
+	}
+	//Startup loader processes while server memory footprint is small (each reader has its own loader)
+	if (oph_io_server_reader_load_start(reader_processes ? 0 : worker_threads)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to start loader processes\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to start loader processes\n");
+	}
+	//Fragments of transient devices are spilled to disk only if a budget (in MB) is set and compressed only if an idle time (in seconds) is set
+	unsigned long long budget = 0;
+	unsigned int idle_time = 0;
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_MEMORY_BUDGET, &memory_budget) && memory_budget)
+		budget = strtoll(memory_budget, NULL, 10);
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_COMPRESSION_IDLE, &compression_idle) && compression_idle)
+		idle_time = strtol(compression_idle, NULL, 10);
+	if (oph_iostore_memory_init(budget * 1048576, idle_time, dir)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to setup memory manager: fragments will be kept in memory\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to setup memory manager: fragments will be kept in memory\n");
+		oph_iostore_memory_free();
+	}
 	//Startup TCP/IP listening
 	if (oph_net_listen(hostname, port, &addrlen, &listenfd) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while listening TCP socket\n");
@@ -260,15 +318,19 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	cliaddr = (struct sockaddr *) malloc(addrlen);
-	if (cliaddr == NULL) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for client address\n");
-		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for client address\n");
-		oph_unload_plugins(&plugin_table, &oph_function_table);
-		oph_metadb_unload_schema(db_table);
-		oph_server_conf_unload(&conf_db);
-		return -1;
-	}
+	//Startup local listening, used by clients running on the same node
+	if (!oph_server_conf_get_param(conf_db, OPH_SERVER_CONF_UNIX_SOCKET, &unix_socket) && unix_socket && *unix_socket) {
+		if (oph_net_unix_listen(unix_socket, &unixfd) != 0) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while listening local socket\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Error while listening local socket\n");
+			oph_unload_plugins(&plugin_table, &oph_function_table);
+			oph_metadb_unload_schema(db_table);
+			oph_server_conf_unload(&conf_db);
+			return -1;
+		}
+	} else
+		unix_socket = NULL;
+
 	//Signal(SIGPIPE, SIG_IGN);
 	oph_net_signal(SIGINT, release);
 	oph_net_signal(SIGABRT, release);
@@ -287,78 +349,24 @@ int main(int argc, char *argv[])
 #endif
 
 	//Startup client connections
-	for (;;) {
-		clilen = addrlen;
-
-
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a request...\n");
-		logging(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a request...\n");
-
-		if (oph_net_accept(listenfd, cliaddr, &clilen, &tmpconnfd) != 0) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error on connection\n");
-			logging(LOG_ERROR, __FILE__, __LINE__, "Error on connection\n");
-			continue;
-		}
-
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection established on socket %d\n", tmpconnfd);
-		logging(LOG_DEBUG, __FILE__, __LINE__, "Connection established on socket %d\n", tmpconnfd);
-
-		//TODO Manage multiple connections with poll
-
-		connfd = (int *) malloc(sizeof(int));
-		*connfd = tmpconnfd;
-		if (pthread_create(&tid, NULL, &server_child, (void *) connfd) != 0) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error creating thread\n");
-			logging(LOG_ERROR, __FILE__, __LINE__, "Error creating thread\n");
-			continue;
-		}
-		connfd = NULL;
-
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a request...\n");
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a request...\n");
+
+	if (oph_io_server_pool_run(listenfd, unixfd, worker_threads)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while serving client connections\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Error while serving client connections\n");
+	} else {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Server stopped\n");
+		logging(LOG_DEBUG, __FILE__, __LINE__, "Server stopped\n");
 	}
 
 	//Cleanup procedures
-	free(cliaddr);
-	oph_metadb_unload_schema(db_table);
-	oph_server_conf_unload(&conf_db);
-	oph_unload_plugins(&plugin_table, &oph_function_table);
-
-	return 0;
-}
-
-void *server_child(void *arg)
-{
-	void oph_io_server_thread(int, pthread_t);
-
-	if (pthread_detach(pthread_self()) != 0)
-		return (NULL);
-
-	pthread_t tid = pthread_self();
-
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "LAUNCHING THREAD...\n");
-	oph_io_server_thread(*((int *) arg), tid);
-
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Closing the connection...\n");
-	logging(LOG_DEBUG, __FILE__, __LINE__, "Closing the connection...\n");
-
-	if (close(*((int *) arg)) == -1)
-		pmesg(LOG_WARNING, __FILE__, __LINE__, "Error while closing connection!\n");
-
-	free((int *) arg);
-
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection closed\n");
-	logging(LOG_DEBUG, __FILE__, __LINE__, "Connection closed\n");
-
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "CLOSING THREAD...\n");
-	return (NULL);
-}
-
-//Garbage collecition function
-void release(int signo)
-{
-	//Cleanup procedures
-	logging(LOG_DEBUG, __FILE__, __LINE__, "Catched signal %d\n", signo);
-	free(cliaddr);
+	oph_io_server_reader_stop();
+	if (unix_socket)
+		unlink(unix_socket);
 	oph_metadb_unload_schema(db_table);
+	oph_io_server_plan_cache_free();
+	oph_iostore_memory_free();
 	oph_unload_plugins(&plugin_table, &oph_function_table);
 	oph_server_conf_unload(&conf_db);
 
@@ -366,5 +374,12 @@ void release(int signo)
 	esdm_finalize();
 #endif
 
-	exit(0);
+	return 0;
+}
+
+//Garbage collecition function: resources are released by the main thread once the event loop is stopped
+void release(int signo)
+{
+	UNUSED(signo);
+	oph_io_server_pool_stop();
 }
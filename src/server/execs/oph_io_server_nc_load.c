@@ -29,14 +29,24 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <unistd.h>
+#include <poll.h>
 
 #include "oph_server_utility.h"
 #include "oph_io_server_query_manager.h"
+#include "oph_io_server_reader.h"
 #include <netcdf.h>
 
 #define INT_LEN 13
 #define MSG_LEN 4096
 
+#define OPH_NC_LOAD_FREE free(start); free(count); free(sizemax); free(dims_index); free(dims_start)
+
+//Shared memory segment attached by the last request: persistent loaders keep it until a request for another segment is received or they are idle.
+//Since segment identifiers can be recycled, the segment is identified by its creation time too
+static int shm_cached_id = 0;
+static time_t shm_cached_ctime = 0;
+static char *shm_cached_buffer = NULL;
+
 int _oph_ioserver_nc_get_dimension_id(unsigned long residual, unsigned long total, unsigned int *sizemax, size_t ** id, int i, int n)
 {
 	if (i < n - 1) {
@@ -63,28 +73,58 @@ int oph_ioserver_nc_compute_dimension_id(unsigned long ID, unsigned int *sizemax
 	return 0;
 }
 
-int main(int argc, char *argv[])
+char *oph_ioserver_nc_attach(int shm_id)
 {
-#ifdef DEBUG
-	int msglevel = LOG_DEBUG_T;
+	struct shmid_ds shm_stat;
+	if (shmctl(shm_id, IPC_STAT, &shm_stat))
+		memset(&shm_stat, 0, sizeof(struct shmid_ds));
+
+	if (shm_cached_buffer) {
+		//A segment removed by the server is not used anymore, even if it is still attached
+#ifdef SHM_DEST
+		if ((shm_cached_id == shm_id) && (shm_cached_ctime == shm_stat.shm_ctime) && !(shm_stat.shm_perm.mode & SHM_DEST))
 #else
-	int msglevel = LOG_INFO_T;
+		if ((shm_cached_id == shm_id) && (shm_cached_ctime == shm_stat.shm_ctime))
 #endif
+			return shm_cached_buffer;
+		shmdt(shm_cached_buffer);
+		shm_cached_buffer = NULL;
+	}
+	char *buffer = shmat(shm_id, NULL, 0);
+	if (buffer == (char *) -1)
+		return NULL;
+	shm_cached_id = shm_id;
+	shm_cached_ctime = shm_stat.shm_ctime;
+	shm_cached_buffer = buffer;
+	return buffer;
+}
 
-	set_debug_level(msglevel);
-
-	if (argc > 1) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Arguments are not correct\n");
-		return OPH_IO_SERVER_EXEC_ERROR;
+void oph_ioserver_nc_detach()
+{
+	if (shm_cached_buffer) {
+		shmdt(shm_cached_buffer);
+		shm_cached_buffer = NULL;
 	}
-	//Get input values
-	char msg[MSG_LEN] = { '\0' };
-	if (read(STDIN_FILENO, msg, MSG_LEN) == -1) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to get message from master process: %s\n", strerror(errno));
-		return OPH_IO_SERVER_EXEC_ERROR;
+}
+
+int oph_ioserver_nc_transfer(int fd, void *buffer, size_t length, char is_read)
+{
+	char *ptr = (char *) buffer;
+	ssize_t n;
+	while (length) {
+		if ((n = is_read ? read(fd, ptr, length) : write(fd, ptr, length)) <= 0) {
+			if ((n < 0) && (errno == EINTR))
+				continue;
+			return OPH_IO_SERVER_EXEC_ERROR;
+		}
+		ptr += n;
+		length -= n;
 	}
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arguments %s\n", msg);
+	return OPH_IO_SERVER_SUCCESS;
+}
 
+int oph_ioserver_nc_load(char *msg)
+{
 	//Convert string to input values
 	int i = 0;
 	char *ptr = NULL;
@@ -206,6 +246,7 @@ int main(int argc, char *argv[])
 		while (*c3++);
 		if (nexp != n3) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, "Arguments are not correct\n");
+			OPH_NC_LOAD_FREE;
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 		c3 = dims_index_msg;
@@ -217,6 +258,7 @@ int main(int argc, char *argv[])
 		while (*c3++);
 		if (n1 != n3) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, "Arguments are not correct\n");
+			OPH_NC_LOAD_FREE;
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 		c3 = dims_start_msg;
@@ -228,6 +270,7 @@ int main(int argc, char *argv[])
 		while (*c3++);
 		if (n1 != n3) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, "Arguments are not correct\n");
+			OPH_NC_LOAD_FREE;
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 		sizemax = (unsigned int *) malloc(nexp * sizeof(unsigned int));
@@ -252,19 +295,22 @@ int main(int argc, char *argv[])
 	char *buffer = NULL;
 
 	//Attach shared memory segment to process
-	if ((buffer = shmat(shm_id, NULL, 0)) == (char *) -1) {
+	if (!(buffer = oph_ioserver_nc_attach(shm_id))) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to attach shared memory segment\n");
+		OPH_NC_LOAD_FREE;
 		return OPH_IO_SERVER_MEMORY_ERROR;
 	}
 
 	if ((retval = nc_open(src_path, NC_NOWRITE, &ncfile_id))) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to open netcdf file '%s': %s\n", src_path, nc_strerror(retval));
+		OPH_NC_LOAD_FREE;
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
 
 	if ((retval = nc_inq_varid(ncfile_id, measure_name, &varid))) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to read variable information: %s\n", nc_strerror(retval));
 		nc_close(ncfile_id);
+		OPH_NC_LOAD_FREE;
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
 	//Get information from id
@@ -272,6 +318,7 @@ int main(int argc, char *argv[])
 	if ((retval = nc_inq_vartype(ncfile_id, varid, &vartype))) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to read variable information: %s\n", nc_strerror(retval));
 		nc_close(ncfile_id);
+		OPH_NC_LOAD_FREE;
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
 
@@ -342,15 +389,7 @@ int main(int argc, char *argv[])
 
 	nc_close(ncfile_id);
 
-	//Detach shared memory segment
-	shmdt(buffer);
-
-	free(start);
-	free(count);
-	if (tuples > 1) {
-		free(sizemax);
-		free(dims_start);
-	}
+	OPH_NC_LOAD_FREE;
 
 	if (res != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error in binary array filling: %s\n", nc_strerror(res));
@@ -360,3 +399,67 @@ int main(int argc, char *argv[])
 		return OPH_IO_SERVER_SUCCESS;
 	}
 }
+
+int main(int argc, char *argv[])
+{
+#ifdef DEBUG
+	int msglevel = LOG_DEBUG_T;
+#else
+	int msglevel = LOG_INFO_T;
+#endif
+
+	set_debug_level(msglevel);
+
+	char persistent = 0;
+	if (argc > 1) {
+		if ((argc == 2) && !strcmp(argv[1], OPH_IO_SERVER_READER_LOAD_OPTION))
+			persistent = 1;
+		else {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Arguments are not correct\n");
+			return OPH_IO_SERVER_EXEC_ERROR;
+		}
+	}
+	//Get input values
+	char msg[MSG_LEN + 1] = { '\0' };
+	if (!persistent) {
+		if (read(STDIN_FILENO, msg, MSG_LEN) == -1) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to get message from master process: %s\n", strerror(errno));
+			return OPH_IO_SERVER_EXEC_ERROR;
+		}
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arguments %s\n", msg);
+		int res = oph_ioserver_nc_load(msg);
+		oph_ioserver_nc_detach();
+		return res;
+	}
+	//Persistent loader: requests MSG_LEN|MSG are received on stdin and the status code is sent on stdout, until master process closes the socket
+	unsigned int msg_len = 0;
+	int res;
+	struct pollfd pfd;
+	pfd.fd = STDIN_FILENO;
+	pfd.events = POLLIN;
+	for (;;) {
+		if (!(res = poll(&pfd, 1, OPH_IO_SERVER_READER_LOAD_IDLE))) {
+			//Release the segment, so that it can be destroyed as soon as master process removes it
+			oph_ioserver_nc_detach();
+			continue;
+		}
+		if ((res < 0) && (errno == EINTR))
+			continue;
+		if ((res < 0) || oph_ioserver_nc_transfer(STDIN_FILENO, &msg_len, sizeof(unsigned int), 1))
+			break;
+		if (msg_len > MSG_LEN) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Message from master process is too long\n");
+			break;
+		}
+		memset(msg, 0, MSG_LEN + 1);
+		if (oph_ioserver_nc_transfer(STDIN_FILENO, msg, msg_len, 1))
+			break;
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arguments %s\n", msg);
+		res = oph_ioserver_nc_load(msg);
+		if (oph_ioserver_nc_transfer(STDOUT_FILENO, &res, sizeof(int), 0))
+			break;
+	}
+	oph_ioserver_nc_detach();
+
+	return OPH_IO_SERVER_SUCCESS;
+}
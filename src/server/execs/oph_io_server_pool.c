@@ -0,0 +1,587 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "oph_io_server_pool.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include "debug.h"
+
+#include "oph_server_utility.h"
+#include "oph_network.h"
+
+extern int msglevel;
+
+//Global server variables (read-only)
+extern unsigned long long max_packet_length;
+extern unsigned short client_ttl;
+
+/**
+ * \brief			        Structure with the status of the worker pool
+ * \param epfd          Epoll descriptor watching listening sockets and idle connections
+ * \param unixfd        Local listening socket descriptor, -1 if not enabled
+ * \param lock          Mutex protecting connection list and worker queue
+ * \param cond          Condition used to wake up workers
+ * \param conn_list     List of open connections
+ * \param ready_head    First connection in worker queue
+ * \param ready_tail    Last connection in worker queue
+ * \param workers       Worker threads
+ * \param worker_num    Number of worker threads started
+ * \param stop          Flag set to 1 when the server has to be stopped
+ */
+typedef struct {
+	int epfd;
+	int unixfd;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	oph_io_server_connection *conn_list;
+	oph_io_server_connection *ready_head;
+	oph_io_server_connection *ready_tail;
+	pthread_t *workers;
+	unsigned short worker_num;
+	volatile sig_atomic_t stop;
+} oph_io_server_pool;
+
+static oph_io_server_pool pool = { -1, -1, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, NULL, NULL, 0, 0 };
+
+static int _oph_io_server_pool_arm(oph_io_server_connection * conn, int op)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+	ev.data.ptr = (void *) conn;
+
+	if (epoll_ctl(pool.epfd, op, conn->sockfd, &ev)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to watch socket %d: %d\n", conn->sockfd, errno);
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to watch socket %d: %d\n", conn->sockfd, errno);
+		return OPH_IO_SERVER_POOL_ERROR;
+	}
+	return OPH_IO_SERVER_POOL_SUCCESS;
+}
+
+//Release connection resources: the connection has to be already removed from connection list
+static void _oph_io_server_pool_release(oph_io_server_connection * conn)
+{
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Closing the connection on socket %d...\n", conn->sockfd);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Closing the connection on socket %d...\n", conn->sockfd);
+
+	if (conn->sent_stats.frames || conn->received_stats.frames) {
+		pmesg(LOG_INFO, __FILE__, __LINE__, "Compression on socket %d: sent %llu fields (%llu to %llu bytes) in %f sec, received %llu args (%llu to %llu bytes) in %f sec\n", conn->sockfd,
+		      conn->sent_stats.frames, conn->sent_stats.raw_len, conn->sent_stats.packed_len, conn->sent_stats.time, conn->received_stats.frames, conn->received_stats.packed_len,
+		      conn->received_stats.raw_len, conn->received_stats.time);
+		logging(LOG_INFO, __FILE__, __LINE__, "Compression on socket %d: sent %llu fields (%llu to %llu bytes) in %f sec, received %llu args (%llu to %llu bytes) in %f sec\n", conn->sockfd,
+			conn->sent_stats.frames, conn->sent_stats.raw_len, conn->sent_stats.packed_len, conn->sent_stats.time, conn->received_stats.frames, conn->received_stats.packed_len,
+			conn->received_stats.raw_len, conn->received_stats.time);
+	}
+
+	epoll_ctl(pool.epfd, EPOLL_CTL_DEL, conn->sockfd, NULL);
+	if (conn->zerocopy && oph_net_zerocopy_wait(conn->sockfd, &(conn->zerocopy_sends), OPH_IO_SERVER_ZEROCOPY_TIMEOUT)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Zero-copy transmissions on socket %d not completed\n", conn->sockfd);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Zero-copy transmissions on socket %d not completed\n", conn->sockfd);
+	}
+	if (close(conn->sockfd) == -1)
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Error while closing connection!\n");
+	oph_net_zerocopy_destroy(&(conn->zerocopy_sends));
+
+	oph_io_server_free_status(&(conn->status));
+	if (conn->buffer)
+		free(conn->buffer);
+	if (conn->fds) {
+		while (conn->fd_num)
+			close(conn->fds[--conn->fd_num]);
+		free(conn->fds);
+	}
+	free(conn);
+}
+
+static void _oph_io_server_pool_unlink(oph_io_server_connection * conn)
+{
+	oph_io_server_connection **iter = &(pool.conn_list);
+	while (*iter) {
+		if (*iter == conn) {
+			*iter = conn->next;
+			break;
+		}
+		iter = &((*iter)->next);
+	}
+	conn->next = NULL;
+}
+
+static void _oph_io_server_pool_close(oph_io_server_connection * conn)
+{
+	pthread_mutex_lock(&pool.lock);
+	_oph_io_server_pool_unlink(conn);
+	pthread_mutex_unlock(&pool.lock);
+
+	_oph_io_server_pool_release(conn);
+}
+
+//Read available bytes from a local socket, storing the descriptors passed with them
+static ssize_t _oph_io_server_pool_receive_fds(oph_io_server_connection * conn)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char control[CMSG_SPACE(OPH_IO_SERVER_POOL_MAX_FDS * sizeof(int))];
+	unsigned int fd_num = 0, i = 0;
+	int *tmp = NULL;
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = conn->buffer + conn->buffer_len;
+	iov.iov_len = conn->buffer_size - conn->buffer_len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	n = recvmsg(conn->sockfd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (n < 0)
+		return n;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		fd_num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		tmp = (int *) realloc(conn->fds, (conn->fd_num + fd_num) * sizeof(int));
+		if (!tmp) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			for (i = 0; i < fd_num; i++)
+				close(((int *) CMSG_DATA(cmsg))[i]);
+			errno = ENOMEM;
+			return -1;
+		}
+		conn->fds = tmp;
+		memcpy(conn->fds + conn->fd_num, CMSG_DATA(cmsg), fd_num * sizeof(int));
+		conn->fd_num += fd_num;
+	}
+	if (msg.msg_flags & MSG_CTRUNC) {
+		//Some descriptors have been discarded by the kernel, so requests cannot be matched to them
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Too many descriptors received\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Too many descriptors received\n");
+		errno = EPROTO;
+		return -1;
+	}
+
+	return n;
+}
+
+//Read all available bytes without blocking
+static int _oph_io_server_pool_receive(oph_io_server_connection * conn)
+{
+	ssize_t n;
+	char *tmp = NULL;
+
+	for (;;) {
+		if (conn->buffer_len == conn->buffer_size) {
+			tmp = (char *) realloc(conn->buffer, 2 * conn->buffer_size * sizeof(char));
+			if (!tmp) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+				logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+				return OPH_IO_SERVER_POOL_ERROR;
+			}
+			conn->buffer = tmp;
+			conn->buffer_size *= 2;
+		}
+
+		if (conn->local)
+			n = _oph_io_server_pool_receive_fds(conn);
+		else
+			n = recv(conn->sockfd, conn->buffer + conn->buffer_len, conn->buffer_size - conn->buffer_len, MSG_DONTWAIT);
+		if (n > 0) {
+			conn->buffer_len += n;
+			continue;
+		}
+		if (n == 0) {
+			pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection closed by peer\n");
+			logging(LOG_DEBUG, __FILE__, __LINE__, "Connection closed by peer\n");
+			return OPH_IO_SERVER_POOL_ERROR;
+		}
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Error in reading socket: %d\n", errno);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Error in reading socket: %d\n", errno);
+		return OPH_IO_SERVER_POOL_ERROR;
+	}
+
+	return OPH_IO_SERVER_POOL_SUCCESS;
+}
+
+//Serve all complete requests of a connection and give it back to event loop
+static void _oph_io_server_pool_serve(oph_io_server_connection * conn, char *line, char *result)
+{
+	unsigned long long frame_len = 0;
+	int res;
+	char *tmp = NULL;
+
+	for (;;) {
+		res = oph_io_server_frame_length(conn->buffer, conn->buffer_len, &frame_len);
+		if (res < 0) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Received a malformed request\n");
+			logging(LOG_WARNING, __FILE__, __LINE__, "Received a malformed request\n");
+			oph_io_server_send_error(conn->sockfd);
+			_oph_io_server_pool_close(conn);
+			return;
+		} else if (res > 0)
+			break;
+
+		if (oph_io_server_serve_request(conn, frame_len, line, result)) {
+			_oph_io_server_pool_close(conn);
+			return;
+		}
+
+		conn->buffer_len -= frame_len;
+		if (conn->buffer_len)
+			memmove(conn->buffer, conn->buffer + frame_len, conn->buffer_len);
+	}
+
+	//Idle connections keep only a small buffer
+	if (conn->buffer_size > OPH_IO_SERVER_POOL_BUFFER_LEN && conn->buffer_len <= OPH_IO_SERVER_POOL_BUFFER_LEN) {
+		tmp = (char *) realloc(conn->buffer, OPH_IO_SERVER_POOL_BUFFER_LEN * sizeof(char));
+		if (tmp) {
+			conn->buffer = tmp;
+			conn->buffer_size = OPH_IO_SERVER_POOL_BUFFER_LEN;
+		}
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	conn->busy = 0;
+	conn->last_access = time(NULL);
+	res = _oph_io_server_pool_arm(conn, EPOLL_CTL_MOD);
+	pthread_mutex_unlock(&pool.lock);
+
+	if (res)
+		_oph_io_server_pool_close(conn);
+}
+
+static void *_oph_io_server_pool_worker(void *arg)
+{
+	UNUSED(arg);
+
+	oph_io_server_connection *conn = NULL;
+
+	//Buffers are related to the worker, not to the connections
+	char *line = (char *) calloc(max_packet_length, sizeof(char));
+	char *result = (char *) calloc(max_packet_length, sizeof(char));
+	if (!line || !result) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+		if (line)
+			free(line);
+		if (result)
+			free(result);
+		return NULL;
+	}
+
+	for (;;) {
+		pthread_mutex_lock(&pool.lock);
+		while (pool.ready_head == NULL && !pool.stop)
+			pthread_cond_wait(&pool.cond, &pool.lock);
+		//Queued connections are closed by the event loop
+		if (pool.stop) {
+			pthread_mutex_unlock(&pool.lock);
+			break;
+		}
+		conn = pool.ready_head;
+		pool.ready_head = conn->next_ready;
+		if (pool.ready_head == NULL)
+			pool.ready_tail = NULL;
+		conn->next_ready = NULL;
+		pthread_mutex_unlock(&pool.lock);
+
+		_oph_io_server_pool_serve(conn, line, result);
+	}
+
+	free(line);
+	free(result);
+	return NULL;
+}
+
+//Check if an error event on an idle connection only notifies completed zero-copy transmissions, collecting them
+static int _oph_io_server_pool_zerocopy_event(oph_io_server_connection * conn, unsigned int events)
+{
+	int error = 0;
+	socklen_t len = sizeof(error);
+
+	if (!conn->zerocopy_sends.sent || (events & EPOLLHUP))
+		return 0;
+	oph_net_zerocopy_wait(conn->sockfd, &(conn->zerocopy_sends), 0);
+	return !getsockopt(conn->sockfd, SOL_SOCKET, SO_ERROR, &error, &len) && !error;
+}
+
+//Called by event loop when new data is available on an idle connection
+static void _oph_io_server_pool_dispatch(oph_io_server_connection * conn, unsigned int events)
+{
+	unsigned long long frame_len = 0;
+	int res;
+
+	if (_oph_io_server_pool_receive(conn)) {
+		_oph_io_server_pool_close(conn);
+		return;
+	}
+	if ((events & (EPOLLERR | EPOLLHUP)) && !(events & EPOLLIN) && !_oph_io_server_pool_zerocopy_event(conn, events)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Connection closed with error\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Connection closed with error\n");
+		_oph_io_server_pool_close(conn);
+		return;
+	}
+
+	res = oph_io_server_frame_length(conn->buffer, conn->buffer_len, &frame_len);
+	if (res < 0) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Received a malformed request\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Received a malformed request\n");
+		oph_io_server_send_error(conn->sockfd);
+		_oph_io_server_pool_close(conn);
+		return;
+	} else if (res > 0) {
+		//Wait for the rest of the request
+		if (_oph_io_server_pool_arm(conn, EPOLL_CTL_MOD))
+			_oph_io_server_pool_close(conn);
+		return;
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	conn->busy = 1;
+	if (pool.ready_tail)
+		pool.ready_tail->next_ready = conn;
+	else
+		pool.ready_head = conn;
+	pool.ready_tail = conn;
+	pthread_cond_signal(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static void _oph_io_server_pool_accept(int listenfd, char local)
+{
+	int connfd;
+	oph_io_server_connection *conn = NULL;
+
+	for (;;) {
+		connfd = accept(listenfd, NULL, NULL);
+		if (connfd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Error on connection\n");
+				logging(LOG_ERROR, __FILE__, __LINE__, "Error on connection\n");
+			}
+			break;
+		}
+
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Connection established on socket %d\n", connfd);
+		logging(LOG_DEBUG, __FILE__, __LINE__, "Connection established on socket %d\n", connfd);
+
+		conn = (oph_io_server_connection *) calloc(1, sizeof(oph_io_server_connection));
+		if (!conn || !(conn->buffer = (char *) malloc(OPH_IO_SERVER_POOL_BUFFER_LEN * sizeof(char)))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate connection structure\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate connection structure\n");
+			if (conn)
+				free(conn);
+			close(connfd);
+			continue;
+		}
+		conn->sockfd = connfd;
+		conn->buffer_size = OPH_IO_SERVER_POOL_BUFFER_LEN;
+		conn->last_access = time(NULL);
+		conn->local = local;
+		conn->zerocopy = !local && oph_net_set_zerocopy(connfd) == OPH_NETWORK_SUCCESS;
+
+		pthread_mutex_lock(&pool.lock);
+		conn->next = pool.conn_list;
+		pool.conn_list = conn;
+		pthread_mutex_unlock(&pool.lock);
+
+		if (_oph_io_server_pool_arm(conn, EPOLL_CTL_ADD))
+			_oph_io_server_pool_close(conn);
+	}
+}
+
+//Close connections idle for more than client TTL
+static void _oph_io_server_pool_sweep()
+{
+	oph_io_server_connection **iter = NULL, *conn = NULL, *expired = NULL;
+	time_t now = time(NULL);
+
+	pthread_mutex_lock(&pool.lock);
+	iter = &(pool.conn_list);
+	while (*iter) {
+		conn = *iter;
+		if (!conn->busy && (now - conn->last_access) > (time_t) client_ttl) {
+			*iter = conn->next;
+			conn->next = expired;
+			expired = conn;
+		} else
+			iter = &(conn->next);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	while (expired) {
+		conn = expired;
+		expired = conn->next;
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Timeout occured\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Timeout occured\n");
+		_oph_io_server_pool_release(conn);
+	}
+}
+
+//Stop worker threads (waiting for the requests being served) and close all connections
+static void _oph_io_server_pool_shutdown()
+{
+	unsigned short i;
+	oph_io_server_connection *conn;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.stop = 1;
+	pthread_cond_broadcast(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 0; i < pool.worker_num; i++)
+		pthread_join(pool.workers[i], NULL);
+	free(pool.workers);
+	pool.workers = NULL;
+	pool.worker_num = 0;
+
+	while ((conn = pool.conn_list)) {
+		pool.conn_list = conn->next;
+		_oph_io_server_pool_release(conn);
+	}
+	pool.ready_head = pool.ready_tail = NULL;
+
+	close(pool.epfd);
+	pool.epfd = -1;
+}
+
+void oph_io_server_pool_stop()
+{
+	pool.stop = 1;
+}
+
+int oph_io_server_pool_run(int listenfd, int unixfd, unsigned short worker_num)
+{
+	if (!worker_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		return OPH_IO_SERVER_POOL_ERROR;
+	}
+
+	int flags = fcntl(listenfd, F_GETFL, 0);
+	if (flags < 0 || fcntl(listenfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to set listening socket as non-blocking\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to set listening socket as non-blocking\n");
+		return OPH_IO_SERVER_POOL_ERROR;
+	}
+	if (unixfd >= 0) {
+		flags = fcntl(unixfd, F_GETFL, 0);
+		if (flags < 0 || fcntl(unixfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to set listening socket as non-blocking\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to set listening socket as non-blocking\n");
+			return OPH_IO_SERVER_POOL_ERROR;
+		}
+	}
+	pool.unixfd = unixfd;
+
+	pool.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (pool.epfd < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to create epoll descriptor\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to create epoll descriptor\n");
+		return OPH_IO_SERVER_POOL_ERROR;
+	}
+
+	struct epoll_event ev, events[OPH_IO_SERVER_POOL_MAX_EVENTS];
+	memset(&ev, 0, sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(pool.epfd, EPOLL_CTL_ADD, listenfd, &ev)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to watch listening socket\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to watch listening socket\n");
+		close(pool.epfd);
+		return OPH_IO_SERVER_POOL_ERROR;
+	}
+	//Local listening socket is identified by the address of its descriptor
+	ev.data.ptr = (void *) &pool.unixfd;
+	if (unixfd >= 0 && epoll_ctl(pool.epfd, EPOLL_CTL_ADD, unixfd, &ev)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to watch listening socket\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to watch listening socket\n");
+		close(pool.epfd);
+		return OPH_IO_SERVER_POOL_ERROR;
+	}
+
+	if (!(pool.workers = (pthread_t *) malloc(worker_num * sizeof(pthread_t)))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error creating thread\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Error creating thread\n");
+		close(pool.epfd);
+		return OPH_IO_SERVER_POOL_ERROR;
+	}
+	for (pool.worker_num = 0; pool.worker_num < worker_num; pool.worker_num++) {
+		if (pthread_create(&(pool.workers[pool.worker_num]), NULL, &_oph_io_server_pool_worker, NULL)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error creating thread\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Error creating thread\n");
+			_oph_io_server_pool_shutdown();
+			return OPH_IO_SERVER_POOL_ERROR;
+		}
+	}
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Started %d worker threads\n", worker_num);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Started %d worker threads\n", worker_num);
+
+	int n, j, res = OPH_IO_SERVER_POOL_SUCCESS;
+	time_t last_sweep = time(NULL), now;
+
+	//Stop flag is checked at least once per timeout, since signals could be delivered to other threads
+	while (!pool.stop) {
+		n = epoll_wait(pool.epfd, events, OPH_IO_SERVER_POOL_MAX_EVENTS, OPH_IO_SERVER_POOL_TIMEOUT);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error in polling sockets: %d\n", errno);
+			logging(LOG_ERROR, __FILE__, __LINE__, "Error in polling sockets: %d\n", errno);
+			res = OPH_IO_SERVER_POOL_ERROR;
+			break;
+		}
+
+		for (j = 0; j < n; j++) {
+			if (events[j].data.ptr == NULL)
+				_oph_io_server_pool_accept(listenfd, 0);
+			else if (events[j].data.ptr == (void *) &pool.unixfd)
+				_oph_io_server_pool_accept(unixfd, 1);
+			else
+				_oph_io_server_pool_dispatch((oph_io_server_connection *) events[j].data.ptr, events[j].events);
+		}
+
+		now = time(NULL);
+		if (client_ttl && now != last_sweep) {
+			_oph_io_server_pool_sweep();
+			last_sweep = now;
+		}
+	}
+
+	_oph_io_server_pool_shutdown();
+	return res;
+}
@@ -20,10 +20,13 @@
 
 #include "oph_io_server_thread.h"
 
-#include <poll.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
 #include <stdio.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "debug.h"
 #include "taketime.h"
 
@@ -33,19 +36,15 @@
 
 #include "oph_iostorage_data.h"
 #include "oph_query_parser.h"
+#include "oph_io_server_plan_cache.h"
 #include "oph_metadb_interface.h"
 #include "oph_network.h"
 
 extern int msglevel;
 
-//TODO thread management operations
-//TODO save info related to threads
-//TODO save connection status
-
 //Global server variables (read-only)
 extern unsigned long long max_packet_length;
 extern unsigned short omp_threads;
-extern unsigned short client_ttl;
 extern HASHTBL *plugin_table;
 
 extern pthread_rwlock_t rwlock;
@@ -53,31 +52,51 @@ extern oph_metadb_db_row *db_table;
 
 //#define DEBUG
 
+/**
+ * \brief			        Structure used to decode a request already stored in memory
+ * \param data          Pointer to request bytes
+ * \param len           Length of request
+ * \param pos           Current read position
+ */
+typedef struct {
+	const char *data;
+	unsigned long long len;
+	unsigned long long pos;
+} oph_io_server_frame;
+
+static int _oph_io_server_frame_read(oph_io_server_frame * frame, void *vptr, unsigned long long n)
+{
+	if (frame->pos + n > frame->len || n > (unsigned long long) INT_MAX)
+		return -1;
+	memcpy(vptr, frame->data + frame->pos, n);
+	frame->pos += n;
+	return (int) n;
+}
+
+static void _oph_io_server_free_stmt(oph_io_server_thread_status * status)
+{
+	if (status->curr_stmt == NULL)
+		return;
+	if (status->curr_stmt->partial_result_set != NULL)
+		oph_iostore_destroy_frag_recordset(&status->curr_stmt->partial_result_set);
+	if (status->curr_stmt->device != NULL)
+		free(status->curr_stmt->device);
+	if (status->curr_stmt->frag != NULL)
+		free(status->curr_stmt->frag);
+	free(status->curr_stmt);
+	status->curr_stmt = NULL;
+}
+
 int oph_io_server_free_status(oph_io_server_thread_status * status)
 {
 
-	if (status->curr_stmt != NULL) {
-		if (status->curr_stmt->partial_result_set != NULL)
-			oph_iostore_destroy_frag_recordset(&status->curr_stmt->partial_result_set);
-		if (status->curr_stmt->device != NULL)
-			free(status->curr_stmt->device);
-		if (status->curr_stmt->frag != NULL)
-			free(status->curr_stmt->frag);
-		free(status->curr_stmt);
-	}
+	_oph_io_server_free_stmt(status);
 	if (status->current_db != NULL)
 		free(status->current_db);
 	if (status->device != NULL)
 		free(status->device);
 
-	if (status->last_result_set != NULL) {
-		if (status->delete_only_rs)
-			oph_iostore_destroy_frag_recordset_only(&(status->last_result_set));
-		else
-			oph_iostore_destroy_frag_recordset(&(status->last_result_set));
-	}
-	status->last_result_set = NULL;
-	status->delete_only_rs = 0;
+	oph_io_server_free_result_set(status);
 
 	return 0;
 }
@@ -116,25 +135,1058 @@ int oph_io_server_free_query_args(oph_query_arg ** args, unsigned int arg_count)
 	return 0;
 }
 
-void oph_io_server_thread(int sockfd, pthread_t tid)
+static int _oph_io_server_frame_field(const char *buffer, unsigned long long buffer_len, unsigned long long *pos, unsigned long long *value, size_t value_size)
+{
+	if (*pos + value_size > buffer_len)
+		return 1;
+	*value = 0;
+	memcpy((void *) value, buffer + *pos, value_size);
+	*pos += value_size;
+	return 0;
+}
+
+int oph_io_server_frame_length(const char *buffer, unsigned long long buffer_len, unsigned long long *frame_len)
+{
+	if (!buffer || !frame_len) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		return -1;
+	}
+
+	*frame_len = 0;
+	if (buffer_len < OPH_IO_SERVER_MSG_TYPE_LEN)
+		return 1;
+
+	char header[OPH_IO_SERVER_MSG_TYPE_LEN + 1];
+	snprintf(header, OPH_IO_SERVER_MSG_TYPE_LEN + 1, "%s", buffer);
+
+	unsigned long long pos = OPH_IO_SERVER_MSG_TYPE_LEN, payload_len = 0, arg_number = 0, n = 0;
+	int i;
+
+	if (STRCMP(header, OPH_IO_SERVER_MSG_TAGGED) == 0) {
+		//TYPE|REQUEST_ID|REQUEST, where request cannot be tagged in turn
+		if (buffer_len < OPH_IO_SERVER_TAGGED_HEADER_LEN + OPH_IO_SERVER_MSG_TYPE_LEN)
+			return 1;
+		if (!strncmp(buffer + OPH_IO_SERVER_TAGGED_HEADER_LEN, OPH_IO_SERVER_MSG_TAGGED, OPH_IO_SERVER_MSG_TYPE_LEN))
+			return -1;
+		if ((i = oph_io_server_frame_length(buffer + OPH_IO_SERVER_TAGGED_HEADER_LEN, buffer_len - OPH_IO_SERVER_TAGGED_HEADER_LEN, &payload_len)))
+			return i;
+		*frame_len = OPH_IO_SERVER_TAGGED_HEADER_LEN + payload_len;
+		return 0;
+	} else if (STRCMP(header, OPH_IO_SERVER_MSG_BATCH_QUERY) == 0) {
+		//TYPE|FLAGS|QUERY_NUM|QUERY1|QUERY2|..., where each query is an exec query request
+		pos += OPH_IO_SERVER_MSG_SHORT_LEN;
+		if (_oph_io_server_frame_field(buffer, buffer_len, &pos, &arg_number, OPH_IO_SERVER_MSG_SHORT_LEN))
+			return 1;
+		for (n = 0; n < arg_number; n++) {
+			if (pos + OPH_IO_SERVER_MSG_TYPE_LEN > buffer_len)
+				return 1;
+			if (strncmp(buffer + pos, OPH_IO_SERVER_MSG_EXEC_QUERY, OPH_IO_SERVER_MSG_TYPE_LEN))
+				return -1;
+			if ((i = oph_io_server_frame_length(buffer + pos, buffer_len - pos, &payload_len)))
+				return i;
+			pos += payload_len;
+		}
+	} else if (STRCMP(header, OPH_IO_SERVER_MSG_PING_OPTIONS) == 0) {
+		//TYPE|OPTIONS
+		pos += OPH_IO_SERVER_MSG_SHORT_LEN;
+	} else if (STRCMP(header, OPH_IO_SERVER_MSG_USE_DB) == 0) {
+		//TYPE|DB_LEN|DB|DEV_LEN|DEV
+		for (i = 0; i < 2; i++) {
+			if (_oph_io_server_frame_field(buffer, buffer_len, &pos, &payload_len, OPH_IO_SERVER_MSG_LONG_LEN))
+				return 1;
+			if (payload_len >= max_packet_length)
+				return -1;
+			pos += payload_len;
+		}
+	} else if (STRCMP(header, OPH_IO_SERVER_MSG_EXEC_QUERY) == 0) {
+		//TYPE|ARG_NUM|QUERY_LEN|QUERY|DEV_LEN|DEV[|N_RUN|CURR_RUN|ARG1_LEN|ARG1_TYPE|ARG1|...]
+		if (_oph_io_server_frame_field(buffer, buffer_len, &pos, &arg_number, OPH_IO_SERVER_MSG_SHORT_LEN))
+			return 1;
+		if (arg_number == 0)
+			return -1;
+		for (i = 0; i < 2; i++) {
+			if (_oph_io_server_frame_field(buffer, buffer_len, &pos, &payload_len, OPH_IO_SERVER_MSG_LONG_LEN))
+				return 1;
+			if (payload_len >= max_packet_length)
+				return -1;
+			pos += payload_len;
+		}
+		if (arg_number > 1) {
+			pos += 2 * OPH_IO_SERVER_MSG_LONG_LEN;
+			for (n = 0; n < arg_number - 1; n++) {
+				if (_oph_io_server_frame_field(buffer, buffer_len, &pos, &payload_len, OPH_IO_SERVER_MSG_LONG_LEN))
+					return 1;
+				if (pos + OPH_IO_SERVER_MSG_TYPE_LEN > buffer_len)
+					return 1;
+				//Args stored in shared memory are replaced by their offset
+				if (!strncmp(buffer + pos, OPH_IO_SERVER_MSG_ARG_DATA_SHM, OPH_IO_SERVER_MSG_TYPE_LEN))
+					payload_len = OPH_IO_SERVER_MSG_LONG_LEN;
+				if (payload_len >= max_packet_length)
+					return -1;
+				pos += OPH_IO_SERVER_MSG_TYPE_LEN + payload_len;
+			}
+		}
+	}
+	//Other requests (ping, result set retrieval or unknown ones) consist of the type only
+
+	if (pos > buffer_len)
+		return 1;
+
+	*frame_len = pos;
+	return 0;
+}
+
+/**
+ * \brief			        Batch of buffers sent to the client with a single vectored write
+ * \param iov           Buffers of the batch
+ * \param iov_num       Number of buffers in batch
+ * \param side          Side buffer with headers, length prefixes and small fields
+ * \param side_len      Number of bytes used in side buffer
+ * \param batch_len     Number of bytes in batch
+ * \param ref_len       Number of bytes of the batch referenced in place
+ * \param part          Header of the part being filled, if any
+ * \param part_len      Payload length of the part being filled
+ * \param part_rows     Number of rows of the part being filled
+ * \param num_fields    Number of fields of the result set
+ * \param zerocopy      Zero-copy transmissions of the socket, NULL if zero-copy is not supported
+ * \param packed        Flags set to 1 for the fields of current row sent compressed, NULL if compression is disabled
+ * \param zbuf          Buffer with compressed fields of the batch
+ * \param zbuf_size     Size of zbuf
+ * \param zbuf_len      Number of bytes used in zbuf
+ * \param stats         Compression statistics to be updated
+ */
+typedef struct {
+	struct iovec iov[OPH_IO_SERVER_RESULT_IOV_NUM];
+	int iov_num;
+	char *side;
+	unsigned long long side_len;
+	unsigned long long batch_len;
+	unsigned long long ref_len;
+	char *part;
+	unsigned long long part_len;
+	unsigned long long part_rows;
+	unsigned int num_fields;
+	oph_net_zerocopy *zerocopy;
+	char *packed;
+	char *zbuf;
+	unsigned long long zbuf_size;
+	unsigned long long zbuf_len;
+	oph_io_server_compression_stats *stats;
+} oph_io_server_result_batch;
+
+//Update compression statistics with a frame processed since start
+static void _oph_io_server_compression_update(oph_io_server_compression_stats * stats, unsigned long long raw_len, unsigned long long packed_len, struct timeval *start)
+{
+	struct timeval end, elapsed;
+
+	gettimeofday(&end, NULL);
+	timeval_subtract(&elapsed, &end, start);
+	stats->frames++;
+	stats->raw_len += raw_len;
+	stats->packed_len += packed_len;
+	stats->time += elapsed.tv_sec + elapsed.tv_usec / (double) MILLION;
+}
+
+static void _oph_io_server_result_header(char *buffer, unsigned long long payload_len, unsigned long long num_rows, unsigned int num_fields)
+{
+	memcpy(buffer, OPH_IO_SERVER_MSG_RESULT_PART, OPH_IO_SERVER_MSG_TYPE_LEN);
+	buffer += OPH_IO_SERVER_MSG_TYPE_LEN;
+	memcpy(buffer, (void *) &payload_len, OPH_IO_SERVER_MSG_LONG_LEN);
+	buffer += OPH_IO_SERVER_MSG_LONG_LEN;
+	memcpy(buffer, (void *) &num_rows, OPH_IO_SERVER_MSG_LONG_LEN);
+	buffer += OPH_IO_SERVER_MSG_LONG_LEN;
+	memcpy(buffer, (void *) &num_fields, OPH_IO_SERVER_MSG_SHORT_LEN);
+}
+
+static void _oph_io_server_batch_copy(oph_io_server_result_batch * batch, const void *data, unsigned long long len)
+{
+	char *ptr = batch->side + batch->side_len;
+	struct iovec *last = batch->iov_num ? batch->iov + batch->iov_num - 1 : NULL;
+
+	memcpy(ptr, data, len);
+	batch->side_len += len;
+	batch->batch_len += len;
+	//Adjacent bytes are sent with the same buffer
+	if (last && (char *) last->iov_base + last->iov_len == ptr)
+		last->iov_len += len;
+	else {
+		batch->iov[batch->iov_num].iov_base = ptr;
+		batch->iov[batch->iov_num++].iov_len = len;
+	}
+}
+
+static void _oph_io_server_batch_ref(oph_io_server_result_batch * batch, const void *data, unsigned long long len)
+{
+	batch->iov[batch->iov_num].iov_base = (void *) data;
+	batch->iov[batch->iov_num++].iov_len = len;
+	batch->batch_len += len;
+	batch->ref_len += len;
+}
+
+static void _oph_io_server_batch_open_part(oph_io_server_result_batch * batch)
+{
+	char header[OPH_IO_SERVER_RESULT_HEADER_LEN];
+
+	//Header is completed when the part is closed
+	_oph_io_server_result_header(header, 0, 0, batch->num_fields);
+	batch->part = batch->side + batch->side_len;
+	batch->part_len = 0;
+	batch->part_rows = 0;
+	_oph_io_server_batch_copy(batch, header, OPH_IO_SERVER_RESULT_HEADER_LEN);
+}
+
+static void _oph_io_server_batch_close_part(oph_io_server_result_batch * batch)
+{
+	if (!batch->part)
+		return;
+	_oph_io_server_result_header(batch->part, batch->part_len, batch->part_rows, batch->num_fields);
+	batch->part = NULL;
+}
+
+static int _oph_io_server_batch_flush(int sockfd, oph_io_server_result_batch * batch)
+{
+	_oph_io_server_batch_close_part(batch);
+
+	oph_net_zerocopy *zerocopy = batch->ref_len >= OPH_IO_SERVER_RESULT_ZEROCOPY_LEN ? batch->zerocopy : NULL;
+	unsigned int sent = zerocopy ? zerocopy->sent : 0;
+	if (batch->iov_num && oph_net_writev(sockfd, batch->iov, batch->iov_num, zerocopy) != (ssize_t) batch->batch_len) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		return -1;
+	}
+	//Buffers sent with zero-copy are reused only once their transmission is completed
+	if (zerocopy && zerocopy->sent != sent) {
+		oph_net_zerocopy_free(zerocopy, batch->side);
+		if (batch->zbuf_len) {
+			oph_net_zerocopy_free(zerocopy, batch->zbuf);
+			batch->zbuf = (char *) oph_net_zerocopy_alloc(sockfd, zerocopy, batch->zbuf_size);
+			batch->zbuf_len = 0;
+		}
+		if (!(batch->side = (char *) oph_net_zerocopy_alloc(sockfd, zerocopy, OPH_IO_SERVER_RESULT_FRAME_LEN)) || (batch->zbuf_size && !batch->zbuf)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			return -1;
+		}
+	}
+	batch->iov_num = 0;
+	batch->side_len = 0;
+	batch->batch_len = 0;
+	batch->ref_len = 0;
+
+	return 0;
+}
+
+//Compress the large fields of a row into the buffer of the batch, replacing their values with RAW_LEN|DATA; fields are sent as they are if compression does not pay
+static int _oph_io_server_batch_compress(int sockfd, oph_io_server_result_batch * batch, char **values, unsigned long long *sizes)
+{
+	unsigned long long bound = 0;
+	unsigned int j;
+	size_t packed_len;
+	struct timeval start;
+	char *ptr;
+
+	for (j = 0; j < batch->num_fields; j++) {
+		batch->packed[j] = 0;
+		if (sizes[j] >= OPH_IO_SERVER_COMPRESS_LEN)
+			bound += OPH_IO_SERVER_MSG_LONG_LEN + oph_net_compress_bound(sizes[j]);
+	}
+	if (!bound)
+		return 0;
+
+	//Compressed fields have to be kept until the batch is sent
+	if (!batch->iov_num)
+		batch->zbuf_len = 0;
+	if (batch->zbuf_len + bound > batch->zbuf_size) {
+		if (_oph_io_server_batch_flush(sockfd, batch))
+			return -1;
+		batch->zbuf_len = 0;
+		if (bound > batch->zbuf_size) {
+			oph_net_zerocopy_free(batch->zerocopy, batch->zbuf);
+			batch->zbuf_size = 0;
+			if (!(batch->zbuf = (char *) oph_net_zerocopy_alloc(sockfd, batch->zerocopy, bound))) {
+				pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to allocate buffer for compression\n");
+				logging(LOG_WARNING, __FILE__, __LINE__, "Unable to allocate buffer for compression\n");
+				return 0;
+			}
+			batch->zbuf_size = bound;
+		}
+	}
+
+	for (j = 0; j < batch->num_fields; j++) {
+		if (sizes[j] < OPH_IO_SERVER_COMPRESS_LEN)
+			continue;
+		gettimeofday(&start, NULL);
+		ptr = batch->zbuf + batch->zbuf_len;
+		packed_len = oph_net_compress_bound(sizes[j]);
+		if (!oph_net_compress(values[j], sizes[j], ptr + OPH_IO_SERVER_MSG_LONG_LEN, &packed_len) && OPH_IO_SERVER_MSG_LONG_LEN + packed_len < sizes[j]) {
+			memcpy(ptr, (void *) (sizes + j), OPH_IO_SERVER_MSG_LONG_LEN);
+			_oph_io_server_compression_update(batch->stats, sizes[j], OPH_IO_SERVER_MSG_LONG_LEN + packed_len, &start);
+			values[j] = ptr;
+			sizes[j] = OPH_IO_SERVER_MSG_LONG_LEN + packed_len;
+			batch->zbuf_len += sizes[j];
+			batch->packed[j] = 1;
+		} else
+			_oph_io_server_compression_update(batch->stats, sizes[j], sizes[j], &start);
+	}
+
+	return 0;
+}
+
+//Append a row to the batch (in the current part, if parts are used): only small fields are copied, the others are sent from record set memory
+static int _oph_io_server_batch_row(int sockfd, oph_io_server_result_batch * batch, char **values, unsigned long long *sizes, char parts)
+{
+	unsigned long long row_size = 0, row_side = parts ? OPH_IO_SERVER_RESULT_HEADER_LEN : 0, field_len = 0;
+	unsigned int j, row_iov = parts ? 1 : 0;
+	char header[OPH_IO_SERVER_RESULT_HEADER_LEN];
+
+	if (batch->packed && _oph_io_server_batch_compress(sockfd, batch, values, sizes))
+		return -1;
+
+	for (j = 0; j < batch->num_fields; j++) {
+		row_size += OPH_IO_SERVER_MSG_LONG_LEN + sizes[j];
+		row_side += OPH_IO_SERVER_MSG_LONG_LEN + (sizes[j] <= OPH_IO_SERVER_RESULT_COPY_LEN ? sizes[j] : 0);
+		row_iov += 2;
+	}
+
+	if (row_side > OPH_IO_SERVER_RESULT_FRAME_LEN || row_iov > OPH_IO_SERVER_RESULT_IOV_NUM) {
+		//Row does not fit in a batch: send it field by field
+		if (_oph_io_server_batch_flush(sockfd, batch))
+			return -1;
+		if (parts) {
+			_oph_io_server_result_header(header, row_size, 1, batch->num_fields);
+			if (oph_net_writen(sockfd, header, OPH_IO_SERVER_RESULT_HEADER_LEN) != OPH_IO_SERVER_RESULT_HEADER_LEN)
+				return -1;
+		}
+		for (j = 0; j < batch->num_fields; j++) {
+			field_len = sizes[j] | (batch->packed && batch->packed[j] ? OPH_IO_SERVER_FIELD_COMPRESSED : 0);
+			if (oph_net_writen(sockfd, (void *) &field_len, OPH_IO_SERVER_MSG_LONG_LEN) != OPH_IO_SERVER_MSG_LONG_LEN
+			    || oph_net_writen(sockfd, values[j], sizes[j]) != (ssize_t) sizes[j])
+				return -1;
+		}
+		return 0;
+	}
+
+	if (parts && batch->part && batch->part_len + row_size > OPH_IO_SERVER_RESULT_FRAME_LEN)
+		_oph_io_server_batch_close_part(batch);
+	if (batch->side_len + row_side > OPH_IO_SERVER_RESULT_FRAME_LEN || batch->iov_num + row_iov > OPH_IO_SERVER_RESULT_IOV_NUM
+	    || (batch->batch_len && batch->batch_len + row_size > OPH_IO_SERVER_RESULT_FRAME_NUM * OPH_IO_SERVER_RESULT_FRAME_LEN)) {
+		if (_oph_io_server_batch_flush(sockfd, batch))
+			return -1;
+	}
+	if (parts && !batch->part)
+		_oph_io_server_batch_open_part(batch);
+
+	for (j = 0; j < batch->num_fields; j++) {
+		field_len = sizes[j] | (batch->packed && batch->packed[j] ? OPH_IO_SERVER_FIELD_COMPRESSED : 0);
+		_oph_io_server_batch_copy(batch, (void *) &field_len, OPH_IO_SERVER_MSG_LONG_LEN);
+		if (sizes[j] <= OPH_IO_SERVER_RESULT_COPY_LEN)
+			_oph_io_server_batch_copy(batch, values[j], sizes[j]);
+		else
+			_oph_io_server_batch_ref(batch, values[j], sizes[j]);
+	}
+	if (parts) {
+		batch->part_len += row_size;
+		batch->part_rows++;
+	}
+
+	return 0;
+}
+
+//Get the value of a field as transmitted to the client: numeric values are sent as they are or converted to string into buffer
+static void _oph_io_server_result_field(oph_iostore_frag_record_set * rs, unsigned long long i, unsigned int j, char binary, char *buffer, char **value, unsigned long long *size)
+{
+	if (binary && rs->field_type[j] != OPH_IOSTORE_STRING_TYPE) {
+		*value = (char *) rs->record_set[i]->field[j];
+		*size = rs->field_type[j] == OPH_IOSTORE_LONG_TYPE ? sizeof(unsigned long long) : sizeof(double);
+	} else if (rs->field_type[j] != OPH_IOSTORE_STRING_TYPE) {
+		if (rs->field_type[j] == OPH_IOSTORE_LONG_TYPE)
+			snprintf(buffer, OPH_IO_SERVER_MAX_LONG_LEN, "%llu", *((unsigned long long *) rs->record_set[i]->field[j]));
+		else
+			snprintf(buffer, OPH_IO_SERVER_MAX_DOUBLE_LEN, "%f", *((double *) rs->record_set[i]->field[j]));
+		*value = buffer;
+		*size = strlen(buffer) + 1;
+	} else {
+		*value = (char *) rs->record_set[i]->field[j];
+		*size = rs->record_set[i]->field_length[j];
+	}
+}
+
+//Send a result set as a single part, whose payload is written in a shared memory segment passed to the client: 1 is returned if the segment cannot be created
+static int _oph_io_server_send_result_shm(int sockfd, oph_iostore_frag_record_set * rs, unsigned int options)
 {
-	char *line = (char *) calloc(max_packet_length, sizeof(char));
-	if (!line) {
+	char binary = (options & OPH_IO_SERVER_OPT_BINARY_NUMBERS) ? 1 : 0;
+	unsigned int num_fields = rs->field_num, j = 0;
+	unsigned long long i = 0, payload_len = 0, m = 0;
+	char number[OPH_IO_SERVER_MAX_DOUBLE_LEN], *value = NULL, *segment = NULL, *header = NULL, type = 0, marker = 0;
+	unsigned long long size = 0;
+	struct iovec iov;
+	int fd = -1, res = 0;
+
+	for (i = 0; rs->record_set[i]; i++) {
+		for (j = 0; j < num_fields; j++) {
+			_oph_io_server_result_field(rs, i, j, binary, number, &value, &size);
+			payload_len += OPH_IO_SERVER_MSG_LONG_LEN + size;
+		}
+	}
+	if (!payload_len || oph_net_shm_create(payload_len, &fd))
+		return 1;
+	segment = (char *) mmap(NULL, payload_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	header = (char *) malloc(OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN + num_fields + OPH_IO_SERVER_RESULT_HEADER_LEN);
+	if (segment == MAP_FAILED || !header) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to map shared memory segment\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to map shared memory segment\n");
+		if (segment != MAP_FAILED)
+			munmap(segment, payload_len);
+		if (header)
+			free(header);
+		close(fd);
+		return 1;
+	}
+
+	for (i = 0; rs->record_set[i]; i++) {
+		for (j = 0; j < num_fields; j++) {
+			_oph_io_server_result_field(rs, i, j, binary, number, &value, &size);
+			memcpy(segment + m, (void *) &size, OPH_IO_SERVER_MSG_LONG_LEN);
+			m += OPH_IO_SERVER_MSG_LONG_LEN;
+			memcpy(segment + m, value, size);
+			m += size;
+		}
+	}
+	munmap(segment, payload_len);
+
+	m = 0;
+	if (binary) {
+		//Type header TYPE|NUM_FIELDS|FIELD_TYPES
+		memcpy(header, OPH_IO_SERVER_MSG_RESULT_TYPES, OPH_IO_SERVER_MSG_TYPE_LEN);
+		m += OPH_IO_SERVER_MSG_TYPE_LEN;
+		memcpy(header + m, (void *) &num_fields, OPH_IO_SERVER_MSG_SHORT_LEN);
+		m += OPH_IO_SERVER_MSG_SHORT_LEN;
+		for (j = 0; j < num_fields; j++) {
+			if (rs->field_type[j] == OPH_IOSTORE_LONG_TYPE)
+				type = OPH_IO_SERVER_FIELD_TYPE_LONG;
+			else if (rs->field_type[j] == OPH_IOSTORE_REAL_TYPE)
+				type = OPH_IO_SERVER_FIELD_TYPE_REAL;
+			else
+				type = OPH_IO_SERVER_FIELD_TYPE_STRING;
+			header[m++] = type;
+		}
+	}
+	//Part TYPE|PAYLOAD_LENGTH|NUM_ROWS|NUM_FIELDS, followed by the marker carrying the segment
+	_oph_io_server_result_header(header + m, payload_len, i, num_fields);
+	memcpy(header + m, OPH_IO_SERVER_MSG_RESULT_SHM, OPH_IO_SERVER_MSG_TYPE_LEN);
+	m += OPH_IO_SERVER_RESULT_HEADER_LEN;
+
+	iov.iov_base = &marker;
+	iov.iov_len = 1;
+	if (oph_net_writen(sockfd, header, m) != (ssize_t) m || oph_net_writev_fd(sockfd, &iov, 1, fd) != 1) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+		res = -1;
+	}
+	//The client has its own reference to the segment
+	close(fd);
+
+	if (!res) {
+		//End marker TYPE|TOTAL_ROWS|NUM_FIELDS
+		m = 0;
+		memcpy(header, OPH_IO_SERVER_MSG_RESULT_END, OPH_IO_SERVER_MSG_TYPE_LEN);
+		m += OPH_IO_SERVER_MSG_TYPE_LEN;
+		memcpy(header + m, (void *) &i, OPH_IO_SERVER_MSG_LONG_LEN);
+		m += OPH_IO_SERVER_MSG_LONG_LEN;
+		memcpy(header + m, (void *) &num_fields, OPH_IO_SERVER_MSG_SHORT_LEN);
+		m += OPH_IO_SERVER_MSG_SHORT_LEN;
+		if (oph_net_writen(sockfd, header, m) != (ssize_t) m) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+			res = -1;
+		}
+	}
+	free(header);
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sent %llu rows in shared memory\n", i);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Sent %llu rows in shared memory\n", i);
+
+	return res;
+}
+
+//Send a result set, in parts terminated by an end marker or (legacy format) as a single message; large fields of parts are compressed if enabled
+static int _oph_io_server_send_result(int sockfd, oph_iostore_frag_record_set * rs, unsigned int options, oph_net_zerocopy * zerocopy, char stream, oph_io_server_compression_stats * stats)
+{
+	char binary = (stream && (options & OPH_IO_SERVER_OPT_BINARY_NUMBERS)) ? 1 : 0;
+	unsigned int num_fields = rs->field_num, j = 0;
+	unsigned long long i = 0, payload_len = 0;
+	char type = 0;
+	int res = 0;
+
+	//Local clients receive the whole result set at once, unless shared memory is not available
+	if (stream && (options & OPH_IO_SERVER_OPT_SHARED_MEMORY) && rs->record_set && rs->record_set[0] && (res = _oph_io_server_send_result_shm(sockfd, rs, options)) <= 0)
+		return res;
+	res = 0;
+
+	oph_io_server_result_batch *batch = (oph_io_server_result_batch *) malloc(sizeof(oph_io_server_result_batch));
+	if (batch) {
+		batch->zerocopy = zerocopy;
+		batch->packed = NULL;
+		batch->zbuf = NULL;
+		batch->side = (char *) oph_net_zerocopy_alloc(sockfd, zerocopy, OPH_IO_SERVER_RESULT_FRAME_LEN);
+	}
+	char **values = (char **) malloc((num_fields + 1) * sizeof(char *));
+	unsigned long long *sizes = (unsigned long long *) malloc((num_fields + 1) * sizeof(unsigned long long));
+	char *numbers = (char *) malloc((num_fields + 1) * OPH_IO_SERVER_MAX_DOUBLE_LEN * sizeof(char));
+	if (!batch || !batch->side || !values || !sizes || !numbers) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
 		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-		return;
+		res = oph_io_server_send_error(sockfd);
+		goto send_end;
+	}
+	if (OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN + num_fields > OPH_IO_SERVER_RESULT_FRAME_LEN) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Too many fields in result set\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Too many fields in result set\n");
+		res = oph_io_server_send_error(sockfd);
+		goto send_end;
+	}
+	batch->iov_num = 0;
+	batch->side_len = 0;
+	batch->batch_len = 0;
+	batch->ref_len = 0;
+	batch->part = NULL;
+	batch->num_fields = num_fields;
+	batch->zbuf_size = 0;
+	batch->zbuf_len = 0;
+	batch->stats = stats;
+	if (stream && (options & OPH_IO_SERVER_OPT_COMPRESSION)) {
+		batch->packed = (char *) calloc(num_fields + 1, sizeof(char));
+		batch->zbuf_size = OPH_IO_SERVER_RESULT_FRAME_NUM * OPH_IO_SERVER_RESULT_FRAME_LEN;
+		batch->zbuf = (char *) oph_net_zerocopy_alloc(sockfd, zerocopy, batch->zbuf_size);
+		if (!batch->packed || !batch->zbuf) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for compression\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for compression\n");
+			batch->zbuf_size = 0;
+			res = oph_io_server_send_error(sockfd);
+			goto send_end;
+		}
+	}
+
+	if (binary) {
+		//Type header TYPE|NUM_FIELDS|FIELD_TYPES
+		_oph_io_server_batch_copy(batch, OPH_IO_SERVER_MSG_RESULT_TYPES, OPH_IO_SERVER_MSG_TYPE_LEN);
+		_oph_io_server_batch_copy(batch, (void *) &num_fields, OPH_IO_SERVER_MSG_SHORT_LEN);
+		for (j = 0; j < num_fields; j++) {
+			if (rs->field_type[j] == OPH_IOSTORE_LONG_TYPE)
+				type = OPH_IO_SERVER_FIELD_TYPE_LONG;
+			else if (rs->field_type[j] == OPH_IOSTORE_REAL_TYPE)
+				type = OPH_IO_SERVER_FIELD_TYPE_REAL;
+			else
+				type = OPH_IO_SERVER_FIELD_TYPE_STRING;
+			_oph_io_server_batch_copy(batch, &type, 1);
+		}
+	} else if (!stream) {
+		//Legacy packet TYPE|PAYLOAD_LENGTH|NUM_ROWS|NUM_FIELDS|PAYLOAD needs total length in advance
+		if (rs->record_set != NULL) {
+			for (i = 0; rs->record_set[i]; i++) {
+				for (j = 0; j < num_fields; j++) {
+					_oph_io_server_result_field(rs, i, j, 0, numbers + j * OPH_IO_SERVER_MAX_DOUBLE_LEN, values + j, sizes + j);
+					payload_len += OPH_IO_SERVER_MSG_LONG_LEN + sizes[j];
+				}
+			}
+		}
+		_oph_io_server_batch_copy(batch, OPH_IO_SERVER_MSG_RESULT, OPH_IO_SERVER_MSG_TYPE_LEN);
+		_oph_io_server_batch_copy(batch, (void *) &payload_len, OPH_IO_SERVER_MSG_LONG_LEN);
+		_oph_io_server_batch_copy(batch, (void *) &i, OPH_IO_SERVER_MSG_LONG_LEN);
+		_oph_io_server_batch_copy(batch, (void *) &num_fields, OPH_IO_SERVER_MSG_SHORT_LEN);
+	}
+
+	i = 0;
+	if (rs->record_set != NULL) {
+		for (i = 0; rs->record_set[i]; i++) {
+			for (j = 0; j < num_fields; j++)
+				_oph_io_server_result_field(rs, i, j, binary, numbers + j * OPH_IO_SERVER_MAX_DOUBLE_LEN, values + j, sizes + j);
+			if ((res = _oph_io_server_batch_row(sockfd, batch, values, sizes, stream)))
+				goto send_end;
+		}
+	}
+
+	if (stream) {
+		//End marker TYPE|TOTAL_ROWS|NUM_FIELDS
+		_oph_io_server_batch_close_part(batch);
+		if (batch->side_len + OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_LONG_LEN + OPH_IO_SERVER_MSG_SHORT_LEN > OPH_IO_SERVER_RESULT_FRAME_LEN
+		    || batch->iov_num + 1 > OPH_IO_SERVER_RESULT_IOV_NUM) {
+			if ((res = _oph_io_server_batch_flush(sockfd, batch)))
+				goto send_end;
+		}
+		_oph_io_server_batch_copy(batch, OPH_IO_SERVER_MSG_RESULT_END, OPH_IO_SERVER_MSG_TYPE_LEN);
+		_oph_io_server_batch_copy(batch, (void *) &i, OPH_IO_SERVER_MSG_LONG_LEN);
+		_oph_io_server_batch_copy(batch, (void *) &num_fields, OPH_IO_SERVER_MSG_SHORT_LEN);
+	}
+	if ((res = _oph_io_server_batch_flush(sockfd, batch)))
+		goto send_end;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sent %llu rows\n", i);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Sent %llu rows\n", i);
+
+      send_end:
+	if (res) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while sending result set\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Error while sending result set\n");
+	}
+	if (batch) {
+		if (batch->packed)
+			free(batch->packed);
+		oph_net_zerocopy_free(zerocopy, batch->zbuf);
+		oph_net_zerocopy_free(zerocopy, batch->side);
+		free(batch);
+	}
+	if (values)
+		free(values);
+	if (sizes)
+		free(sizes);
+	if (numbers)
+		free(numbers);
+
+	return res;
+}
+
+/**
+ * \brief			        Structure with the shared memory segment passed by a local client together with a request
+ * \param addr          Address of the segment mapped in memory, NULL if no segment is used
+ * \param len           Length of the segment
+ */
+typedef struct {
+	char *addr;
+	unsigned long long len;
+} oph_io_server_segment;
+
+//Map the first descriptor received from the client and not yet used
+static int _oph_io_server_segment_map(oph_io_server_connection * conn, oph_io_server_segment * segment)
+{
+	struct stat st;
+	int fd;
+
+	if (!conn->fd_num) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Shared memory segment has not been received\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Shared memory segment has not been received\n");
+		return -1;
+	}
+	fd = conn->fds[0];
+	conn->fd_num--;
+	memmove(conn->fds, conn->fds + 1, conn->fd_num * sizeof(int));
+
+	if (fstat(fd, &st) || st.st_size <= 0 || (segment->addr = (char *) mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to map shared memory segment\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to map shared memory segment\n");
+		segment->addr = NULL;
+		close(fd);
+		return -1;
 	}
-	char *result = (char *) calloc(max_packet_length, sizeof(char));
-	if (!result) {
+	segment->len = st.st_size;
+	close(fd);
+
+	return 0;
+}
+
+//Release arguments of a prepared statement: those stored in shared memory segment are not copied, so they are only unmapped
+static void _oph_io_server_free_args(oph_query_arg ** args, unsigned int arg_count, oph_io_server_segment * segment)
+{
+	unsigned int n = 0;
+
+	if (segment->addr) {
+		for (n = 0; args && n < arg_count; n++)
+			if (args[n] && (char *) args[n]->arg >= segment->addr && (char *) args[n]->arg < segment->addr + segment->len)
+				args[n]->arg = NULL;
+		munmap(segment->addr, segment->len);
+		segment->addr = NULL;
+	}
+	oph_io_server_free_query_args(args, arg_count);
+}
+
+//Decode the arguments ARG1_LEN|ARG1_TYPE|ARG1|... of a prepared statement
+static int _oph_io_server_read_args(oph_io_server_connection * conn, oph_io_server_frame * frame, char *buffer, unsigned int arg_count, oph_query_arg *** args,
+				    oph_io_server_segment * segment)
+{
+	unsigned int n = 0;
+	unsigned long long arg_len = 0, offset = 0, raw_len = 0;
+	struct timeval start;
+
+	*args = (oph_query_arg **) calloc(arg_count + 1, sizeof(oph_query_arg *));
+	if (!*args) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
 		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-		free(result);
-		return;
+		return -1;
+	}
+
+	for (n = 0; n < arg_count; n++) {
+		(*args)[n] = (oph_query_arg *) calloc(1, sizeof(oph_query_arg));
+		if (!(*args)[n]) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+			break;
+		}
+		//Read arg length
+		if (_oph_io_server_frame_read(frame, buffer, OPH_IO_SERVER_MSG_LONG_LEN) <= 0)
+			break;
+		arg_len = *((unsigned long long *) buffer);
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arg %d len: %llu\n", n, arg_len);
+		logging(LOG_DEBUG, __FILE__, __LINE__, "Arg %d len: %llu\n", n, arg_len);
+
+		(*args)[n]->arg_length = arg_len;
+		(*args)[n]->arg_is_null = 0;
+
+		//Read arg type
+		if (_oph_io_server_frame_read(frame, buffer, OPH_IO_SERVER_MSG_TYPE_LEN) <= 0)
+			break;
+		buffer[OPH_IO_SERVER_MSG_TYPE_LEN] = 0;
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arg %d type: %s\n", n, buffer);
+		logging(LOG_DEBUG, __FILE__, __LINE__, "Arg %d type: %s\n", n, buffer);
+
+		if (conn->local && STRCMP(buffer, OPH_IO_SERVER_MSG_ARG_DATA_SHM) == 0) {
+			//Read arg offset in shared memory segment, mapped when the first of these args is found
+			(*args)[n]->arg_type = OPH_QUERY_TYPE_BLOB;
+			if (_oph_io_server_frame_read(frame, buffer, OPH_IO_SERVER_MSG_LONG_LEN) <= 0)
+				break;
+			offset = *((unsigned long long *) buffer);
+			if (!segment->addr && _oph_io_server_segment_map(conn, segment))
+				break;
+			if (offset > segment->len || arg_len > segment->len - offset) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Argument exceeds shared memory segment\n");
+				logging(LOG_ERROR, __FILE__, __LINE__, "Argument exceeds shared memory segment\n");
+				break;
+			}
+			(*args)[n]->arg = (void *) (segment->addr + offset);
+			continue;
+		} else if ((conn->options & OPH_IO_SERVER_OPT_COMPRESSION) && STRCMP(buffer, OPH_IO_SERVER_MSG_ARG_DATA_COMPRESSED) == 0) {
+			//Read original length and uncompress arg directly from request
+			(*args)[n]->arg_type = OPH_QUERY_TYPE_BLOB;
+			if (arg_len < OPH_IO_SERVER_MSG_LONG_LEN || arg_len >= max_packet_length || _oph_io_server_frame_read(frame, buffer, OPH_IO_SERVER_MSG_LONG_LEN) <= 0)
+				break;
+			raw_len = *((unsigned long long *) buffer);
+			arg_len -= OPH_IO_SERVER_MSG_LONG_LEN;
+			if (!raw_len || raw_len >= max_packet_length || frame->pos + arg_len > frame->len) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Compressed argument is not valid\n");
+				logging(LOG_ERROR, __FILE__, __LINE__, "Compressed argument is not valid\n");
+				break;
+			}
+			gettimeofday(&start, NULL);
+			if (!((*args)[n]->arg = malloc(raw_len)) || oph_net_uncompress(frame->data + frame->pos, arg_len, (*args)[n]->arg, raw_len)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to uncompress argument\n");
+				logging(LOG_ERROR, __FILE__, __LINE__, "Unable to uncompress argument\n");
+				break;
+			}
+			_oph_io_server_compression_update(&(conn->received_stats), raw_len, OPH_IO_SERVER_MSG_LONG_LEN + arg_len, &start);
+			frame->pos += arg_len;
+			(*args)[n]->arg_length = raw_len;
+			continue;
+		} else if (STRCMP(buffer, OPH_IO_SERVER_MSG_ARG_DATA_LONG)) {
+			(*args)[n]->arg_type = OPH_QUERY_TYPE_LONG;
+		} else if (STRCMP(buffer, OPH_IO_SERVER_MSG_ARG_DATA_DOUBLE)) {
+			(*args)[n]->arg_type = OPH_QUERY_TYPE_DOUBLE;
+		} else if (STRCMP(buffer, OPH_IO_SERVER_MSG_ARG_DATA_NULL)) {
+			(*args)[n]->arg_type = OPH_QUERY_TYPE_NULL;
+		} else if (STRCMP(buffer, OPH_IO_SERVER_MSG_ARG_DATA_VARCHAR)) {
+			(*args)[n]->arg_type = OPH_QUERY_TYPE_VARCHAR;
+		} else if (STRCMP(buffer, OPH_IO_SERVER_MSG_ARG_DATA_BLOB)) {
+			(*args)[n]->arg_type = OPH_QUERY_TYPE_BLOB;
+		} else {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Argument type not recognized\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Argument type not recognized\n");
+			break;
+		}
+
+		//Read arg
+		if (arg_len >= max_packet_length || _oph_io_server_frame_read(frame, buffer, arg_len) <= 0)
+			break;
+		buffer[arg_len] = 0;
+
+		(*args)[n]->arg = (void *) memdup(buffer, arg_len);
+	}
+
+	//Check termination condition
+	if (n < arg_count) {
+		_oph_io_server_free_args(*args, arg_count, segment);
+		*args = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief               Decode and execute a query request ARG_NUM|QUERY_LEN|QUERY|DEV_LEN|DEV[|N_RUN|CURR_RUN|ARG1_LEN|ARG1_TYPE|ARG1|...], whose type has already been read
+ * \param conn          Connection related to client
+ * \param frame         Request being decoded
+ * \param line          Buffer of max_packet_length bytes
+ * \param result        Buffer of max_packet_length bytes
+ * \param dev_handle    Handler of the device used by last query; it is kept by the caller to be reused by following queries
+ * \return              0 if query has been executed, 1 if execution failed, -1 if request is malformed
+ */
+static int _oph_io_server_exec_query(oph_io_server_connection * conn, oph_io_server_frame * frame, char *line, char *result, oph_iostore_handler ** dev_handle)
+{
+#ifdef DEBUG
+	struct timeval s_time, e_time, t_time;
+	gettimeofday(&s_time, NULL);
+#endif
+	unsigned int arg_count = 0;
+	unsigned long long payload_len = 0, tot_run = 0, curr_run = 0;
+	oph_io_server_thread_status *status = &(conn->status);
+	oph_io_server_segment segment = { NULL, 0 };
+	oph_query_arg **args = NULL;
+	HASHTBL *query_args = NULL;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Setup query...\n");
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Setup query...\n");
+
+	//Read number of args
+	if (_oph_io_server_frame_read(frame, line, OPH_IO_SERVER_MSG_SHORT_LEN) <= 0)
+		return -1;
+	arg_count = *((unsigned int *) line) - 1;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Number of args: %u\n", arg_count);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Number of args: %u\n", arg_count);
+
+	//Read query
+	if (_oph_io_server_frame_read(frame, line, OPH_IO_SERVER_MSG_LONG_LEN) <= 0)
+		return -1;
+	payload_len = *((unsigned long long *) line);
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Query length: %llu\n", payload_len);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Query length: %llu\n", payload_len);
+	if (payload_len >= max_packet_length || _oph_io_server_frame_read(frame, line, payload_len) <= 0)
+		return -1;
+	line[payload_len] = 0;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Query is: %s - threadID: %lu\n", line, pthread_self());
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Query is: %s\n", line);
+
+	//Read device name
+	if (_oph_io_server_frame_read(frame, result, OPH_IO_SERVER_MSG_LONG_LEN) <= 0)
+		return -1;
+	payload_len = *((unsigned long long *) result);
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Device length: %llu\n", payload_len);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Device length: %llu\n", payload_len);
+	if (payload_len >= max_packet_length) {
+		//Request too long
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Request length is too big ...\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Request length is too big ...\n");
+		return -1;
+	}
+	if (_oph_io_server_frame_read(frame, result, payload_len) <= 0)
+		return -1;
+	result[payload_len] = 0;
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Device name: %s\n", result);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Device name: %s\n", result);
+
+	//TODO perform coerence check to verify device existance
+	if (!status->device || STRCMP(status->device, result)) {
+		if (status->device)
+			free(status->device);
+		status->device = (char *) strndup(result, strlen(result));
+		if (status->device == NULL) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
+			logging(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
+			return 1;
+		}
+		if (*dev_handle) {
+			oph_iostore_cleanup(*dev_handle);
+			*dev_handle = NULL;
+		}
+	}
+
+	//If complex query (with prepared statement) parse following arguments and save query status
+	if (arg_count > 0) {
+		//Decode complex part of message ...|N_RUN|CURR_RUN|ARG1_LEN|ARG1_TYPE|ARG1|...
+		if (_oph_io_server_frame_read(frame, result, OPH_IO_SERVER_MSG_LONG_LEN) <= 0)
+			return -1;
+		tot_run = *((unsigned long long *) result);
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Total runs: %llu\n", tot_run);
+		logging(LOG_DEBUG, __FILE__, __LINE__, "Total runs: %llu\n", tot_run);
+
+		if (_oph_io_server_frame_read(frame, result, OPH_IO_SERVER_MSG_LONG_LEN) <= 0)
+			return -1;
+		curr_run = *((unsigned long long *) result);
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Current run: %llu\n", curr_run);
+		logging(LOG_DEBUG, __FILE__, __LINE__, "Current run: %llu\n", curr_run);
+
+		//Check if current statement is already in progress
+		if (status->curr_stmt != NULL) {
+			if (curr_run > tot_run) {
+				pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", OPH_IO_SERVER_MSG_EXEC_QUERY);
+				logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", OPH_IO_SERVER_MSG_EXEC_QUERY);
+				return -1;
+			}
+			//Update statement status
+			status->curr_stmt->curr_run = curr_run;
+			status->curr_stmt->tot_run = tot_run;
+		} else {
+			if (curr_run > 1) {
+				pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", OPH_IO_SERVER_MSG_EXEC_QUERY);
+				logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", OPH_IO_SERVER_MSG_EXEC_QUERY);
+				return -1;
+			}
+			//Create first struct
+			status->curr_stmt = (oph_io_server_running_stmt *) calloc(1, sizeof(oph_io_server_running_stmt));
+			if (!status->curr_stmt) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+				logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+				return 1;
+			}
+			status->curr_stmt->tot_run = tot_run;
+			status->curr_stmt->curr_run = curr_run;
+		}
+
+		if (_oph_io_server_read_args(conn, frame, result, arg_count, &args, &segment)) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", OPH_IO_SERVER_MSG_EXEC_QUERY);
+			logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", OPH_IO_SERVER_MSG_EXEC_QUERY);
+			return -1;
+		}
+	}
+#ifdef DEBUG
+	gettimeofday(&e_time, NULL);
+	timeval_subtract(&t_time, &e_time, &s_time);
+	pmesg(LOG_INFO, __FILE__, __LINE__, "Setup query:\t Time %d,%06d sec\n", (int) t_time.tv_sec, (int) t_time.tv_usec);
+	gettimeofday(&s_time, NULL);
+#endif
+
+	if (oph_io_server_plan_cache_get_args(line, &query_args)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
+		_oph_io_server_free_args(args, arg_count, &segment);
+		return 1;
+	}
+#ifdef DEBUG
+	gettimeofday(&e_time, NULL);
+	timeval_subtract(&t_time, &e_time, &s_time);
+	pmesg(LOG_INFO, __FILE__, __LINE__, "Parse query %s:\t Time %d,%06d sec\n", line, (int) t_time.tv_sec, (int) t_time.tv_usec);
+	gettimeofday(&s_time, NULL);
+#endif
+
+	if (!*dev_handle && oph_iostore_setup(status->device, dev_handle) != 0) {
+		hashtbl_destroy(query_args);
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to setup iostorage\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to setup iostorage\n");
+		_oph_io_server_free_args(args, arg_count, &segment);
+		*dev_handle = NULL;
+		return 1;
+	}
+	//TODO if query is SELECT then set globally last result set
+	if (oph_io_server_dispatcher(&db_table, *dev_handle, status, args, query_args, plugin_table)) {
+		hashtbl_destroy(query_args);
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
+		_oph_io_server_free_args(args, arg_count, &segment);
+		return 1;
+	}
+#ifdef DEBUG
+	gettimeofday(&e_time, NULL);
+	timeval_subtract(&t_time, &e_time, &s_time);
+	pmesg(LOG_INFO, __FILE__, __LINE__, "Exec query %s:\t Time %d,%06d sec\n", line, (int) t_time.tv_sec, (int) t_time.tv_usec);
+#endif
+
+	hashtbl_destroy(query_args);
+	//Delete temp result set
+	_oph_io_server_free_args(args, arg_count, &segment);
+
+	return 0;
+}
+
+/**
+ * \brief               Decode and execute a batch of queries FLAGS|QUERY_NUM|QUERY1|QUERY2|..., where each query is an exec query request, whose type has already been read.
+ *                      Queries are executed in order and the reply TYPE|QUERY_NUM|STATUS1|STATUS2|... is sent to the client
+ * \param conn          Connection related to client
+ * \param frame         Request being decoded
+ * \param line          Buffer of max_packet_length bytes
+ * \param result        Buffer of max_packet_length bytes
+ * \return              0 if reply has been sent, non-0 if request is malformed or reply cannot be sent
+ */
+static int _oph_io_server_exec_batch(oph_io_server_connection * conn, oph_io_server_frame * frame, char *line, char *result)
+{
+	unsigned int flags = 0, query_num = 0, n = 0;
+	char *reply = NULL, failed = 0;
+	oph_iostore_handler *dev_handle = NULL;
+	int res = 0;
+
+	if (_oph_io_server_frame_read(frame, line, OPH_IO_SERVER_MSG_SHORT_LEN) <= 0)
+		return -1;
+	flags = *((unsigned int *) line);
+	if (_oph_io_server_frame_read(frame, line, OPH_IO_SERVER_MSG_SHORT_LEN) <= 0)
+		return -1;
+	query_num = *((unsigned int *) line);
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Number of queries in batch: %u\n", query_num);
+	logging(LOG_DEBUG, __FILE__, __LINE__, "Number of queries in batch: %u\n", query_num);
+
+	//Reply TYPE|QUERY_NUM|STATUS1|STATUS2|...
+	reply = (char *) malloc((OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN + query_num) * sizeof(char));
+	if (!reply) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
+		return -1;
+	}
+	memcpy(reply, OPH_IO_SERVER_MSG_BATCH_QUERY, OPH_IO_SERVER_MSG_TYPE_LEN);
+	memcpy(reply + OPH_IO_SERVER_MSG_TYPE_LEN, (void *) &query_num, OPH_IO_SERVER_MSG_SHORT_LEN);
+	memset(reply + OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN, OPH_IO_SERVER_BATCH_SKIPPED, query_num);
+
+	for (n = 0; n < query_num; n++) {
+		if (_oph_io_server_frame_read(frame, line, OPH_IO_SERVER_MSG_TYPE_LEN) <= 0 || strncmp(line, OPH_IO_SERVER_MSG_EXEC_QUERY, OPH_IO_SERVER_MSG_TYPE_LEN)) {
+			res = -1;
+			break;
+		}
+		//Queries following a failed one are skipped on request: they are neither decoded nor executed, since the rest of the frame is discarded, and they are reported as skipped
+		if (failed && (flags & OPH_IO_SERVER_BATCH_STOP_ON_ERROR)) {
+			frame->pos = frame->len;
+			break;
+		}
+		if ((res = _oph_io_server_exec_query(conn, frame, line, result, &dev_handle)) < 0)
+			break;
+		if (res) {
+			//Statements interrupted by the failure cannot be resumed
+			_oph_io_server_free_stmt(&(conn->status));
+			failed = 1;
+		}
+		reply[OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN + n] = res ? OPH_IO_SERVER_BATCH_FAILED : OPH_IO_SERVER_BATCH_DONE;
+		res = 0;
 	}
+	if (dev_handle)
+		oph_iostore_cleanup(dev_handle);
+
+	if (!res) {
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %u bytes\n", OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN + query_num);
+		logging(LOG_DEBUG, __FILE__, __LINE__, "Sending %u bytes\n", OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN + query_num);
+		if (oph_net_writen(conn->sockfd, reply, OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN + query_num) !=
+		    (ssize_t) (OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN + query_num)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+			logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+			res = -1;
+		}
+	}
+	free(reply);
+
+	return res;
+}
 
-	char header[OPH_IO_SERVER_MSG_TYPE_LEN + 1], buffer[OPH_IO_SERVER_MAX_DOUBLE_LEN];
+/**
+ * \brief               Internal function used to answer a request that cannot be served
+ * \param sockfd        Socket of the connection
+ * \param tagged        Flag set if the request has a request ID, whose header has already been sent
+ * \return              0 if the connection can still be used, non-0 otherwise
+ */
+static int _oph_io_server_reply_error(int sockfd, char tagged)
+{
+	if (oph_io_server_send_error(sockfd))
+		return -1;
+	//The error of a tagged request refers to its request ID only, so the other requests pipelined on the connection are still served
+	return tagged ? 0 : -1;
+}
+
+int oph_io_server_serve_request(oph_io_server_connection * conn, unsigned long long frame_len, char *line, char *result)
+{
+	if (!conn || !line || !result) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		return -1;
+	}
+
+	int sockfd = conn->sockfd;
+	char header[OPH_IO_SERVER_MSG_TYPE_LEN + 1];
 	int res;
 	int m = 0;
+	int ret = -1;
+	char tagged = 0;
 
 #ifdef DEBUG
 	//Total Exec time evaluate
@@ -143,60 +1195,34 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 	struct timeval s_time, e_time, t_time;
 #endif
 
-	//Status of thread
-	oph_io_server_thread_status global_status;
-	global_status.current_db = NULL;
-	global_status.last_result_set = NULL;
-	global_status.delete_only_rs = 0;
-	global_status.device = NULL;
-	global_status.curr_stmt = NULL;
+	//Status of the session
+	oph_io_server_thread_status *global_status = &(conn->status);
 
-	oph_metadb_db_row *db_row = NULL;
+	//Request could release the result set sent with zero-copy, so its pages have to be released by the kernel
+	if (conn->zerocopy && oph_net_zerocopy_wait(sockfd, &(conn->zerocopy_sends), OPH_IO_SERVER_ZEROCOPY_TIMEOUT)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Zero-copy transmissions on socket %d not completed: data will be copied\n", sockfd);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Zero-copy transmissions on socket %d not completed: data will be copied\n", sockfd);
+		conn->zerocopy = 0;
+	}
 
-	//Poll socket 
-	int rv;
-	struct pollfd ufds[1];
+	//Request to be decoded
+	oph_io_server_frame frame;
+	frame.data = conn->buffer;
+	frame.len = frame_len;
+	frame.pos = 0;
 
-	ufds[0].fd = sockfd;
-	ufds[0].events = POLLIN;	// check for normal or out-of-band
+	oph_metadb_db_row *db_row = NULL;
 
-	unsigned long long current_threshold = 0;
-	char *result_buffer = NULL;
-	char *tmp_buffer = NULL;
-	unsigned long long k = 0, i = 0;
-	unsigned int j = 0, n = 0;
-	unsigned long long size = 0;
-	unsigned int num_fields = 0;
+	unsigned int j = 0;
 	unsigned long long payload_len = 0;
-	unsigned int arg_count = 0;
-	unsigned long long tot_run = 0, curr_run = 0;
 
-	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a query from socket %d...\n", sockfd);
-	logging(LOG_DEBUG, __FILE__, __LINE__, "Waiting for a query from socket %d...\n", sockfd);
-	for (;;) {
+	do {
 #ifdef DEBUG
 		//Get time from first call
 		gettimeofday(&start_time, NULL);
 #endif
-		// wait for events on the sockets, ttl second timeout
-		rv = poll(ufds, 1, client_ttl * 1000);
 
-		if (rv == -1) {
-			pmesg(LOG_WARNING, __FILE__, __LINE__, "Error in polling socket: %d\n", errno);
-			logging(LOG_WARNING, __FILE__, __LINE__, "Error in polling socket: %d\n", errno);
-			break;
-		} else if (rv == 0) {
-			pmesg(LOG_WARNING, __FILE__, __LINE__, "Timeout occured\n");
-			logging(LOG_WARNING, __FILE__, __LINE__, "Timeout occured\n");
-			break;
-		}
-		if (ufds[0].revents != POLLIN) {
-			pmesg(LOG_WARNING, __FILE__, __LINE__, "Connection closed with error\n");
-			logging(LOG_WARNING, __FILE__, __LINE__, "Connection closed with error\n");
-			break;
-		}
-
-		res = oph_net_readn(sockfd, line, OPH_IO_SERVER_MSG_TYPE_LEN);
+		res = _oph_io_server_frame_read(&frame, line, OPH_IO_SERVER_MSG_TYPE_LEN);
 		if (res > 0) {
 			//Request Manager section: handle request and call the correct function
 
@@ -212,6 +1238,29 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 			//Decode message and find payload length
 			snprintf(header, OPH_IO_SERVER_MSG_TYPE_LEN + 1, "%s", line);
 
+			if (STRCMP(header, OPH_IO_SERVER_MSG_TAGGED) == 0) {
+				//Tagged request: reply is preceded by TYPE|REQUEST_ID
+				memcpy(result, OPH_IO_SERVER_MSG_TAGGED_REPLY, OPH_IO_SERVER_MSG_TYPE_LEN);
+				if (_oph_io_server_frame_read(&frame, result + OPH_IO_SERVER_MSG_TYPE_LEN, OPH_IO_SERVER_MSG_SHORT_LEN) <= 0
+				    || _oph_io_server_frame_read(&frame, line, OPH_IO_SERVER_MSG_TYPE_LEN) <= 0)
+					break;
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Request ID: %u\n", *((unsigned int *) (result + OPH_IO_SERVER_MSG_TYPE_LEN)));
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Request ID: %u\n", *((unsigned int *) (result + OPH_IO_SERVER_MSG_TYPE_LEN)));
+#ifdef MSG_MORE
+				//The header is sent together with the beginning of the reply
+				if (send(sockfd, result, OPH_IO_SERVER_TAGGED_HEADER_LEN, MSG_MORE) != OPH_IO_SERVER_TAGGED_HEADER_LEN) {
+#else
+				if (oph_net_writen(sockfd, result, OPH_IO_SERVER_TAGGED_HEADER_LEN) != OPH_IO_SERVER_TAGGED_HEADER_LEN) {
+#endif
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					break;
+				}
+				line[OPH_IO_SERVER_MSG_TYPE_LEN] = 0;
+				snprintf(header, OPH_IO_SERVER_MSG_TYPE_LEN + 1, "%s", line);
+				tagged = 1;
+			}
+
 			//Select operation
 			if (STRCMP(header, OPH_IO_SERVER_MSG_PING) == 0) {
 				//Answer to ping
@@ -224,12 +1273,39 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				}
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				ret = 0;
+			} else if (STRCMP(header, OPH_IO_SERVER_MSG_PING_OPTIONS) == 0) {
+				//Answer to ping with the options supported among the requested ones
+				res = _oph_io_server_frame_read(&frame, line, OPH_IO_SERVER_MSG_SHORT_LEN);
+				if (res <= 0)
+					break;
+				memcpy(&j, line, OPH_IO_SERVER_MSG_SHORT_LEN);
+				conn->options = j & OPH_IO_SERVER_SUPPORTED_OPTIONS;
+				//Shared memory can be used only by clients running on the same node
+				if (!conn->local)
+					conn->options &= ~OPH_IO_SERVER_OPT_SHARED_MEMORY;
+				if (!oph_net_compression_supported())
+					conn->options &= ~OPH_IO_SERVER_OPT_COMPRESSION;
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Requested options %u, enabled options %u\n", j, conn->options);
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Requested options %u, enabled options %u\n", j, conn->options);
+
+				m = snprintf(result, strlen(OPH_IO_SERVER_MSG_PING_OPTIONS) + 1, OPH_IO_SERVER_MSG_PING_OPTIONS);
+				memcpy(result + m, (void *) &(conn->options), OPH_IO_SERVER_MSG_SHORT_LEN);
+				m += OPH_IO_SERVER_MSG_SHORT_LEN;
+				if (oph_net_writen(sockfd, (void *) result, m) != m) {
+					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
+					break;
+				}
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				ret = 0;
 			} else if (STRCMP(header, OPH_IO_SERVER_MSG_USE_DB) == 0) {
 				//Set database
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Setting default database...\n");
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Setting default database...\n");
 				//Read payload len
-				res = oph_net_readn(sockfd, line, OPH_IO_SERVER_MSG_LONG_LEN);
+				res = _oph_io_server_frame_read(&frame, line, OPH_IO_SERVER_MSG_LONG_LEN);
 				if (res <= 0)
 					break;
 				line[OPH_IO_SERVER_MSG_LONG_LEN] = 0;
@@ -238,7 +1314,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Db name length: %llu\n", payload_len);
 
 				//Read database name
-				res = oph_net_readn(sockfd, line, payload_len);
+				res = _oph_io_server_frame_read(&frame, line, payload_len);
 				if (res <= 0)
 					break;
 				line[payload_len] = 0;
@@ -246,7 +1322,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Database name: %s\n", line);
 
 				//Read payload len
-				res = oph_net_readn(sockfd, result, OPH_IO_SERVER_MSG_LONG_LEN);
+				res = _oph_io_server_frame_read(&frame, result, OPH_IO_SERVER_MSG_LONG_LEN);
 				if (res <= 0)
 					break;
 				result[OPH_IO_SERVER_MSG_LONG_LEN] = 0;
@@ -255,7 +1331,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Device length: %llu\n", payload_len);
 
 				//Read device name
-				res = oph_net_readn(sockfd, result, payload_len);
+				res = _oph_io_server_frame_read(&frame, result, payload_len);
 				if (res <= 0)
 					break;
 				result[payload_len] = 0;
@@ -263,10 +1339,10 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Device name: %s\n", result);
 
 				//TODO perform coerence check to verify device existance
-				if (global_status.device)
-					free(global_status.device);
-				global_status.device = (char *) strndup(result, strlen(result));
-				if (global_status.device == NULL) {
+				if (global_status->device)
+					free(global_status->device);
+				global_status->device = (char *) strndup(result, strlen(result));
+				if (global_status->device == NULL) {
 					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 					break;
@@ -280,7 +1356,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				}
 
 				if (db_table != NULL) {
-					if (oph_metadb_find_db(db_table, line, global_status.device, &db_row) || db_row == NULL) {
+					if (oph_metadb_find_db(db_table, line, global_status->device, &db_row) || db_row == NULL) {
 						if (pthread_rwlock_unlock(&rwlock) != 0) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to unlock mutex\n");
 							logging(LOG_ERROR, __FILE__, __LINE__, "Unable to unlock mutex\n");
@@ -299,10 +1375,10 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 							break;
 						}
 						//Set current db name
-						if (global_status.current_db)
-							free(global_status.current_db);
-						global_status.current_db = (char *) strndup(line, strlen(line));
-						if (global_status.current_db == NULL) {
+						if (global_status->current_db)
+							free(global_status->current_db);
+						global_status->current_db = (char *) strndup(line, strlen(line));
+						if (global_status->current_db == NULL) {
 							pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 							logging(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
 							oph_io_server_send_error(sockfd);
@@ -333,460 +1409,54 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				}
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				ret = 0;
 			} else if (STRCMP(header, OPH_IO_SERVER_MSG_RESULT) == 0) {
 				//Get resultset
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Retrieving result set...\n");
 
-				if (global_status.last_result_set == NULL) {
+				if (global_status->last_result_set == NULL) {
 					pmesg(LOG_WARNING, __FILE__, __LINE__, "Result set of last query is corrupted\n");
 					logging(LOG_WARNING, __FILE__, __LINE__, "Result set of last query is corrupted\n");
-					oph_io_server_send_error(sockfd);
+					ret = _oph_io_server_reply_error(sockfd, tagged);
 					break;
 				}
-				//Build request packet TYPE|PAYLOAD_LENGTH|NUM_ROWS|NUM_FIELDS|PAYLOAD
-				current_threshold = max_packet_length;
-				result_buffer = (char *) calloc(current_threshold, sizeof(char));
-				if (!result_buffer) {
-					pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-					logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-					oph_io_server_send_error(sockfd);
-					break;
-				}
-				tmp_buffer = NULL;
-
-				m = snprintf(result_buffer, strlen(OPH_IO_SERVER_MSG_RESULT) + 1, OPH_IO_SERVER_MSG_RESULT);
-				k = m + sizeof(unsigned long long) + sizeof(unsigned long long) + sizeof(unsigned int);
-
-				i = 0;
-				j = 0;
-				size = 0;
-				num_fields = global_status.last_result_set->field_num;
-
-				if (k >= current_threshold) {
-					current_threshold *= 2;
-					tmp_buffer = (char *) realloc(result_buffer, current_threshold * sizeof(char));
-					if (!tmp_buffer) {
-						pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-						logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-						oph_io_server_send_error(sockfd);
-						free(result_buffer);
-						break;
-					}
-					result_buffer = tmp_buffer;
-				}
-				//If non-empty record set
-				if (global_status.last_result_set->record_set != NULL) {
-
-					while (global_status.last_result_set->record_set[i]) {
-						//Send each row of result set
-
-						//TODO send also field name
-						for (j = 0; j < num_fields; j++) {
-							//Check field type
-							if (global_status.last_result_set->field_type[j] != OPH_IOSTORE_STRING_TYPE) {
-								//Convert to string
-								if (global_status.last_result_set->field_type[j] == OPH_IOSTORE_LONG_TYPE) {
-									snprintf(buffer, OPH_IO_SERVER_MAX_LONG_LEN, "%llu",
-										 *((unsigned long long *) global_status.last_result_set->record_set[i]->field[j]));
-								} else {
-									snprintf(buffer, OPH_IO_SERVER_MAX_DOUBLE_LEN, "%f", *((double *) global_status.last_result_set->record_set[i]->field[j]));
-								}
-								size = strlen(buffer) + 1;
-
-								//Check current size
-								if ((k + size + sizeof(unsigned long long)) >= current_threshold) {
-									current_threshold *= 2;
-									tmp_buffer = (char *) realloc(result_buffer, current_threshold * sizeof(char));
-									if (!tmp_buffer) {
-										pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-										logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-										oph_io_server_send_error(sockfd);
-										free(result_buffer);
-										break;
-									}
-									result_buffer = tmp_buffer;
-								}
-
-								memcpy(result_buffer + k, (void *) &size, sizeof(unsigned long long));
-								k += sizeof(unsigned long long);
-								memcpy(result_buffer + k, (void *) buffer, size);
-								k += size;
-							} else {
-								//String and binary values are already char*
-
-								//Check current size
-								if ((k + global_status.last_result_set->record_set[i]->field_length[j] + sizeof(unsigned long long)) >= current_threshold) {
-									current_threshold *= 2;
-									tmp_buffer = (char *) realloc(result_buffer, current_threshold * sizeof(char));
-									if (!tmp_buffer) {
-										pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-										logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-										oph_io_server_send_error(sockfd);
-										free(result_buffer);
-										break;
-									}
-									result_buffer = tmp_buffer;
-								}
-
-								memcpy(result_buffer + k, (void *) &(global_status.last_result_set->record_set[i]->field_length[j]), sizeof(unsigned long long));
-								k += sizeof(unsigned long long);
-								memcpy(result_buffer + k, (void *) (global_status.last_result_set->record_set[i]->field[j]),
-								       global_status.last_result_set->record_set[i]->field_length[j]);
-								k += global_status.last_result_set->record_set[i]->field_length[j];
-							}
-							pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arg[%d] progressive length is: %lld\n", j, k);
-						}
-						i++;
-					}
-				}
-				payload_len = k - (m + sizeof(unsigned long long) + sizeof(unsigned long long) + sizeof(unsigned int));
-				memcpy(result_buffer + m, (void *) &payload_len, sizeof(unsigned long long));
-				m += sizeof(unsigned long long);
-				memcpy(result_buffer + m, (void *) &i, sizeof(unsigned long long));
-				m += sizeof(unsigned long long);
-				memcpy(result_buffer + m, (void *) &num_fields, sizeof(unsigned int));
-				//Transfer result set
-
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", k);
-				logging(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", k);
-
-				if (write(sockfd, (void *) result_buffer, k) != (ssize_t) k) {
-					pmesg(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
-					logging(LOG_ERROR, __FILE__, __LINE__, "Error while writing to socket\n");
-					free(result_buffer);
+				if (_oph_io_server_send_result(sockfd, global_status->last_result_set, conn->options, conn->zerocopy ? &(conn->zerocopy_sends) : NULL, 0, &(conn->sent_stats)))
 					break;
-				}
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
 				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				ret = 0;
+			} else if (STRCMP(header, OPH_IO_SERVER_MSG_RESULT_STREAM) == 0) {
+				//Get resultset in fixed-size parts
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Streaming result set...\n");
 
-				free(result_buffer);
-			} else if (STRCMP(header, OPH_IO_SERVER_MSG_EXEC_QUERY) == 0) {
-
-#ifdef DEBUG
-				gettimeofday(&s_time, NULL);
-#endif
-				//Execute query
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Setup query...\n");
-				logging(LOG_DEBUG, __FILE__, __LINE__, "Setup query...\n");
-				//Read payload len
-				res = oph_net_readn(sockfd, line, OPH_IO_SERVER_MSG_SHORT_LEN);
-				if (res <= 0)
-					break;
-				line[OPH_IO_SERVER_MSG_SHORT_LEN] = 0;
-				arg_count = *((unsigned int *) line) - 1;
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Number of args: %u\n", arg_count);
-				logging(LOG_DEBUG, __FILE__, __LINE__, "Number of args: %u\n", arg_count);
-
-				//Read payload len
-				res = oph_net_readn(sockfd, line, OPH_IO_SERVER_MSG_LONG_LEN);
-				if (res <= 0)
-					break;
-				line[OPH_IO_SERVER_MSG_LONG_LEN] = 0;
-				payload_len = *((unsigned long long *) line);
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Query length: %llu\n", payload_len);
-				logging(LOG_DEBUG, __FILE__, __LINE__, "Query length: %llu\n", payload_len);
-
-				//Read query
-				res = oph_net_readn(sockfd, line, payload_len);
-				if (res <= 0)
-					break;
-				line[payload_len] = 0;
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Query is: %s - threadID: %lu\n", line, tid);
-				logging(LOG_DEBUG, __FILE__, __LINE__, "Query is: %s\n", line);
-
-				//Read payload len
-				res = oph_net_readn(sockfd, result, OPH_IO_SERVER_MSG_LONG_LEN);
-				if (res <= 0)
-					break;
-				result[OPH_IO_SERVER_MSG_LONG_LEN] = 0;
-				payload_len = *((unsigned long long *) result);
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Device length: %llu\n", payload_len);
-				logging(LOG_DEBUG, __FILE__, __LINE__, "Device length: %llu\n", payload_len);
-
-				if (payload_len >= max_packet_length) {
-					//Request too long
-					pmesg(LOG_WARNING, __FILE__, __LINE__, "Request length is too big ...\n");
-					logging(LOG_WARNING, __FILE__, __LINE__, "Request length is too big ...\n");
-					oph_io_server_send_error(sockfd);
-					break;
-				}
-				//Read device name
-				res = oph_net_readn(sockfd, result, payload_len);
-				if (res <= 0)
-					break;
-				result[payload_len] = 0;
-				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Device name: %s\n", result);
-				logging(LOG_DEBUG, __FILE__, __LINE__, "Device name: %s\n", result);
-
-				//TODO perform coerence check to verify device existance
-				if (global_status.device)
-					free(global_status.device);
-				global_status.device = (char *) strndup(result, strlen(result));
-				if (global_status.device == NULL) {
-					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
-					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to set default device: %s\n", result);
+				if (global_status->last_result_set == NULL) {
+					pmesg(LOG_WARNING, __FILE__, __LINE__, "Result set of last query is corrupted\n");
+					logging(LOG_WARNING, __FILE__, __LINE__, "Result set of last query is corrupted\n");
+					ret = _oph_io_server_reply_error(sockfd, tagged);
 					break;
 				}
 
-				oph_query_arg **args = NULL;
-
-				n = 0;
-
-				//If complex query (with prepared statement) parse following arguments and save query status
-				if (arg_count > 0) {
-					//Set status (save current/total runs + alloc argument array) + status flag + alloc result set container 
-					//Decode complex part of message ...|N_RUN|CURR_RUN|ARG1_LEN|ARG1_TYPE|ARG1|...
-
-					//Read number of runs
-					res = oph_net_readn(sockfd, result, OPH_IO_SERVER_MSG_LONG_LEN);
-					if (res <= 0)
-						break;
-					result[OPH_IO_SERVER_MSG_LONG_LEN] = 0;
-					tot_run = *((unsigned long long *) result);
-					pmesg(LOG_DEBUG, __FILE__, __LINE__, "Total runs: %llu\n", tot_run);
-					logging(LOG_DEBUG, __FILE__, __LINE__, "Total runs: %llu\n", tot_run);
-
-					//Read number of runs
-					res = oph_net_readn(sockfd, result, OPH_IO_SERVER_MSG_LONG_LEN);
-					if (res <= 0)
-						break;
-					result[OPH_IO_SERVER_MSG_LONG_LEN] = 0;
-					curr_run = *((unsigned long long *) result);
-					pmesg(LOG_DEBUG, __FILE__, __LINE__, "Current run: %llu\n", curr_run);
-					logging(LOG_DEBUG, __FILE__, __LINE__, "Current run: %llu\n", curr_run);
-
-					//Check if current statement is already in progress
-					if (global_status.curr_stmt != NULL) {
-						if (curr_run > tot_run) {
-							//Corrupted section then exit
-							pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
-							logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
-							oph_io_server_send_error(sockfd);
-							break;
-						} else {
-							//Decode message and update statement status
-							global_status.curr_stmt->curr_run = curr_run;
-							global_status.curr_stmt->tot_run = tot_run;
-
-							args = (oph_query_arg **) calloc(arg_count + 1, sizeof(oph_query_arg *));
-							if (!args) {
-								pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-								logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-								oph_io_server_send_error(sockfd);
-								break;
-							}
-
-							for (n = 0; n < arg_count; n++) {
-
-								args[n] = (oph_query_arg *) malloc(1 * sizeof(oph_query_arg));
-								if (!args[n]) {
-									pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-									logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-									oph_io_server_send_error(sockfd);
-									break;
-								}
-								//Read arg length
-								res = oph_net_readn(sockfd, result, OPH_IO_SERVER_MSG_LONG_LEN);
-								if (res <= 0)
-									break;
-								result[OPH_IO_SERVER_MSG_LONG_LEN] = 0;
-								payload_len = *((unsigned long long *) result);
-								pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arg %d len: %d\n", n, payload_len);
-								logging(LOG_DEBUG, __FILE__, __LINE__, "Arg %d len: %d\n", n, payload_len);
-
-								args[n]->arg_length = payload_len;
-								args[n]->arg_is_null = 0;
-
-								//Read arg type
-								res = oph_net_readn(sockfd, result, OPH_IO_SERVER_MSG_TYPE_LEN);
-								if (res <= 0)
-									break;
-								result[OPH_IO_SERVER_MSG_TYPE_LEN] = 0;
-								pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arg %d type: %d\n", n, result);
-								logging(LOG_DEBUG, __FILE__, __LINE__, "Arg %d type: %d\n", n, result);
-
-								if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_LONG)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_LONG;
-								} else if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_DOUBLE)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_DOUBLE;
-								} else if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_NULL)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_NULL;
-								} else if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_VARCHAR)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_VARCHAR;
-								} else if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_BLOB)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_BLOB;
-								} else {
-									pmesg(LOG_ERROR, __FILE__, __LINE__, "Argument type not recognized\n");
-									logging(LOG_ERROR, __FILE__, __LINE__, "Argument type not recognized\n");
-									break;
-								}
-
-								//Read arg
-								res = oph_net_readn(sockfd, result, payload_len);
-								if (res <= 0)
-									break;
-								result[payload_len] = 0;
-
-								args[n]->arg = (void *) memdup(result, payload_len);
-
-							}
-
-							//Check termination condition
-							if (n < arg_count) {
-								//Corrupted section then exit
-								pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
-								logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
-								oph_io_server_send_error(sockfd);
-								oph_io_server_free_query_args(args, arg_count);
-								break;
-							}
-						}
-					}
-					//Create curr_stmt
-					else {
-						if (curr_run > 1) {
-							//Corrupted section then exit
-							pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
-							logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
-							oph_io_server_send_error(sockfd);
-							break;
-						} else {
-							//Create first struct 
-							global_status.curr_stmt = (oph_io_server_running_stmt *) malloc(1 * sizeof(oph_io_server_running_stmt));
-							global_status.curr_stmt->tot_run = tot_run;
-							global_status.curr_stmt->curr_run = curr_run;
-							global_status.curr_stmt->partial_result_set = NULL;
-							global_status.curr_stmt->device = NULL;
-							global_status.curr_stmt->frag = NULL;
-							global_status.curr_stmt->size = 0;
-							global_status.curr_stmt->mi_prev_rows = 0;
-
-							args = (oph_query_arg **) calloc(arg_count + 1, sizeof(oph_query_arg *));
-
-							for (n = 0; n < arg_count; n++) {
-								args[n] = (oph_query_arg *) malloc(1 * sizeof(oph_query_arg));
-								if (!args[n]) {
-									pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-									logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate buffer for communications\n");
-									oph_io_server_send_error(sockfd);
-									break;
-								}
-								//Read arg length
-								res = oph_net_readn(sockfd, result, OPH_IO_SERVER_MSG_LONG_LEN);
-								if (res <= 0)
-									break;
-								result[OPH_IO_SERVER_MSG_LONG_LEN] = 0;
-								payload_len = *((unsigned long long *) result);
-								pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arg %d len: %d\n", n, payload_len);
-								logging(LOG_DEBUG, __FILE__, __LINE__, "Arg %d len: %d\n", n, payload_len);
-
-								args[n]->arg_length = payload_len;
-								args[n]->arg_is_null = 0;
-
-								//Read arg type
-								res = oph_net_readn(sockfd, result, OPH_IO_SERVER_MSG_TYPE_LEN);
-								if (res <= 0)
-									break;
-								result[OPH_IO_SERVER_MSG_TYPE_LEN] = 0;
-								pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arg %d type: %d\n", n, result);
-								logging(LOG_DEBUG, __FILE__, __LINE__, "Arg %d type: %d\n", n, result);
-
-								if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_LONG)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_LONG;
-								} else if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_DOUBLE)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_DOUBLE;
-								} else if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_NULL)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_NULL;
-								} else if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_VARCHAR)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_VARCHAR;
-								} else if (STRCMP(result, OPH_IO_SERVER_MSG_ARG_DATA_BLOB)) {
-									args[n]->arg_type = OPH_QUERY_TYPE_BLOB;
-								} else {
-									pmesg(LOG_ERROR, __FILE__, __LINE__, "Argument type not recognized\n");
-									logging(LOG_ERROR, __FILE__, __LINE__, "Argument type not recognized\n");
-									break;
-								}
-
-								//Read arg
-								res = oph_net_readn(sockfd, result, payload_len);
-								if (res <= 0)
-									break;
-								result[payload_len] = 0;
-								pmesg(LOG_DEBUG, __FILE__, __LINE__, "Arg %d type: %d\n", n, result);
-								logging(LOG_DEBUG, __FILE__, __LINE__, "Arg %d type: %d\n", n, result);
-
-								args[n]->arg = (void *) memdup(result, payload_len);
-
-							}
-							//Check termination condition
-							if (n < arg_count) {
-								//Corrupted section then exit
-								pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
-								logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
-								oph_io_server_send_error(sockfd);
-								oph_io_server_free_query_args(args, arg_count);
-								break;
-							}
-						}
-					}
-				}
-#ifdef DEBUG
-				gettimeofday(&e_time, NULL);
-				timeval_subtract(&t_time, &e_time, &s_time);
-				pmesg(LOG_INFO, __FILE__, __LINE__, "Setup query:\t Time %d,%06d sec\n", (int) t_time.tv_sec, (int) t_time.tv_usec);
-				gettimeofday(&s_time, NULL);
-#endif
-				//Define global variables
-				HASHTBL *query_args = NULL;
-
-				if (oph_query_parser(line, &query_args)) {
-					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
-					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
-					oph_io_server_send_error(sockfd);
-					oph_io_server_free_query_args(args, arg_count);
+				if (_oph_io_server_send_result(sockfd, global_status->last_result_set, conn->options, conn->zerocopy ? &(conn->zerocopy_sends) : NULL, 1, &(conn->sent_stats)))
 					break;
-				}
-#ifdef DEBUG
-				gettimeofday(&e_time, NULL);
-				timeval_subtract(&t_time, &e_time, &s_time);
-				pmesg(LOG_INFO, __FILE__, __LINE__, "Parse query %s:\t Time %d,%06d sec\n", line, (int) t_time.tv_sec, (int) t_time.tv_usec);
-				gettimeofday(&s_time, NULL);
-#endif
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				ret = 0;
+			} else if (STRCMP(header, OPH_IO_SERVER_MSG_EXEC_QUERY) == 0) {
 
+				//Execute query
 				oph_iostore_handler *dev_handle = NULL;
-
-				if (oph_iostore_setup(global_status.device, &dev_handle) != 0) {
-					hashtbl_destroy(query_args);
-					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to setup iostorage\n");
-					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to setup iostorage\n");
-					oph_io_server_send_error(sockfd);
-					oph_io_server_free_query_args(args, arg_count);
-					break;
-				}
-				//TODO if query is SELECT then set globally last result set
-				if (oph_io_server_dispatcher(&db_table, dev_handle, &global_status, args, query_args, plugin_table)) {
-
+				res = _oph_io_server_exec_query(conn, &frame, line, result, &dev_handle);
+				if (dev_handle)
 					oph_iostore_cleanup(dev_handle);
-					hashtbl_destroy(query_args);
-					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
-					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to run query\n");
-					oph_io_server_send_error(sockfd);
-					oph_io_server_free_query_args(args, arg_count);
+				if (res) {
+					//Statements interrupted by the failure cannot be resumed
+					_oph_io_server_free_stmt(global_status);
+					ret = _oph_io_server_reply_error(sockfd, tagged);
 					break;
 				}
-
-				oph_iostore_cleanup(dev_handle);
-
 #ifdef DEBUG
-				gettimeofday(&e_time, NULL);
-				timeval_subtract(&t_time, &e_time, &s_time);
-				pmesg(LOG_INFO, __FILE__, __LINE__, "Exec query %s:\t Time %d,%06d sec\n", line, (int) t_time.tv_sec, (int) t_time.tv_usec);
 				gettimeofday(&s_time, NULL);
 #endif
-				hashtbl_destroy(query_args);
-				//Delete temp result set
-				oph_io_server_free_query_args(args, arg_count);
-
 				//Build response packet TYPE
 				m = snprintf(line, strlen(OPH_IO_SERVER_MSG_EXEC_QUERY) + 1, OPH_IO_SERVER_MSG_EXEC_QUERY);
 				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Sending %d bytes\n", m);
@@ -804,11 +1474,26 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 				timeval_subtract(&t_time, &e_time, &s_time);
 				pmesg(LOG_INFO, __FILE__, __LINE__, "Reply:\t Time %d,%06d sec\n", (int) t_time.tv_sec, (int) t_time.tv_usec);
 #endif
+				ret = 0;
+
+			} else if (STRCMP(header, OPH_IO_SERVER_MSG_BATCH_QUERY) == 0) {
+				//Execute a batch of queries and answer with the status of each one
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Executing query batch...\n");
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Executing query batch...\n");
+				if (_oph_io_server_exec_batch(conn, &frame, line, result)) {
+					pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
+					logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
+					ret = _oph_io_server_reply_error(sockfd, tagged);
+					break;
+				}
+				pmesg(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				logging(LOG_DEBUG, __FILE__, __LINE__, "Result sent\n");
+				ret = 0;
 
 			} else {
 				pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
 				logging(LOG_WARNING, __FILE__, __LINE__, "Unable to understand request '%s'...\n", header);
-				oph_io_server_send_error(sockfd);
+				ret = _oph_io_server_reply_error(sockfd, tagged);
 				break;
 			}
 		} else if (res <= 0)
@@ -819,10 +1504,7 @@ void oph_io_server_thread(int sockfd, pthread_t tid)
 		timeval_subtract(&total_time, &end_time, &start_time);
 		pmesg(LOG_INFO, __FILE__, __LINE__, "Total reply:\t Time %d,%06d sec\n", (int) total_time.tv_sec, (int) total_time.tv_usec);
 #endif
-	}
-
-	oph_io_server_free_status(&global_status);
-	free(result);
-	free(line);
+	} while (0);
 
+	return ret;
 }
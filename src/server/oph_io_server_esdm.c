@@ -19,6 +19,7 @@
 #define _GNU_SOURCE
 
 #include "oph_io_server_query_manager.h"
+#include "oph_io_server_reader.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -2034,6 +2035,11 @@ int _oph_ioserver_esdm_read(char *src_path, char *measure_name, unsigned long lo
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
+	//Containers are read by a reader process, if available, so that several fragments can be imported in parallel
+	int res = oph_io_server_reader_read(OPH_IO_SERVER_READER_ESDM, src_path, measure_name, tuplexfrag_number, frag_key_start, compressed_flag, dim_num, dims_type, dims_index, dims_start,
+					    dims_end, -1, sub_operation, sub_args, binary_frag, frag_size);
+	if (res != OPH_IO_SERVER_READER_LOCAL)
+		return res;
 	//Common part of code
 	if (strstr(src_path, "..")) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "The use of '..' is forbidden\n");
@@ -19,6 +19,7 @@
 #define _GNU_SOURCE
 
 #include "oph_io_server_query_manager.h"
+#include "oph_io_server_reader.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -31,7 +32,6 @@
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
 #include "oph_server_utility.h"
@@ -63,7 +63,6 @@ extern unsigned long long cache_size;
 
 #ifdef OPH_IO_SERVER_NETCDF
 
-#define OPH_NC_LOAD_EXEC OPH_IO_SERVER_PREFIX "/bin/oph_io_server_nc_load"
 #define INT_LEN 16
 #define LONG_LEN 24
 #define MSG_LEN 4096
@@ -359,56 +358,14 @@ int _oph_ioserver_nc_read_data_v0(Buffer * buff, int offset, char transpose, cha
 
 		pmesg(LOG_DEBUG, __FILE__, __LINE__, "MESSAGE IS %s\n", msg);
 
-		//Open pipe
-		int fd[2];
-		if (pipe(fd) == -1) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error in opening pipe: %s\n", strerror(errno));
-			logging(LOG_ERROR, __FILE__, __LINE__, "Error in opening pipe: %s\n", strerror(errno));
-			return OPH_IO_SERVER_EXEC_ERROR;
-		}
-		pid_t child_pid;
-		//Fork process to fill shared memory
-		if ((child_pid = fork()) == 0) {
-			//Replace SDTIN with pipe
-			close(STDIN_FILENO);
-			dup(fd[0]);
-			close(fd[0]);
-			close(fd[1]);
-
-			char *exec_path = OPH_NC_LOAD_EXEC;
-			if (execvp(exec_path, (char *[]) {
-				   exec_path, NULL}) == -1)
-				exit(errno);
-			else
-				exit(0);
-		}
-		//Close read end of pipe
-		close(fd[0]);
-		//Send message to child process
-		if (write(fd[1], msg, msg_len) == -1) {
-			close(fd[1]);
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to send shared memory id to child\n");
-			logging(LOG_ERROR, __FILE__, __LINE__, "Unable to send shared memory id to child\n");
-			return OPH_IO_SERVER_EXEC_ERROR;
-		}
-		close(fd[1]);
-
-		//Wait for child process to end
+		//Slab is loaded by a persistent loader process
 		int status;
-		waitpid(child_pid, &status, 0);
-		if ((WIFEXITED(status)) == 0) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error in binary array filling\n");
-			logging(LOG_ERROR, __FILE__, __LINE__, "Error in binary array filling\n");
+		if ((status = oph_io_server_reader_load(msg, msg_len))) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error in binary array filling: loader returned %d\n", status);
+			logging(LOG_ERROR, __FILE__, __LINE__, "Error in binary array filling: loader returned %d\n", status);
 			return OPH_IO_SERVER_MEMORY_ERROR;
 		}
-		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Loading process status is: %d\n", status);
 		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Shared cache ID is: %d\n", shm_id);
-
-		if ((status = WEXITSTATUS(status)) != 0) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, "Error in binary array filling: %s\n", strerror(status));
-			logging(LOG_ERROR, __FILE__, __LINE__, "Error in binary array filling: %s\n", strerror(status));
-			return OPH_IO_SERVER_MEMORY_ERROR;
-		}
 	} else {
 #endif
 		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Loading data directly\n");
@@ -2721,6 +2678,11 @@ int _oph_ioserver_nc_read(char *src_path, char *measure_name, unsigned long long
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
+	//Files are read by a reader process, if available, so that several fragments can be imported in parallel
+	int res = oph_io_server_reader_read(OPH_IO_SERVER_READER_NETCDF, src_path, measure_name, tuplexfrag_number, frag_key_start, compressed_flag, dim_num, dims_type, dims_index, dims_start,
+					    dims_end, dim_unlim, NULL, NULL, binary_frag, frag_size);
+	if (res != OPH_IO_SERVER_READER_LOCAL)
+		return res;
 	//Common part of code
 	if (strstr(src_path, "..")) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, "The use of '..' is forbidden\n");
@@ -0,0 +1,776 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "oph_io_server_plan_cache.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "debug.h"
+
+#include "oph_query_parser.h"
+#include "oph_query_engine_language.h"
+
+extern int msglevel;
+
+//Prefix of the variables replacing the placeholders in the text parsed to build the AST of an expression
+#define OPH_IO_SERVER_PLAN_CACHE_AST_PREFIX '$'
+//Max number of digits of the index of a literal
+#define OPH_IO_SERVER_PLAN_CACHE_INDEX_SIZE 10
+
+/**
+ * \brief			        Structure with a literal replaced by a placeholder
+ * \param token         Pointer to the literal in the original text
+ * \param token_length  Length of the literal
+ * \param value         Pointer to the value of the literal (without quotes)
+ * \param length        Length of the value
+ * \param type          Type of the literal
+ * \param offset        Position of the placeholder in the normalized text
+ */
+typedef struct {
+	const char *token;
+	size_t token_length;
+	const char *value;
+	size_t length;
+	oph_query_expr_value_type type;
+	size_t offset;
+} oph_io_server_plan_literal;
+
+/**
+ * \brief			        Structure with a normalized text
+ * \param key           Normalized text
+ * \param length        Length of the normalized text
+ * \param literals      Literals replaced by placeholders, in order of appearance
+ * \param literal_num   Number of literals
+ * \param max_literal_num Size of the array of literals
+ */
+typedef struct {
+	char *key;
+	size_t length;
+	oph_io_server_plan_literal *literals;
+	unsigned int literal_num;
+	unsigned int max_literal_num;
+} oph_io_server_plan_text;
+
+/**
+ * \brief			        Structure with an argument of a normalized query
+ * \param name          Name of the argument
+ * \param value         Normalized value of the argument
+ * \param slots         Positions of the placeholders in the value
+ * \param slot_num      Number of placeholders
+ * \param skip          Flag set to 1 if the argument is not loaded, since its name is repeated
+ */
+typedef struct {
+	char *name;
+	char *value;
+	size_t *slots;
+	unsigned int slot_num;
+	char skip;
+} oph_io_server_plan_arg;
+
+/**
+ * \brief			        Structure with an entry of a cache
+ * \param key           Normalized text
+ * \param hash          Hash of the key
+ * \param ast           AST of an expression, with variables in place of literals, not compiled
+ * \param args          Arguments of a query
+ * \param arg_num       Number of arguments of a query
+ * \param prev          Entry used more recently
+ * \param next          Entry used less recently
+ * \param chain         Next entry in the same slot
+ */
+typedef struct _oph_io_server_plan_entry {
+	char *key;
+	unsigned long long hash;
+	oph_query_expr_node *ast;
+	oph_io_server_plan_arg *args;
+	unsigned int arg_num;
+	struct _oph_io_server_plan_entry *prev;
+	struct _oph_io_server_plan_entry *next;
+	struct _oph_io_server_plan_entry *chain;
+} oph_io_server_plan_entry;
+
+/**
+ * \brief			        Structure with the status of a cache
+ * \param slots         Hash slots with chains of entries
+ * \param slot_num      Number of slots (power of 2)
+ * \param entry_num     Number of entries
+ * \param max_entry_num Max number of entries (0 if the cache is disabled)
+ * \param head          Entry used most recently
+ * \param tail          Entry used least recently, evicted first
+ * \param hits          Number of keys found in cache
+ * \param misses        Number of keys not found in cache
+ * \param lock          Mutex protecting the cache
+ */
+typedef struct {
+	oph_io_server_plan_entry **slots;
+	unsigned int slot_num;
+	unsigned int entry_num;
+	unsigned int max_entry_num;
+	oph_io_server_plan_entry *head;
+	oph_io_server_plan_entry *tail;
+	unsigned long long hits;
+	unsigned long long misses;
+	pthread_mutex_t lock;
+} oph_io_server_plan_cache;
+
+static oph_io_server_plan_cache query_cache = { NULL, 0, 0, 0, NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+static oph_io_server_plan_cache expr_cache = { NULL, 0, 0, 0, NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+
+//FNV-1a
+static unsigned long long _oph_io_server_plan_cache_hash(const char *key)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (; *key; key++) {
+		hash ^= (unsigned char) *key;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static void _oph_io_server_plan_cache_free_entry(oph_io_server_plan_entry * entry)
+{
+	if (entry->ast)
+		oph_query_expr_delete_node(entry->ast, NULL);
+	if (entry->args) {
+		unsigned int i;
+		for (i = 0; i < entry->arg_num; i++) {
+			free(entry->args[i].name);
+			free(entry->args[i].value);
+			free(entry->args[i].slots);
+		}
+		free(entry->args);
+	}
+	free(entry->key);
+	free(entry);
+}
+
+static void _oph_io_server_plan_cache_unlink(oph_io_server_plan_cache * cache, oph_io_server_plan_entry * entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		cache->head = entry->next;
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+	entry->prev = entry->next = NULL;
+}
+
+static void _oph_io_server_plan_cache_push(oph_io_server_plan_cache * cache, oph_io_server_plan_entry * entry)
+{
+	entry->prev = NULL;
+	entry->next = cache->head;
+	if (cache->head)
+		cache->head->prev = entry;
+	else
+		cache->tail = entry;
+	cache->head = entry;
+}
+
+//Function used to find an entry and mark it as the most recently used: the cache has to be locked
+static oph_io_server_plan_entry *_oph_io_server_plan_cache_find(oph_io_server_plan_cache * cache, const char *key, unsigned long long hash)
+{
+	//Cache could be released at shutdown
+	if (!cache->slots)
+		return NULL;
+
+	oph_io_server_plan_entry *entry = cache->slots[hash & (cache->slot_num - 1)];
+	for (; entry; entry = entry->chain)
+		if (entry->hash == hash && !strcmp(entry->key, key))
+			break;
+	if (entry && entry != cache->head) {
+		_oph_io_server_plan_cache_unlink(cache, entry);
+		_oph_io_server_plan_cache_push(cache, entry);
+	}
+	return entry;
+}
+
+//Function used to add an entry (or release it if the key has been added in the meanwhile) and evict the least recently used one
+static void _oph_io_server_plan_cache_add(oph_io_server_plan_cache * cache, oph_io_server_plan_entry * entry)
+{
+	pthread_mutex_lock(&cache->lock);
+	if (!cache->slots || _oph_io_server_plan_cache_find(cache, entry->key, entry->hash)) {
+		pthread_mutex_unlock(&cache->lock);
+		_oph_io_server_plan_cache_free_entry(entry);
+		return;
+	}
+	oph_io_server_plan_entry **slot = &(cache->slots[entry->hash & (cache->slot_num - 1)]);
+	entry->chain = *slot;
+	*slot = entry;
+	_oph_io_server_plan_cache_push(cache, entry);
+	cache->entry_num++;
+
+	oph_io_server_plan_entry *evicted = NULL;
+	if (cache->entry_num > cache->max_entry_num) {
+		evicted = cache->tail;
+		_oph_io_server_plan_cache_unlink(cache, evicted);
+		for (slot = &(cache->slots[evicted->hash & (cache->slot_num - 1)]); *slot != evicted; slot = &((*slot)->chain));
+		*slot = evicted->chain;
+		cache->entry_num--;
+	}
+	pthread_mutex_unlock(&cache->lock);
+
+	if (evicted)
+		_oph_io_server_plan_cache_free_entry(evicted);
+}
+
+static int _oph_io_server_plan_cache_setup(oph_io_server_plan_cache * cache, unsigned int size)
+{
+	cache->max_entry_num = size;
+	if (!size)
+		return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+
+	//Keep chains short
+	for (cache->slot_num = 1; cache->slot_num < 2 * size; cache->slot_num <<= 1);
+	cache->slots = (oph_io_server_plan_entry **) calloc(cache->slot_num, sizeof(oph_io_server_plan_entry *));
+	if (!cache->slots) {
+		cache->max_entry_num = cache->slot_num = 0;
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+	}
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+static void _oph_io_server_plan_cache_release(oph_io_server_plan_cache * cache)
+{
+	oph_io_server_plan_entry *entry, *next;
+
+	pthread_mutex_lock(&cache->lock);
+	for (entry = cache->head; entry; entry = next) {
+		next = entry->next;
+		_oph_io_server_plan_cache_free_entry(entry);
+	}
+	free(cache->slots);
+	cache->slots = NULL;
+	cache->head = cache->tail = NULL;
+	cache->slot_num = cache->entry_num = cache->max_entry_num = 0;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+//Char classes of the lexer of expressions
+static int _oph_io_server_plan_cache_is_symbol_start(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$' || c == OPH_QUERY_ENGINE_LANG_ARG_REPLACE;
+}
+
+static int _oph_io_server_plan_cache_is_symbol_char(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '$';
+}
+
+static int _oph_io_server_plan_cache_is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int _oph_io_server_plan_cache_is_blank(char c)
+{
+	return c == ' ' || c == '\r' || c == '\n' || c == '\t';
+}
+
+static int _oph_io_server_plan_cache_init_text(oph_io_server_plan_text * text, size_t size)
+{
+	memset(text, 0, sizeof(oph_io_server_plan_text));
+	if (!(text->key = (char *) malloc((size + 1) * sizeof(char))))
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+	text->key[0] = 0;
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+static void _oph_io_server_plan_cache_free_text(oph_io_server_plan_text * text)
+{
+	free(text->key);
+	free(text->literals);
+	memset(text, 0, sizeof(oph_io_server_plan_text));
+}
+
+//Function used to copy a piece of text as is; a '?' is only admitted at the beginning of a numbered binary argument, so that placeholders are not ambiguous
+static int _oph_io_server_plan_cache_copy(oph_io_server_plan_text * text, const char *begin, const char *end)
+{
+	for (; begin < end; begin++) {
+		if (*begin == OPH_QUERY_ENGINE_LANG_ARG_REPLACE && !_oph_io_server_plan_cache_is_symbol_char(begin[1]))
+			return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		text->key[text->length++] = *begin;
+	}
+	text->key[text->length] = 0;
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+static int _oph_io_server_plan_cache_add_literal(oph_io_server_plan_text * text, const char *token, size_t token_length, const char *value, size_t length, oph_query_expr_value_type type)
+{
+	if (text->literal_num == text->max_literal_num) {
+		unsigned int max_literal_num = text->max_literal_num ? 2 * text->max_literal_num : 16;
+		oph_io_server_plan_literal *literals = (oph_io_server_plan_literal *) realloc(text->literals, max_literal_num * sizeof(oph_io_server_plan_literal));
+		if (!literals)
+			return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		text->literals = literals;
+		text->max_literal_num = max_literal_num;
+	}
+
+	oph_io_server_plan_literal *literal = text->literals + text->literal_num++;
+	literal->token = token;
+	literal->token_length = token_length;
+	literal->value = value;
+	literal->length = length;
+	literal->type = type;
+	literal->offset = text->length;
+
+	text->key[text->length++] = OPH_QUERY_ENGINE_LANG_ARG_REPLACE;
+	text->key[text->length] = 0;
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+//Function used to replace the literals of an expression with placeholders. Literals are recognized as the lexer of expressions does and are kept
+//as they are when a variable could be parsed differently in their place (e.g. before '(' or other chars of a symbol). It fails if the expression
+//contains something that could be mistaken for a placeholder.
+static int _oph_io_server_plan_cache_normalize_expr(oph_io_server_plan_text * text, const char *begin, const char *end)
+{
+	const char *c = begin, *next, *value, *value_end, *follower;
+	oph_query_expr_value_type type;
+
+	while (c < end) {
+		//Symbols (variables, functions, keywords and binary arguments) are kept as they are
+		if (_oph_io_server_plan_cache_is_symbol_start(*c)) {
+			if (*c == OPH_IO_SERVER_PLAN_CACHE_AST_PREFIX)
+				return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+			for (next = c + 1; next < end && _oph_io_server_plan_cache_is_symbol_char(*next); next++);
+			if (_oph_io_server_plan_cache_copy(text, c, next))
+				return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+			c = next;
+			continue;
+		}
+
+		value = value_end = next = NULL;
+		type = OPH_QUERY_EXPR_TYPE_STRING;
+		if (*c == OPH_QUERY_ENGINE_LANG_STRING_DELIMITER) {
+			for (value_end = c + 1; value_end < end && *value_end != OPH_QUERY_ENGINE_LANG_STRING_DELIMITER; value_end++);
+			if (value_end < end)
+				value = c + 1;
+		} else if (*c == OPH_QUERY_ENGINE_LANG_STRING_DELIMITER2) {
+			for (value_end = c + 1; value_end < end && *value_end != OPH_QUERY_ENGINE_LANG_STRING_DELIMITER2; value_end++)
+				if (*value_end == '\\')
+					value_end++;
+			if (value_end < end)
+				value = c + 1;
+		} else if (_oph_io_server_plan_cache_is_digit(*c) || (*c == '-' && c + 1 < end && _oph_io_server_plan_cache_is_digit(c[1]))) {
+			value = c;
+			type = OPH_QUERY_EXPR_TYPE_LONG;
+			for (value_end = c + 1; value_end < end && _oph_io_server_plan_cache_is_digit(*value_end); value_end++);
+			if (value_end < end && *value_end == '.') {
+				type = OPH_QUERY_EXPR_TYPE_DOUBLE;
+				for (value_end++; value_end < end && _oph_io_server_plan_cache_is_digit(*value_end); value_end++);
+			}
+		} else if (*c == '.' && c + 1 < end && _oph_io_server_plan_cache_is_digit(c[1])) {
+			//Decimals without integer part are kept as they are
+			for (next = c + 1; next < end && _oph_io_server_plan_cache_is_symbol_char(*next); next++);
+			if (_oph_io_server_plan_cache_copy(text, c, next))
+				return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+			c = next;
+			continue;
+		}
+
+		if (!value) {
+			if (_oph_io_server_plan_cache_copy(text, c, c + 1))
+				return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+			c++;
+			continue;
+		}
+		next = type == OPH_QUERY_EXPR_TYPE_STRING ? value_end + 1 : value_end;
+
+		for (follower = next; follower < end && _oph_io_server_plan_cache_is_blank(*follower); follower++);
+		if ((next < end && _oph_io_server_plan_cache_is_symbol_char(*next))
+		    || (follower < end && !strchr(")+-*/=%&|,", *follower) && !(follower > next && _oph_io_server_plan_cache_is_symbol_start(*follower)))) {
+			if (_oph_io_server_plan_cache_copy(text, c, next))
+				return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		} else if (_oph_io_server_plan_cache_add_literal(text, c, next - c, value, value_end - value, type))
+			return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		c = next;
+	}
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+static int _oph_io_server_plan_cache_is_arg(const char *name, size_t length, const char *arg)
+{
+	return strlen(arg) == length && !strncmp(name, arg, length);
+}
+
+//Function used to normalize a query, splitting arguments as _oph_query_parser_load_query_params does. Fragment and DB names are replaced with
+//a placeholder, values checked by the parser are kept as they are and literals of any other value are replaced as in expressions.
+static int _oph_io_server_plan_cache_normalize_query(oph_io_server_plan_text * text, const char *query)
+{
+	const char *begin = query, *equal, *end;
+
+	while ((end = strchr(begin, OPH_QUERY_ENGINE_LANG_PARAM_SEPARATOR))) {
+		if (!(equal = memchr(begin, OPH_QUERY_ENGINE_LANG_VALUE_SEPARATOR, end - begin))) {
+			if (_oph_io_server_plan_cache_copy(text, begin, end + 1))
+				return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+			begin = end + 1;
+			continue;
+		}
+
+		if (_oph_io_server_plan_cache_copy(text, begin, equal + 1))
+			return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		if (_oph_io_server_plan_cache_is_arg(begin, equal - begin, OPH_QUERY_ENGINE_LANG_ARG_FRAG) || _oph_io_server_plan_cache_is_arg(begin, equal - begin, OPH_QUERY_ENGINE_LANG_ARG_FROM)
+		    || _oph_io_server_plan_cache_is_arg(begin, equal - begin, OPH_QUERY_ENGINE_LANG_ARG_DB)) {
+			if (_oph_io_server_plan_cache_add_literal(text, equal + 1, end - equal - 1, equal + 1, end - equal - 1, OPH_QUERY_EXPR_TYPE_STRING))
+				return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		} else if (_oph_io_server_plan_cache_is_arg(begin, equal - begin, OPH_QUERY_ENGINE_LANG_ARG_ORDER_DIR)) {
+			if (_oph_io_server_plan_cache_copy(text, equal + 1, end))
+				return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		} else if (_oph_io_server_plan_cache_normalize_expr(text, equal + 1, end))
+			return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+
+		if (_oph_io_server_plan_cache_copy(text, end, end + 1))
+			return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		begin = end + 1;
+	}
+
+	return _oph_io_server_plan_cache_copy(text, begin, begin + strlen(begin));
+}
+
+//Function used to load the arguments of a normalized query into an entry
+static int _oph_io_server_plan_cache_load_args(oph_io_server_plan_entry * entry, oph_io_server_plan_text * text)
+{
+	const char *begin, *equal, *end;
+	unsigned int i, j, literal = 0;
+
+	for (begin = text->key; (end = strchr(begin, OPH_QUERY_ENGINE_LANG_PARAM_SEPARATOR)); begin = end + 1)
+		entry->arg_num++;
+	if (!entry->arg_num || !(entry->args = (oph_io_server_plan_arg *) calloc(entry->arg_num, sizeof(oph_io_server_plan_arg))))
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+
+	for (i = 0, begin = text->key; i < entry->arg_num; i++, begin = end + 1) {
+		end = strchr(begin, OPH_QUERY_ENGINE_LANG_PARAM_SEPARATOR);
+		if (!(equal = memchr(begin, OPH_QUERY_ENGINE_LANG_VALUE_SEPARATOR, end - begin)))
+			return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+
+		oph_io_server_plan_arg *arg = entry->args + i;
+		if (!(arg->name = strndup(begin, equal - begin)) || !(arg->value = strndup(equal + 1, end - equal - 1)))
+			return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		//Hash table keeps the first value of an argument
+		for (j = 0; j < i && !arg->skip; j++)
+			if (!strcmp(entry->args[j].name, arg->name))
+				arg->skip = 1;
+
+		for (; literal + arg->slot_num < text->literal_num && text->literals[literal + arg->slot_num].offset < (size_t) (end - text->key); arg->slot_num++);
+		if (arg->slot_num) {
+			if (!(arg->slots = (size_t *) malloc(arg->slot_num * sizeof(size_t))))
+				return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+			for (j = 0; j < arg->slot_num; j++, literal++)
+				arg->slots[j] = text->literals[literal].offset - (equal + 1 - text->key);
+		}
+	}
+
+	return literal == text->literal_num ? OPH_IO_SERVER_PLAN_CACHE_SUCCESS : OPH_IO_SERVER_PLAN_CACHE_ERROR;
+}
+
+//Function used to build the arguments of a query from an entry, binding the literals of the query: the cache has to be locked
+static int _oph_io_server_plan_cache_bind_args(oph_io_server_plan_entry * entry, oph_io_server_plan_text * text, HASHTBL ** query_args)
+{
+	if (!(*query_args = hashtbl_create(OPH_QUERY_ENGINE_QUERY_ARGS, NULL)))
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+
+	unsigned int i, j, literal = 0;
+	for (i = 0; i < entry->arg_num; literal += entry->args[i++].slot_num) {
+		oph_io_server_plan_arg *arg = entry->args + i;
+		if (literal + arg->slot_num > text->literal_num)
+			break;
+		if (arg->skip)
+			continue;
+
+		size_t length = strlen(arg->value) - arg->slot_num, pos = 0, prev = 0;
+		for (j = 0; j < arg->slot_num; j++)
+			length += text->literals[literal + j].token_length;
+		char *value = (char *) malloc((length + 1) * sizeof(char));
+		if (!value)
+			break;
+		for (j = 0; j < arg->slot_num; j++) {
+			memcpy(value + pos, arg->value + prev, arg->slots[j] - prev);
+			pos += arg->slots[j] - prev;
+			memcpy(value + pos, text->literals[literal + j].token, text->literals[literal + j].token_length);
+			pos += text->literals[literal + j].token_length;
+			prev = arg->slots[j] + 1;
+		}
+		strcpy(value + pos, arg->value + prev);
+
+		if (hashtbl_insert(*query_args, arg->name, value)) {
+			free(value);
+			break;
+		}
+	}
+
+	if (i < entry->arg_num || literal != text->literal_num) {
+		hashtbl_destroy(*query_args);
+		*query_args = NULL;
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+	}
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+//Function used to replace each placeholder of a normalized expression with a variable named after the index of the literal
+static int _oph_io_server_plan_cache_get_ast_text(oph_io_server_plan_text * text, char **ast_text)
+{
+	if (!(*ast_text = (char *) malloc((text->length + text->literal_num * (OPH_IO_SERVER_PLAN_CACHE_INDEX_SIZE + 3) + 1) * sizeof(char))))
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+
+	size_t pos = 0, prev = 0;
+	unsigned int i;
+	for (i = 0; i < text->literal_num; i++) {
+		memcpy(*ast_text + pos, text->key + prev, text->literals[i].offset - prev);
+		pos += text->literals[i].offset - prev;
+		pos += sprintf(*ast_text + pos, " %c%u ", OPH_IO_SERVER_PLAN_CACHE_AST_PREFIX, i);
+		prev = text->literals[i].offset + 1;
+	}
+	strcpy(*ast_text + pos, text->key + prev);
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+//Function used to replace the variables of a copied AST with the literals of an expression, as they would be parsed
+static int _oph_io_server_plan_cache_bind_ast(oph_query_expr_node * e, oph_io_server_plan_text * text)
+{
+	if (!e)
+		return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+
+	if (e->type == eVAR && e->name[0] == OPH_IO_SERVER_PLAN_CACHE_AST_PREFIX) {
+		unsigned int i = (unsigned int) strtoul(e->name + 1, NULL, 10);
+		if (i >= text->literal_num)
+			return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+
+		oph_io_server_plan_literal *literal = text->literals + i;
+		switch (literal->type) {
+			case OPH_QUERY_EXPR_TYPE_LONG:
+				e->value.data.long_value = strtoll(literal->value, NULL, 10);
+				break;
+			case OPH_QUERY_EXPR_TYPE_DOUBLE:
+				e->value.data.double_value = strtod(literal->value, NULL);
+				break;
+			default:
+				if (!(e->value.data.string_value = strndup(literal->value, literal->length)))
+					return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+		}
+		free(e->name);
+		e->name = NULL;
+		e->type = eVALUE;
+		e->value.type = literal->type;
+		e->value.free_flag = 0;
+		e->value.jump_flag = 0;
+	}
+
+	if (_oph_io_server_plan_cache_bind_ast(e->left, text) || _oph_io_server_plan_cache_bind_ast(e->right, text))
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+int oph_io_server_plan_cache_init(unsigned int size)
+{
+	if (_oph_io_server_plan_cache_setup(&query_cache, size) || _oph_io_server_plan_cache_setup(&expr_cache, size)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate plan cache\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to allocate plan cache\n");
+		oph_io_server_plan_cache_free();
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+	}
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+int oph_io_server_plan_cache_free()
+{
+	_oph_io_server_plan_cache_release(&query_cache);
+	_oph_io_server_plan_cache_release(&expr_cache);
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+int oph_io_server_plan_cache_get_args(char *query, HASHTBL ** query_args)
+{
+	if (!query || !query_args) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+	}
+	*query_args = NULL;
+
+	if (!query_cache.max_entry_num)
+		return oph_query_parser(query, query_args) ? OPH_IO_SERVER_PLAN_CACHE_ERROR : OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+
+	//Query is checked and numbered as oph_query_parser does before normalization
+	char *updated_query = NULL;
+	if (_oph_query_parser_validate_query(query) || _oph_query_parser_remove_query_tokens(query) || oph_query_expr_update_binary_args(query, &updated_query)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to parse query '%s'\n", query);
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to parse query '%s'\n", query);
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+	}
+
+	//Empty values of names are replaced too
+	size_t size = strlen(updated_query);
+	const char *c;
+	for (c = updated_query; (c = strchr(c, OPH_QUERY_ENGINE_LANG_PARAM_SEPARATOR)); c++)
+		size++;
+
+	oph_io_server_plan_text text;
+	oph_io_server_plan_entry *entry = NULL;
+	unsigned long long hash = 0;
+	char normalized = !_oph_io_server_plan_cache_init_text(&text, size) && !_oph_io_server_plan_cache_normalize_query(&text, updated_query);
+	if (normalized)
+		hash = _oph_io_server_plan_cache_hash(text.key);
+
+	pthread_mutex_lock(&query_cache.lock);
+	if (normalized && (entry = _oph_io_server_plan_cache_find(&query_cache, text.key, hash))) {
+		query_cache.hits++;
+		int res = _oph_io_server_plan_cache_bind_args(entry, &text, query_args);
+		pthread_mutex_unlock(&query_cache.lock);
+		if (!res) {
+			_oph_io_server_plan_cache_free_text(&text);
+			free(updated_query);
+			return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+		}
+		//Query is parsed in case of errors
+		normalized = 0;
+	} else {
+		query_cache.misses++;
+		pthread_mutex_unlock(&query_cache.lock);
+	}
+
+	//Arguments are loaded as oph_query_parser does
+	if (!(*query_args = hashtbl_create(OPH_QUERY_ENGINE_QUERY_ARGS, NULL)) || _oph_query_parser_load_query_params(updated_query, *query_args) || _oph_query_check_query_params(*query_args)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to parse query '%s'\n", query);
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to parse query '%s'\n", query);
+		if (*query_args)
+			hashtbl_destroy(*query_args);
+		*query_args = NULL;
+		_oph_io_server_plan_cache_free_text(&text);
+		free(updated_query);
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+	}
+
+	//Query is executed anyway if it cannot be cached
+	if (normalized && (entry = (oph_io_server_plan_entry *) calloc(1, sizeof(oph_io_server_plan_entry)))) {
+		entry->hash = hash;
+		if (_oph_io_server_plan_cache_load_args(entry, &text) || !(entry->key = strdup(text.key)))
+			_oph_io_server_plan_cache_free_entry(entry);
+		else
+			_oph_io_server_plan_cache_add(&query_cache, entry);
+	}
+	_oph_io_server_plan_cache_free_text(&text);
+	free(updated_query);
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+int oph_io_server_plan_cache_get_ast(const char *expr, oph_query_expr_node ** e)
+{
+	if (!expr || !e) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		logging(LOG_ERROR, __FILE__, __LINE__, "Null input parameter\n");
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+	}
+	*e = NULL;
+
+	if (!expr_cache.max_entry_num)
+		return oph_query_expr_get_ast(expr, e);
+
+	oph_io_server_plan_text text;
+	oph_io_server_plan_entry *entry = NULL;
+	unsigned long long hash = 0;
+	char normalized = !_oph_io_server_plan_cache_init_text(&text, strlen(expr)) && !_oph_io_server_plan_cache_normalize_expr(&text, expr, expr + strlen(expr));
+	if (normalized)
+		hash = _oph_io_server_plan_cache_hash(text.key);
+
+	pthread_mutex_lock(&expr_cache.lock);
+	if (normalized && (entry = _oph_io_server_plan_cache_find(&expr_cache, text.key, hash))) {
+		expr_cache.hits++;
+		int res = oph_query_expr_copy_ast(entry->ast, e);
+		pthread_mutex_unlock(&expr_cache.lock);
+		if (!res && !_oph_io_server_plan_cache_bind_ast(*e, &text)) {
+			_oph_io_server_plan_cache_free_text(&text);
+			return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+		}
+		//Expression is parsed in case of errors
+		if (*e)
+			oph_query_expr_delete_node(*e, NULL);
+		*e = NULL;
+		normalized = 0;
+	} else {
+		expr_cache.misses++;
+		pthread_mutex_unlock(&expr_cache.lock);
+	}
+
+	//The AST kept in cache has variables in place of literals, which are bound to a copy
+	char *ast_text = NULL;
+	oph_query_expr_node *ast = NULL;
+	char parsed = 0;
+	if (normalized && !_oph_io_server_plan_cache_get_ast_text(&text, &ast_text)) {
+		//Without literals the expression is parsed as it is
+		parsed = !text.literal_num;
+		if (!oph_query_expr_get_ast(ast_text, &ast) && !oph_query_expr_copy_ast(ast, e) && !_oph_io_server_plan_cache_bind_ast(*e, &text)) {
+			if ((entry = (oph_io_server_plan_entry *) calloc(1, sizeof(oph_io_server_plan_entry)))) {
+				entry->hash = hash;
+				entry->ast = ast;
+				ast = NULL;
+				if (!(entry->key = strdup(text.key)))
+					_oph_io_server_plan_cache_free_entry(entry);
+				else
+					_oph_io_server_plan_cache_add(&expr_cache, entry);
+			}
+		} else if (*e) {
+			oph_query_expr_delete_node(*e, NULL);
+			*e = NULL;
+		}
+	}
+	if (ast)
+		oph_query_expr_delete_node(ast, NULL);
+	free(ast_text);
+	_oph_io_server_plan_cache_free_text(&text);
+
+	//Expression is parsed as it is if it cannot be cached, so that errors are reported on the actual text
+	if (!*e && (parsed || oph_query_expr_get_ast(expr, e)))
+		return OPH_IO_SERVER_PLAN_CACHE_ERROR;
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
+
+int oph_io_server_plan_cache_stats(unsigned long long *query_hits, unsigned long long *query_misses, unsigned long long *expr_hits, unsigned long long *expr_misses)
+{
+	pthread_mutex_lock(&query_cache.lock);
+	if (query_hits)
+		*query_hits = query_cache.hits;
+	if (query_misses)
+		*query_misses = query_cache.misses;
+	pthread_mutex_unlock(&query_cache.lock);
+
+	pthread_mutex_lock(&expr_cache.lock);
+	if (expr_hits)
+		*expr_hits = expr_cache.hits;
+	if (expr_misses)
+		*expr_misses = expr_cache.misses;
+	pthread_mutex_unlock(&expr_cache.lock);
+
+	return OPH_IO_SERVER_PLAN_CACHE_SUCCESS;
+}
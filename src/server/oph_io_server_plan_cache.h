@@ -0,0 +1,75 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPH_IO_SERVER_PLAN_CACHE_H
+#define OPH_IO_SERVER_PLAN_CACHE_H
+
+#include "hashtbl.h"
+#include "oph_query_expression_evaluator.h"
+
+//Server-wide LRU caches of parsed queries and expressions, shared by all worker threads. Keys are normalized texts, where fragment
+//and DB names and literals (numbers and quoted strings) are replaced by '?', so queries differing only in those values share an entry.
+//Query entries hold the argument set of the query, expression entries hold the AST; the actual values are bound on each request,
+//which gets its own copy, since argument tables are released and ASTs are bound to execution symtables after the execution.
+
+#define OPH_IO_SERVER_PLAN_CACHE_SUCCESS 0
+#define OPH_IO_SERVER_PLAN_CACHE_ERROR 1
+
+//Default number of entries of the cache
+#define OPH_IO_SERVER_PLAN_CACHE_DEFAULT_SIZE 256
+
+/**
+ * \brief               Function used to setup the cache; it has to be called before any worker thread is started
+ * \param size          Max number of entries of each cache (0 to disable caching)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_plan_cache_init(unsigned int size);
+
+/**
+ * \brief               Function used to release the cache
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_plan_cache_free();
+
+/**
+ * \brief               Function used to parse a query and load its arguments, as oph_query_parser, by reusing previous parsing. It modifies the input string
+ * \param query         Query to be parsed
+ * \param query_args    Pointer to be filled with a new hash table with the arguments, to be freed with hashtbl_destroy
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_plan_cache_get_args(char *query, HASHTBL ** query_args);
+
+/**
+ * \brief               Function used to build the AST of an expression, as oph_query_expr_get_ast, by reusing previous parsing
+ * \param expr          Expression to be parsed
+ * \param e             Pointer to be filled with a new AST, to be freed with oph_query_expr_delete_node
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_plan_cache_get_ast(const char *expr, oph_query_expr_node ** e);
+
+/**
+ * \brief               Function used to get the counters of the caches
+ * \param query_hits    Pointer to be filled with the number of queries found in cache (can be NULL)
+ * \param query_misses  Pointer to be filled with the number of queries parsed (can be NULL)
+ * \param expr_hits     Pointer to be filled with the number of expressions found in cache (can be NULL)
+ * \param expr_misses   Pointer to be filled with the number of expressions parsed (can be NULL)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_plan_cache_stats(unsigned long long *query_hits, unsigned long long *query_misses, unsigned long long *expr_hits, unsigned long long *expr_misses);
+
+#endif				/* OPH_IO_SERVER_PLAN_CACHE_H */
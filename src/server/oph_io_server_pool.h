@@ -0,0 +1,51 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPH_IO_SERVER_POOL_H
+#define OPH_IO_SERVER_POOL_H
+
+#include "oph_io_server_thread.h"
+
+#define OPH_IO_SERVER_POOL_SUCCESS 0
+#define OPH_IO_SERVER_POOL_ERROR -1
+
+//Initial size of connection input buffer
+#define OPH_IO_SERVER_POOL_BUFFER_LEN 4096
+//Max number of events returned by a single wait
+#define OPH_IO_SERVER_POOL_MAX_EVENTS 64
+//Max number of descriptors received with a single read on local connections
+#define OPH_IO_SERVER_POOL_MAX_FDS 16
+//Wait timeout (ms) used to periodically check idle connections
+#define OPH_IO_SERVER_POOL_TIMEOUT 1000
+
+/**
+ * \brief               Function used to serve client connections: it starts the worker threads and runs the event loop on listening socket in the calling thread.
+ *                      Idle connections are only watched by the event loop; complete requests are queued and served by the workers.
+ * \param listenfd      Listening socket descriptor
+ * \param unixfd        Local (AF_UNIX) listening socket descriptor, -1 if local connections are not enabled
+ * \param worker_num    Number of worker threads
+ * \return              Returns 0 once stopped with oph_io_server_pool_stop (workers are joined and connections closed), non-0 in case of error
+ */
+int oph_io_server_pool_run(int listenfd, int unixfd, unsigned short worker_num);
+
+/**
+ * \brief               Function used to stop the event loop started by oph_io_server_pool_run; it is async-signal-safe
+ */
+void oph_io_server_pool_stop();
+
+#endif				/* OPH_IO_SERVER_POOL_H */
@@ -28,12 +28,43 @@
 
 #include "oph_server_utility.h"
 #include "oph_query_engine_language.h"
+#include "oph_iostorage_memory.h"
 
 extern int msglevel;
 //extern pthread_mutex_t metadb_mutex;
 extern unsigned short omp_threads;
 extern HASHTBL *plugin_table;
 
+int oph_io_server_free_result_set(oph_io_server_thread_status * thread_status)
+{
+	if (!thread_status) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	if (thread_status->last_result_set != NULL) {
+		if (thread_status->delete_only_rs)
+			oph_iostore_destroy_frag_recordset_only(&(thread_status->last_result_set));
+		else
+			oph_iostore_destroy_frag_recordset(&(thread_status->last_result_set));
+	}
+	thread_status->last_result_set = NULL;
+	thread_status->delete_only_rs = 0;
+
+	//Stored records are released (or unpinned, so that they can be spilled again) only once the result set is no longer used
+	if (thread_status->stored_rs != NULL) {
+		if (thread_status->unpin_stored_rs)
+			oph_iostore_memory_unpin(thread_status->stored_rs);
+		else
+			oph_iostore_destroy_frag_recordset(&(thread_status->stored_rs));
+	}
+	thread_status->stored_rs = NULL;
+	thread_status->unpin_stored_rs = 0;
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
 int oph_io_server_dispatcher(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args,
 			     HASHTBL * plugin_table)
 {
@@ -108,14 +139,7 @@ int oph_io_server_dispatcher(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 		//Execute select fragment query  
 
 		//First delete last result set
-		if (thread_status->last_result_set != NULL) {
-			if (thread_status->delete_only_rs)
-				oph_iostore_destroy_frag_recordset_only(&(thread_status->last_result_set));
-			else
-				oph_iostore_destroy_frag_recordset(&(thread_status->last_result_set));
-		}
-		thread_status->last_result_set = NULL;
-		thread_status->delete_only_rs = 0;
+		oph_io_server_free_result_set(thread_status);
 
 		//Check if current DB is setted
 		//TODO Improve how current DB is found
@@ -519,6 +543,27 @@ int oph_io_server_dispatcher(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_DISPATCH_ERROR, "Size Procedure");
 				return OPH_IO_SERVER_EXEC_ERROR;
 			}
+		} else if (STRCMP(function_name, OPH_IO_SERVER_PROCEDURE_PLAN_CACHE) == 0) {
+			//Call Plan cache internal procedure
+			if (oph_io_server_run_plan_cache_procedure(meta_db, dev_handle, thread_status, args, query_args)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_DISPATCH_ERROR, "Plan cache Procedure");
+				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_DISPATCH_ERROR, "Plan cache Procedure");
+				return OPH_IO_SERVER_EXEC_ERROR;
+			}
+		} else if (STRCMP(function_name, OPH_IO_SERVER_PROCEDURE_FRAG_STATS) == 0) {
+			//Call Fragment statistics internal procedure
+			if (oph_io_server_run_frag_stats_procedure(meta_db, dev_handle, thread_status, args, query_args)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_DISPATCH_ERROR, "Fragment statistics Procedure");
+				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_DISPATCH_ERROR, "Fragment statistics Procedure");
+				return OPH_IO_SERVER_EXEC_ERROR;
+			}
+		} else if (STRCMP(function_name, OPH_IO_SERVER_PROCEDURE_MEMORY_STATS) == 0) {
+			//Call Memory statistics internal procedure
+			if (oph_io_server_run_memory_stats_procedure(meta_db, dev_handle, thread_status, args, query_args)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_DISPATCH_ERROR, "Memory statistics Procedure");
+				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_DISPATCH_ERROR, "Memory statistics Procedure");
+				return OPH_IO_SERVER_EXEC_ERROR;
+			}
 		} else {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_DISPATCH_ERROR, function_name);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_DISPATCH_ERROR, function_name);
@@ -33,198 +33,203 @@
 
 #include "oph_query_expression_evaluator.h"
 #include "oph_query_expression_functions.h"
+#include "oph_query_engine_log_error_codes.h"
 #include "oph_query_plugin_loader.h"
+#include "oph_io_server_sort.h"
+#include "oph_io_server_plan_cache.h"
 
 extern int msglevel;
 //extern pthread_mutex_t metadb_mutex;
 extern pthread_rwlock_t rwlock;
 extern HASHTBL *plugin_table;
+extern unsigned short omp_threads;
+
+//Internal structure used to manage groups of rows: indexes of the rows of each group are stored contiguously in a single array
+typedef struct oph_ioserver_groups {
+	long long *elem_index;
+	long long *group_start;
+	long long group_num;
+} oph_ioserver_groups;
+
+//Internal structure used to build groups: evaluated keys are hashed in an open-addressing table
+typedef struct oph_ioserver_group_table {
+	unsigned long long *key;
+	char *key_type;
+	long long *length;
+	long long group_num;
+	long long group_size;
+	long long *slot;
+	long long slot_num;
+} oph_ioserver_group_table;
+
+int _oph_ioserver_query_delete_groups(oph_ioserver_groups * groups)
+{
+	if (!groups) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
 
-//Internal structures used to manage group of rows
-typedef struct oph_ioserver_group_elem {
-	long long elem_index;
-	struct oph_ioserver_group_elem *next;
-} oph_ioserver_group_elem;
-
-typedef struct oph_ioserver_group_elem_list {
-	struct oph_ioserver_group_elem *last;
-	struct oph_ioserver_group_elem *first;
-	long long length;
-} oph_ioserver_group_elem_list;
+	if (groups->elem_index)
+		free(groups->elem_index);
+	if (groups->group_start)
+		free(groups->group_start);
+	free(groups);
 
-typedef struct oph_ioserver_group {
-	oph_ioserver_group_elem_list *group_list;
-	struct oph_ioserver_group *next;
-} oph_ioserver_group;
+	return OPH_IO_SERVER_SUCCESS;
+}
 
-int _oph_ioserver_query_add_group_elem(oph_ioserver_group_elem_list * list, long long index)
+int _oph_ioserver_query_delete_group_table(oph_ioserver_group_table * table)
 {
-	if (!list) {
+	if (!table) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
 
-	oph_ioserver_group_elem *tmp = (oph_ioserver_group_elem *) malloc(sizeof(oph_ioserver_group_elem));
-	if (!tmp) {
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-		return OPH_IO_SERVER_MEMORY_ERROR;
-	}
-	tmp->next = NULL;
-	tmp->elem_index = index;
-
-	if (list->first == NULL) {
-		list->first = tmp;
-	} else {
-		list->last->next = tmp;
-	}
-	list->last = tmp;
-	list->length++;
+	if (table->key)
+		free(table->key);
+	if (table->key_type)
+		free(table->key_type);
+	if (table->length)
+		free(table->length);
+	if (table->slot)
+		free(table->slot);
+	memset(table, 0, sizeof(oph_ioserver_group_table));
 
 	return OPH_IO_SERVER_SUCCESS;
 }
 
-int _oph_ioserver_query_add_group(oph_ioserver_group ** current, oph_ioserver_group_elem_list * index)
+static long long _oph_ioserver_query_group_slot(oph_ioserver_group_table * table, unsigned long long key, char key_type)
 {
-	if (!current || !index) {
+	//Mix key bits (splitmix64 finalizer), so that consecutive ids are spread over slots
+	key ^= (unsigned long long) key_type;
+	key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return (long long) (key & (table->slot_num - 1));
+}
+
+int _oph_ioserver_query_build_group_slots(oph_ioserver_group_table * table, long long slot_num)
+{
+	if (!table || !slot_num) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
 
-	oph_ioserver_group *tmp = (oph_ioserver_group *) malloc(sizeof(oph_ioserver_group));
-	if (!tmp) {
+	long long *slot = (long long *) calloc(slot_num, sizeof(long long));
+	if (!slot) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 		return OPH_IO_SERVER_MEMORY_ERROR;
 	}
-	tmp->next = NULL;
-	tmp->group_list = index;
+	if (table->slot)
+		free(table->slot);
+	table->slot = slot;
+	table->slot_num = slot_num;
 
-	if (*current != NULL) {
-		(*current)->next = tmp;
+	//Slots contain group index + 1, 0 for empty slots
+	long long group = 0, h = 0;
+	for (group = 0; group < table->group_num; group++) {
+		for (h = _oph_ioserver_query_group_slot(table, table->key[group], table->key_type[group]); table->slot[h]; h = (h + 1) & (slot_num - 1));
+		table->slot[h] = group + 1;
 	}
-	*current = tmp;
 
 	return OPH_IO_SERVER_SUCCESS;
 }
 
-int _oph_ioserver_query_delete_group_elem_list(oph_ioserver_group_elem_list * list)
+int _oph_ioserver_query_add_group(oph_ioserver_group_table * table, unsigned long long key, char key_type, long long *group)
 {
-	if (!list) {
+	if (!table || !group) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
 
-	oph_ioserver_group_elem *tmp = NULL;
-	while (list->first) {
-		tmp = list->first;
-		list->first = list->first->next;
-		free(tmp);
+	if (table->group_num == table->group_size) {
+		long long group_size = table->group_size ? 2 * table->group_size : OPH_IO_SERVER_GROUP_SIZE;
+		unsigned long long *tmp_key = (unsigned long long *) realloc(table->key, group_size * sizeof(unsigned long long));
+		if (tmp_key)
+			table->key = tmp_key;
+		char *tmp_key_type = (char *) realloc(table->key_type, group_size * sizeof(char));
+		if (tmp_key_type)
+			table->key_type = tmp_key_type;
+		long long *tmp_length = (long long *) realloc(table->length, group_size * sizeof(long long));
+		if (tmp_length)
+			table->length = tmp_length;
+		if (!tmp_key || !tmp_key_type || !tmp_length) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+		table->group_size = group_size;
+	}
+
+	*group = table->group_num++;
+	table->key[*group] = key;
+	table->key_type[*group] = key_type;
+	table->length[*group] = 0;
+
+	//Keep load factor below 1/2
+	if (table->slot) {
+		if (2 * table->group_num > table->slot_num)
+			return _oph_ioserver_query_build_group_slots(table, 2 * table->slot_num);
+		long long h = 0;
+		for (h = _oph_ioserver_query_group_slot(table, key, key_type); table->slot[h]; h = (h + 1) & (table->slot_num - 1));
+		table->slot[h] = *group + 1;
 	}
-	free(list);
 
 	return OPH_IO_SERVER_SUCCESS;
 }
 
-
-int _oph_ioserver_query_build_groups(HASHTBL * query_groups, char *group, long long row, oph_ioserver_group ** head_group, oph_ioserver_group ** current_group, long long *group_num)
+int _oph_ioserver_query_find_group(oph_ioserver_group_table * table, unsigned long long key, char key_type, long long *group)
 {
-	if (!query_groups || !group || !head_group || !current_group || !group_num) {
+	if (!table || !table->slot || !group) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
 
-	if (!(*head_group)) {
-		//Create first group list
-		oph_ioserver_group_elem_list *list = (oph_ioserver_group_elem_list *) malloc(sizeof(oph_ioserver_group_elem_list));
-		if (!list) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			return OPH_IO_SERVER_MEMORY_ERROR;
-		}
-		list->first = list->last = NULL;
-		list->length = 0;
-		if (_oph_ioserver_query_add_group_elem(list, row)) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			free(list);
-			return OPH_IO_SERVER_MEMORY_ERROR;
-		}
-		if (_oph_ioserver_query_add_group(head_group, list)) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			free(list);
-			_oph_ioserver_query_delete_group_elem_list(list);
-			return OPH_IO_SERVER_MEMORY_ERROR;
-		}
-		*current_group = *head_group;
-		hashtbl_insert(query_groups, (char *) group, (void *) (*current_group));
-		(*group_num)++;
-	} else {
-		if (!(*current_group)) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
-			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
-			return OPH_IO_SERVER_NULL_PARAM;
-		}
-		//Check if group is already available
-		oph_ioserver_group *group_index = (oph_ioserver_group *) hashtbl_get(query_groups, group);
-		if (!group_index) {
-			//Add group to hash table
-			oph_ioserver_group_elem_list *list = (oph_ioserver_group_elem_list *) malloc(sizeof(oph_ioserver_group_elem_list));
-			if (!list) {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-				return OPH_IO_SERVER_MEMORY_ERROR;
-			}
-			list->first = list->last = NULL;
-			list->length = 0;
-			if (_oph_ioserver_query_add_group_elem(list, row)) {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-				free(list);
-				return OPH_IO_SERVER_MEMORY_ERROR;
-			}
-			if (_oph_ioserver_query_add_group(current_group, list)) {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-				free(list);
-				_oph_ioserver_query_delete_group_elem_list(list);
-				return OPH_IO_SERVER_MEMORY_ERROR;
-			}
-			hashtbl_insert(query_groups, (char *) group, (void *) (*current_group));
-			(*group_num)++;
-		} else {
-			//Simply extend the group list
-			if (_oph_ioserver_query_add_group_elem(group_index->group_list, row)) {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-				return OPH_IO_SERVER_MEMORY_ERROR;
-			}
-
+	long long h = 0, slot = 0;
+	*group = -1;
+	for (h = _oph_ioserver_query_group_slot(table, key, key_type); (slot = table->slot[h]); h = (h + 1) & (table->slot_num - 1)) {
+		if (table->key[slot - 1] == key && table->key_type[slot - 1] == key_type) {
+			*group = slot - 1;
+			break;
 		}
 	}
 
 	return OPH_IO_SERVER_SUCCESS;
 }
 
+static char _oph_ioserver_query_group_key_greater(unsigned long long key, char key_type, unsigned long long last_key, char last_key_type)
+{
+	if (key_type != last_key_type)
+		return 0;
+	if (key_type == OPH_QUERY_EXPR_TYPE_LONG)
+		return (long long) key > (long long) last_key;
+
+	double value, last_value;
+	memcpy(&value, &key, sizeof(double));
+	memcpy(&last_value, &last_key, sizeof(double));
+	return value > last_value;
+}
+
 int _oph_ioserver_query_get_groups(HASHTBL * query_args, long long total_row_number, oph_query_arg ** args, oph_iostore_frag_record_set ** inputs, int table_num, long long *output_row_num,
-				   oph_ioserver_group_elem_list *** group_lists)
+				   oph_ioserver_groups ** groups)
 {
-	if (!query_args || !total_row_number || !table_num || !inputs || !output_row_num || !group_lists) {
+	if (!query_args || !total_row_number || !table_num || !inputs || !output_row_num || !groups) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
 
-	int k, l, i;
+	int l, i;
 	long long j;
 
 	*output_row_num = 0;
-	*group_lists = NULL;
+	*groups = NULL;
 
 	// Check group by clause
 	char *group_by = hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_GROUP);
@@ -270,7 +275,7 @@ int _oph_ioserver_query_get_groups(HASHTBL * query_args, long long total_row_num
 
 		oph_query_expr_node *e = NULL;
 
-		if (oph_query_expr_get_ast(group_by, &e) != 0) {
+		if (oph_io_server_plan_cache_get_ast(group_by, &e) != 0) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
 			return OPH_IO_SERVER_PARSE_ERROR;
@@ -318,130 +323,151 @@ int _oph_ioserver_query_get_groups(HASHTBL * query_args, long long total_row_num
 			return OPH_IO_SERVER_PARSE_ERROR;
 		}
 
+		//Bind variables and functions once, rows are evaluated without symbol lookups
+		oph_query_expr_record *var_slots[var_count];
+		if (oph_query_expr_compile(e, table, var_list, var_count, var_slots)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
+			oph_query_expr_delete_node(e, table);
+			oph_query_expr_destroy_symtable(table);
+			free(var_list);
+			return OPH_IO_SERVER_PARSE_ERROR;
+		}
+
 		oph_query_expr_value *res = NULL;
 
 		//TODO Count actual number of string/binary variables
 		oph_query_arg val_b[var_count];
 
-		//Create group hash table
-		HASHTBL *query_groups = hashtbl_create(2 * total_row_number, NULL);
-		if (!query_groups) {
+		//Group of each row
+		long long *row_group = (long long *) malloc(total_row_number * sizeof(long long));
+		if (!row_group) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			oph_query_expr_delete_node(e, table);
+			oph_query_expr_destroy_symtable(table);
+			free(var_list);
 			return OPH_IO_SERVER_MEMORY_ERROR;
 		}
 
-		oph_ioserver_group *head = NULL, *current = NULL;
-		long long group_number = 0;
+		oph_ioserver_group_table group_table;
+		memset(&group_table, 0, sizeof(oph_ioserver_group_table));
 
-		char result[OPH_IO_SERVER_BUFFER] = { '\0' };
+		//Keys are hashed only when they are not increasing: until then, a new key cannot belong to a previous group
+		char streaming = 1;
+		long long group = -1, slot_num = 0;
+		unsigned long long key = 0;
+		char key_type = 0;
+		double double_key = 0;
+		int error = OPH_IO_SERVER_SUCCESS;
 
-		for (j = 0; j < total_row_number; j++) {
-			if (_oph_ioserver_query_set_parser_variables(args, var_list, var_count, inputs, table, field_indexes, frag_indexes, field_binary, val_b, group_by, j, NULL)) {
+		for (j = 0; j < total_row_number && !error; j++) {
+			if (_oph_ioserver_query_set_parser_variables(args, var_slots, var_count, inputs, field_indexes, frag_indexes, field_binary, val_b, group_by, j, NULL)
+			    || oph_query_expr_eval_expression(e, &res, table)) {
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
-				oph_query_expr_delete_node(e, table);
-				oph_query_expr_destroy_symtable(table);
-				free(var_list);
-				for (current = head; current; current = current->next)
-					if (current->group_list)
-						_oph_ioserver_query_delete_group_elem_list(current->group_list);
-				hashtbl_destroy(query_groups);
-				return OPH_IO_SERVER_PARSE_ERROR;
+				error = OPH_IO_SERVER_PARSE_ERROR;
+				break;
 			}
+			//Create index key
+			key_type = res->type;
+			switch (res->type) {
+				case OPH_QUERY_EXPR_TYPE_DOUBLE:
+					{
+						double_key = res->data.double_value;
+						//-0 and +0 belong to the same group
+						if (double_key == 0)
+							double_key = 0;
+						memcpy(&key, &double_key, sizeof(unsigned long long));
+						break;
+					}
+				case OPH_QUERY_EXPR_TYPE_LONG:
+					{
+						key = (unsigned long long) res->data.long_value;
+						break;
+					}
+				default:
+					{
+						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
+						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
+						error = OPH_IO_SERVER_PARSE_ERROR;
+					}
+			}
+			free(res);
+			if (error)
+				break;
 
-			if (e != NULL && !oph_query_expr_eval_expression(e, &res, table)) {
-				//Create index record
-				switch (res->type) {
-					case OPH_QUERY_EXPR_TYPE_DOUBLE:
-						{
-							snprintf(result, OPH_IO_SERVER_BUFFER - 1, "%f", res->data.double_value);
-							free(res);
-							break;
-						}
-					case OPH_QUERY_EXPR_TYPE_LONG:
-						{
-							snprintf(result, OPH_IO_SERVER_BUFFER - 1, "%lld", res->data.long_value);
-							free(res);
-							break;
-						}
-					default:
-						{
-							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
-							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
-							free(res);
-							oph_query_expr_delete_node(e, table);
-							oph_query_expr_destroy_symtable(table);
-							free(var_list);
-							for (current = head; current; current = current->next)
-								if (current->group_list)
-									_oph_ioserver_query_delete_group_elem_list(current->group_list);
-							hashtbl_destroy(query_groups);
-							return OPH_IO_SERVER_PARSE_ERROR;
-						}
+			//Add row to correct group: rows of the same group are usually consecutive
+			if (group < 0 || group_table.key[group] != key || group_table.key_type[group] != key_type) {
+				if (streaming && (group < 0 || _oph_ioserver_query_group_key_greater(key, key_type, group_table.key[group], group_table.key_type[group])))
+					error = _oph_ioserver_query_add_group(&group_table, key, key_type, &group);
+				else {
+					if (streaming) {
+						streaming = 0;
+						for (slot_num = OPH_IO_SERVER_GROUP_SIZE; slot_num < 4 * group_table.group_num; slot_num *= 2);
+						error = _oph_ioserver_query_build_group_slots(&group_table, slot_num);
+					}
+					if (!error && !(error = _oph_ioserver_query_find_group(&group_table, key, key_type, &group)) && group < 0)
+						error = _oph_ioserver_query_add_group(&group_table, key, key_type, &group);
 				}
-
-				//Add row to correct group
-				if (_oph_ioserver_query_build_groups(query_groups, result, j, &head, &current, &group_number)) {
-
+				if (error) {
 					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 					logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-					oph_query_expr_delete_node(e, table);
-					oph_query_expr_destroy_symtable(table);
-					free(var_list);
-					for (current = head; current; current = current->next)
-						if (current->group_list)
-							_oph_ioserver_query_delete_group_elem_list(current->group_list);
-					hashtbl_destroy(query_groups);
-					return OPH_IO_SERVER_MEMORY_ERROR;
+					break;
 				}
-			} else {
-				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
-				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, group_by);
-				free(var_list);
-				oph_query_expr_delete_node(e, table);
-				oph_query_expr_destroy_symtable(table);
-				for (current = head; current; current = current->next)
-					if (current->group_list)
-						_oph_ioserver_query_delete_group_elem_list(current->group_list);
-				hashtbl_destroy(query_groups);
-				return OPH_IO_SERVER_PARSE_ERROR;
 			}
+			row_group[j] = group;
+			group_table.length[group]++;
 		}
 		free(var_list);
 		oph_query_expr_delete_node(e, table);
 		oph_query_expr_destroy_symtable(table);
 
-		oph_ioserver_group_elem_list **groups = (oph_ioserver_group_elem_list **) malloc(group_number * sizeof(oph_ioserver_group_elem_list *));
-		if (!groups) {
-			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-			for (current = head; current; current = current->next)
-				if (current->group_list)
-					_oph_ioserver_query_delete_group_elem_list(current->group_list);
-			hashtbl_destroy(query_groups);
-			return OPH_IO_SERVER_MEMORY_ERROR;
+		oph_ioserver_groups *tmp_groups = NULL;
+		if (!error) {
+			tmp_groups = (oph_ioserver_groups *) malloc(sizeof(oph_ioserver_groups));
+			if (tmp_groups) {
+				tmp_groups->group_num = group_table.group_num;
+				tmp_groups->group_start = (long long *) malloc((group_table.group_num + 1) * sizeof(long long));
+				tmp_groups->elem_index = (long long *) malloc(total_row_number * sizeof(long long));
+			}
+			if (!tmp_groups || !tmp_groups->group_start || !tmp_groups->elem_index) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+				if (tmp_groups)
+					_oph_ioserver_query_delete_groups(tmp_groups);
+				error = OPH_IO_SERVER_MEMORY_ERROR;
+			}
 		}
-
-		for (k = 0; k < group_number; k++) {
-			groups[k] = head->group_list;
-			head = head->next;
+		if (error) {
+			free(row_group);
+			_oph_ioserver_query_delete_group_table(&group_table);
+			return error;
+		}
+		//Store row indexes by group, lengths are used as insertion positions
+		tmp_groups->group_start[0] = 0;
+		for (group = 0; group < group_table.group_num; group++) {
+			tmp_groups->group_start[group + 1] = tmp_groups->group_start[group] + group_table.length[group];
+			group_table.length[group] = tmp_groups->group_start[group];
 		}
-		hashtbl_destroy(query_groups);
+		for (j = 0; j < total_row_number; j++)
+			tmp_groups->elem_index[group_table.length[row_group[j]]++] = j;
+		free(row_group);
+		_oph_ioserver_query_delete_group_table(&group_table);
 
 		//Return groups
-		*output_row_num = group_number;
-		*group_lists = groups;
+		*output_row_num = tmp_groups->group_num;
+		*groups = tmp_groups;
 
 	}
 
 	return OPH_IO_SERVER_SUCCESS;
 }
 
-int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_list, unsigned int var_count, oph_iostore_frag_record_set ** inputs, oph_query_expr_symtable * table,
+int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, oph_query_expr_record ** var_slots, unsigned int var_count, oph_iostore_frag_record_set ** inputs,
 					     unsigned int *field_indexes, int *frag_indexes, char *field_binary, oph_query_arg * binary_var, char *field, long long row, long long *where_start_id)
 {
-	if (!var_list || !var_count || !inputs || !table || !field_indexes || !frag_indexes || !field_binary || !binary_var || !field) {
+	if (!var_slots || !var_count || !inputs || !field_indexes || !frag_indexes || !field_binary || !binary_var || !field) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
@@ -452,7 +478,7 @@ int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_l
 	for (k = 0; k < var_count; k++) {
 		if (field_binary[k]) {
 			if (args) {
-				if (oph_query_expr_add_binary(var_list[k], args[field_indexes[k]], table)) {
+				if (oph_query_expr_set_binary(var_slots[k], args[field_indexes[k]])) {
 					pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 					logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 					return OPH_IO_SERVER_EXEC_ERROR;
@@ -466,10 +492,8 @@ int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_l
 			switch (inputs[frag_indexes[k]]->field_type[field_indexes[k]]) {
 				case OPH_IOSTORE_LONG_TYPE:
 					{
-						if (oph_query_expr_add_long
-						    (var_list[k],
-						     *((long long *) inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field[field_indexes[k]]),
-						     table)) {
+						if (oph_query_expr_set_long
+						    (var_slots[k], *((long long *) inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field[field_indexes[k]]))) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							return OPH_IO_SERVER_EXEC_ERROR;
@@ -478,10 +502,8 @@ int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_l
 					}
 				case OPH_IOSTORE_REAL_TYPE:
 					{
-						if (oph_query_expr_add_double
-						    (var_list[k],
-						     *((double *) inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field[field_indexes[k]]),
-						     table)) {
+						if (oph_query_expr_set_double
+						    (var_slots[k], *((double *) inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field[field_indexes[k]]))) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							return OPH_IO_SERVER_EXEC_ERROR;
@@ -494,7 +516,7 @@ int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_l
 						binary_var[k].arg = inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field[field_indexes[k]];
 						binary_var[k].arg_length =
 						    inputs[frag_indexes[k]]->record_set[(where_start_id ? where_start_id[frag_indexes[k]] + row : row)]->field_length[field_indexes[k]];
-						if (oph_query_expr_add_binary(var_list[k], &(binary_var[k]), table)) {
+						if (oph_query_expr_set_binary(var_slots[k], &(binary_var[k]))) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
 							return OPH_IO_SERVER_EXEC_ERROR;
@@ -508,6 +530,217 @@ int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_l
 	return OPH_IO_SERVER_SUCCESS;
 }
 
+int _oph_ioserver_query_get_batch_types(unsigned int var_count, oph_iostore_frag_record_set ** inputs, unsigned int *field_indexes, int *frag_indexes, char *field_binary,
+					oph_query_expr_value_type * var_types)
+{
+	if (!var_count || !inputs || !field_indexes || !frag_indexes || !field_binary || !var_types) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	unsigned int k;
+
+	for (k = 0; k < var_count; k++) {
+		if (field_binary[k])
+			return OPH_IO_SERVER_EXEC_ERROR;
+		switch (inputs[frag_indexes[k]]->field_type[field_indexes[k]]) {
+			case OPH_IOSTORE_LONG_TYPE:
+				var_types[k] = OPH_QUERY_EXPR_TYPE_LONG;
+				break;
+			case OPH_IOSTORE_REAL_TYPE:
+				var_types[k] = OPH_QUERY_EXPR_TYPE_DOUBLE;
+				break;
+			default:
+				return OPH_IO_SERVER_EXEC_ERROR;
+		}
+	}
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+int _oph_ioserver_query_set_batch_variables(oph_query_expr_batch * batch, oph_iostore_frag_record_set ** inputs, unsigned int *field_indexes, int *frag_indexes, long long row, int row_num,
+					    long long *where_start_id)
+{
+	if (!batch || !inputs || !field_indexes || !frag_indexes || row_num > OPH_QUERY_EXPR_BATCH_SIZE) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	int k, i;
+	unsigned int field;
+	oph_iostore_frag_record **record_set;
+	void *column;
+
+	//Values of consecutive rows of columnar fragments are copied at once, otherwise each field is gathered in a contiguous array
+	for (k = 0; k < batch->var_count; k++) {
+		field = field_indexes[k];
+		record_set = inputs[frag_indexes[k]]->record_set + (where_start_id ? where_start_id[frag_indexes[k]] + row : row);
+		if (oph_iostore_get_frag_column(inputs[frag_indexes[k]], record_set, row_num, field, &column)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+			return OPH_IO_SERVER_EXEC_ERROR;
+		}
+		if (column)
+			memcpy(batch->var_values[k], column, row_num * sizeof(long long));
+		else if (batch->var_types[k] == OPH_QUERY_EXPR_TYPE_LONG) {
+			long long *values = (long long *) batch->var_values[k];
+			for (i = 0; i < row_num; i++)
+				values[i] = *((long long *) record_set[i]->field[field]);
+		} else {
+			double *values = (double *) batch->var_values[k];
+			for (i = 0; i < row_num; i++)
+				values[i] = *((double *) record_set[i]->field[field]);
+		}
+	}
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+#ifdef OPH_OMP
+int _oph_ioserver_query_store_function_result(oph_iostore_frag_record_set * output, int column, long long row, oph_query_expr_value * res)
+{
+	if (!output || !res) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		free(res);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	int ret = OPH_IO_SERVER_SUCCESS;
+	switch (res->type) {
+		case OPH_QUERY_EXPR_TYPE_DOUBLE:
+			{
+				if (!row)
+					output->field_type[column] = OPH_IOSTORE_REAL_TYPE;
+				//Values with the size of numbers are written in the slots of their own cells
+				if (oph_iostore_set_frag_cell(output, row, column, &(res->data.double_value), sizeof(double)))
+					ret = OPH_IO_SERVER_MEMORY_ERROR;
+				break;
+			}
+		case OPH_QUERY_EXPR_TYPE_LONG:
+			{
+				if (!row)
+					output->field_type[column] = OPH_IOSTORE_LONG_TYPE;
+				if (oph_iostore_set_frag_cell(output, row, column, &(res->data.long_value), sizeof(unsigned long long)))
+					ret = OPH_IO_SERVER_MEMORY_ERROR;
+				break;
+			}
+		case OPH_QUERY_EXPR_TYPE_STRING:
+			{
+				if (!row)
+					output->field_type[column] = OPH_IOSTORE_STRING_TYPE;
+				//Other values are appended to the arena shared by all threads
+#pragma omp critical(oph_ioserver_query_store_cell)
+				if (oph_iostore_set_frag_cell(output, row, column, res->data.string_value, strlen(res->data.string_value) + 1))
+					ret = OPH_IO_SERVER_MEMORY_ERROR;
+#ifdef PLUGIN_RES_COPY
+				free(res->data.string_value);
+#endif
+				break;
+			}
+		case OPH_QUERY_EXPR_TYPE_BINARY:
+			{
+				if (!row)
+					output->field_type[column] = OPH_IOSTORE_STRING_TYPE;
+#pragma omp critical(oph_ioserver_query_store_cell)
+				if (oph_iostore_set_frag_cell(output, row, column, res->data.binary_value->arg, res->data.binary_value->arg_length))
+					ret = OPH_IO_SERVER_MEMORY_ERROR;
+#ifdef PLUGIN_RES_COPY
+				free(res->data.binary_value->arg);
+#endif
+				free(res->data.binary_value);
+				break;
+			}
+		default:
+			{
+				free(res);
+				return OPH_IO_SERVER_EXEC_ERROR;
+			}
+	}
+	free(res);
+
+	return ret;
+}
+
+int _oph_ioserver_query_run_function_parallel(char *field, oph_query_arg ** args, char **var_list, int var_count, oph_iostore_frag_record_set ** inputs, unsigned int *field_indexes,
+					      int *frag_indexes, char *field_binary, long long offset, long long total_row_number, int column, oph_iostore_frag_record_set * output,
+					      unsigned short thread_num)
+{
+	if (!field || !inputs || !output || thread_num < 2 || (var_count > 0 && (!var_list || !field_indexes || !frag_indexes || !field_binary))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	int ret = OPH_IO_SERVER_SUCCESS;
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Evaluating %s on %lld rows with %d threads\n", field, total_row_number, thread_num);
+
+#pragma omp parallel num_threads(thread_num)
+	{
+		//Plugins keep their state in the AST, so each thread parses and compiles its own copy
+		oph_query_expr_node *e = NULL;
+		oph_query_expr_symtable *table = NULL;
+		oph_query_expr_value *res = NULL;
+		oph_query_expr_record *var_slots[var_count];
+		//TODO Count actual number of string/binary variables
+		oph_query_arg val_b[var_count];
+		int thread_ret = OPH_IO_SERVER_SUCCESS, curr_ret;
+		long long j;
+
+		if (oph_io_server_plan_cache_get_ast(field, &e))
+			thread_ret = OPH_IO_SERVER_PARSE_ERROR;
+		else if (oph_query_expr_create_symtable(&table, OPH_QUERY_ENGINE_MAX_PLUGIN_NUMBER))
+			thread_ret = OPH_IO_SERVER_MEMORY_ERROR;
+		else if (oph_query_expr_compile(e, table, var_list, var_count, var_slots))
+			thread_ret = OPH_IO_SERVER_PARSE_ERROR;
+		if (thread_ret) {
+#pragma omp atomic write
+			ret = thread_ret;
+		}
+		//Each output row is written by a single thread
+#pragma omp for schedule(static)
+		for (j = 0; j < total_row_number; j++) {
+#pragma omp atomic read
+			curr_ret = ret;
+			if (curr_ret)
+				continue;
+
+			if (memory_check())
+				thread_ret = OPH_IO_SERVER_MEMORY_ERROR;
+			else if (var_count > 0
+				 && _oph_ioserver_query_set_parser_variables(args, var_slots, var_count, inputs, field_indexes, frag_indexes, field_binary, val_b, field, offset + j, NULL))
+				thread_ret = OPH_IO_SERVER_PARSE_ERROR;
+			else if (oph_query_expr_eval_expression(e, &res, table))
+				thread_ret = OPH_IO_SERVER_PARSE_ERROR;
+			else if (res->jump_flag) {
+				free(res);
+				thread_ret = OPH_IO_SERVER_EXEC_ERROR;
+			} else if (_oph_ioserver_query_store_function_result(output, column, j, res))
+				thread_ret = OPH_IO_SERVER_EXEC_ERROR;
+			if (thread_ret) {
+#pragma omp atomic write
+				ret = thread_ret;
+			}
+		}
+
+		if (e)
+			oph_query_expr_delete_node(e, table);
+		if (table)
+			oph_query_expr_destroy_symtable(table);
+	}
+
+	if (ret) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field);
+	}
+
+	return ret;
+}
+#endif
+
 int _oph_ioserver_query_get_variable_indexes(unsigned int arg_count, char **var_list, unsigned int var_count, oph_iostore_frag_record_set ** inputs, unsigned int table_num,
 					     unsigned int *field_indexes, int *frag_indexes, char *field_binary, char only_id, short int *id_indexes)
 {
@@ -744,7 +977,119 @@ int _oph_io_server_query_compute_limits(HASHTBL * query_args, long long *offset,
 	return OPH_IO_SERVER_SUCCESS;
 }
 
-int _oph_io_server_query_order_output(HASHTBL * query_args, oph_iostore_frag_record_set * rs)
+int _oph_io_server_query_get_order(HASHTBL * query_args, char *order_dir)
+{
+	if (!query_args || !order_dir) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	char *dir = hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_ORDER_DIR);
+	if (!dir || !strcasecmp(dir, OPH_QUERY_ENGINE_LANG_VAL_ASC))
+		*order_dir = OPH_IO_SERVER_SORT_ASC;
+	else if (!strcasecmp(dir, OPH_QUERY_ENGINE_LANG_VAL_DESC))
+		*order_dir = OPH_IO_SERVER_SORT_DESC;
+	else {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_DIR_ERROR, dir);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_DIR_ERROR, dir);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+int _oph_io_server_query_prepare_order(HASHTBL * query_args, char **field_list, int field_list_num, oph_iostore_frag_record_set * input, long long *offset, long long *limit,
+				       long long *order_offset, long long *order_limit)
+{
+	if (!query_args || !field_list || !input || !input->record_set || !offset || !limit || !order_offset || !order_limit) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	*order_offset = *order_limit = 0;
+
+	//Limits are applied to grouped rows before ordering
+	char *order = hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_ORDER);
+	if (!order || (!(*offset) && !(*limit)) || hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_GROUP))
+		return OPH_IO_SERVER_SUCCESS;
+
+	char order_dir = OPH_IO_SERVER_SORT_ASC;
+	if (_oph_io_server_query_get_order(query_args, &order_dir))
+		return OPH_IO_SERVER_EXEC_ERROR;
+
+	//Look for the selected field named (or aliased) as order: alias string is copied since parsing splits it in place
+	char *field = NULL;
+	int i = 0;
+	char *fields_alias = hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_FIELD_ALIAS);
+	if (fields_alias) {
+		char **field_alias_list = NULL;
+		int field_alias_list_num = 0;
+		char *tmp_alias = strdup(fields_alias);
+		if (!tmp_alias) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+		if (!oph_query_parse_multivalue_arg(tmp_alias, &field_alias_list, &field_alias_list_num) && field_alias_list_num == field_list_num) {
+			for (i = 0; i < field_list_num; i++)
+				if (!STRCMP(order, strlen(field_alias_list[i]) ? field_alias_list[i] : field_list[i]))
+					break;
+			if (i < field_list_num)
+				field = field_list[i];
+		}
+		if (field_alias_list)
+			free(field_alias_list);
+		free(tmp_alias);
+	} else {
+		for (i = 0; i < field_list_num; i++)
+			if (!STRCMP(order, field_list[i]))
+				break;
+		if (i < field_list_num)
+			field = field_list[i];
+	}
+
+	//Only input columns can be checked without computing the selected fields
+	char sort_order = OPH_IO_SERVER_SORT_UNSORTED;
+	long long row_num = 0;
+	while (input->record_set[row_num])
+		row_num++;
+	if (field) {
+		for (i = 0; i < input->field_num; i++)
+			if (!STRCMP(field, input->field_name[i]))
+				break;
+		if ((i < input->field_num) && oph_io_server_sort_check(input->record_set, row_num, i, input->field_type[i], order_dir, &sort_order))
+			return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	switch (sort_order) {
+		case OPH_IO_SERVER_SORT_SORTED:
+			//Limits can be applied to input rows
+			break;
+		case OPH_IO_SERVER_SORT_REVERSED:
+			//Select the rows at the end of input, they will be reversed by ordering
+			if (*offset >= row_num) {
+				*offset = row_num;
+				*limit = 0;
+			} else if (*limit && (*offset + *limit < row_num)) {
+				*offset = row_num - *offset - *limit;
+			} else {
+				*limit = row_num - *offset;
+				*offset = 0;
+			}
+			break;
+		default:
+			//All the rows have to be computed and ordered before applying limits
+			*order_offset = *offset;
+			*order_limit = *limit;
+			*offset = *limit = 0;
+	}
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+int _oph_io_server_query_order_output(HASHTBL * query_args, long long offset, long long limit, oph_iostore_frag_record_set * rs)
 {
 	if (!query_args || !rs || !rs->record_set) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
@@ -752,65 +1097,39 @@ int _oph_io_server_query_order_output(HASHTBL * query_args, oph_iostore_frag_rec
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
 
+	long long row_num = 0, j = 0;
+	while (rs->record_set[row_num])
+		row_num++;
+
 	char *order = hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_ORDER);
 	if (order) {
 		int i = 0;
-		long long j = 1, l = 0;
-		oph_iostore_frag_record *tmp = NULL;
-		for (i = 0; i < rs->field_num; i++) {
-			if (!STRCMP(order, rs->field_name[i])) {
-				//If single row, then no order required
-				if (!rs->record_set[j])
-					break;
-
-				switch (rs->field_type[i]) {
-					case OPH_IOSTORE_REAL_TYPE:
-						{
-							//Run insertion sort routine
-							while (rs->record_set[j]) {
-								tmp = rs->record_set[j];
-								for (l = j - 1; l >= 0; l--) {
-									if (*((double *) tmp->field[i]) >= *((double *) rs->record_set[l]->field[i]))
-										break;
-									else
-										rs->record_set[l + 1] = rs->record_set[l];
-								}
-								rs->record_set[l + 1] = tmp;
-								j++;
-							}
-							break;
-						}
-					case OPH_IOSTORE_LONG_TYPE:
-						{
-							//Run insertion sort routine
-							while (rs->record_set[j]) {
-								tmp = rs->record_set[j];
-								for (l = j - 1; l >= 0; l--) {
-									if (*((long long *) tmp->field[i]) >= *((long long *) rs->record_set[l]->field[i]))
-										break;
-									else
-										rs->record_set[l + 1] = rs->record_set[l];
-								}
-								rs->record_set[l + 1] = tmp;
-								j++;
-							}
-							break;
-						}
-					default:
-						{
-							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_TYPE_ERROR);
-							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_TYPE_ERROR);
-							return OPH_IO_SERVER_EXEC_ERROR;
-						}
-				}
+		for (i = 0; i < rs->field_num; i++)
+			if (!STRCMP(order, rs->field_name[i]))
 				break;
-			}
-		}
 		if (i == rs->field_num) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, order);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, order);
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
+
+		char order_dir = OPH_IO_SERVER_SORT_ASC;
+		if (_oph_io_server_query_get_order(query_args, &order_dir))
+			return OPH_IO_SERVER_EXEC_ERROR;
+
+		//With limits only the first offset + limit rows have to be ordered
+		if (oph_io_server_sort_records(rs->record_set, row_num, i, rs->field_type[i], order_dir, limit ? offset + limit : 0))
+			return OPH_IO_SERVER_EXEC_ERROR;
+	}
+	//Apply limits to ordered rows
+	if (offset || limit) {
+		long long first = offset < row_num ? offset : row_num, last = (limit && (first + limit < row_num)) ? first + limit : row_num;
+		for (j = 0; j < row_num; j++)
+			if ((j < first) || (j >= last))
+				oph_iostore_destroy_frag_shared_record(rs, &(rs->record_set[j]));
+		if (first)
+			memmove(rs->record_set, rs->record_set + first, (last - first) * sizeof(oph_iostore_frag_record *));
+		rs->record_set[last - first] = NULL;
 	}
 
 	return OPH_IO_SERVER_SUCCESS;
@@ -830,6 +1149,8 @@ int _oph_ioserver_query_release_input_record_set(oph_iostore_handler * dev_handl
 		for (l = 0; stored_rs[l]; l++) {
 			if (dev_handle->is_persistent || stored_rs[l]->tmp_flag != 0)
 				oph_iostore_destroy_frag_recordset(&(stored_rs[l]));
+			else
+				oph_iostore_release_frag(dev_handle, stored_rs[l]);
 		}
 		free(stored_rs);
 	}
@@ -909,6 +1230,90 @@ int _oph_ioserver_query_multi_table_where_assert(int table_num, short int *id_in
 	return OPH_IO_SERVER_SUCCESS;
 }
 
+int _oph_ioserver_query_select_id_rows(oph_query_expr_node * e, oph_query_expr_record ** var_slots, int var_count, int *frag_indexes, int table_num, short int *id_indexes,
+				       long long *start_row_indexes, oph_iostore_frag_record_set ** stored_rs, long long *input_row_num, oph_iostore_frag_record_set ** input_rs, char *selected)
+{
+	if (!e || !var_slots || !var_count || !frag_indexes || !table_num || !id_indexes || !start_row_indexes || !stored_rs || !input_row_num || !input_rs || !selected) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	*selected = 0;
+
+	int k, l, id_num = 0;
+	long long j, row_num = *input_row_num;
+
+	//Only id columns are allowed in where clauses, other variables are arguments
+	oph_query_expr_record *id_slots[var_count];
+	for (k = 0; k < var_count; k++)
+		if (frag_indexes[k] >= 0)
+			id_slots[id_num++] = var_slots[k];
+	if (!id_num || row_num <= 0)
+		return OPH_IO_SERVER_SUCCESS;
+
+	//Check that ids are sequential (and aligned among tables)
+	oph_iostore_frag_record *record = stored_rs[0]->record_set[start_row_indexes[0]];
+	if (!record || !record->field[id_indexes[0]])
+		return OPH_IO_SERVER_SUCCESS;
+	long long first_id = *((long long *) record->field[id_indexes[0]]), *ids;
+	for (l = 0; l < table_num; l++) {
+		if (oph_iostore_get_frag_column(stored_rs[l], stored_rs[l]->record_set + start_row_indexes[l], row_num, id_indexes[l], (void **) &ids)) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+			return OPH_IO_SERVER_EXEC_ERROR;
+		}
+		if (ids) {
+			for (j = 0; j < row_num; j++)
+				if (ids[j] != first_id + j)
+					return OPH_IO_SERVER_SUCCESS;
+			continue;
+		}
+		for (j = 0; j < row_num; j++) {
+			record = stored_rs[l]->record_set[start_row_indexes[l] + j];
+			if (!record || !record->field[id_indexes[l]] || *((long long *) record->field[id_indexes[l]]) != first_id + j)
+				return OPH_IO_SERVER_SUCCESS;
+		}
+	}
+
+	long long words = (row_num + OPH_QUERY_EXPR_BITMAP_BITS - 1) / OPH_QUERY_EXPR_BITMAP_BITS;
+	unsigned long long *bitmap = (unsigned long long *) malloc(words * sizeof(unsigned long long));
+	if (!bitmap) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+
+	int ret = oph_query_expr_select_ids(e, id_slots, id_num, first_id, row_num, bitmap);
+	if (ret) {
+		free(bitmap);
+		if (ret == OPH_QUERY_ENGINE_EXEC_ERROR)
+			return OPH_IO_SERVER_SUCCESS;
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//Add selected rows to each index table
+	long long w, curr_row = 0;
+	unsigned long long bits;
+	for (w = 0; w < words; w++) {
+		for (bits = bitmap[w], j = w * OPH_QUERY_EXPR_BITMAP_BITS; bits; bits >>= 1, j++) {
+			if (bits & 1) {
+				for (l = 0; l < table_num; l++)
+					input_rs[l]->record_set[curr_row] = stored_rs[l]->record_set[start_row_indexes[l] + j];
+				curr_row++;
+			}
+		}
+	}
+	free(bitmap);
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Where clause applied to ids: %lld rows selected out of %lld\n", curr_row, row_num);
+	*input_row_num = curr_row;
+	*selected = 1;
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
 int _oph_ioserver_query_run_where_clause(char *where_string, oph_query_arg ** args, int table_num, oph_iostore_frag_record_set ** stored_rs, long long *input_row_num,
 					 oph_iostore_frag_record_set ** input_rs)
 {
@@ -962,7 +1367,7 @@ int _oph_ioserver_query_run_where_clause(char *where_string, oph_query_arg ** ar
 
 	oph_query_expr_node *e = NULL;
 
-	if (oph_query_expr_get_ast(where_string, &e) != 0) {
+	if (oph_io_server_plan_cache_get_ast(where_string, &e) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
 		return OPH_IO_SERVER_PARSE_ERROR;
@@ -1011,16 +1416,85 @@ int _oph_ioserver_query_run_where_clause(char *where_string, oph_query_arg ** ar
 			return OPH_IO_SERVER_PARSE_ERROR;
 		}
 	}
+	//Bind variables and functions once, rows are evaluated without symbol lookups
+	oph_query_expr_record *var_slots[var_count];
+	if (oph_query_expr_compile(e, table, var_list, var_count, var_slots)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
+		oph_query_expr_delete_node(e, table);
+		oph_query_expr_destroy_symtable(table);
+		free(var_list);
+		return OPH_IO_SERVER_PARSE_ERROR;
+	}
+
+	//Predicates on sequential ids are mapped on row indexes without evaluating the expression
+	char selected = 0;
+	if (var_count > 0 && _oph_ioserver_query_select_id_rows(e, var_slots, var_count, frag_indexes, table_num, id_indexes, start_row_indexes, stored_rs, input_row_num, input_rs, &selected)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
+		oph_query_expr_delete_node(e, table);
+		oph_query_expr_destroy_symtable(table);
+		free(var_list);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+	if (selected) {
+		free(var_list);
+		oph_query_expr_delete_node(e, table);
+		oph_query_expr_destroy_symtable(table);
+		return OPH_IO_SERVER_SUCCESS;
+	}
+
+	long long curr_row = 0;
+
+	//Rows are evaluated by blocks when the expression only involves numeric fields and built-in functions
+	oph_query_expr_value_type var_types[var_count];
+	oph_query_expr_batch *batch = NULL;
+	if (var_count > 0 && !_oph_ioserver_query_get_batch_types(var_count, stored_rs, field_indexes, frag_indexes, field_binary, var_types)
+	    && !oph_query_expr_create_batch(e, var_slots, var_types, var_count, &batch)) {
+		oph_query_expr_value_type res_type;
+		void *res_values = NULL;
+		int row_num, k;
+
+		for (j = 0; j < (*input_row_num); j += row_num) {
+			row_num = ((*input_row_num) - j < OPH_QUERY_EXPR_BATCH_SIZE ? (int) ((*input_row_num) - j) : OPH_QUERY_EXPR_BATCH_SIZE);
+
+			if (_oph_ioserver_query_set_batch_variables(batch, stored_rs, field_indexes, frag_indexes, j, row_num, start_row_indexes)
+			    || oph_query_expr_eval_batch(batch, row_num, &res_type, &res_values)) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
+				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
+				oph_query_expr_destroy_batch(batch);
+				oph_query_expr_delete_node(e, table);
+				oph_query_expr_destroy_symtable(table);
+				free(var_list);
+				return OPH_IO_SERVER_PARSE_ERROR;
+			}
+			//Add selected rows to each index table
+			for (k = 0; k < row_num; k++) {
+				if (res_type == OPH_QUERY_EXPR_TYPE_DOUBLE ? (long long) ((double *) res_values)[k] : ((long long *) res_values)[k]) {
+					for (l = 0; l < table_num; l++) {
+						input_rs[l]->record_set[curr_row] = stored_rs[l]->record_set[start_row_indexes[l] + j + k];
+					}
+					curr_row++;
+				}
+			}
+		}
+		oph_query_expr_destroy_batch(batch);
+		free(var_list);
+		oph_query_expr_delete_node(e, table);
+		oph_query_expr_destroy_symtable(table);
+		*input_row_num = curr_row;
+
+		return OPH_IO_SERVER_SUCCESS;
+	}
 
 	oph_query_expr_value *res = NULL;
 
 	//TODO Count actual number of string/binary variables
 	oph_query_arg val_b[var_count];
-	long long curr_row = 0;
 
 	for (j = 0; j < (*input_row_num); j++) {
 
-		if (_oph_ioserver_query_set_parser_variables(args, var_list, var_count, stored_rs, table, field_indexes, frag_indexes, field_binary, val_b, where_string, j, start_row_indexes)) {
+		if (_oph_ioserver_query_set_parser_variables(args, var_slots, var_count, stored_rs, field_indexes, frag_indexes, field_binary, val_b, where_string, j, start_row_indexes)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, where_string);
 			oph_query_expr_delete_node(e, table);
@@ -1939,8 +2413,19 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
 			return OPH_IO_SERVER_METADB_ERROR;
 		}
+		//Fragments cannot be removed while the DB lock is held
+		if (pthread_rwlock_rdlock(&(db_row->lock)) != 0) {
+			pthread_rwlock_unlock(&rwlock);
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+			free(in_frag_names);
+			free(in_db_names);
+			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+			return OPH_IO_SERVER_EXEC_ERROR;
+		}
 		//Check if Frag exists
 		if (oph_metadb_find_frag(db_row, in_frag_names[l], &frag)) {
+			pthread_rwlock_unlock(&(db_row->lock));
 			pthread_rwlock_unlock(&rwlock);
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag find");
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag find");
@@ -1952,6 +2437,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 		//TODO Lock table while working with it
 
 		if (frag == NULL) {
+			pthread_rwlock_unlock(&(db_row->lock));
 			pthread_rwlock_unlock(&rwlock);
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_FRAG_NOT_EXIST_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_FRAG_NOT_EXIST_ERROR);
@@ -1962,6 +2448,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 		}
 		//Call API to read Frag
 		if (oph_iostore_get_frag(dev_handle, &(frag->frag_id), &(orig_record_sets[l])) != 0) {
+			pthread_rwlock_unlock(&(db_row->lock));
 			pthread_rwlock_unlock(&rwlock);
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frag");
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_IO_API_ERROR, "get_frag");
@@ -1970,6 +2457,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
 			return OPH_IO_SERVER_API_ERROR;
 		}
+		pthread_rwlock_unlock(&(db_row->lock));
 	}
 	free(in_db_names);
 	free(in_frag_names);
@@ -2042,9 +2530,7 @@ int _oph_ioserver_query_build_input_record_set(HASHTBL * query_args, oph_query_a
 	for (l = 0; l < table_list_num; l++) {
 
 		//Take the biggest row number as reference 
-		partial_tot_row_number = 0;
-		while (orig_record_sets[l]->record_set[partial_tot_row_number])
-			partial_tot_row_number++;
+		oph_iostore_get_frag_row_num(orig_record_sets[l], &partial_tot_row_number);
 		if (partial_tot_row_number > total_row_number)
 			total_row_number = partial_tot_row_number;
 
@@ -2160,6 +2646,9 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 	oph_query_expr_node *e = NULL;
 	oph_query_expr_symtable *table = NULL;
 	oph_query_expr_value *res = NULL;
+	const void *cell_value = NULL;
+	unsigned long long cell_length = 0;
+	int cell_ret = 0;
 	unsigned int binary_index = 0;
 
 	long long actual_rows = 0, rows = 0;
@@ -2196,8 +2685,8 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 	}
 
 	//Check group by
-	oph_ioserver_group_elem_list **group_lists = NULL;
-	if (_oph_ioserver_query_get_groups(query_args, total_row_number, args, inputs, table_num, &actual_rows, &group_lists)) {
+	oph_ioserver_groups *groups = NULL;
+	if (_oph_ioserver_query_get_groups(query_args, total_row_number, args, inputs, table_num, &actual_rows, &groups)) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_GROUP_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_GROUP_ERROR);
 		return OPH_IO_SERVER_PARSE_ERROR;
@@ -2209,12 +2698,8 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 				{
 					pmesg(LOG_ERROR, __FILE__, __LINE__, "Unsupported execution of %s\n", field_list[i]);
 					logging(LOG_ERROR, __FILE__, __LINE__, "Unsupported execution of %s\n", field_list[i]);
-					if (group_lists) {
-						for (k = 0; k < actual_rows; k++)
-							if (group_lists[k])
-								_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-						free(group_lists);
-					}
+					if (groups)
+						_oph_ioserver_query_delete_groups(groups);
 					return OPH_IO_SERVER_EXEC_ERROR;
 				}
 			case OPH_QUERY_FIELD_TYPE_DOUBLE:
@@ -2223,20 +2708,13 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					//Simply copy the value on each row
 					rows = (actual_rows ? actual_rows : total_row_number);
 					for (j = 0; j < rows; j++) {
-						if (memory_check()) {
+						if (memory_check() || oph_iostore_set_frag_cell(output, j, i, &val_d, sizeof(double))) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-							if (group_lists) {
-								for (k = 0; k < actual_rows; k++)
-									if (group_lists[k])
-										_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-								free(group_lists);
-							}
+							if (groups)
+								_oph_ioserver_query_delete_groups(groups);
 							return OPH_IO_SERVER_MEMORY_ERROR;
 						}
-
-						output->record_set[j]->field[i] = (void *) memdup((const void *) &val_d, sizeof(double));
-						output->record_set[j]->field_length[i] = sizeof(double);
 					}
 					output->field_type[i] = OPH_IOSTORE_REAL_TYPE;
 					break;
@@ -2247,20 +2725,13 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					//Simply copy the value on each row
 					rows = (actual_rows ? actual_rows : total_row_number);
 					for (j = 0; j < rows; j++) {
-						if (memory_check()) {
+						if (memory_check() || oph_iostore_set_frag_cell(output, j, i, &val_l, sizeof(unsigned long long))) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-							if (group_lists) {
-								for (k = 0; k < actual_rows; k++)
-									if (group_lists[k])
-										_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-								free(group_lists);
-							}
+							if (groups)
+								_oph_ioserver_query_delete_groups(groups);
 							return OPH_IO_SERVER_MEMORY_ERROR;
 						}
-
-						output->record_set[j]->field[i] = (void *) memdup((const void *) &val_l, sizeof(unsigned long long));
-						output->record_set[j]->field_length[i] = sizeof(unsigned long long);
 					}
 					output->field_type[i] = OPH_IOSTORE_LONG_TYPE;
 					break;
@@ -2270,20 +2741,13 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					//Simply copy the value on each row
 					rows = (actual_rows ? actual_rows : total_row_number);
 					for (j = 0; j < rows; j++) {
-						if (memory_check()) {
+						if (memory_check() || oph_iostore_set_frag_cell(output, j, i, field_list[i], strlen(field_list[i]) + 1)) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-							if (group_lists) {
-								for (k = 0; k < actual_rows; k++)
-									if (group_lists[k])
-										_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-								free(group_lists);
-							}
+							if (groups)
+								_oph_ioserver_query_delete_groups(groups);
 							return OPH_IO_SERVER_MEMORY_ERROR;
 						}
-
-						output->record_set[j]->field[i] = (void *) memdup((const void *) (field_list[i]), strlen(field_list[i]) + 1);
-						output->record_set[j]->field_length[i] = strlen(field_list[i]) + 1;
 					}
 					output->field_type[i] = OPH_IOSTORE_REAL_TYPE;
 					break;
@@ -2294,31 +2758,20 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					if (binary_index >= arg_count) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, field_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, field_list[i]);
-						if (group_lists) {
-							for (k = 0; k < actual_rows; k++)
-								if (group_lists[k])
-									_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-							free(group_lists);
-						}
+						if (groups)
+							_oph_ioserver_query_delete_groups(groups);
 						return OPH_IO_SERVER_PARSE_ERROR;
 					}
 					//Simply copy the value on each row
 					rows = (actual_rows ? actual_rows : total_row_number);
 					for (j = 0; j < rows; j++) {
-						if (memory_check()) {
+						if (memory_check() || oph_iostore_set_frag_cell(output, j, i, args[binary_index]->arg, args[binary_index]->arg_length)) {
 							pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 							logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-							if (group_lists) {
-								for (k = 0; k < actual_rows; k++)
-									if (group_lists[k])
-										_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-								free(group_lists);
-							}
+							if (groups)
+								_oph_ioserver_query_delete_groups(groups);
 							return OPH_IO_SERVER_MEMORY_ERROR;
 						}
-
-						output->record_set[j]->field[i] = (void *) memdup((const void *) (args[binary_index]->arg), args[binary_index]->arg_length);
-						output->record_set[j]->field_length[i] = args[binary_index]->arg_length;
 					}
 					switch (args[binary_index]->arg_type) {
 						case OPH_QUERY_TYPE_LONG:
@@ -2349,12 +2802,8 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					if (oph_query_parse_hierarchical_args(field_list[i], &field_components, &field_components_num)) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_HIERARCHY_PARSE_ERROR, field_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_HIERARCHY_PARSE_ERROR, field_list[i]);
-						if (group_lists) {
-							for (k = 0; k < actual_rows; k++)
-								if (group_lists[k])
-									_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-							free(group_lists);
-						}
+						if (groups)
+							_oph_ioserver_query_delete_groups(groups);
 						return OPH_IO_SERVER_PARSE_ERROR;
 					}
 
@@ -2362,12 +2811,8 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_HIERARCHY_PARSE_ERROR, field_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_HIERARCHY_PARSE_ERROR, field_list[i]);
 						free(field_components);
-						if (group_lists) {
-							for (k = 0; k < actual_rows; k++)
-								if (group_lists[k])
-									_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-							free(group_lists);
-						}
+						if (groups)
+							_oph_ioserver_query_delete_groups(groups);
 						return OPH_IO_SERVER_PARSE_ERROR;
 					}
 					//Match table
@@ -2388,12 +2833,8 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 								pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, field_list[i]);
 								logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, field_list[i]);
 								free(field_components);
-								if (group_lists) {
-									for (k = 0; k < actual_rows; k++)
-										if (group_lists[k])
-											_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-									free(group_lists);
-								}
+								if (groups)
+									_oph_ioserver_query_delete_groups(groups);
 								return OPH_IO_SERVER_PARSE_ERROR;
 							}
 							break;
@@ -2403,76 +2844,70 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, field_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_FIELD_NAME_UNKNOWN, field_list[i]);
 						free(field_components);
-						if (group_lists) {
-							for (k = 0; k < actual_rows; k++)
-								if (group_lists[k])
-									_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-							free(group_lists);
-						}
+						if (groups)
+							_oph_ioserver_query_delete_groups(groups);
 						return OPH_IO_SERVER_PARSE_ERROR;
 					}
 					free(field_components);
 
 					rows = (actual_rows ? actual_rows : total_row_number);
 					if (!use_seq_id) {
-						if (!group_lists) {
+						//Cells of string columns stored in an arena are shared instead of being copied
+						oph_iostore_frag_columns *shared_columns = NULL;
+						if (oph_iostore_get_frag_shared_columns(inputs[frag_index], field_index, &shared_columns)
+						    || (shared_columns && oph_iostore_share_frag_field(output, i, shared_columns)))
+							shared_columns = NULL;
+						if (!groups) {
 							id = offset;
 							for (j = 0; j < rows; j++, id++) {
-								if (memory_check()) {
+								if (memory_check()
+								    || (!shared_columns
+									&& oph_iostore_set_frag_cell(output, j, i,
+												     inputs[frag_index]->record_set[id]->field_length[field_index] ?
+												     inputs[frag_index]->record_set[id]->field[field_index] : NULL,
+												     inputs[frag_index]->record_set[id]->field_length[field_index]))) {
 									pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 									logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-									if (group_lists) {
-										for (k = 0; k < actual_rows; k++)
-											if (group_lists[k])
-												_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-										free(group_lists);
-									}
+									if (groups)
+										_oph_ioserver_query_delete_groups(groups);
 									return OPH_IO_SERVER_MEMORY_ERROR;
 								}
-								output->record_set[j]->field[i] =
-								    inputs[frag_index]->record_set[id]->field_length[field_index] ?
-								    memdup(inputs[frag_index]->record_set[id]->field[field_index],
-									   inputs[frag_index]->record_set[id]->field_length[field_index]) : NULL;
-								output->record_set[j]->field_length[i] = inputs[frag_index]->record_set[id]->field_length[field_index];
+								if (shared_columns) {
+									output->record_set[j]->field[i] = inputs[frag_index]->record_set[id]->field[field_index];
+									output->record_set[j]->field_length[i] = inputs[frag_index]->record_set[id]->field_length[field_index];
+								}
 							}
 						} else {
 							//Aggregation is used, no offset allowed
 							for (j = 0; j < rows; j++) {
-								if (memory_check()) {
+								oph_iostore_frag_record *input_record = inputs[frag_index]->record_set[groups->elem_index[groups->group_start[j]]];
+								if (memory_check()
+								    || (!shared_columns
+									&& oph_iostore_set_frag_cell(output, j, i, input_record->field_length[field_index] ? input_record->field[field_index] : NULL,
+												     input_record->field_length[field_index]))) {
 									pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 									logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-									if (group_lists) {
-										for (k = 0; k < actual_rows; k++)
-											if (group_lists[k])
-												_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-										free(group_lists);
-									}
+									if (groups)
+										_oph_ioserver_query_delete_groups(groups);
 									return OPH_IO_SERVER_MEMORY_ERROR;
 								}
-								output->record_set[j]->field[i] =
-								    inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field_length[field_index] ?
-								    memdup(inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field[field_index],
-									   inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field_length[field_index]) : NULL;
-								output->record_set[j]->field_length[i] = inputs[frag_index]->record_set[group_lists[j]->first->elem_index]->field_length[field_index];
+								if (shared_columns) {
+									output->record_set[j]->field[i] = input_record->field[field_index];
+									output->record_set[j]->field_length[i] = input_record->field_length[field_index];
+								}
 							}
 						}
 					} else {
 						//Use sequential IDs instead
 						for (j = 0; j < rows; j++) {
-							if (memory_check()) {
+							val_l = start_id + j;
+							if (memory_check() || oph_iostore_set_frag_cell(output, j, i, &val_l, sizeof(unsigned long long))) {
 								pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 								logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
-								if (group_lists) {
-									for (k = 0; k < actual_rows; k++)
-										if (group_lists[k])
-											_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-									free(group_lists);
-								}
+								if (groups)
+									_oph_ioserver_query_delete_groups(groups);
 								return OPH_IO_SERVER_MEMORY_ERROR;
 							}
-							val_l = start_id + j;
-							output->record_set[j]->field[i] = memdup(&val_l, sizeof(unsigned long long));
-							output->record_set[j]->field_length[i] = sizeof(unsigned long long);
 						}
 					}
 					output->field_type[i] = inputs[frag_index]->field_type[field_index];
@@ -2490,25 +2925,17 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					if (oph_query_expr_create_symtable(&table, OPH_QUERY_ENGINE_MAX_PLUGIN_NUMBER)) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, field_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, field_list[i]);
-						if (group_lists) {
-							for (k = 0; k < actual_rows; k++)
-								if (group_lists[k])
-									_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-							free(group_lists);
-						}
+						if (groups)
+							_oph_ioserver_query_delete_groups(groups);
 						return OPH_IO_SERVER_EXEC_ERROR;
 					}
 
-					if (oph_query_expr_get_ast(field_list[i], &e) != 0) {
+					if (oph_io_server_plan_cache_get_ast(field_list[i], &e) != 0) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, field_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, field_list[i]);
 						oph_query_expr_destroy_symtable(table);
-						if (group_lists) {
-							for (k = 0; k < actual_rows; k++)
-								if (group_lists[k])
-									_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-							free(group_lists);
-						}
+						if (groups)
+							_oph_ioserver_query_delete_groups(groups);
 						return OPH_IO_SERVER_EXEC_ERROR;
 					}
 					//Read all variables and link them to input record set fields
@@ -2517,12 +2944,8 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, field_list[i]);
 						oph_query_expr_delete_node(e, table);
 						oph_query_expr_destroy_symtable(table);
-						if (group_lists) {
-							for (k = 0; k < actual_rows; k++)
-								if (group_lists[k])
-									_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-							free(group_lists);
-						}
+						if (groups)
+							_oph_ioserver_query_delete_groups(groups);
 						return OPH_IO_SERVER_EXEC_ERROR;
 					}
 
@@ -2543,18 +2966,105 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 							oph_query_expr_delete_node(e, table);
 							oph_query_expr_destroy_symtable(table);
 							free(var_list);
-							if (group_lists) {
-								for (k = 0; k < actual_rows; k++)
-									if (group_lists[k])
-										_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-								free(group_lists);
-							}
+							if (groups)
+								_oph_ioserver_query_delete_groups(groups);
 							return OPH_IO_SERVER_EXEC_ERROR;
 						}
 					}
+					//Bind variables and functions once, rows are evaluated without symbol lookups
+					oph_query_expr_record *var_slots[var_count];
+					if (oph_query_expr_compile(e, table, var_list, var_count, var_slots)) {
+						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
+						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
+						oph_query_expr_delete_node(e, table);
+						oph_query_expr_destroy_symtable(table);
+						free(var_list);
+						if (groups)
+							_oph_ioserver_query_delete_groups(groups);
+						return OPH_IO_SERVER_PARSE_ERROR;
+					}
+
+					//Rows are evaluated by blocks when the expression only involves numeric fields and built-in functions
+					oph_query_expr_value_type var_types[var_count];
+					oph_query_expr_batch *batch = NULL;
+					if (!groups && var_count > 0 && !_oph_ioserver_query_get_batch_types(var_count, inputs, field_indexes, frag_indexes, field_binary, var_types))
+						oph_query_expr_create_batch(e, var_slots, var_types, var_count, &batch);
+#ifdef OPH_OMP
+					//Otherwise rows are split among threads, within the server-wide CPU budget, if they can be evaluated independently
+					unsigned short thread_num = 0;
+					char has_aggregate = 1;
+					if (!batch && !groups && omp_threads > 1 && total_row_number >= 2 * OPH_IO_SERVER_MIN_ROWS_PER_THREAD && !oph_query_expr_has_aggregate(e, &has_aggregate)
+					    && !has_aggregate)
+						oph_util_cpu_acquire(total_row_number / OPH_IO_SERVER_MIN_ROWS_PER_THREAD < omp_threads ? (unsigned short) (total_row_number / OPH_IO_SERVER_MIN_ROWS_PER_THREAD) :
+								     omp_threads, &thread_num);
+#endif
 
 					long long function_row_number = 0;
-					if (!group_lists) {
+					if (batch) {
+						//No group by provided, no aggregate function
+						oph_query_expr_value_type res_type;
+						void *res_values = NULL;
+						int row_num;
+						id = offset;
+
+						for (j = 0; j < total_row_number; j += row_num, id += row_num) {
+							row_num = (total_row_number - j < OPH_QUERY_EXPR_BATCH_SIZE ? (int) (total_row_number - j) : OPH_QUERY_EXPR_BATCH_SIZE);
+
+							if (memory_check()) {
+								pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+								logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+								oph_query_expr_destroy_batch(batch);
+								oph_query_expr_delete_node(e, table);
+								oph_query_expr_destroy_symtable(table);
+								free(var_list);
+								return OPH_IO_SERVER_MEMORY_ERROR;
+							}
+
+							if (_oph_ioserver_query_set_batch_variables(batch, inputs, field_indexes, frag_indexes, id, row_num, NULL)
+							    || oph_query_expr_eval_batch(batch, row_num, &res_type, &res_values)) {
+								pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
+								logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
+								oph_query_expr_destroy_batch(batch);
+								oph_query_expr_delete_node(e, table);
+								oph_query_expr_destroy_symtable(table);
+								free(var_list);
+								return OPH_IO_SERVER_PARSE_ERROR;
+							}
+
+							if (!function_row_number)
+								output->field_type[i] = (res_type == OPH_QUERY_EXPR_TYPE_DOUBLE ? OPH_IOSTORE_REAL_TYPE : OPH_IOSTORE_LONG_TYPE);
+							//Doubles and longs have the same size, so values are copied as they are
+							for (k = 0; k < row_num; k++, function_row_number++) {
+								if (oph_iostore_set_frag_cell(output, function_row_number, i, (long long *) res_values + k, sizeof(long long))) {
+									pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+									logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+									oph_query_expr_destroy_batch(batch);
+									oph_query_expr_delete_node(e, table);
+									oph_query_expr_destroy_symtable(table);
+									free(var_list);
+									return OPH_IO_SERVER_MEMORY_ERROR;
+								}
+							}
+						}
+						oph_query_expr_destroy_batch(batch);
+
+					}
+#ifdef OPH_OMP
+					else if (thread_num) {
+						//No group by provided, no aggregate function
+						if (_oph_ioserver_query_run_function_parallel
+						    (field_list[i], args, var_list, var_count, inputs, field_indexes, frag_indexes, field_binary, offset, total_row_number, i, output, thread_num)) {
+							oph_util_cpu_release(thread_num);
+							oph_query_expr_delete_node(e, table);
+							oph_query_expr_destroy_symtable(table);
+							free(var_list);
+							return OPH_IO_SERVER_PARSE_ERROR;
+						}
+						oph_util_cpu_release(thread_num);
+						function_row_number = total_row_number;
+					}
+#endif
+					else if (!groups) {
 						//No group by provided  
 						char is_aggregate = 0;
 						id = offset;
@@ -2571,7 +3081,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 
 							if (var_count > 0) {
 								if (_oph_ioserver_query_set_parser_variables
-								    (args, var_list, var_count, inputs, table, field_indexes, frag_indexes, field_binary, val_b, field_list[i], id, NULL)) {
+								    (args, var_slots, var_count, inputs, field_indexes, frag_indexes, field_binary, val_b, field_list[i], id, NULL)) {
 									pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
 									logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
 									oph_query_expr_delete_node(e, table);
@@ -2599,49 +3109,32 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 											{
 												if (!function_row_number)
 													output->field_type[i] = OPH_IOSTORE_REAL_TYPE;
-												output->record_set[function_row_number]->field[i] =
-												    (void *) memdup((const void *) &(res->data.double_value), sizeof(double));
-												output->record_set[function_row_number]->field_length[i] = sizeof(double);
-												free(res);
+												cell_value = &(res->data.double_value);
+												cell_length = sizeof(double);
 												break;
 											}
 										case OPH_QUERY_EXPR_TYPE_LONG:
 											{
 												if (!function_row_number)
 													output->field_type[i] = OPH_IOSTORE_LONG_TYPE;
-												output->record_set[function_row_number]->field[i] =
-												    (void *) memdup((const void *) &(res->data.long_value), sizeof(unsigned long long));
-												output->record_set[function_row_number]->field_length[i] = sizeof(unsigned long long);
-												free(res);
+												cell_value = &(res->data.long_value);
+												cell_length = sizeof(unsigned long long);
 												break;
 											}
 										case OPH_QUERY_EXPR_TYPE_STRING:
 											{
 												if (!function_row_number)
 													output->field_type[i] = OPH_IOSTORE_STRING_TYPE;
-#ifdef PLUGIN_RES_COPY
-												output->record_set[function_row_number]->field[i] = (void *) res->data.string_value;
-#else
-												output->record_set[function_row_number]->field[i] =
-												    (void *) memdup((const void *) res->data.string_value, strlen(res->data.string_value) + 1);
-#endif
-												output->record_set[function_row_number]->field_length[i] = strlen(res->data.string_value) + 1;
-												free(res);
+												cell_value = res->data.string_value;
+												cell_length = strlen(res->data.string_value) + 1;
 												break;
 											}
 										case OPH_QUERY_EXPR_TYPE_BINARY:
 											{
 												if (!function_row_number)
 													output->field_type[i] = OPH_IOSTORE_STRING_TYPE;
-#ifdef PLUGIN_RES_COPY
-												output->record_set[function_row_number]->field[i] = (void *) res->data.binary_value->arg;
-#else
-												output->record_set[function_row_number]->field[i] =
-												    (void *) memdup((const void *) res->data.binary_value->arg, res->data.binary_value->arg_length);
-#endif
-												output->record_set[function_row_number]->field_length[i] = res->data.binary_value->arg_length;
-												free(res->data.binary_value);
-												free(res);
+												cell_value = res->data.binary_value->arg;
+												cell_length = res->data.binary_value->arg_length;
 												break;
 											}
 										default:
@@ -2655,6 +3148,27 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 												return OPH_IO_SERVER_EXEC_ERROR;
 											}
 									}
+									//Value is copied in the output cell, then the result is released
+									cell_ret = oph_iostore_set_frag_cell(output, function_row_number, i, cell_value, cell_length);
+									if (res->type == OPH_QUERY_EXPR_TYPE_BINARY) {
+#ifdef PLUGIN_RES_COPY
+										free(res->data.binary_value->arg);
+#endif
+										free(res->data.binary_value);
+#ifdef PLUGIN_RES_COPY
+									} else if (res->type == OPH_QUERY_EXPR_TYPE_STRING) {
+										free(res->data.string_value);
+#endif
+									}
+									free(res);
+									if (cell_ret) {
+										pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+										logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+										oph_query_expr_delete_node(e, table);
+										oph_query_expr_destroy_symtable(table);
+										free(var_list);
+										return OPH_IO_SERVER_MEMORY_ERROR;
+									}
 									function_row_number++;
 								} else {
 									free(res);
@@ -2672,12 +3186,11 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 
 					} else {
 						//Group by is provided, no offset allowed 
-						oph_ioserver_group_elem *tmp = NULL;
 						char jump_flag = 1;
 
 						for (k = 0; k < actual_rows; k++) {
 							//Loop on groups
-							for (tmp = group_lists[k]->first, j = 0; tmp; tmp = tmp->next, j++) {
+							for (l = groups->group_start[k], j = 0; l < groups->group_start[k + 1]; l++, j++) {
 								jump_flag = 1;
 
 								//Loop on rows                                          
@@ -2687,41 +3200,32 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 									oph_query_expr_delete_node(e, table);
 									oph_query_expr_destroy_symtable(table);
 									free(var_list);
-									for (k = 0; k < actual_rows; k++)
-										if (group_lists[k])
-											_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-									free(group_lists);
+									_oph_ioserver_query_delete_groups(groups);
 									return OPH_IO_SERVER_MEMORY_ERROR;
 								}
 
 								if (var_count > 0) {
 									if (_oph_ioserver_query_set_parser_variables
-									    (args, var_list, var_count, inputs, table, field_indexes, frag_indexes, field_binary, val_b, field_list[i], tmp->elem_index,
+									    (args, var_slots, var_count, inputs, field_indexes, frag_indexes, field_binary, val_b, field_list[i], groups->elem_index[l],
 									     NULL)) {
 										pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
 										logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
 										oph_query_expr_delete_node(e, table);
 										oph_query_expr_destroy_symtable(table);
 										free(var_list);
-										for (k = 0; k < actual_rows; k++)
-											if (group_lists[k])
-												_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-										free(group_lists);
+										_oph_ioserver_query_delete_groups(groups);
 										return OPH_IO_SERVER_PARSE_ERROR;
 									}
 								}
 								//IF last row of group  
-								if (tmp->next == NULL) {
+								if (l == groups->group_start[k + 1] - 1) {
 									if (oph_query_expr_change_group(e)) {
 										pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
 										logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
 										oph_query_expr_delete_node(e, table);
 										oph_query_expr_destroy_symtable(table);
 										free(var_list);
-										for (k = 0; k < actual_rows; k++)
-											if (group_lists[k])
-												_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-										free(group_lists);
+										_oph_ioserver_query_delete_groups(groups);
 										return OPH_IO_SERVER_PARSE_ERROR;
 									}
 									//Unset internal jump flag for non-aggregating functions
@@ -2735,50 +3239,32 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 												{
 													if (!function_row_number)
 														output->field_type[i] = OPH_IOSTORE_REAL_TYPE;
-													output->record_set[function_row_number]->field[i] =
-													    (void *) memdup((const void *) &(res->data.double_value), sizeof(double));
-													output->record_set[function_row_number]->field_length[i] = sizeof(double);
-													free(res);
+													cell_value = &(res->data.double_value);
+													cell_length = sizeof(double);
 													break;
 												}
 											case OPH_QUERY_EXPR_TYPE_LONG:
 												{
 													if (!function_row_number)
 														output->field_type[i] = OPH_IOSTORE_LONG_TYPE;
-													output->record_set[function_row_number]->field[i] =
-													    (void *) memdup((const void *) &(res->data.long_value), sizeof(unsigned long long));
-													output->record_set[function_row_number]->field_length[i] = sizeof(unsigned long long);
-													free(res);
+													cell_value = &(res->data.long_value);
+													cell_length = sizeof(unsigned long long);
 													break;
 												}
 											case OPH_QUERY_EXPR_TYPE_STRING:
 												{
 													if (!function_row_number)
 														output->field_type[i] = OPH_IOSTORE_STRING_TYPE;
-#ifdef PLUGIN_RES_COPY
-													output->record_set[function_row_number]->field[i] = (void *) res->data.string_value;
-#else
-													output->record_set[function_row_number]->field[i] =
-													    (void *) memdup((const void *) res->data.string_value, strlen(res->data.string_value) + 1);
-#endif
-													output->record_set[function_row_number]->field_length[i] = strlen(res->data.string_value) + 1;
-													free(res);
+													cell_value = res->data.string_value;
+													cell_length = strlen(res->data.string_value) + 1;
 													break;
 												}
 											case OPH_QUERY_EXPR_TYPE_BINARY:
 												{
 													if (!function_row_number)
 														output->field_type[i] = OPH_IOSTORE_STRING_TYPE;
-#ifdef PLUGIN_RES_COPY
-													output->record_set[function_row_number]->field[i] = (void *) res->data.binary_value->arg;
-#else
-													output->record_set[function_row_number]->field[i] =
-													    (void *) memdup((const void *) res->data.binary_value->arg,
-															    res->data.binary_value->arg_length);
-#endif
-													output->record_set[function_row_number]->field_length[i] = res->data.binary_value->arg_length;
-													free(res->data.binary_value);
-													free(res);
+													cell_value = res->data.binary_value->arg;
+													cell_length = res->data.binary_value->arg_length;
 													break;
 												}
 											default:
@@ -2789,13 +3275,32 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 													oph_query_expr_delete_node(e, table);
 													oph_query_expr_destroy_symtable(table);
 													free(var_list);
-													for (k = 0; k < actual_rows; k++)
-														if (group_lists[k])
-															_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-													free(group_lists);
+													_oph_ioserver_query_delete_groups(groups);
 													return OPH_IO_SERVER_EXEC_ERROR;
 												}
 										}
+										//Value is copied in the output cell, then the result is released
+										cell_ret = oph_iostore_set_frag_cell(output, function_row_number, i, cell_value, cell_length);
+										if (res->type == OPH_QUERY_EXPR_TYPE_BINARY) {
+#ifdef PLUGIN_RES_COPY
+											free(res->data.binary_value->arg);
+#endif
+											free(res->data.binary_value);
+#ifdef PLUGIN_RES_COPY
+										} else if (res->type == OPH_QUERY_EXPR_TYPE_STRING) {
+											free(res->data.string_value);
+#endif
+										}
+										free(res);
+										if (cell_ret) {
+											pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+											logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+											oph_query_expr_delete_node(e, table);
+											oph_query_expr_destroy_symtable(table);
+											free(var_list);
+											_oph_ioserver_query_delete_groups(groups);
+											return OPH_IO_SERVER_MEMORY_ERROR;
+										}
 										function_row_number++;
 									} else {
 										free(res);
@@ -2806,10 +3311,7 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 									oph_query_expr_delete_node(e, table);
 									oph_query_expr_destroy_symtable(table);
 									free(var_list);
-									for (k = 0; k < actual_rows; k++)
-										if (group_lists[k])
-											_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-									free(group_lists);
+									_oph_ioserver_query_delete_groups(groups);
 									return OPH_IO_SERVER_PARSE_ERROR;
 								}
 							}
@@ -2823,12 +3325,8 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 					if (function_row_number == 0 || (function_row_number != actual_rows && actual_rows != 0)) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_PARSING_ERROR, field_list[i]);
-						if (group_lists) {
-							for (k = 0; k < actual_rows; k++)
-								if (group_lists[k])
-									_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-							free(group_lists);
-						}
+						if (groups)
+							_oph_ioserver_query_delete_groups(groups);
 						return OPH_IO_SERVER_PARSE_ERROR;
 					}
 					actual_rows = function_row_number;
@@ -2836,18 +3334,14 @@ int _oph_ioserver_query_build_select_columns(HASHTBL * query_args, char **field_
 		}
 	}
 
-	if (group_lists) {
-		for (k = 0; k < actual_rows; k++)
-			if (group_lists[k])
-				_oph_ioserver_query_delete_group_elem_list(group_lists[k]);
-		free(group_lists);
-	}
+	if (groups)
+		_oph_ioserver_query_delete_groups(groups);
 
 	actual_rows = (actual_rows ? actual_rows : total_row_number);
 	if (actual_rows != total_row_number) {
 		//Remove unnecessary rows
 		for (j = actual_rows; j < total_row_number; j++) {
-			oph_iostore_destroy_frag_record(&(output->record_set[j]), output->field_num);
+			oph_iostore_destroy_frag_shared_record(output, &(output->record_set[j]));
 		}
 		//Realloc record set array
 		oph_iostore_frag_record **tmp = (oph_iostore_frag_record **) realloc(output->record_set, (actual_rows + 1) * sizeof(oph_iostore_frag_record *));
@@ -2922,11 +3416,17 @@ int _oph_ioserver_query_store_fragment(oph_metadb_db_row ** meta_db, oph_iostore
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
 		return OPH_IO_SERVER_NULL_PARAM;
 	}
+	//Columns of query results are sealed, while records built one by one are moved in columnar storage, so that fragments are scanned
+	//sequentially and released at once (or written block by block)
+	if (oph_iostore_pack_frag_recordset(*final_result_set)) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to pack fragment '%s' by columns\n", (*final_result_set)->frag_name);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Unable to pack fragment '%s' by columns\n", (*final_result_set)->frag_name);
+	}
 	//Check current db
 	oph_metadb_db_row *db_row = NULL;
 
 	//LOCK FROM HERE
-	if (pthread_rwlock_wrlock(&rwlock) != 0) {
+	if (pthread_rwlock_rdlock(&rwlock) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
 		return OPH_IO_SERVER_EXEC_ERROR;
@@ -2963,31 +3463,21 @@ int _oph_ioserver_query_store_fragment(oph_metadb_db_row ** meta_db, oph_iostore
 	free(frag_id);
 	frag_id = NULL;
 
-	oph_metadb_db_row *tmp_db_row = NULL;
-	if (oph_metadb_setup_db_struct(db_row->db_name, db_row->device, dev_handle->is_persistent, &(db_row->db_id), db_row->frag_number, &tmp_db_row)) {
-		pthread_rwlock_unlock(&rwlock);
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "db");
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "db");
-		oph_metadb_cleanup_frag_struct(frag);
-		return OPH_IO_SERVER_METADB_ERROR;
-	}
+	//Only the bucket of the new fragment is locked while it is added
 	if (oph_metadb_add_frag(db_row, frag)) {
 		pthread_rwlock_unlock(&rwlock);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "frag add");
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "frag add");
 		oph_metadb_cleanup_frag_struct(frag);
-		oph_metadb_cleanup_db_struct(tmp_db_row);
 		return OPH_IO_SERVER_METADB_ERROR;
 	}
 
 	oph_metadb_cleanup_frag_struct(frag);
 
-	tmp_db_row->frag_number++;
-	if (oph_metadb_update_db(*meta_db, tmp_db_row)) {
+	if (oph_metadb_update_db_frag_number(db_row, 1)) {
 		pthread_rwlock_unlock(&rwlock);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "db update");
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "db update");
-		oph_metadb_cleanup_db_struct(tmp_db_row);
 		return OPH_IO_SERVER_METADB_ERROR;
 	}
 	//If device is transient then block record from being deleted
@@ -2998,12 +3488,9 @@ int _oph_ioserver_query_store_fragment(oph_metadb_db_row ** meta_db, oph_iostore
 	if (pthread_rwlock_unlock(&rwlock) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
-		oph_metadb_cleanup_db_struct(tmp_db_row);
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
 
-	oph_metadb_cleanup_db_struct(tmp_db_row);
-
 	return OPH_IO_SERVER_SUCCESS;
 }
 
@@ -3123,7 +3610,7 @@ int _oph_ioserver_query_build_row(unsigned int arg_count, unsigned long long *ro
 						return OPH_IO_SERVER_EXEC_ERROR;
 					}
 
-					if (oph_query_expr_get_ast(value_list[i], &e) != 0) {
+					if (oph_io_server_plan_cache_get_ast(value_list[i], &e) != 0) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, value_list[i]);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_ENGINE_ERROR, value_list[i]);
 						oph_query_expr_destroy_symtable(table);
@@ -127,6 +127,17 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 		free(frag_components);
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
+	//Check if limits can be applied before ordering
+	long long order_limit = 0, order_offset = 0;
+	if (_oph_io_server_query_prepare_order(query_args, field_list, field_list_num, record_sets[0], &offset, &limit, &order_offset, &order_limit)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		if (field_list)
+			free(field_list);
+		free(frag_components);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
 	//Prepare output record set
 	oph_iostore_frag_record_set *rs = NULL;
 	int i = 0;
@@ -142,8 +153,8 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 				total_row_number++;
 			}
 		}
-		//Create output record set
-		if (oph_iostore_create_frag_recordset(&rs, total_row_number, field_list_num)) {
+		//Create output record set, whose cells are written in place in its columns
+		if (oph_iostore_create_frag_recordset_columns(&rs, total_row_number, field_list_num)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
@@ -180,7 +191,7 @@ int _oph_io_server_run_create_as_select(oph_metadb_db_row ** meta_db, oph_iostor
 			return OPH_IO_SERVER_EXEC_ERROR;
 		}
 		//Order rows
-		if (_oph_io_server_query_order_output(query_args, rs)) {
+		if (_oph_io_server_query_order_output(query_args, order_offset, order_limit, rs)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
 			_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
@@ -302,6 +313,16 @@ int oph_io_server_run_select(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 			free(field_list);
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
+	//Check if limits can be applied before ordering
+	long long order_limit = 0, order_offset = 0;
+	if (_oph_io_server_query_prepare_order(query_args, field_list, field_list_num, record_sets[0], &offset, &limit, &order_offset, &order_limit)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
+		if (field_list)
+			free(field_list);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
 	//Prepare output record set
 	oph_iostore_frag_record_set *rs = NULL;
 	long long j = 0, total_row_number = 0;
@@ -318,8 +339,8 @@ int oph_io_server_run_select(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 				total_row_number++;
 			}
 		}
-		//Create output record set
-		if (oph_iostore_create_frag_recordset(&rs, total_row_number, field_list_num)) {
+		//Create output record set, whose cells are written in place in its columns
+		if (oph_iostore_create_frag_recordset_columns(&rs, total_row_number, field_list_num)) {
 			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
 			error = OPH_IO_SERVER_MEMORY_ERROR;
@@ -341,7 +362,7 @@ int oph_io_server_run_select(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 					error = OPH_IO_SERVER_EXEC_ERROR;
 				} else {
 					//Order rows
-					if (_oph_io_server_query_order_output(query_args, rs)) {
+					if (_oph_io_server_query_order_output(query_args, order_offset, order_limit, rs)) {
 						pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
 						logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
 						error = OPH_IO_SERVER_EXEC_ERROR;
@@ -1030,7 +1051,7 @@ int oph_io_server_run_drop_frag(oph_metadb_db_row ** meta_db, oph_iostore_handle
 	frag_id.id = NULL;
 
 	//LOCK FROM HERE
-	if (pthread_rwlock_wrlock(&rwlock) != 0) {
+	if (pthread_rwlock_rdlock(&rwlock) != 0) {
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
 		return OPH_IO_SERVER_EXEC_ERROR;
@@ -1042,13 +1063,22 @@ int oph_io_server_run_drop_frag(oph_metadb_db_row ** meta_db, oph_iostore_handle
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "DB find");
 		return OPH_IO_SERVER_METADB_ERROR;
 	}
+	//Only queries on the same DB wait for fragment removal
+	if (pthread_rwlock_wrlock(&(db_row->lock)) != 0) {
+		pthread_rwlock_unlock(&rwlock);
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
 	//Remove Frag from MetaDB
 	if (oph_metadb_remove_frag(db_row, frag_name, &frag_id)) {
+		pthread_rwlock_unlock(&(db_row->lock));
 		pthread_rwlock_unlock(&rwlock);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag remove");
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag remove");
 		return OPH_IO_SERVER_METADB_ERROR;
 	}
+	pthread_rwlock_unlock(&(db_row->lock));
 
 	if (frag_id.id == NULL) {
 		pthread_rwlock_unlock(&rwlock);
@@ -1057,29 +1087,16 @@ int oph_io_server_run_drop_frag(oph_metadb_db_row ** meta_db, oph_iostore_handle
 		return OPH_IO_SERVER_SUCCESS;
 	}
 
-	oph_metadb_db_row *tmp_db_row = NULL;
-	if (oph_metadb_setup_db_struct(db_row->db_name, db_row->device, dev_handle->is_persistent, &(db_row->db_id), db_row->frag_number, &tmp_db_row)) {
-		pthread_rwlock_unlock(&rwlock);
-		oph_iostore_delete_frag(dev_handle, &(frag_id));
-		free(frag_id.id);
-		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "db");
-		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ALLOC_ERROR, "db");
-		return OPH_IO_SERVER_METADB_ERROR;
-	}
-
-	tmp_db_row->frag_number--;
-	if (oph_metadb_update_db(*meta_db, tmp_db_row)) {
+	if (oph_metadb_update_db_frag_number(db_row, -1)) {
 		pthread_rwlock_unlock(&rwlock);
 		oph_iostore_delete_frag(dev_handle, &(frag_id));
 		free(frag_id.id);
-		oph_metadb_cleanup_db_struct(tmp_db_row);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "db update");
 		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "db update");
 		return OPH_IO_SERVER_METADB_ERROR;
 	}
 	//UNLOCK FROM HERE
 	if (pthread_rwlock_unlock(&rwlock) != 0) {
-		oph_metadb_cleanup_db_struct(tmp_db_row);
 		oph_iostore_delete_frag(dev_handle, &(frag_id));
 		free(frag_id.id);
 		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_UNLOCK_ERROR);
@@ -1087,8 +1104,6 @@ int oph_io_server_run_drop_frag(oph_metadb_db_row ** meta_db, oph_iostore_handle
 		return OPH_IO_SERVER_EXEC_ERROR;
 	}
 
-	oph_metadb_cleanup_db_struct(tmp_db_row);
-
 	//Call API to delete Frag
 	if (oph_iostore_delete_frag(dev_handle, &(frag_id)) != 0) {
 		free(frag_id.id);
@@ -1254,8 +1269,7 @@ int oph_io_server_run_drop_db(oph_metadb_db_row ** meta_db, oph_iostore_handler
 			}
 		}
 		//Cleanup fragment table
-		free(db->table->rows);
-		free(db->table);
+		oph_metadb_frag_table_destroy(db->table);
 		db->table = NULL;
 	}
 	//Call API to delete DB
@@ -35,6 +35,12 @@
 #include "oph_metadb_interface.h"
 #include "oph_query_expression_evaluator.h"
 
+//Minimum number of rows assigned to each thread when the rows of a function are processed in parallel
+#define OPH_IO_SERVER_MIN_ROWS_PER_THREAD 16
+
+//Initial number of groups (and minimum number of hash slots) allocated for a group by clause
+#define OPH_IO_SERVER_GROUP_SIZE 64
+
 // error codes
 #define OPH_IO_SERVER_SUCCESS						0
 #define OPH_IO_SERVER_NULL_PARAM					1
@@ -97,7 +103,7 @@
 #define OPH_IO_SERVER_LOG_WRONG_PROCEDURE_ARG				"Arguments of %s procedure are not correct\n"
 #define OPH_IO_SERVER_LOG_ARG_NO_STRING						"Argument %s is not a valid string\n"
 #define OPH_IO_SERVER_LOG_ARG_NO_LONG						"Argument %s is not a valid integer\n"
-#define OPH_IO_SERVER_LOG_ORDER_TYPE_ERROR					"Only numeric (int or real) columns can be used for sorting\n"
+#define OPH_IO_SERVER_LOG_ORDER_DIR_ERROR					"Sort direction '%s' not supported\n"
 #define OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR					"Unable to perform row sorting\n"
 #define OPH_IO_SERVER_LOG_TOO_MANY_GROUPS					"Only one single group clause is supported: %s\n"
 #define OPH_IO_SERVER_LOG_NO_VARIABLE_FOR_GROUP				"At least one variable is required in group by clause: %s\n"
@@ -115,6 +121,16 @@
 #define OPH_IO_SERVER_PROCEDURE_SUBSET "oph_subset"
 #define OPH_IO_SERVER_PROCEDURE_EXPORT "oph_export"
 #define OPH_IO_SERVER_PROCEDURE_SIZE "oph_size"
+#define OPH_IO_SERVER_PROCEDURE_PLAN_CACHE "oph_plan_cache"
+#define OPH_IO_SERVER_PROCEDURE_FRAG_STATS "oph_frag_stats"
+#define OPH_IO_SERVER_PROCEDURE_MEMORY_STATS "oph_memory_stats"
+
+/**
+ * \brief               Function used to release the last result set of a thread, with the stored records it refers to
+ * \param thread_status Status of thread executing the queries
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_free_result_set(oph_io_server_thread_status * thread_status);
 
 //Server Main manager function
 /**
@@ -135,10 +151,9 @@ int oph_io_server_dispatcher(oph_metadb_db_row ** meta_db, oph_iostore_handler *
 /**
  * \brief               	Support function used to set variables for expression parser function
  * \param args 				Additional args used in prepared statements (can be NULL)
- * \param var_list    		List of function variables
+ * \param var_slots   		Symtable records of function variables, bound by oph_query_expr_compile
  * \param var_count   		Number of function variables
  * \param inputs   			Null terminated list of input record sets
- * \param table 			Symtable related to expression
  * \param field_indexes 	Array of field indexes related to variables
  * \param frag_indexes 		Array of fragment indexes related to variables
  * \param field_binary 		Array of binary flag related to variables
@@ -148,9 +163,88 @@ int oph_io_server_dispatcher(oph_metadb_db_row ** meta_db, oph_iostore_handler *
  * \param where_start_id 	Array used for where starting point (can be null)
  * \return              	0 if successfull, non-0 otherwise
  */
-int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, char **var_list, unsigned int var_count, oph_iostore_frag_record_set ** inputs, oph_query_expr_symtable * table,
+int _oph_ioserver_query_set_parser_variables(oph_query_arg ** args, oph_query_expr_record ** var_slots, unsigned int var_count, oph_iostore_frag_record_set ** inputs,
 					     unsigned int *field_indexes, int *frag_indexes, char *field_binary, oph_query_arg * binary_var, char *field, long long row, long long *where_start_id);
 
+/**
+ * \brief               	Support function used to check if variables of an expression can be evaluated by blocks of rows
+ * \param var_count   		Number of function variables
+ * \param inputs   			Null terminated list of input record sets
+ * \param field_indexes 	Array of field indexes related to variables
+ * \param frag_indexes 		Array of fragment indexes related to variables
+ * \param field_binary 		Array of binary flag related to variables
+ * \param var_types 		Array filled with the types of variables (must be already allocated)
+ * \return              	0 if all variables are numeric fields, non-0 otherwise
+ */
+int _oph_ioserver_query_get_batch_types(unsigned int var_count, oph_iostore_frag_record_set ** inputs, unsigned int *field_indexes, int *frag_indexes, char *field_binary,
+					oph_query_expr_value_type * var_types);
+
+/**
+ * \brief               	Support function used to copy a block of rows in the variables of a batch
+ * \param batch   			Batch created by oph_query_expr_create_batch
+ * \param inputs   			Null terminated list of input record sets
+ * \param field_indexes 	Array of field indexes related to variables
+ * \param frag_indexes 		Array of fragment indexes related to variables
+ * \param row 				First input row of the block
+ * \param row_num 			Number of rows of the block (at most OPH_QUERY_EXPR_BATCH_SIZE)
+ * \param where_start_id 	Array used for where starting point (can be null)
+ * \return              	0 if successfull, non-0 otherwise
+ */
+int _oph_ioserver_query_set_batch_variables(oph_query_expr_batch * batch, oph_iostore_frag_record_set ** inputs, unsigned int *field_indexes, int *frag_indexes, long long row, int row_num,
+					    long long *where_start_id);
+
+/**
+ * \brief               	Support function used to apply a where clause on ids without evaluating it row by row; it is applied only if ids are sequential and
+ *                          the clause is supported by oph_query_expr_select_ids, otherwise the clause has to be evaluated by rows
+ * \param e 				Where clause AST, compiled with oph_query_expr_compile
+ * \param var_slots 		Records of the variables returned by oph_query_expr_compile
+ * \param var_count 		Number of variables
+ * \param frag_indexes 		Array of fragment indexes related to variables
+ * \param table_num 		Number of tables
+ * \param id_indexes 		Indexes of id columns in each table
+ * \param start_row_indexes Index of the first row of each table
+ * \param stored_rs 		Stored record sets
+ * \param input_row_num 	Number of rows to be filtered, updated with the number of selected rows
+ * \param input_rs 			Record sets to be filled with selected rows
+ * \param selected 			Flag set to 1 if the clause has been applied
+ * \return              	0 if successfull, non-0 otherwise
+ */
+int _oph_ioserver_query_select_id_rows(oph_query_expr_node * e, oph_query_expr_record ** var_slots, int var_count, int *frag_indexes, int table_num, short int *id_indexes,
+				       long long *start_row_indexes, oph_iostore_frag_record_set ** stored_rs, long long *input_row_num, oph_iostore_frag_record_set ** input_rs, char *selected);
+
+#ifdef OPH_OMP
+/**
+ * \brief               	Support function used to store the result of a function in a cell of the output record set, from any thread; the result is freed
+ * \param output 			Output record set
+ * \param column 			Index of output column
+ * \param row 				Index of output row
+ * \param res 				Result of expression evaluation
+ * \return              	0 if successfull, non-0 otherwise
+ */
+int _oph_ioserver_query_store_function_result(oph_iostore_frag_record_set * output, int column, long long row, oph_query_expr_value * res);
+
+/**
+ * \brief               	Support function used to evaluate a function without aggregates on rows split among OpenMP threads; each thread has its own AST, symtable and plugin state
+ * \param field 			Expression to be evaluated
+ * \param args 				Additional args used in prepared statements (can be NULL)
+ * \param var_list 			List of variables of the expression
+ * \param var_count   		Number of variables
+ * \param inputs   			Null terminated list of input record sets
+ * \param field_indexes 	Array of field indexes related to variables
+ * \param frag_indexes 		Array of fragment indexes related to variables
+ * \param field_binary 		Array of binary flag related to variables
+ * \param offset 			First input row considered
+ * \param total_row_number 	Number of rows to be evaluated
+ * \param column 			Index of output column
+ * \param output 			Output record set with total_row_number rows already allocated
+ * \param thread_num 		Number of threads, reserved with oph_util_cpu_acquire
+ * \return              	0 if successfull, non-0 otherwise
+ */
+int _oph_ioserver_query_run_function_parallel(char *field, oph_query_arg ** args, char **var_list, int var_count, oph_iostore_frag_record_set ** inputs, unsigned int *field_indexes,
+					      int *frag_indexes, char *field_binary, long long offset, long long total_row_number, int column, oph_iostore_frag_record_set * output,
+					      unsigned short thread_num);
+#endif
+
 /**
  * \brief               	Support function used to set index of variables used in expression parser
  * \param arg_count 		Number of additional args used in prepared statements (can be 0)
@@ -178,12 +272,39 @@ int _oph_ioserver_query_get_variable_indexes(unsigned int arg_count, char **var_
 int _oph_io_server_query_compute_limits(HASHTBL * query_args, long long *offset, long long *limit);
 
 /**
- * \brief               Internal function used to order output recordset (ORDER block)
+ * \brief               Internal function used to get the sort direction of a query (ORDER block)
+ * \param query_args    Hash table containing args to be selected
+ * \param order_dir     Arg to be filled with OPH_IO_SERVER_SORT_ASC or OPH_IO_SERVER_SORT_DESC
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _oph_io_server_query_get_order(HASHTBL * query_args, char *order_dir);
+
+/**
+ * \brief               Internal function used to decide whether limits can be applied to input rows before ordering (ORDER and LIMIT blocks).
+ *                      If the order field is an input column already ordered, limits are kept (and remapped when input is reversed);
+ *                      otherwise they are moved to order_offset and order_limit, so that they are applied after ordering the whole output
+ * \param query_args    Hash table containing args to be selected
+ * \param field_list    List of fields to be selected
+ * \param field_list_num Number of fields to be selected
+ * \param input         Input record set (after WHERE block)
+ * \param offset        Offset of input rows to be computed (it may be modified)
+ * \param limit         Limit of input rows to be computed (it may be modified)
+ * \param order_offset  Arg to be filled with offset to be applied after ordering
+ * \param order_limit   Arg to be filled with limit to be applied after ordering
+ * \return              0 if successfull, non-0 otherwise
+ */
+int _oph_io_server_query_prepare_order(HASHTBL * query_args, char **field_list, int field_list_num, oph_iostore_frag_record_set * input, long long *offset, long long *limit,
+				       long long *order_offset, long long *order_limit);
+
+/**
+ * \brief               Internal function used to order output recordset (ORDER block) and apply limits to ordered rows
  * \param query_args    Hash table containing args to be selected
+ * \param offset        Number of ordered rows to be dropped
+ * \param limit         Max number of ordered rows to be kept (0 to keep all rows)
  * \param rs 			Recordset to be sorted (it will be modified)
  * \return              0 if successfull, non-0 otherwise
  */
-int _oph_io_server_query_order_output(HASHTBL * query_args, oph_iostore_frag_record_set * rs);
+int _oph_io_server_query_order_output(HASHTBL * query_args, long long offset, long long limit, oph_iostore_frag_record_set * rs);
 
 /**
  * \brief               Internal function used to release memory for input record sets of a query (FROM and WHERE blocks). Used in case of select and create as select. 
@@ -553,4 +674,37 @@ int oph_io_server_run_export_procedure(oph_metadb_db_row ** meta_db, oph_iostore
  */
 int oph_io_server_run_size_procedure(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args);
 
+/**
+ * \brief               Internal function used to get the counters of plan cache (hits and misses of queries and expressions)
+ * \param meta_db       Pointer to metadb
+ * \param dev_handle 	Handler to current IO server device
+ * \param thread_status Status of thread executing the query
+ * \param args          Additional query arguments
+ * \param query_args    Hash table containing args to be selected
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_run_plan_cache_procedure(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args);
+
+/**
+ * \brief               Internal function used to get the compression statistics of a fragment of a transient device (compression ratio and average decompression time in seconds)
+ * \param meta_db       Pointer to metadb
+ * \param dev_handle 	Handler to current IO server device
+ * \param thread_status Status of thread executing the query
+ * \param args          Additional query arguments
+ * \param query_args    Hash table containing args to be selected
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_run_frag_stats_procedure(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args);
+
+/**
+ * \brief               Internal function used to get the counters of the memory manager of transient devices (resident size in bytes, spills, faults and compressions)
+ * \param meta_db       Pointer to metadb
+ * \param dev_handle 	Handler to current IO server device
+ * \param thread_status Status of thread executing the query
+ * \param args          Additional query arguments
+ * \param query_args    Hash table containing args to be selected
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_run_memory_stats_procedure(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args);
+
 #endif				/* OPH_IO_SERVER_QUERY_MANAGER_H */
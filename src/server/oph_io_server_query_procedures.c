@@ -29,6 +29,8 @@
 
 #include "oph_server_utility.h"
 #include "oph_query_engine_language.h"
+#include "oph_io_server_plan_cache.h"
+#include "oph_iostorage_memory.h"
 
 extern int msglevel;
 extern pthread_rwlock_t rwlock;
@@ -233,14 +235,7 @@ int oph_io_server_run_export_procedure(oph_metadb_db_row ** meta_db, oph_iostore
 		return OPH_IO_SERVER_METADB_ERROR;
 	}
 	//First delete last result set
-	if (thread_status->last_result_set != NULL) {
-		if (thread_status->delete_only_rs)
-			oph_iostore_destroy_frag_recordset_only(&(thread_status->last_result_set));
-		else
-			oph_iostore_destroy_frag_recordset(&(thread_status->last_result_set));
-	}
-	thread_status->last_result_set = NULL;
-	thread_status->delete_only_rs = 0;
+	oph_io_server_free_result_set(thread_status);
 
 	//Fetch function arguments
 	char *function_args = hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_ARG);
@@ -295,7 +290,7 @@ int oph_io_server_run_export_procedure(oph_metadb_db_row ** meta_db, oph_iostore
 			error = OPH_IO_SERVER_EXEC_ERROR;
 		} else {
 			//Order rows
-			if (_oph_io_server_query_order_output(query_args, rs)) {
+			if (_oph_io_server_query_order_output(query_args, 0, 0, rs)) {
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ORDER_EXEC_ERROR);
 				error = OPH_IO_SERVER_EXEC_ERROR;
@@ -307,18 +302,16 @@ int oph_io_server_run_export_procedure(oph_metadb_db_row ** meta_db, oph_iostore
 		error = OPH_IO_SERVER_EXEC_ERROR;
 	}
 
-	if (dev_handle->is_persistent)
-		oph_iostore_destroy_frag_recordset(&(orig_record_sets[0]));
-	free(orig_record_sets);
-
 	if (error) {
-		oph_iostore_destroy_frag_recordset_only(&(record_sets[0]));
-		free(record_sets);
+		_oph_ioserver_query_release_input_record_set(dev_handle, orig_record_sets, record_sets);
 		return error;
 	}
-
+	//Result set refers to the stored records, so they are released (or unpinned) with it
 	thread_status->last_result_set = rs;
 	thread_status->delete_only_rs = 1;
+	thread_status->stored_rs = orig_record_sets[0];
+	thread_status->unpin_stored_rs = !dev_handle->is_persistent && !orig_record_sets[0]->tmp_flag;
+	free(orig_record_sets);
 	free(record_sets);
 
 	return OPH_IO_SERVER_SUCCESS;
@@ -337,14 +330,7 @@ int oph_io_server_run_size_procedure(oph_metadb_db_row ** meta_db, oph_iostore_h
 	UNUSED(args);
 
 	//First delete last result set
-	if (thread_status->last_result_set != NULL) {
-		if (thread_status->delete_only_rs)
-			oph_iostore_destroy_frag_recordset_only(&(thread_status->last_result_set));
-		else
-			oph_iostore_destroy_frag_recordset(&(thread_status->last_result_set));
-	}
-	thread_status->last_result_set = NULL;
-	thread_status->delete_only_rs = 0;
+	oph_io_server_free_result_set(thread_status);
 
 	//Fetch function arguments
 	char *function_args = hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_ARG);
@@ -397,8 +383,16 @@ int oph_io_server_run_size_procedure(oph_metadb_db_row ** meta_db, oph_iostore_h
 		//Look for fragments
 		for (tmp_db = *meta_db; tmp_db != NULL; tmp_db = tmp_db->next_db) {
 
+			if (pthread_rwlock_rdlock(&(tmp_db->lock)) != 0) {
+				pthread_rwlock_unlock(&rwlock);
+				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+				free(func_args_list);
+				return OPH_IO_SERVER_EXEC_ERROR;
+			}
 			//Find Frag from MetaDB
 			if (oph_metadb_find_frag(tmp_db, func_args_list[i], &tmp_frag)) {
+				pthread_rwlock_unlock(&(tmp_db->lock));
 				pthread_rwlock_unlock(&rwlock);
 				pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag find");
 				logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag find");
@@ -409,8 +403,10 @@ int oph_io_server_run_size_procedure(oph_metadb_db_row ** meta_db, oph_iostore_h
 			if (tmp_frag != NULL) {
 				//Found fragment
 				tot_frag_size += tmp_frag->frag_size;
+				pthread_rwlock_unlock(&(tmp_db->lock));
 				break;
 			}
+			pthread_rwlock_unlock(&(tmp_db->lock));
 
 		}
 
@@ -486,3 +482,317 @@ int oph_io_server_run_size_procedure(oph_metadb_db_row ** meta_db, oph_iostore_h
 
 	return OPH_IO_SERVER_SUCCESS;
 }
+
+//Function for PLAN CACHE
+int oph_io_server_run_plan_cache_procedure(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args)
+{
+	if (!thread_status) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+	//No arguments required
+	UNUSED(meta_db);
+	UNUSED(dev_handle);
+	UNUSED(args);
+	UNUSED(query_args);
+
+	//First delete last result set
+	oph_io_server_free_result_set(thread_status);
+
+	unsigned long long counters[4];
+	const char *counter_names[4] = { "query_hits", "query_misses", "expr_hits", "expr_misses" };
+	oph_io_server_plan_cache_stats(&counters[0], &counters[1], &counters[2], &counters[3]);
+
+	//Prepare output record set
+	oph_iostore_frag_record_set *rs = NULL;
+	if (oph_iostore_create_frag_recordset(&rs, 0, 4)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//No name required
+	rs->frag_name = NULL;
+
+	int i;
+	for (i = 0; i < 4; i++) {
+		rs->field_type[i] = OPH_IOSTORE_LONG_TYPE;
+		rs->field_name[i] = (char *) strndup(counter_names[i], (strlen(counter_names[i]) + 1) * sizeof(char));
+		if (rs->field_name[i] == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			oph_iostore_destroy_frag_recordset(&rs);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	}
+
+	rs->record_set = (oph_iostore_frag_record **) calloc(1 + 1, sizeof(oph_iostore_frag_record *));
+	if (rs->record_set == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		oph_iostore_destroy_frag_recordset(&rs);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//Created record struct
+	oph_iostore_frag_record *new_record = NULL;
+	if (oph_iostore_create_frag_record(&new_record, 4) == 1) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		oph_iostore_destroy_frag_recordset(&rs);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//Add record to record set
+	rs->record_set[0] = new_record;
+
+	//Fill record
+	for (i = 0; i < 4; i++) {
+		new_record->field_length[i] = sizeof(long long);
+		new_record->field[i] = (void *) memdup((const void *) &counters[i], new_record->field_length[i]);
+		if (new_record->field[i] == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			oph_iostore_destroy_frag_recordset(&rs);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	}
+
+	thread_status->last_result_set = rs;
+	thread_status->delete_only_rs = 0;
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+//Function for FRAGMENT STATISTICS
+int oph_io_server_run_frag_stats_procedure(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args)
+{
+	if (!query_args || !thread_status || !meta_db) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+	//For future implementations
+	UNUSED(dev_handle);
+	UNUSED(args);
+
+	//First delete last result set
+	oph_io_server_free_result_set(thread_status);
+
+	//Fetch function arguments
+	char *function_args = hashtbl_get(query_args, OPH_QUERY_ENGINE_LANG_ARG_ARG);
+	if (function_args == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_ARG);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MISSING_QUERY_ARGUMENT, OPH_QUERY_ENGINE_LANG_ARG_ARG);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	char **func_args_list = NULL;
+	int func_args_num = 0;
+	if (oph_query_parse_multivalue_arg(function_args, &func_args_list, &func_args_num)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_MULTIVAL_PARSE_ERROR, OPH_QUERY_ENGINE_LANG_ARG_ARG);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_MULTIVAL_PARSE_ERROR, OPH_QUERY_ENGINE_LANG_ARG_ARG);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+	//Only one fragment is allowed
+	if (func_args_num != 1) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_WRONG_PROCEDURE_ARG, OPH_IO_SERVER_PROCEDURE_FRAG_STATS);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_WRONG_PROCEDURE_ARG, OPH_IO_SERVER_PROCEDURE_FRAG_STATS);
+		free(func_args_list);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+	//Remove leading/trailing spaces and match string
+	if (oph_query_check_procedure_string(&(func_args_list[0]))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ARG_NO_STRING, func_args_list[0]);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_ARG_NO_STRING, func_args_list[0]);
+		free(func_args_list);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	oph_metadb_db_row *tmp_db = NULL;
+	oph_metadb_frag_row *tmp_frag = NULL;
+	double stats[2] = { 0, 0 };
+	const char *stat_names[2] = { "compression_ratio", "decompression_time" };
+
+	//LOCK FROM HERE
+	if (pthread_rwlock_rdlock(&rwlock) != 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+		free(func_args_list);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+	//Look for fragment
+	for (tmp_db = *meta_db; tmp_db != NULL; tmp_db = tmp_db->next_db) {
+
+		if (pthread_rwlock_rdlock(&(tmp_db->lock)) != 0) {
+			pthread_rwlock_unlock(&rwlock);
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_LOCK_ERROR);
+			free(func_args_list);
+			return OPH_IO_SERVER_EXEC_ERROR;
+		}
+		//Find Frag from MetaDB
+		if (oph_metadb_find_frag(tmp_db, func_args_list[0], &tmp_frag)) {
+			pthread_rwlock_unlock(&(tmp_db->lock));
+			pthread_rwlock_unlock(&rwlock);
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag find");
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_METADB_ERROR, "Frag find");
+			free(func_args_list);
+			return OPH_IO_SERVER_METADB_ERROR;
+		}
+
+		if (tmp_frag != NULL) {
+			//Only fragments of transient devices are handled by memory manager
+			if (!tmp_frag->is_persistent)
+				oph_iostore_memory_frag_stats(&(tmp_frag->frag_id), &stats[0], &stats[1]);
+			pthread_rwlock_unlock(&(tmp_db->lock));
+			break;
+		}
+		pthread_rwlock_unlock(&(tmp_db->lock));
+	}
+
+	//UNLOCK FROM HERE
+	pthread_rwlock_unlock(&rwlock);
+	free(func_args_list);
+
+	//Fragment not found
+	if (tmp_db == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_FRAG_NOT_EXIST_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_QUERY_FRAG_NOT_EXIST_ERROR);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	//Prepare output record set
+	oph_iostore_frag_record_set *rs = NULL;
+	if (oph_iostore_create_frag_recordset(&rs, 0, 2)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//No name required
+	rs->frag_name = NULL;
+
+	int i;
+	for (i = 0; i < 2; i++) {
+		rs->field_type[i] = OPH_IOSTORE_REAL_TYPE;
+		rs->field_name[i] = (char *) strndup(stat_names[i], (strlen(stat_names[i]) + 1) * sizeof(char));
+		if (rs->field_name[i] == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			oph_iostore_destroy_frag_recordset(&rs);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	}
+
+	rs->record_set = (oph_iostore_frag_record **) calloc(1 + 1, sizeof(oph_iostore_frag_record *));
+	if (rs->record_set == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		oph_iostore_destroy_frag_recordset(&rs);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//Created record struct
+	oph_iostore_frag_record *new_record = NULL;
+	if (oph_iostore_create_frag_record(&new_record, 2) == 1) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		oph_iostore_destroy_frag_recordset(&rs);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//Add record to record set
+	rs->record_set[0] = new_record;
+
+	//Fill record
+	for (i = 0; i < 2; i++) {
+		new_record->field_length[i] = sizeof(double);
+		new_record->field[i] = (void *) memdup((const void *) &stats[i], new_record->field_length[i]);
+		if (new_record->field[i] == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			oph_iostore_destroy_frag_recordset(&rs);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	}
+
+	thread_status->last_result_set = rs;
+	thread_status->delete_only_rs = 0;
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+//Function for MEMORY STATISTICS
+int oph_io_server_run_memory_stats_procedure(oph_metadb_db_row ** meta_db, oph_iostore_handler * dev_handle, oph_io_server_thread_status * thread_status, oph_query_arg ** args, HASHTBL * query_args)
+{
+	if (!thread_status) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+	//No arguments required
+	UNUSED(meta_db);
+	UNUSED(dev_handle);
+	UNUSED(args);
+	UNUSED(query_args);
+
+	//First delete last result set
+	oph_io_server_free_result_set(thread_status);
+
+	unsigned long long counters[4];
+	const char *counter_names[4] = { "resident_size", "spills", "faults", "compressions" };
+	oph_iostore_memory_stats(&counters[0], &counters[1], &counters[2], &counters[3]);
+
+	//Prepare output record set
+	oph_iostore_frag_record_set *rs = NULL;
+	if (oph_iostore_create_frag_recordset(&rs, 0, 4)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//No name required
+	rs->frag_name = NULL;
+
+	int i;
+	for (i = 0; i < 4; i++) {
+		rs->field_type[i] = OPH_IOSTORE_LONG_TYPE;
+		rs->field_name[i] = (char *) strndup(counter_names[i], (strlen(counter_names[i]) + 1) * sizeof(char));
+		if (rs->field_name[i] == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			oph_iostore_destroy_frag_recordset(&rs);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	}
+
+	rs->record_set = (oph_iostore_frag_record **) calloc(1 + 1, sizeof(oph_iostore_frag_record *));
+	if (rs->record_set == NULL) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		oph_iostore_destroy_frag_recordset(&rs);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//Created record struct
+	oph_iostore_frag_record *new_record = NULL;
+	if (oph_iostore_create_frag_record(&new_record, 4) == 1) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		oph_iostore_destroy_frag_recordset(&rs);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+	//Add record to record set
+	rs->record_set[0] = new_record;
+
+	//Fill record
+	for (i = 0; i < 4; i++) {
+		new_record->field_length[i] = sizeof(long long);
+		new_record->field[i] = (void *) memdup((const void *) &counters[i], new_record->field_length[i]);
+		if (new_record->field[i] == NULL) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			oph_iostore_destroy_frag_recordset(&rs);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+	}
+
+	thread_status->last_result_set = rs;
+	thread_status->delete_only_rs = 0;
+
+	return OPH_IO_SERVER_SUCCESS;
+}
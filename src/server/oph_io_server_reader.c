@@ -0,0 +1,678 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "oph_io_server_query_manager.h"
+#include "oph_io_server_reader.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "debug.h"
+#include "oph_server_utility.h"
+
+#ifdef OPH_IO_SERVER_ESDM
+#include <esdm.h>
+#endif
+
+extern int msglevel;
+
+//Max number of vectors used to send a fragment row
+#define OPH_IO_SERVER_READER_IOV_NUM 64
+//String length used to send NULL strings
+#define OPH_IO_SERVER_READER_NULL_STRING ((unsigned int) -1)
+
+#define OPH_IO_SERVER_READER_LOAD_EXEC OPH_IO_SERVER_PREFIX "/bin/oph_io_server_nc_load"
+
+/**
+ * \brief			        Structure with the status of a reader (or loader) process
+ * \param pid           Process identifier, 0 if the process has been dropped
+ * \param fd            Socket connected to the process, -1 if the process has been dropped
+ * \param busy          Flag set to 1 while a request is being served by the process
+ */
+typedef struct {
+	pid_t pid;
+	int fd;
+	char busy;
+} oph_io_server_reader;
+
+/**
+ * \brief			        Structure with the status of a pool of processes
+ * \param procs         Processes of the pool
+ * \param num           Number of processes started
+ * \param alive         Number of processes not dropped
+ * \param lock          Mutex protecting the pool
+ * \param cond          Condition used to wait for an idle process
+ */
+typedef struct {
+	oph_io_server_reader *procs;
+	unsigned short num;
+	unsigned short alive;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} oph_io_server_reader_pool;
+
+/**
+ * \brief			              Header of a request sent to a reader process, followed by strings, dimension arrays, field types and field names
+ * \param tuplexfrag_number Number of tuple to insert
+ * \param frag_key_start    Starting key of fragment
+ * \param dim_num           Number of dimensions related to measure
+ * \param dim_unlim         Index of the unlimited dimension
+ * \param field_num         Number of fields of fragment
+ * \param compressed_flag   If the data to insert is compressed (1) or not (0)
+ * \param source            Source code
+ */
+typedef struct {
+	unsigned long long tuplexfrag_number;
+	long long frag_key_start;
+	int dim_num;
+	int dim_unlim;
+	unsigned short field_num;
+	char compressed_flag;
+	char source;
+} oph_io_server_reader_request;
+
+/**
+ * \brief			        Header of a reply sent by a reader process, followed by row_num rows of FIELD_LEN|DATA fields
+ * \param status        Return code of the read function
+ * \param frag_size     Size of fragment
+ * \param row_num       Number of rows
+ */
+typedef struct {
+	int status;
+	unsigned long long frag_size;
+	unsigned long long row_num;
+} oph_io_server_reader_reply;
+
+static oph_io_server_reader_pool readers = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+static oph_io_server_reader_pool loaders = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+#if defined(OPH_IO_SERVER_NETCDF) || defined(OPH_IO_SERVER_ESDM)
+
+//Function used to wait for an idle process of a pool: it returns -1 if no process is alive
+static int oph_io_server_reader_acquire(oph_io_server_reader_pool * pool)
+{
+	int i = -1;
+	unsigned short j;
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->alive) {
+		for (j = 0; j < pool->num; j++)
+			if ((pool->procs[j].fd >= 0) && !pool->procs[j].busy)
+				break;
+		if (j < pool->num) {
+			pool->procs[j].busy = 1;
+			i = j;
+			break;
+		}
+		pthread_cond_wait(&pool->cond, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return i;
+}
+
+//Function used to release a process of a pool: a process with a broken stream is dropped, it is not replaced since forking a multi-threaded process is not safe
+static void oph_io_server_reader_release(oph_io_server_reader_pool * pool, int i, char drop)
+{
+	pid_t pid = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->procs[i].busy = 0;
+	if (drop && (pool->procs[i].fd >= 0)) {
+		close(pool->procs[i].fd);
+		pool->procs[i].fd = -1;
+		pid = pool->procs[i].pid;
+		pool->procs[i].pid = 0;
+		pool->alive--;
+	}
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	if (pid > 0) {
+		pmesg(LOG_WARNING, __FILE__, __LINE__, "Process %d has been dropped\n", (int) pid);
+		logging(LOG_WARNING, __FILE__, __LINE__, "Process %d has been dropped\n", (int) pid);
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+	}
+}
+
+static int oph_io_server_reader_send(int fd, const void *buffer, unsigned long long length)
+{
+	const char *ptr = (const char *) buffer;
+	ssize_t n;
+	while (length) {
+		if ((n = send(fd, ptr, length, MSG_NOSIGNAL)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return OPH_IO_SERVER_READER_ERROR;
+		}
+		ptr += n;
+		length -= n;
+	}
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+static int oph_io_server_reader_sendv(int fd, struct iovec *iov, int iov_num)
+{
+	struct msghdr msg;
+	ssize_t n;
+	memset(&msg, 0, sizeof(struct msghdr));
+	while (iov_num) {
+		msg.msg_iov = iov;
+		msg.msg_iovlen = iov_num;
+		if ((n = sendmsg(fd, &msg, MSG_NOSIGNAL)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return OPH_IO_SERVER_READER_ERROR;
+		}
+		while (iov_num && ((size_t) n >= iov->iov_len)) {
+			n -= iov->iov_len;
+			iov++;
+			iov_num--;
+		}
+		if (iov_num) {
+			iov->iov_base = (char *) iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+static int oph_io_server_reader_recv(int fd, void *buffer, unsigned long long length)
+{
+	char *ptr = (char *) buffer;
+	ssize_t n;
+	while (length) {
+		if ((n = read(fd, ptr, length)) <= 0) {
+			if ((n < 0) && (errno == EINTR))
+				continue;
+			return OPH_IO_SERVER_READER_ERROR;
+		}
+		ptr += n;
+		length -= n;
+	}
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+static int oph_io_server_reader_send_string(int fd, const char *string)
+{
+	unsigned int length = string ? strlen(string) : OPH_IO_SERVER_READER_NULL_STRING;
+	if (oph_io_server_reader_send(fd, &length, sizeof(unsigned int)) || (string && oph_io_server_reader_send(fd, string, length)))
+		return OPH_IO_SERVER_READER_ERROR;
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+static int oph_io_server_reader_recv_string(int fd, char **string)
+{
+	unsigned int length = 0;
+	*string = NULL;
+	if (oph_io_server_reader_recv(fd, &length, sizeof(unsigned int)))
+		return OPH_IO_SERVER_READER_ERROR;
+	if (length == OPH_IO_SERVER_READER_NULL_STRING)
+		return OPH_IO_SERVER_READER_SUCCESS;
+	if (!(*string = (char *) malloc(length + 1)))
+		return OPH_IO_SERVER_READER_ERROR;
+	if (oph_io_server_reader_recv(fd, *string, length)) {
+		free(*string);
+		*string = NULL;
+		return OPH_IO_SERVER_READER_ERROR;
+	}
+	(*string)[length] = 0;
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+//Function run by reader processes: a stream error means the server is gone (or the stream is broken), so the reader exits
+static int oph_io_server_reader_serve(int fd)
+{
+	oph_io_server_reader_request request;
+	oph_io_server_reader_reply reply;
+	char *src_path = NULL, *measure_name = NULL, *sub_operation = NULL, *sub_args = NULL;
+	oph_iostore_frag_record_set *binary_frag = NULL;
+	unsigned long long i;
+	int j;
+
+	while (!oph_io_server_reader_recv(fd, &request, sizeof(oph_io_server_reader_request))) {
+
+		if (oph_io_server_reader_recv_string(fd, &src_path) || oph_io_server_reader_recv_string(fd, &measure_name) || oph_io_server_reader_recv_string(fd, &sub_operation)
+		    || oph_io_server_reader_recv_string(fd, &sub_args))
+			break;
+
+		short int dims_type[request.dim_num], dims_index[request.dim_num];
+		int dims_start[request.dim_num], dims_end[request.dim_num];
+		if (oph_io_server_reader_recv(fd, dims_type, request.dim_num * sizeof(short int)) || oph_io_server_reader_recv(fd, dims_index, request.dim_num * sizeof(short int))
+		    || oph_io_server_reader_recv(fd, dims_start, request.dim_num * sizeof(int)) || oph_io_server_reader_recv(fd, dims_end, request.dim_num * sizeof(int)))
+			break;
+
+		//Build an empty fragment with the same fields of the original one
+		if (oph_iostore_create_frag_recordset_only(&binary_frag, request.tuplexfrag_number, request.field_num))
+			break;
+		if (oph_io_server_reader_recv(fd, binary_frag->field_type, request.field_num * sizeof(oph_iostore_field_type)))
+			break;
+		for (j = 0; j < request.field_num; j++)
+			if (oph_io_server_reader_recv_string(fd, &(binary_frag->field_name[j])))
+				break;
+		if (j < request.field_num)
+			break;
+
+		memset(&reply, 0, sizeof(oph_io_server_reader_reply));
+#ifdef OPH_IO_SERVER_NETCDF
+		if (request.source == OPH_IO_SERVER_READER_NETCDF)
+			reply.status =
+			    _oph_ioserver_nc_read(src_path, measure_name, request.tuplexfrag_number, request.frag_key_start, request.compressed_flag, request.dim_num, dims_type, dims_index,
+						  dims_start, dims_end, request.dim_unlim, binary_frag, &reply.frag_size);
+		else
+#endif
+#ifdef OPH_IO_SERVER_ESDM
+		if (request.source == OPH_IO_SERVER_READER_ESDM)
+			reply.status =
+			    _oph_ioserver_esdm_read(src_path, measure_name, request.tuplexfrag_number, request.frag_key_start, request.compressed_flag, request.dim_num, dims_type, dims_index,
+						    dims_start, dims_end, sub_operation, sub_args, binary_frag, &reply.frag_size);
+		else
+#endif
+			reply.status = OPH_IO_SERVER_EXEC_ERROR;
+
+		if (!reply.status)
+			while ((reply.row_num < request.tuplexfrag_number) && binary_frag->record_set[reply.row_num])
+				reply.row_num++;
+		if (oph_io_server_reader_send(fd, &reply, sizeof(oph_io_server_reader_reply)))
+			break;
+
+		//Send rows and release them as soon as they are sent
+		struct iovec iov[OPH_IO_SERVER_READER_IOV_NUM];
+		unsigned long long field_length[OPH_IO_SERVER_READER_IOV_NUM / 2];
+		int iov_num, length_num;
+		oph_iostore_frag_record *record;
+		for (i = 0; i < reply.row_num; i++) {
+			record = binary_frag->record_set[i];
+			for (j = iov_num = length_num = 0; j < request.field_num; j++) {
+				field_length[length_num] = record->field[j] ? record->field_length[j] : OPH_IO_SERVER_READER_NULL_FIELD;
+				iov[iov_num].iov_base = &field_length[length_num++];
+				iov[iov_num++].iov_len = sizeof(unsigned long long);
+				if (record->field[j] && record->field_length[j]) {
+					iov[iov_num].iov_base = record->field[j];
+					iov[iov_num++].iov_len = record->field_length[j];
+				}
+				if ((length_num == OPH_IO_SERVER_READER_IOV_NUM / 2) || (j == request.field_num - 1)) {
+					if (oph_io_server_reader_sendv(fd, iov, iov_num))
+						break;
+					iov_num = length_num = 0;
+				}
+			}
+			if (j < request.field_num)
+				break;
+			oph_iostore_destroy_frag_record(&(binary_frag->record_set[i]), request.field_num);
+		}
+		if (i < reply.row_num)
+			break;
+
+		oph_iostore_destroy_frag_recordset(&binary_frag);
+		free(src_path);
+		free(measure_name);
+		if (sub_operation)
+			free(sub_operation);
+		if (sub_args)
+			free(sub_args);
+		src_path = measure_name = sub_operation = sub_args = NULL;
+	}
+
+	if (binary_frag)
+		oph_iostore_destroy_frag_recordset(&binary_frag);
+	if (src_path)
+		free(src_path);
+	if (measure_name)
+		free(measure_name);
+	if (sub_operation)
+		free(sub_operation);
+	if (sub_args)
+		free(sub_args);
+
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+//Function used to exchange a request with a reader: return code is OPH_IO_SERVER_READER_ERROR only if the stream is broken
+static int oph_io_server_reader_exchange(int fd, oph_io_server_reader_request * request, char *src_path, char *measure_name, short int *dims_type, short int *dims_index, int *dims_start,
+					 int *dims_end, char *sub_operation, char *sub_args, oph_iostore_frag_record_set * binary_frag, unsigned long long *frag_size)
+{
+	int i;
+	if (oph_io_server_reader_send(fd, request, sizeof(oph_io_server_reader_request)) || oph_io_server_reader_send_string(fd, src_path)
+	    || oph_io_server_reader_send_string(fd, measure_name) || oph_io_server_reader_send_string(fd, sub_operation) || oph_io_server_reader_send_string(fd, sub_args)
+	    || oph_io_server_reader_send(fd, dims_type, request->dim_num * sizeof(short int)) || oph_io_server_reader_send(fd, dims_index, request->dim_num * sizeof(short int))
+	    || oph_io_server_reader_send(fd, dims_start, request->dim_num * sizeof(int)) || oph_io_server_reader_send(fd, dims_end, request->dim_num * sizeof(int))
+	    || oph_io_server_reader_send(fd, binary_frag->field_type, request->field_num * sizeof(oph_iostore_field_type)))
+		return OPH_IO_SERVER_READER_ERROR;
+	for (i = 0; i < request->field_num; i++)
+		if (oph_io_server_reader_send_string(fd, binary_frag->field_name[i]))
+			return OPH_IO_SERVER_READER_ERROR;
+
+	oph_io_server_reader_reply reply;
+	if (oph_io_server_reader_recv(fd, &reply, sizeof(oph_io_server_reader_reply)) || (reply.row_num > request->tuplexfrag_number))
+		return OPH_IO_SERVER_READER_ERROR;
+	if (reply.status)
+		return reply.status;
+
+	//Rows are added to fragment as they are received, so that they are released by the caller in case of errors
+	unsigned long long j, field_length;
+	oph_iostore_frag_record *record = NULL;
+	for (j = 0; j < reply.row_num; j++) {
+		if (oph_iostore_create_frag_record(&record, request->field_num))
+			return OPH_IO_SERVER_READER_ERROR;
+		for (i = 0; i < request->field_num; i++) {
+			if (oph_io_server_reader_recv(fd, &field_length, sizeof(unsigned long long)))
+				break;
+			if (field_length == OPH_IO_SERVER_READER_NULL_FIELD)
+				continue;
+			if (!(record->field[i] = malloc(field_length ? field_length : 1)) || oph_io_server_reader_recv(fd, record->field[i], field_length))
+				break;
+			record->field_length[i] = field_length;
+		}
+		if (i < request->field_num) {
+			oph_iostore_destroy_frag_record(&record, request->field_num);
+			return OPH_IO_SERVER_READER_ERROR;
+		}
+		binary_frag->record_set[j] = record;
+		record = NULL;
+	}
+	*frag_size = reply.frag_size;
+
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+#ifdef OPH_PAR_NC4
+
+static int oph_io_server_reader_load_spawn(oph_io_server_reader * loader)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds)) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to create socket for loader process: %s\n", strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to create socket for loader process: %s\n", strerror(errno));
+		return OPH_IO_SERVER_READER_ERROR;
+	}
+	if ((pid = fork()) < 0) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Unable to fork loader process: %s\n", strerror(errno));
+		logging(LOG_ERROR, __FILE__, __LINE__, "Unable to fork loader process: %s\n", strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		return OPH_IO_SERVER_READER_ERROR;
+	}
+	if (!pid) {
+		//Socket is used as stdin and stdout of the loader (descriptors created by dup2 are kept on exec)
+		dup2(fds[1], STDIN_FILENO);
+		dup2(fds[1], STDOUT_FILENO);
+		char *exec_path = OPH_IO_SERVER_READER_LOAD_EXEC;
+		execv(exec_path, (char *[]) {
+		      exec_path, OPH_IO_SERVER_READER_LOAD_OPTION, NULL});
+		_exit(errno);
+	}
+	close(fds[1]);
+	loader->pid = pid;
+	loader->fd = fds[0];
+	loader->busy = 0;
+
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+static int oph_io_server_reader_load_exchange(int fd, char *msg, unsigned int msg_len)
+{
+	int status = 0;
+	if (oph_io_server_reader_send(fd, &msg_len, sizeof(unsigned int)) || oph_io_server_reader_send(fd, msg, msg_len) || oph_io_server_reader_recv(fd, &status, sizeof(int)))
+		return OPH_IO_SERVER_READER_ERROR;
+	return status;
+}
+
+#endif
+
+#endif
+
+int oph_io_server_reader_start(unsigned short num)
+{
+#if defined(OPH_IO_SERVER_NETCDF) || defined(OPH_IO_SERVER_ESDM)
+	if (!num || readers.procs)
+		return OPH_IO_SERVER_READER_SUCCESS;
+
+	if (!(readers.procs = (oph_io_server_reader *) calloc(num, sizeof(oph_io_server_reader)))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_READER_ERROR;
+	}
+
+	unsigned short i, j;
+	int fds[2];
+	pid_t pid;
+	for (i = 0; i < num; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds)) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to create socket for reader process: %s\n", strerror(errno));
+			logging(LOG_WARNING, __FILE__, __LINE__, "Unable to create socket for reader process: %s\n", strerror(errno));
+			break;
+		}
+		if ((pid = fork()) < 0) {
+			pmesg(LOG_WARNING, __FILE__, __LINE__, "Unable to fork reader process: %s\n", strerror(errno));
+			logging(LOG_WARNING, __FILE__, __LINE__, "Unable to fork reader process: %s\n", strerror(errno));
+			close(fds[0]);
+			close(fds[1]);
+			break;
+		}
+		if (!pid) {
+			//Reader process: requests are served locally
+			close(fds[0]);
+			for (j = 0; j < i; j++)
+				close(readers.procs[j].fd);
+			free(readers.procs);
+			readers.procs = NULL;
+			readers.num = readers.alive = 0;
+#ifdef OPH_PAR_NC4
+			oph_io_server_reader_load_start(1);
+#endif
+#ifdef OPH_IO_SERVER_ESDM
+			if (esdm_init()) {
+				pmesg(LOG_ERROR, __FILE__, __LINE__, "ESDM cannot be initialized\n");
+				logging(LOG_ERROR, __FILE__, __LINE__, "ESDM cannot be initialized\n");
+				_exit(1);
+			}
+#endif
+			oph_io_server_reader_serve(fds[1]);
+			oph_io_server_reader_stop();
+#ifdef OPH_IO_SERVER_ESDM
+			esdm_finalize();
+#endif
+			_exit(0);
+		}
+		close(fds[1]);
+		readers.procs[i].pid = pid;
+		readers.procs[i].fd = fds[0];
+		readers.procs[i].busy = 0;
+	}
+	readers.num = readers.alive = i;
+
+	if (!readers.num) {
+		free(readers.procs);
+		readers.procs = NULL;
+		return OPH_IO_SERVER_READER_ERROR;
+	}
+
+	pmesg(LOG_INFO, __FILE__, __LINE__, "Started %d reader processes\n", readers.num);
+	logging(LOG_INFO, __FILE__, __LINE__, "Started %d reader processes\n", readers.num);
+#else
+	if (num)
+		pmesg(LOG_DEBUG, __FILE__, __LINE__, "Reader processes are not used since file import is not enabled\n");
+#endif
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+int oph_io_server_reader_load_start(unsigned short num)
+{
+#ifndef OPH_PAR_NC4
+	UNUSED(num);
+#else
+	if (!num || loaders.procs)
+		return OPH_IO_SERVER_READER_SUCCESS;
+
+	if (!(loaders.procs = (oph_io_server_reader *) calloc(num, sizeof(oph_io_server_reader)))) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_READER_ERROR;
+	}
+
+	unsigned short i;
+	for (i = 0; i < num; i++)
+		if (oph_io_server_reader_load_spawn(&(loaders.procs[i])))
+			break;
+	loaders.num = loaders.alive = i;
+
+	if (!loaders.num) {
+		free(loaders.procs);
+		loaders.procs = NULL;
+		return OPH_IO_SERVER_READER_ERROR;
+	}
+
+	pmesg(LOG_DEBUG, __FILE__, __LINE__, "Started %d loader processes\n", loaders.num);
+#endif
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+//Function used to stop the processes of a pool: closing the stream makes a process exit once its current request is served, then the process is reaped
+static void oph_io_server_reader_close(oph_io_server_reader_pool * pool)
+{
+	unsigned short i, num;
+	oph_io_server_reader *procs;
+
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < pool->num; i++)
+		if (pool->procs[i].fd >= 0) {
+			close(pool->procs[i].fd);
+			pool->procs[i].fd = -1;
+		}
+	procs = pool->procs;
+	num = pool->num;
+	pool->procs = NULL;
+	pool->num = pool->alive = 0;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < num; i++)
+		if (procs[i].pid > 0)
+			waitpid(procs[i].pid, NULL, 0);
+	if (procs)
+		free(procs);
+}
+
+int oph_io_server_reader_stop()
+{
+	oph_io_server_reader_close(&readers);
+	oph_io_server_reader_close(&loaders);
+
+	return OPH_IO_SERVER_READER_SUCCESS;
+}
+
+int oph_io_server_reader_read(char source, char *src_path, char *measure_name, unsigned long long tuplexfrag_number, long long frag_key_start, char compressed_flag, int dim_num,
+			      short int *dims_type, short int *dims_index, int *dims_start, int *dims_end, int dim_unlim, char *sub_operation, char *sub_args, oph_iostore_frag_record_set * binary_frag,
+			      unsigned long long *frag_size)
+{
+#if !defined(OPH_IO_SERVER_NETCDF) && !defined(OPH_IO_SERVER_ESDM)
+	UNUSED(source);
+	UNUSED(src_path);
+	UNUSED(measure_name);
+	UNUSED(tuplexfrag_number);
+	UNUSED(frag_key_start);
+	UNUSED(compressed_flag);
+	UNUSED(dim_num);
+	UNUSED(dims_type);
+	UNUSED(dims_index);
+	UNUSED(dims_start);
+	UNUSED(dims_end);
+	UNUSED(dim_unlim);
+	UNUSED(sub_operation);
+	UNUSED(sub_args);
+	UNUSED(binary_frag);
+	UNUSED(frag_size);
+#endif
+
+	//Reader processes do not have a pool, so they serve requests locally
+	if (!readers.num)
+		return OPH_IO_SERVER_READER_LOCAL;
+
+#if defined(OPH_IO_SERVER_NETCDF) || defined(OPH_IO_SERVER_ESDM)
+	if (!src_path || !measure_name || !dim_num || !dims_type || !dims_index || !dims_start || !dims_end || !binary_frag || !frag_size)
+		return OPH_IO_SERVER_READER_LOCAL;
+
+	int i = oph_io_server_reader_acquire(&readers);
+	if (i < 0)
+		return OPH_IO_SERVER_READER_LOCAL;
+
+	oph_io_server_reader_request request;
+	memset(&request, 0, sizeof(oph_io_server_reader_request));
+	request.tuplexfrag_number = tuplexfrag_number;
+	request.frag_key_start = frag_key_start;
+	request.dim_num = dim_num;
+	request.dim_unlim = dim_unlim;
+	request.field_num = binary_frag->field_num;
+	request.compressed_flag = compressed_flag;
+	request.source = source;
+
+	int res = oph_io_server_reader_exchange(readers.procs[i].fd, &request, src_path, measure_name, dims_type, dims_index, dims_start, dims_end, sub_operation, sub_args, binary_frag,
+						frag_size);
+	oph_io_server_reader_release(&readers, i, res == OPH_IO_SERVER_READER_ERROR);
+	if (res == OPH_IO_SERVER_READER_ERROR) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, "Reader process failed while reading '%s'\n", src_path);
+		logging(LOG_ERROR, __FILE__, __LINE__, "Reader process failed while reading '%s'\n", src_path);
+		return OPH_IO_SERVER_EXEC_ERROR;
+	}
+
+	return res;
+#else
+	return OPH_IO_SERVER_READER_LOCAL;
+#endif
+}
+
+int oph_io_server_reader_load(char *msg, unsigned int msg_len)
+{
+#ifdef OPH_PAR_NC4
+	int i, res;
+	if ((i = oph_io_server_reader_acquire(&loaders)) >= 0) {
+		res = oph_io_server_reader_load_exchange(loaders.procs[i].fd, msg, msg_len);
+		oph_io_server_reader_release(&loaders, i, res == OPH_IO_SERVER_READER_ERROR);
+		if (res != OPH_IO_SERVER_READER_ERROR)
+			return res;
+	}
+	//No persistent loader is available: a new one is executed to serve the request
+	oph_io_server_reader loader;
+	if (oph_io_server_reader_load_spawn(&loader))
+		return OPH_IO_SERVER_EXEC_ERROR;
+	res = oph_io_server_reader_load_exchange(loader.fd, msg, msg_len);
+	close(loader.fd);
+	waitpid(loader.pid, NULL, 0);
+
+	return res == OPH_IO_SERVER_READER_ERROR ? OPH_IO_SERVER_EXEC_ERROR : res;
+#else
+	UNUSED(msg);
+	UNUSED(msg_len);
+	return OPH_IO_SERVER_EXEC_ERROR;
+#endif
+}
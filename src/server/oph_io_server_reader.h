@@ -0,0 +1,86 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPH_IO_SERVER_READER_H
+#define OPH_IO_SERVER_READER_H
+
+#include "oph_iostorage_data.h"
+
+//NetCDF and ESDM libraries are not thread-safe, so in-process reads are serialized by nc_lock. Imports are rather routed to a pool of reader processes,
+//forked at startup, each one with its own library state: request and fragment rows are exchanged on a socket pair, the caller waits for the reply
+//while the other readers serve other imports.
+
+#define OPH_IO_SERVER_READER_SUCCESS 0
+#define OPH_IO_SERVER_READER_ERROR -1
+//Returned when no reader process is available: the request has to be served by the calling thread
+#define OPH_IO_SERVER_READER_LOCAL -2
+
+//Source codes of reader requests
+#define OPH_IO_SERVER_READER_NETCDF 'N'
+#define OPH_IO_SERVER_READER_ESDM 'E'
+
+//Field length used to send NULL fields
+#define OPH_IO_SERVER_READER_NULL_FIELD ((unsigned long long) -1)
+
+//Slabs to be loaded in shared memory are read by loaders, i.e. oph_io_server_nc_load started with OPH_IO_SERVER_READER_LOAD_OPTION at startup:
+//requests MSG_LEN|MSG are sent on a socket used as stdin and stdout of the loader, which replies with its status code
+#define OPH_IO_SERVER_READER_LOAD_OPTION "-p"
+//Time (ms) after which an idle loader detaches the last shared memory segment
+#define OPH_IO_SERVER_READER_LOAD_IDLE 1000
+
+/**
+ * \brief               Function used to fork the reader processes; it has to be called before any other thread is started
+ * \param reader_num    Number of reader processes (0 to read files in the calling threads)
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_reader_start(unsigned short reader_num);
+
+/**
+ * \brief               Function used to start the loader processes; each reader process starts its own loader
+ * \param loader_num    Number of loader processes
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_reader_load_start(unsigned short loader_num);
+
+/**
+ * \brief               Function used to stop reader and loader processes (they exit as soon as their socket is closed) and to wait for their termination; it must be called when no request is being served
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_reader_stop();
+
+/**
+ * \brief               Function used to read a fragment with a reader process; arguments are the same of _oph_ioserver_nc_read and _oph_ioserver_esdm_read
+ * \param source        Source code (OPH_IO_SERVER_READER_NETCDF or OPH_IO_SERVER_READER_ESDM)
+ * \param sub_operation Operation to be applied to ESDM data (can be NULL)
+ * \param sub_args      Arguments of sub_operation (can be NULL)
+ * \param dim_unlim     Index of the unlimited dimension (NetCDF only)
+ * \return              0 if successfull, OPH_IO_SERVER_READER_LOCAL if no reader is available, an OPH_IO_SERVER error code otherwise
+ */
+int oph_io_server_reader_read(char source, char *src_path, char *measure_name, unsigned long long tuplexfrag_number, long long frag_key_start, char compressed_flag, int dim_num,
+			      short int *dims_type, short int *dims_index, int *dims_start, int *dims_end, int dim_unlim, char *sub_operation, char *sub_args, oph_iostore_frag_record_set * binary_frag,
+			      unsigned long long *frag_size);
+
+/**
+ * \brief               Function used to load a slab in shared memory with an idle loader process (a new loader is executed if none is available)
+ * \param msg           Message with request for oph_io_server_nc_load
+ * \param msg_len       Length of message
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_reader_load(char *msg, unsigned int msg_len);
+
+#endif				/* OPH_IO_SERVER_READER_H */
@@ -0,0 +1,303 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "oph_io_server_query_manager.h"
+#include "oph_io_server_sort.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+
+extern int msglevel;
+
+#define OPH_IO_SERVER_SORT_SIGN_BIT 0x8000000000000000ULL
+
+//Radix sort processes a byte of the keys at each pass
+#define OPH_IO_SERVER_SORT_RADIX_BITS 8
+#define OPH_IO_SERVER_SORT_RADIX_SIZE (1 << OPH_IO_SERVER_SORT_RADIX_BITS)
+#define OPH_IO_SERVER_SORT_RADIX_MASK (OPH_IO_SERVER_SORT_RADIX_SIZE - 1)
+//Below this number of rows merge sort is used also for numeric keys
+#define OPH_IO_SERVER_SORT_RADIX_MIN_ROWS 256
+
+/**
+ * \brief			        Structure used to sort a row
+ * \param key           Numeric key mapped so that unsigned order corresponds to the requested one (not used for strings)
+ * \param index         Position of the row in input, used to break ties
+ * \param record        Pointer to the row
+ */
+typedef struct {
+	unsigned long long key;
+	long long index;
+	oph_iostore_frag_record *record;
+} oph_io_server_sort_item;
+
+static unsigned long long _oph_io_server_sort_key(oph_iostore_frag_record * record, int field, oph_iostore_field_type type, char direction)
+{
+	unsigned long long key = 0;
+
+	if (record->field[field]) {
+		if (type == OPH_IOSTORE_LONG_TYPE)
+			key = ((unsigned long long) *((long long *) record->field[field])) ^ OPH_IO_SERVER_SORT_SIGN_BIT;
+		else {
+			double value = *((double *) record->field[field]);
+			//-0 and +0 have to be equal
+			if (value == 0)
+				value = 0;
+			memcpy(&key, &value, sizeof(unsigned long long));
+			key = (key & OPH_IO_SERVER_SORT_SIGN_BIT) ? ~key : key ^ OPH_IO_SERVER_SORT_SIGN_BIT;
+		}
+	}
+
+	return direction == OPH_IO_SERVER_SORT_DESC ? ~key : key;
+}
+
+static int _oph_io_server_sort_compare_strings(oph_iostore_frag_record * a, oph_iostore_frag_record * b, int field, char direction)
+{
+	int res = 0;
+
+	if (!a->field[field] || !b->field[field])
+		res = (a->field[field] != NULL) - (b->field[field] != NULL);
+	else {
+		unsigned long long length_a = a->field_length[field], length_b = b->field_length[field];
+		res = memcmp(a->field[field], b->field[field], length_a < length_b ? length_a : length_b);
+		if (!res)
+			res = (length_a > length_b) - (length_a < length_b);
+		else
+			res = res > 0 ? 1 : -1;
+	}
+
+	return direction == OPH_IO_SERVER_SORT_DESC ? -res : res;
+}
+
+static int _oph_io_server_sort_compare_rows(oph_iostore_frag_record * a, oph_iostore_frag_record * b, int field, oph_iostore_field_type type, char direction)
+{
+	if (type == OPH_IOSTORE_STRING_TYPE)
+		return _oph_io_server_sort_compare_strings(a, b, field, direction);
+
+	unsigned long long key_a = _oph_io_server_sort_key(a, field, type, direction), key_b = _oph_io_server_sort_key(b, field, type, direction);
+	return (key_a > key_b) - (key_a < key_b);
+}
+
+static int _oph_io_server_sort_compare_items(oph_io_server_sort_item * a, oph_io_server_sort_item * b, int field, oph_iostore_field_type type, char direction)
+{
+	int res = 0;
+
+	if (type == OPH_IOSTORE_STRING_TYPE)
+		res = _oph_io_server_sort_compare_strings(a->record, b->record, field, direction);
+	else
+		res = (a->key > b->key) - (a->key < b->key);
+	if (!res)
+		res = (a->index > b->index) - (a->index < b->index);
+
+	return res;
+}
+
+static void _oph_io_server_sort_radix(oph_io_server_sort_item * items, oph_io_server_sort_item * tmp, long long row_num)
+{
+	long long count[OPH_IO_SERVER_SORT_RADIX_SIZE], position = 0, i = 0;
+	oph_io_server_sort_item *src = items, *dst = tmp, *swap = NULL;
+	unsigned int shift = 0, digit = 0;
+
+	for (shift = 0; shift < 8 * sizeof(unsigned long long); shift += OPH_IO_SERVER_SORT_RADIX_BITS) {
+		memset(count, 0, sizeof(count));
+		for (i = 0; i < row_num; i++)
+			count[(src[i].key >> shift) & OPH_IO_SERVER_SORT_RADIX_MASK]++;
+		//Skip the pass if all the keys have the same digit (e.g. high bytes of ids)
+		if (count[(src[0].key >> shift) & OPH_IO_SERVER_SORT_RADIX_MASK] == row_num)
+			continue;
+		for (digit = 0, position = 0; digit < OPH_IO_SERVER_SORT_RADIX_SIZE; digit++) {
+			i = count[digit];
+			count[digit] = position;
+			position += i;
+		}
+		for (i = 0; i < row_num; i++)
+			dst[count[(src[i].key >> shift) & OPH_IO_SERVER_SORT_RADIX_MASK]++] = src[i];
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != items)
+		memcpy(items, src, row_num * sizeof(oph_io_server_sort_item));
+}
+
+static void _oph_io_server_sort_merge(oph_io_server_sort_item * items, oph_io_server_sort_item * tmp, long long row_num, int field, oph_iostore_field_type type, char direction)
+{
+	long long width = 0, left = 0, middle = 0, right = 0, i = 0, j = 0, k = 0;
+	oph_io_server_sort_item *src = items, *dst = tmp, *swap = NULL;
+
+	for (width = 1; width < row_num; width *= 2) {
+		for (left = 0; left < row_num; left += 2 * width) {
+			middle = left + width < row_num ? left + width : row_num;
+			right = left + 2 * width < row_num ? left + 2 * width : row_num;
+			for (i = left, j = middle, k = left; i < middle && j < right; k++)
+				dst[k] = _oph_io_server_sort_compare_items(src + j, src + i, field, type, direction) < 0 ? src[j++] : src[i++];
+			while (i < middle)
+				dst[k++] = src[i++];
+			while (j < right)
+				dst[k++] = src[j++];
+		}
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != items)
+		memcpy(items, src, row_num * sizeof(oph_io_server_sort_item));
+}
+
+static void _oph_io_server_sort_heap_down(oph_io_server_sort_item * heap, long long heap_num, int field, oph_iostore_field_type type, char direction)
+{
+	long long parent = 0, child = 0;
+	oph_io_server_sort_item item = heap[0];
+
+	while ((child = 2 * parent + 1) < heap_num) {
+		if (child + 1 < heap_num && _oph_io_server_sort_compare_items(heap + child + 1, heap + child, field, type, direction) > 0)
+			child++;
+		if (_oph_io_server_sort_compare_items(heap + child, &item, field, type, direction) <= 0)
+			break;
+		heap[parent] = heap[child];
+		parent = child;
+	}
+	heap[parent] = item;
+}
+
+static void _oph_io_server_sort_heap_up(oph_io_server_sort_item * heap, long long heap_num, int field, oph_iostore_field_type type, char direction)
+{
+	long long child = heap_num - 1, parent = 0;
+	oph_io_server_sort_item item = heap[child];
+
+	while (child > 0) {
+		parent = (child - 1) / 2;
+		if (_oph_io_server_sort_compare_items(heap + parent, &item, field, type, direction) >= 0)
+			break;
+		heap[child] = heap[parent];
+		child = parent;
+	}
+	heap[child] = item;
+}
+
+int oph_io_server_sort_check(oph_iostore_frag_record ** records, long long row_num, int field, oph_iostore_field_type type, char direction, char *order)
+{
+	if (!records || !order) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	char sorted = 1, reversed = 1;
+	long long i = 0;
+	int res = 0;
+
+	for (i = 1; i < row_num && (sorted || reversed); i++) {
+		res = _oph_io_server_sort_compare_rows(records[i - 1], records[i], field, type, direction);
+		if (res > 0)
+			sorted = 0;
+		if (res >= 0)
+			reversed = 0;
+	}
+	*order = sorted ? OPH_IO_SERVER_SORT_SORTED : (reversed ? OPH_IO_SERVER_SORT_REVERSED : OPH_IO_SERVER_SORT_UNSORTED);
+
+	return OPH_IO_SERVER_SUCCESS;
+}
+
+int oph_io_server_sort_records(oph_iostore_frag_record ** records, long long row_num, int field, oph_iostore_field_type type, char direction, long long top_num)
+{
+	if (!records) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_NULL_INPUT_PARAM);
+		return OPH_IO_SERVER_NULL_PARAM;
+	}
+
+	if (row_num < 2)
+		return OPH_IO_SERVER_SUCCESS;
+	if (top_num <= 0 || top_num > row_num)
+		top_num = row_num;
+
+	//Ids are usually monotonic, so check the order before sorting
+	char order = OPH_IO_SERVER_SORT_UNSORTED;
+	oph_io_server_sort_check(records, row_num, field, type, direction, &order);
+	if (order == OPH_IO_SERVER_SORT_SORTED)
+		return OPH_IO_SERVER_SUCCESS;
+
+	long long i = 0, j = 0;
+	oph_iostore_frag_record *tmp = NULL;
+	if (order == OPH_IO_SERVER_SORT_REVERSED) {
+		for (i = 0, j = row_num - 1; i < j; i++, j--) {
+			tmp = records[i];
+			records[i] = records[j];
+			records[j] = tmp;
+		}
+		return OPH_IO_SERVER_SUCCESS;
+	}
+
+	oph_io_server_sort_item *items = (oph_io_server_sort_item *) malloc(2 * top_num * sizeof(oph_io_server_sort_item));
+	if (!items) {
+		pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+		return OPH_IO_SERVER_MEMORY_ERROR;
+	}
+
+	oph_io_server_sort_item item;
+	if (top_num < row_num) {
+		//Keep the first top_num rows in a max-heap, whose root is the row to be dropped first
+		char *selected = (char *) calloc(row_num, sizeof(char));
+		if (!selected) {
+			pmesg(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			logging(LOG_ERROR, __FILE__, __LINE__, OPH_IO_SERVER_LOG_MEMORY_ALLOC_ERROR);
+			free(items);
+			return OPH_IO_SERVER_MEMORY_ERROR;
+		}
+		long long heap_num = 0;
+		for (i = 0; i < row_num; i++) {
+			item.key = type == OPH_IOSTORE_STRING_TYPE ? 0 : _oph_io_server_sort_key(records[i], field, type, direction);
+			item.index = i;
+			item.record = records[i];
+			if (heap_num < top_num) {
+				items[heap_num++] = item;
+				_oph_io_server_sort_heap_up(items, heap_num, field, type, direction);
+			} else if (_oph_io_server_sort_compare_items(&item, items, field, type, direction) < 0) {
+				items[0] = item;
+				_oph_io_server_sort_heap_down(items, heap_num, field, type, direction);
+			}
+		}
+		for (i = 0; i < top_num; i++)
+			selected[items[i].index] = 1;
+		//Move the other rows after the selected ones
+		oph_iostore_frag_record **tail = records + top_num;
+		for (i = 0, j = row_num - top_num - 1; i < row_num && j >= 0; i++)
+			if (!selected[row_num - 1 - i])
+				tail[j--] = records[row_num - 1 - i];
+		free(selected);
+	} else {
+		for (i = 0; i < row_num; i++) {
+			items[i].key = type == OPH_IOSTORE_STRING_TYPE ? 0 : _oph_io_server_sort_key(records[i], field, type, direction);
+			items[i].index = i;
+			items[i].record = records[i];
+		}
+	}
+
+	if (type != OPH_IOSTORE_STRING_TYPE && top_num >= OPH_IO_SERVER_SORT_RADIX_MIN_ROWS && top_num == row_num)
+		_oph_io_server_sort_radix(items, items + top_num, top_num);
+	else
+		_oph_io_server_sort_merge(items, items + top_num, top_num, field, type, direction);
+
+	for (i = 0; i < top_num; i++)
+		records[i] = items[i].record;
+	free(items);
+
+	return OPH_IO_SERVER_SUCCESS;
+}
@@ -0,0 +1,61 @@
+/*
+    Ophidia IO Server
+    Copyright (C) 2014-2024 CMCC Foundation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPH_IO_SERVER_SORT_H
+#define OPH_IO_SERVER_SORT_H
+
+#include "oph_iostorage_data.h"
+
+//Rows are sorted by a single column: numeric keys (long and double) are mapped on unsigned 64-bit keys and sorted by LSD radix sort,
+//strings (and binary arrays) are sorted by a stable merge sort. Ties always preserve input order and NULL values come first in ascending order.
+
+//Sort directions
+#define OPH_IO_SERVER_SORT_ASC 0
+#define OPH_IO_SERVER_SORT_DESC 1
+
+//Order of a sequence of rows with respect to a direction
+#define OPH_IO_SERVER_SORT_UNSORTED 0
+#define OPH_IO_SERVER_SORT_SORTED 1
+//Rows strictly ordered in the opposite direction: reversing them is enough
+#define OPH_IO_SERVER_SORT_REVERSED 2
+
+/**
+ * \brief               Function used to check if a sequence of rows is already ordered by a column
+ * \param records       Array of rows
+ * \param row_num       Number of rows
+ * \param field         Index of the column
+ * \param type          Type of the column
+ * \param direction     Sort direction (OPH_IO_SERVER_SORT_ASC or OPH_IO_SERVER_SORT_DESC)
+ * \param order         Pointer to be filled with OPH_IO_SERVER_SORT_SORTED, OPH_IO_SERVER_SORT_REVERSED or OPH_IO_SERVER_SORT_UNSORTED
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_sort_check(oph_iostore_frag_record ** records, long long row_num, int field, oph_iostore_field_type type, char direction, char *order);
+
+/**
+ * \brief               Function used to sort rows by a column; no work is done if rows are already ordered
+ * \param records       Array of rows to be sorted in place
+ * \param row_num       Number of rows
+ * \param field         Index of the column
+ * \param type          Type of the column
+ * \param direction     Sort direction (OPH_IO_SERVER_SORT_ASC or OPH_IO_SERVER_SORT_DESC)
+ * \param top_num       If positive and lower than row_num, only the first top_num rows are ordered (with a bounded heap); the other rows follow them in no specific order
+ * \return              0 if successfull, non-0 otherwise
+ */
+int oph_io_server_sort_records(oph_iostore_frag_record ** records, long long row_num, int field, oph_iostore_field_type type, char direction, long long top_num);
+
+#endif				/* OPH_IO_SERVER_SORT_H */
@@ -22,7 +22,10 @@
 // Prototypes
 
 #include "oph_iostorage_interface.h"
+#include "oph_network.h"
 #include <pthread.h>
+#include <time.h>
+#include <limits.h>
 
 //Packet codes
 
@@ -35,19 +38,75 @@
 #define OPH_IO_SERVER_MSG_USE_DB "UD"
 #define OPH_IO_SERVER_MSG_SET_QUERY "SQ"
 #define OPH_IO_SERVER_MSG_EXEC_QUERY "EQ"
+#define OPH_IO_SERVER_MSG_RESULT_STREAM "RF"
+#define OPH_IO_SERVER_MSG_RESULT_PART "RP"
+#define OPH_IO_SERVER_MSG_RESULT_END "RE"
+#define OPH_IO_SERVER_MSG_RESULT_TYPES "RT"
+#define OPH_IO_SERVER_MSG_RESULT_SHM "RM"
+#define OPH_IO_SERVER_MSG_PING_OPTIONS "PO"
+#define OPH_IO_SERVER_MSG_TAGGED "TQ"
+#define OPH_IO_SERVER_MSG_TAGGED_REPLY "TR"
+#define OPH_IO_SERVER_MSG_BATCH_QUERY "BQ"
 
 #define OPH_IO_SERVER_MSG_ARG_DATA_LONG "DL"
 #define OPH_IO_SERVER_MSG_ARG_DATA_DOUBLE "DD"
 #define OPH_IO_SERVER_MSG_ARG_DATA_NULL "DN"
 #define OPH_IO_SERVER_MSG_ARG_DATA_VARCHAR "DV"
 #define OPH_IO_SERVER_MSG_ARG_DATA_BLOB "DB"
+#define OPH_IO_SERVER_MSG_ARG_DATA_SHM "DM"
+#define OPH_IO_SERVER_MSG_ARG_DATA_COMPRESSED "DZ"
 
 #define OPH_IO_SERVER_REQ_ERROR   "ER"
 
+//Tagged requests TYPE|REQUEST_ID|REQUEST are answered with TYPE|REQUEST_ID|REPLY, so that several requests can be sent without waiting for replies
+#define OPH_IO_SERVER_TAGGED_HEADER_LEN (OPH_IO_SERVER_MSG_TYPE_LEN + OPH_IO_SERVER_MSG_SHORT_LEN)
+
+//Query batches TYPE|FLAGS|QUERY_NUM|QUERY1|QUERY2|... are answered with TYPE|QUERY_NUM|STATUS1|STATUS2|..., with a status byte for each query
+#define OPH_IO_SERVER_BATCH_STOP_ON_ERROR 0x1
+#define OPH_IO_SERVER_BATCH_DONE 0
+#define OPH_IO_SERVER_BATCH_FAILED 1
+#define OPH_IO_SERVER_BATCH_SKIPPED 2
+
+//Protocol options negotiated with PO message
+#define OPH_IO_SERVER_OPT_BINARY_NUMBERS 0x1
+#define OPH_IO_SERVER_OPT_SHARED_MEMORY 0x2
+#define OPH_IO_SERVER_OPT_COMPRESSION 0x4
+#define OPH_IO_SERVER_SUPPORTED_OPTIONS (OPH_IO_SERVER_OPT_BINARY_NUMBERS | OPH_IO_SERVER_OPT_SHARED_MEMORY | OPH_IO_SERVER_OPT_COMPRESSION)
+
+//Shared memory transfers, enabled only on local connections: large arguments ARG_LEN|TYPE|SEGMENT_OFFSET are stored in a segment passed with the request,
+//streamed result sets are sent as a single part TYPE|PAYLOAD_LENGTH|NUM_ROWS|NUM_FIELDS|MARKER, where the marker byte carries the segment with the payload
+
+//Compression, enabled only if the server is built with zlib: binary arguments ARG_LEN|TYPE|RAW_LEN|DATA and fields of streamed result sets FIELD_LEN|RAW_LEN|DATA
+//of at least OPH_IO_SERVER_COMPRESS_LEN bytes can be compressed; compressed fields have the highest bit of FIELD_LEN set and are sent as they are when compression does not pay
+#define OPH_IO_SERVER_COMPRESS_LEN 4096
+#define OPH_IO_SERVER_FIELD_COMPRESSED (1ULL << 63)
+
+//Field type codes sent in result type header
+#define OPH_IO_SERVER_FIELD_TYPE_LONG 'L'
+#define OPH_IO_SERVER_FIELD_TYPE_REAL 'R'
+#define OPH_IO_SERVER_FIELD_TYPE_STRING 'S'
+
 // enum and struct
 #define OPH_IO_SERVER_MAX_LONG_LEN 24
 #define OPH_IO_SERVER_MAX_DOUBLE_LEN 32
 
+//Result set streaming: each part is TYPE|PAYLOAD_LENGTH|NUM_ROWS|NUM_FIELDS|PAYLOAD, the end marker is TYPE|TOTAL_ROWS|NUM_FIELDS
+//With binary numbers the parts are preceded by the type header TYPE|NUM_FIELDS|FIELD_TYPES
+//Result sets are sent with vectored writes: fields longer than OPH_IO_SERVER_RESULT_COPY_LEN are sent from record set memory, the remaining bytes are copied
+//in a side buffer of OPH_IO_SERVER_RESULT_FRAME_LEN bytes; each write sends up to OPH_IO_SERVER_RESULT_FRAME_NUM parts worth of data
+#define OPH_IO_SERVER_RESULT_FRAME_LEN 262144
+#define OPH_IO_SERVER_RESULT_FRAME_NUM 4
+#define OPH_IO_SERVER_RESULT_COPY_LEN 512
+#define OPH_IO_SERVER_RESULT_ZEROCOPY_LEN 65536
+//Max number of ms to wait for zero-copy transmissions before the result set is released
+#define OPH_IO_SERVER_ZEROCOPY_TIMEOUT 5000
+#ifdef IOV_MAX
+#define OPH_IO_SERVER_RESULT_IOV_NUM IOV_MAX
+#else
+#define OPH_IO_SERVER_RESULT_IOV_NUM 1024
+#endif
+#define OPH_IO_SERVER_RESULT_HEADER_LEN (OPH_IO_SERVER_MSG_TYPE_LEN + 2 * OPH_IO_SERVER_MSG_LONG_LEN + OPH_IO_SERVER_MSG_SHORT_LEN)
+
 /**
  * \brief			            Structure to contain info about a running statement (query executed in multiple runs)
  * \param tot_run         Total number of times the query should be executed
@@ -72,6 +131,8 @@ typedef struct {
  * \param current_db 	    Pointer to current (default) database, if defined
  * \param last_result_set	Pointer to last result set retrieved by a selection query
  * \param delete_only_rs	Flag set to 1 if only record set structure should be deleted
+ * \param stored_rs	    Stored record set whose records are referred by last result set, released with it (can be NULL)
+ * \param unpin_stored_rs	Flag set to 1 if stored record set is kept by a transient device, so it has only to be unpinned
  * \param device        	Device selected for operations
  * \param curr_stmt       Current statement being executed, if any
  */
@@ -80,10 +141,66 @@ typedef struct {
 	char *current_db;
 	oph_iostore_frag_record_set *last_result_set;
 	char delete_only_rs;
+	oph_iostore_frag_record_set *stored_rs;
+	char unpin_stored_rs;
 	char *device;
 	oph_io_server_running_stmt *curr_stmt;
 } oph_io_server_thread_status;
 
+/**
+ * \brief			            Structure to collect statistics about data compressed on a connection
+ * \param frames          Number of arguments or fields processed
+ * \param raw_len         Number of bytes before compression
+ * \param packed_len      Number of bytes after compression
+ * \param time            Time spent to compress or uncompress data (seconds)
+ */
+typedef struct {
+	unsigned long long frames;
+	unsigned long long raw_len;
+	unsigned long long packed_len;
+	double time;
+} oph_io_server_compression_stats;
+
+/**
+ * \brief			            Structure to store info about a client connection handled by the worker pool
+ * \param sockfd          Socket descriptor related to connection
+ * \param buffer          Input buffer with bytes received but not yet processed
+ * \param buffer_size     Size of input buffer
+ * \param buffer_len      Number of valid bytes in input buffer
+ * \param last_access     Time of last activity on connection
+ * \param busy            Flag set to 1 while connection is queued or served by a worker
+ * \param options         Protocol options negotiated with the client
+ * \param zerocopy        Flag set to 1 if zero-copy transmission is enabled on socket
+ * \param zerocopy_sends  Zero-copy transmissions started on socket
+ * \param local           Flag set to 1 if client is connected to local (AF_UNIX) socket
+ * \param fds             Descriptors received from a local client and not yet used by requests
+ * \param fd_num          Number of descriptors received
+ * \param sent_stats      Statistics about result sets compressed by the server
+ * \param received_stats  Statistics about arguments compressed by the client
+ * \param status          Status of the session related to connection
+ * \param next            Pointer to next connection in connection list
+ * \param next_ready      Pointer to next connection in worker queue
+ */
+typedef struct _oph_io_server_connection {
+	int sockfd;
+	char *buffer;
+	unsigned long long buffer_size;
+	unsigned long long buffer_len;
+	time_t last_access;
+	char busy;
+	unsigned int options;
+	char zerocopy;
+	oph_net_zerocopy zerocopy_sends;
+	char local;
+	int *fds;
+	unsigned int fd_num;
+	oph_io_server_compression_stats sent_stats;
+	oph_io_server_compression_stats received_stats;
+	oph_io_server_thread_status status;
+	struct _oph_io_server_connection *next;
+	struct _oph_io_server_connection *next_ready;
+} oph_io_server_connection;
+
 /**
  * \brief               Function used to release thread status resources
  * \param status        Thread status
@@ -92,11 +209,29 @@ typedef struct {
 int oph_io_server_free_status(oph_io_server_thread_status * status);
 
 /**
- * \brief               Thread function used by IO server
- * \param sockfd        Socket descriptor related to thread
- * \param tid        Thread ID
+ * \brief               Function used to send an error message to the client
+ * \param sockfd        Socket descriptor related to client
  * \return              0 if successfull, non-0 otherwise
  */
-void oph_io_server_thread(int sockfd, pthread_t tid);
+int oph_io_server_send_error(int sockfd);
+
+/**
+ * \brief               Function used to check if a buffer begins with a complete request (without consuming it)
+ * \param buffer        Buffer with bytes received from client
+ * \param buffer_len    Number of bytes in buffer
+ * \param frame_len     Length of the first request, if complete
+ * \return              0 if request is complete, 1 if more bytes are needed, -1 if request is malformed
+ */
+int oph_io_server_frame_length(const char *buffer, unsigned long long buffer_len, unsigned long long *frame_len);
+
+/**
+ * \brief               Function used by worker threads to serve a single complete request stored at the beginning of connection buffer
+ * \param conn          Connection to be served
+ * \param frame_len     Length of request, as returned by oph_io_server_frame_length
+ * \param line          Worker buffer of max_packet_length bytes
+ * \param result        Worker buffer of max_packet_length bytes
+ * \return              0 if connection can be kept alive, non-0 if it has to be closed
+ */
+int oph_io_server_serve_request(oph_io_server_connection * conn, unsigned long long frame_len, char *line, char *result);
 
 #endif				/* OPH_IO_SERVER_THREAD_H */